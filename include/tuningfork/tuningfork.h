@@ -107,6 +107,8 @@ typedef uint64_t TuningFork_TraceHandle;
 typedef uint64_t TuningFork_LoadingEventHandle;
 /// A  handle used in TuningFork_startLoadingGroup
 typedef uint64_t TuningFork_LoadingGroupHandle;
+/// A handle used in TuningFork_startLoadingSpan
+typedef uint64_t TuningFork_LoadingSpanHandle;
 /// A time as milliseconds past the epoch.
 typedef uint64_t TuningFork_TimePoint;
 /// A duration in nanoseconds.
@@ -202,6 +204,9 @@ typedef enum TuningFork_ErrorCode {
     TUNINGFORK_ERROR_FRAME_LOGGING_ALREADY_RUNNING =
         39,  ///< Cannot resume frame time logging because it is already
              ///< running.
+    TUNINGFORK_ERROR_FIDELITY_PARAMS_NOT_MODIFIED =
+        40,  ///< The fidelity parameters on the server haven't changed since
+             ///< they were cached.
 
     // Error codes 100-150 are reserved for engines integrations.
 } TuningFork_ErrorCode;
@@ -453,6 +458,43 @@ TuningFork_ErrorCode TuningFork_getFidelityParameters(
 TuningFork_ErrorCode TuningFork_setCurrentAnnotation(
     const TuningFork_CProtobufSerialization* annotation);
 
+/**
+ * @brief Register an annotation ahead of time, so that it can be made current
+ * cheaply with `TuningFork_setCurrentAnnotationById`.
+ * @param annotation the protobuf serialization of the annotation.
+ * @param[out] id an id for the annotation, valid until Tuning Fork is
+ * destroyed. Registering the same annotation again gives the same id.
+ * @return TUNINGFORK_ERROR_BAD_PARAMETER if annotation or id is NULL.
+ * @return TUNINGFORK_ERROR_INVALID_ANNOTATION if the annotation couldn't be
+ * registered.
+ * @return TUNINGFORK_ERROR_OK on success.
+ */
+TuningFork_ErrorCode TuningFork_registerAnnotation(
+    const TuningFork_CProtobufSerialization* annotation, uint32_t* id);
+
+/**
+ * @brief Set the current annotation to one registered with
+ * `TuningFork_registerAnnotation`. Unlike `TuningFork_setCurrentAnnotation`,
+ * this doesn't copy or hash the annotation and doesn't allocate, so it can be
+ * called many times per frame.
+ * @param id an id returned by `TuningFork_registerAnnotation`.
+ * @return TUNINGFORK_ERROR_INVALID_ANNOTATION if id wasn't registered.
+ * @return TUNINGFORK_ERROR_OK on success.
+ */
+TuningFork_ErrorCode TuningFork_setCurrentAnnotationById(uint32_t id);
+
+/**
+ * @brief Set the swap interval that frame times are compared to when counting
+ * janky frames. If you use Swappy, call this with `SwappyGL_getSwapIntervalNS`
+ * or `SwappyVk_getSwapIntervalNS` whenever the swap interval changes. The
+ * default is 1/60th of a second. This can be called before
+ * `TuningFork_init`.
+ * @param swap_interval_ns the swap interval in nanoseconds.
+ * @return TUNINGFORK_ERROR_BAD_PARAMETER if swap_interval_ns is zero.
+ * @return TUNINGFORK_ERROR_OK on success.
+ */
+TuningFork_ErrorCode TuningFork_setSwapIntervalNanos(uint64_t swap_interval_ns);
+
 /**
  * @brief Record a frame tick that will be associated with the instrumentation
  * key and the current annotation. NB: calling the tick or trace functions from
@@ -478,6 +520,41 @@ TuningFork_ErrorCode TuningFork_frameTick(TuningFork_InstrumentKey key);
 TuningFork_ErrorCode TuningFork_frameDeltaTimeNanos(
     TuningFork_InstrumentKey key, TuningFork_Duration dt);
 
+/**
+ * @brief Record several frame times using external times in one call.
+ * This is equivalent to calling TuningFork_frameDeltaTimeNanos for each time,
+ * but checks for an upload only once.
+ * @param key an instrument key
+ * @see the reserved instrument keys above
+ * @param dts the durations you wish to record (in nanoseconds)
+ * @param n the number of durations in dts
+ * @return TUNINGFORK_ERROR_INVALID_INSTRUMENT_KEY if the instrument key is
+ * invalid.
+ * @return TUNINGFORK_ERROR_BAD_PARAMETER if dts is NULL.
+ * @return TUNINGFORK_ERROR_OK on success.
+ */
+TuningFork_ErrorCode TuningFork_frameDeltaTimeNanosBatch(
+    TuningFork_InstrumentKey key, const TuningFork_Duration* dts, size_t n);
+
+/**
+ * @brief Record several frame times for different instrument keys using
+ * external times in one call.
+ * This is equivalent to calling TuningFork_frameDeltaTimeNanos(keys[i], dts[i])
+ * for each i, but checks for an upload only once. Runs of the same key are
+ * recorded together, so it's most efficient to group times by key.
+ * @param keys the instrument key of each duration
+ * @see the reserved instrument keys above
+ * @param dts the durations you wish to record (in nanoseconds)
+ * @param n the number of keys and durations
+ * @return TUNINGFORK_ERROR_INVALID_INSTRUMENT_KEY if any instrument key is
+ * invalid. Times for the other keys are still recorded.
+ * @return TUNINGFORK_ERROR_BAD_PARAMETER if keys or dts is NULL.
+ * @return TUNINGFORK_ERROR_OK on success.
+ */
+TuningFork_ErrorCode TuningFork_frameDeltaTimeNanosMultiKeyBatch(
+    const TuningFork_InstrumentKey* keys, const TuningFork_Duration* dts,
+    size_t n);
+
 /**
  * @brief Start a trace segment.
  * @param key an instrument key
@@ -498,6 +575,50 @@ TuningFork_ErrorCode TuningFork_startTrace(TuningFork_InstrumentKey key,
  */
 TuningFork_ErrorCode TuningFork_endTrace(TuningFork_TraceHandle handle);
 
+/**
+ * @brief Formats that recorded trace events can be written in.
+ */
+typedef enum TuningFork_TraceFormat {
+    TUNINGFORK_TRACE_FORMAT_CHROME_JSON =
+        0,  ///< Chrome's JSON trace event format.
+    TUNINGFORK_TRACE_FORMAT_PERFETTO = 1,  ///< A serialized perfetto Trace.
+} TuningFork_TraceFormat;
+
+/**
+ * @brief Start recording trace events in memory.
+ *
+ * While recording, the trace sections and counters that Tuning Fork and
+ * Swappy send to systrace, such as TFTick and TFTrace, are also kept in a
+ * buffer for each thread, whether or not systrace is attached. Tuning Fork
+ * doesn't need to be initialized.
+ * @param events_per_thread The number of events each thread can record
+ * between calls to TuningFork_drainTraceRecording. Events that don't fit are
+ * dropped. 0 means the default of 2048.
+ * @return TUNINGFORK_ERROR_OK on success.
+ */
+TuningFork_ErrorCode TuningFork_startTraceRecording(uint32_t events_per_thread);
+
+/**
+ * @brief Stop recording trace events. Events already recorded are kept until
+ * drained.
+ * @return TUNINGFORK_ERROR_OK on success.
+ */
+TuningFork_ErrorCode TuningFork_stopTraceRecording();
+
+/**
+ * @brief Remove the trace events recorded so far and write them out.
+ *
+ * This can be called while recording, in which case recording continues.
+ * @param format The format to write the events in.
+ * @param[out] trace Filled with the trace. Ownership is passed to the caller:
+ * call TuningFork_CProtobufSerialization_free to deallocate it.
+ * @return TUNINGFORK_ERROR_OK on success.
+ * @return TUNINGFORK_ERROR_BAD_PARAMETER if trace is null or format is
+ * unknown.
+ */
+TuningFork_ErrorCode TuningFork_drainTraceRecording(
+    TuningFork_TraceFormat format, TuningFork_CProtobufSerialization* trace);
+
 /**
  * @brief Force upload of the current histograms.
  * @return TUNINGFORK_ERROR_OK if the upload could be initiated.
@@ -702,6 +823,42 @@ TuningFork_ErrorCode TuningFork_startLoadingGroup(
 TuningFork_ErrorCode TuningFork_stopLoadingGroup(
     TuningFork_LoadingGroupHandle handle);
 
+/**
+ * @brief Start a span of work within the current loading group, such as
+ * loading an asset or compiling a shader. Spans can be nested and can run in
+ * parallel, on any thread.
+ * When the group is stopped, its time is broken down by the stages of the
+ * spans in it, both the time in each stage and the time each stage was on
+ * the critical path, the chain of spans that the group's end waited for.
+ * This is reported with the group's loading time.
+ * @param source The stage of loading, a LoadingSource value from
+ * TuningFork_LoadingTimeMetadata.
+ * @param parent A handle from a previous call for the span this one is part
+ * of, or 0 if it is directly part of the group.
+ * @param[out] handle A handle to pass to TuningFork_stopLoadingSpan.
+ * @return TUNINGFORK_ERROR_OK on success.
+ * @return TUNINGFORK_ERROR_NO_ACTIVE_LOADING_GROUP if there is no loading
+ * group.
+ * @return TUNINGFORK_ERROR_INVALID_LOADING_HANDLE if parent isn't a span in
+ * the current group.
+ * @return TUNINGFORK_ERROR_NO_MORE_SPACE_FOR_LOADING_TIME_DATA if the group
+ * already has 256 spans.
+ **/
+TuningFork_ErrorCode TuningFork_startLoadingSpan(
+    uint32_t source, TuningFork_LoadingSpanHandle parent,
+    TuningFork_LoadingSpanHandle* handle);
+
+/**
+ * @brief Stop a span of work started with TuningFork_startLoadingSpan. Spans
+ * that are still running when their group stops end with it.
+ * @param handle A handle from TuningFork_startLoadingSpan.
+ * @return TUNINGFORK_ERROR_OK on success.
+ * @return TUNINGFORK_ERROR_INVALID_LOADING_HANDLE if the handle isn't for a
+ * running span in the current group.
+ **/
+TuningFork_ErrorCode TuningFork_stopLoadingSpan(
+    TuningFork_LoadingSpanHandle handle);
+
 /**
  * @brief The set of states that the TuningFork_reportLifecycleEvent method
  * accepts.
@@ -739,6 +896,30 @@ typedef enum TuningFork_Submission {
     TUNINGFORK_SUBMISSION_TICK_BASED = 2
 } TuningFork_Submission;
 
+/**
+ * @brief Statistics on telemetry waiting to be uploaded.
+ * @see TuningFork_getUploadQueueStats
+ */
+typedef struct TuningFork_UploadQueueStats {
+    uint32_t queued_sessions;  ///< Sessions waiting to be uploaded, including
+                               ///< ones saved while logging was paused.
+    uint64_t queued_bytes;     ///< Total size of the queued sessions.
+    uint64_t dropped_sessions;  ///< Sessions evicted or that failed to upload.
+} TuningFork_UploadQueueStats;
+
+/**
+ * @brief Frame statistics for one instrument key over a window of time, kept
+ * on the device when rollups are enabled in the settings.
+ */
+typedef struct TuningFork_RollupWindow {
+    uint64_t start_ms;       ///< Start of the window, since the epoch.
+    uint64_t length_ms;      ///< Length of the window.
+    uint64_t frames;         ///< Frames recorded, over all annotations.
+    uint64_t frame_time_ns;  ///< Total time taken by those frames.
+    uint64_t janky_frames;   ///< Frames that missed vsyncs. Not counted when
+                             ///< frames are sampled.
+} TuningFork_RollupWindow;
+
 /**
  * @brief Set the interval between histogram uploads, overriding that in
  * settings.
@@ -754,6 +935,45 @@ typedef enum TuningFork_Submission {
 TuningFork_ErrorCode TuningFork_setAggregationStrategyInterval(
     TuningFork_Submission method, uint32_t interval_ms_or_count);
 
+/**
+ * @brief Get statistics on the sessions waiting to be uploaded.
+ *
+ * Sessions that can't be uploaded, for example because there is no network
+ * connection, are kept on disk and uploaded later. When the queue is over
+ * max_upload_queue_bytes in the settings, the oldest sessions are dropped.
+ * The counts include sessions queued by previous runs of the app.
+ * @param stats Filled with the statistics. Zero if a custom backend is used.
+ * @return TUNINGFORK_ERROR_OK on success.
+ * @return TUNINGFORK_ERROR_TUNINGFORK_NOT_INITIALIZED if Tuning Fork wasn't
+ * initialized.
+ * @return TUNINGFORK_ERROR_BAD_PARAMETER if stats is null.
+ */
+TuningFork_ErrorCode TuningFork_getUploadQueueStats(
+    TuningFork_UploadQueueStats* stats);
+
+/**
+ * @brief Get the frame statistics kept on the device for recent windows of
+ * time.
+ *
+ * Level 0 has a window for each rollup slot, level 1 for each 10 slots and
+ * level 2 for each 60 slots. A window covers the sessions that ended in it,
+ * and the last window may still be added to.
+ * @param level The level of the windows, from 0 to 2.
+ * @param key The instrument key to get statistics for.
+ * @param windows Filled with the windows, oldest first. If there are more
+ * than fit, the most recent are written.
+ * @param n_windows On input, the size of windows. On output, the number of
+ * windows kept, which is 0 if rollups aren't enabled.
+ * @return TUNINGFORK_ERROR_OK on success.
+ * @return TUNINGFORK_ERROR_TUNINGFORK_NOT_INITIALIZED if Tuning Fork wasn't
+ * initialized.
+ * @return TUNINGFORK_ERROR_BAD_PARAMETER if level is out of range, n_windows
+ * is null, or windows is null and *n_windows isn't 0.
+ */
+TuningFork_ErrorCode TuningFork_getRollupWindows(
+    uint32_t level, TuningFork_InstrumentKey key,
+    TuningFork_RollupWindow* windows, uint32_t* n_windows);
+
 #ifdef __cplusplus
 }
 #endif
@@ -22,6 +22,8 @@
 
 #include <memory>
 
+#include "trace_recorder.h"
+
 namespace gamesdk {
 
 class Trace {
@@ -85,6 +87,7 @@ class Trace {
     }
 
     void beginSection(const char *name) const {
+        TraceRecorder::Begin(name);
         if (!ATrace_beginSection) {
             return;
         }
@@ -93,6 +96,7 @@ class Trace {
     }
 
     void endSection() const {
+        TraceRecorder::End();
         if (!ATrace_endSection) {
             return;
         }
@@ -101,6 +105,7 @@ class Trace {
     }
 
     void setCounter(const char *name, int64_t value) {
+        TraceRecorder::Counter(name, value);
         if (!ATrace_setCounter || !isEnabled()) {
             return;
         }
@@ -123,7 +128,8 @@ class Trace {
 struct ScopedTrace {
     ScopedTrace(const char *name) {
         Trace *trace = Trace::getInstance();
-        if (!trace->isAvailable() || !trace->isEnabled()) {
+        if (!TraceRecorder::IsRecording() &&
+            (!trace->isAvailable() || !trace->isEnabled())) {
             return;
         }
 
@@ -153,4 +159,7 @@ struct ScopedTrace {
                                       __LINE__)(__PRETTY_FUNCTION__)
 #define TRACE_INT(name, value) \
     gamesdk::Trace::getInstance()->setCounter(name, value)
-#define TRACE_ENABLED() gamesdk::Trace::getInstance()->isEnabled()
+// True if sections would be traced, by systrace or the in-process recorder.
+#define TRACE_ENABLED()                       \
+    (gamesdk::TraceRecorder::IsRecording() || \
+     gamesdk::Trace::getInstance()->isEnabled())
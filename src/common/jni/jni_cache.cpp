@@ -0,0 +1,172 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "jni/jni_cache.h"
+
+namespace gamesdk {
+
+namespace jni {
+
+/*static*/ IdCache& IdCache::Instance() {
+    static IdCache cache;
+    return cache;
+}
+
+IdCache::IdCache() {
+    for (auto& b : buckets_) b.store(nullptr, std::memory_order_relaxed);
+}
+
+IdCache::~IdCache() {
+    // There may be no JNIEnv by now, so the global references are left.
+    for (auto& b : buckets_) {
+        Entry* e = b.load(std::memory_order_relaxed);
+        while (e != nullptr) {
+            Entry* next = e->next;
+            delete e;
+            e = next;
+        }
+    }
+}
+
+/*static*/ uint32_t IdCache::Hash(Kind kind, const char* name,
+                                  const char* sig) {
+    // FNV-1a
+    uint32_t h = 2166136261u ^ static_cast<uint32_t>(kind);
+    for (const char* p = name; *p != '\0'; ++p)
+        h = (h ^ static_cast<uint8_t>(*p)) * 16777619u;
+    h *= 16777619u;
+    for (const char* p = sig; *p != '\0'; ++p)
+        h = (h ^ static_cast<uint8_t>(*p)) * 16777619u;
+    return h;
+}
+
+const IdCache::Entry* IdCache::Find(JNIEnv* env, Kind kind, uint32_t hash,
+                                    jclass clz, const char* name,
+                                    const char* sig) const {
+    for (const Entry* e =
+             buckets_[hash % kNumBuckets].load(std::memory_order_acquire);
+         e != nullptr; e = e->next) {
+        if (e->hash != hash || e->kind != kind || e->name != name ||
+            e->sig != sig)
+            continue;
+        // Methods and fields with the same name in different classes have
+        // different ids.
+        if (kind == Kind::CLASS || env->IsSameObject(e->clz, clz)) return e;
+    }
+    return nullptr;
+}
+
+const IdCache::Entry* IdCache::Add(JNIEnv* env, Kind kind, uint32_t hash,
+                                   jclass clz, const char* name,
+                                   const char* sig, void* id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const Entry* found = Find(env, kind, hash, clz, name, sig);
+    if (found != nullptr) return found;
+    auto global_clz = reinterpret_cast<jclass>(env->NewGlobalRef(clz));
+    if (global_clz == nullptr) return nullptr;
+    auto& bucket = buckets_[hash % kNumBuckets];
+    Entry* e = new Entry{kind,
+                         hash,
+                         name,
+                         sig,
+                         global_clz,
+                         kind == Kind::CLASS ? global_clz : id,
+                         bucket.load(std::memory_order_relaxed)};
+    // Publish the entry only once it is complete.
+    bucket.store(e, std::memory_order_release);
+    ++size_;
+    return e;
+}
+
+jclass IdCache::FindClass(JNIEnv* env, const char* name, ClassFinder find) {
+    uint32_t hash = Hash(Kind::CLASS, name, "");
+    const Entry* e = Find(env, Kind::CLASS, hash, nullptr, name, "");
+    if (e != nullptr)
+        return reinterpret_cast<jclass>(env->NewLocalRef(e->clz));
+    jclass clz = find(name);
+    if (clz != nullptr) Add(env, Kind::CLASS, hash, clz, name, "", nullptr);
+    return clz;
+}
+
+void* IdCache::GetId(JNIEnv* env, Kind kind, jclass clz, const char* name,
+                     const char* sig) {
+    uint32_t hash = Hash(kind, name, sig);
+    if (clz != nullptr) {
+        const Entry* e = Find(env, kind, hash, clz, name, sig);
+        if (e != nullptr) return e->id;
+    }
+    void* id = nullptr;
+    switch (kind) {
+        case Kind::METHOD:
+            id = env->GetMethodID(clz, name, sig);
+            break;
+        case Kind::STATIC_METHOD:
+            id = env->GetStaticMethodID(clz, name, sig);
+            break;
+        case Kind::FIELD:
+            id = env->GetFieldID(clz, name, sig);
+            break;
+        case Kind::STATIC_FIELD:
+            id = env->GetStaticFieldID(clz, name, sig);
+            break;
+        case Kind::CLASS:
+            break;
+    }
+    // Failed lookups leave an exception pending and aren't cached.
+    if (id != nullptr && clz != nullptr)
+        Add(env, kind, hash, clz, name, sig, id);
+    return id;
+}
+
+jmethodID IdCache::GetMethodID(JNIEnv* env, jclass clz, const char* name,
+                               const char* sig) {
+    return static_cast<jmethodID>(GetId(env, Kind::METHOD, clz, name, sig));
+}
+
+jmethodID IdCache::GetStaticMethodID(JNIEnv* env, jclass clz,
+                                     const char* name, const char* sig) {
+    return static_cast<jmethodID>(
+        GetId(env, Kind::STATIC_METHOD, clz, name, sig));
+}
+
+jfieldID IdCache::GetFieldID(JNIEnv* env, jclass clz, const char* name,
+                             const char* sig) {
+    return static_cast<jfieldID>(GetId(env, Kind::FIELD, clz, name, sig));
+}
+
+jfieldID IdCache::GetStaticFieldID(JNIEnv* env, jclass clz, const char* name,
+                                   const char* sig) {
+    return static_cast<jfieldID>(
+        GetId(env, Kind::STATIC_FIELD, clz, name, sig));
+}
+
+void IdCache::Clear(JNIEnv* env) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& b : buckets_) {
+        Entry* e = b.exchange(nullptr, std::memory_order_acq_rel);
+        while (e != nullptr) {
+            Entry* next = e->next;
+            if (env != nullptr) env->DeleteGlobalRef(e->clz);
+            delete e;
+            e = next;
+        }
+    }
+    size_ = 0;
+}
+
+}  // namespace jni
+
+}  // namespace gamesdk
@@ -0,0 +1,109 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <jni.h>
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+namespace gamesdk {
+
+namespace jni {
+
+// A cache of classes and method and field ids.
+//
+// Looking these up through JNI resolves names through the class hierarchy and,
+// for classes not visible to the system class loader, calls back into Java.
+// The wrappers make the same few calls over and over, so they go through here
+// instead. The class of each method or field is kept with a global reference,
+// which keeps it loaded and so its ids valid.
+//
+// Entries are only added, under a mutex, and are never changed once visible,
+// so lookups that hit the cache don't lock.
+class IdCache {
+   public:
+    // Look up a class the first time it is needed. Returns a local reference.
+    typedef jclass (*ClassFinder)(const char* name);
+
+    // The cache used by the jni wrappers.
+    static IdCache& Instance();
+
+    IdCache();
+    ~IdCache();
+    IdCache(const IdCache&) = delete;
+    IdCache& operator=(const IdCache&) = delete;
+
+    // Returns a new local reference to the class, as JNIEnv::FindClass would,
+    // or null, with any exception from find pending.
+    jclass FindClass(JNIEnv* env, const char* name, ClassFinder find);
+
+    // These return the same as the JNIEnv methods of the same names, which
+    // are only called the first time a name and signature are seen for a
+    // class.
+    jmethodID GetMethodID(JNIEnv* env, jclass clz, const char* name,
+                          const char* sig);
+    jmethodID GetStaticMethodID(JNIEnv* env, jclass clz, const char* name,
+                                const char* sig);
+    jfieldID GetFieldID(JNIEnv* env, jclass clz, const char* name,
+                        const char* sig);
+    jfieldID GetStaticFieldID(JNIEnv* env, jclass clz, const char* name,
+                              const char* sig);
+
+    // Remove everything and delete the global references. Nothing else may be
+    // using the cache at the same time.
+    void Clear(JNIEnv* env);
+
+    size_t Size() const { return size_; }
+
+   private:
+    enum class Kind { CLASS, METHOD, STATIC_METHOD, FIELD, STATIC_FIELD };
+
+    struct Entry {
+        Kind kind;
+        uint32_t hash;
+        std::string name;
+        std::string sig;
+        // A global reference.
+        jclass clz;
+        // The jmethodID or jfieldID, or the class itself.
+        void* id;
+        Entry* next;
+    };
+
+    static constexpr size_t kNumBuckets = 256;
+
+    static uint32_t Hash(Kind kind, const char* name, const char* sig);
+    const Entry* Find(JNIEnv* env, Kind kind, uint32_t hash, jclass clz,
+                      const char* name, const char* sig) const;
+    void* GetId(JNIEnv* env, Kind kind, jclass clz, const char* name,
+                const char* sig);
+    // Add an entry unless another thread got there first, and return the one
+    // in the cache.
+    const Entry* Add(JNIEnv* env, Kind kind, uint32_t hash, jclass clz,
+                     const char* name, const char* sig, void* id);
+
+    std::atomic<Entry*> buckets_[kNumBuckets];
+    std::mutex mutex_;
+    std::atomic<size_t> size_{0};
+};
+
+}  // namespace jni
+
+}  // namespace gamesdk
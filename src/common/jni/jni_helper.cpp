@@ -16,6 +16,7 @@
 
 #include "jni/jni_helper.h"
 
+#include "jni/jni_cache.h"
 #include "jnictx.h"
 
 namespace gamesdk {
@@ -44,7 +45,12 @@ void InitActivityClassLoader() {
 }
 
 void Init(JNIEnv* env, jobject ctx) { Ctx::Init(env, ctx); }
-void Destroy() { Ctx::Destroy(); }
+void Destroy() {
+    // The global references in the cache need an env to delete them.
+    auto& cache = IdCache::Instance();
+    if (cache.Size() > 0) cache.Clear(Env());
+    Ctx::Destroy();
+}
 bool IsValid() {
     return Ctx::Instance() != nullptr && Ctx::Instance()->IsValid();
 }
@@ -52,7 +58,7 @@ JNIEnv* Env() { return Ctx::Instance()->Env(); }
 void DetachThread() { return Ctx::Instance()->DetachThread(); }
 jobject AppContextGlobalRef() { return Ctx::Instance()->AppCtx(); }
 
-jclass FindClass(const char* class_name) {
+static jclass FindClassUncached(const char* class_name) {
     jclass jni_class = Env()->FindClass(class_name);
 
     if (jni_class == NULL) {
@@ -67,9 +73,26 @@ jclass FindClass(const char* class_name) {
     return jni_class;
 }
 
+jclass FindClass(const char* class_name) {
+    return IdCache::Instance().FindClass(Env(), class_name, FindClassUncached);
+}
+
+jmethodID GetMethodID(jclass clz, const char* name, const char* sig) {
+    return IdCache::Instance().GetMethodID(Env(), clz, name, sig);
+}
+jmethodID GetStaticMethodID(jclass clz, const char* name, const char* sig) {
+    return IdCache::Instance().GetStaticMethodID(Env(), clz, name, sig);
+}
+jfieldID GetFieldID(jclass clz, const char* name, const char* sig) {
+    return IdCache::Instance().GetFieldID(Env(), clz, name, sig);
+}
+jfieldID GetStaticFieldID(jclass clz, const char* name, const char* sig) {
+    return IdCache::Instance().GetStaticFieldID(Env(), clz, name, sig);
+}
+
 LocalObject NewObjectV(const char* cclz, const char* ctorSig, va_list argptr) {
     jclass clz = FindClass(cclz);
-    jmethodID constructor = Env()->GetMethodID(clz, "<init>", ctorSig);
+    jmethodID constructor = GetMethodID(clz, "<init>", ctorSig);
     jobject o = Env()->NewObjectV(clz, constructor, argptr);
     return LocalObject(o, clz);
 }
@@ -82,7 +105,7 @@ LocalObject NewObject(const char* cclz, const char* ctorSig, ...) {
 }
 jobject LocalObject::CallObjectMethod(const char* name, const char* sig,
                                       ...) const {
-    jmethodID mid = Env()->GetMethodID(clz_, name, sig);
+    jmethodID mid = GetMethodID(clz_, name, sig);
     va_list argptr;
     va_start(argptr, sig);
     jobject o = Env()->CallObjectMethodV(obj_, mid, argptr);
@@ -91,7 +114,7 @@ jobject LocalObject::CallObjectMethod(const char* name, const char* sig,
 }
 jobject LocalObject::CallStaticObjectMethod(const char* name, const char* sig,
                                             ...) const {
-    jmethodID mid = Env()->GetStaticMethodID(clz_, name, sig);
+    jmethodID mid = GetStaticMethodID(clz_, name, sig);
     va_list argptr;
     va_start(argptr, sig);
     jobject o = Env()->CallStaticObjectMethodV(clz_, mid, argptr);
@@ -100,7 +123,7 @@ jobject LocalObject::CallStaticObjectMethod(const char* name, const char* sig,
 }
 String LocalObject::CallStringMethod(const char* name, const char* sig,
                                      ...) const {
-    jmethodID mid = Env()->GetMethodID(clz_, name, sig);
+    jmethodID mid = GetMethodID(clz_, name, sig);
     va_list argptr;
     va_start(argptr, sig);
     jobject o = Env()->CallObjectMethodV(obj_, mid, argptr);
@@ -109,14 +132,14 @@ String LocalObject::CallStringMethod(const char* name, const char* sig,
     return s;
 }
 void LocalObject::CallVoidMethod(const char* name, const char* sig, ...) const {
-    jmethodID mid = Env()->GetMethodID(clz_, name, sig);
+    jmethodID mid = GetMethodID(clz_, name, sig);
     va_list argptr;
     va_start(argptr, sig);
     Env()->CallVoidMethodV(obj_, mid, argptr);
     va_end(argptr);
 }
 int LocalObject::CallIntMethod(const char* name, const char* sig, ...) const {
-    jmethodID mid = Env()->GetMethodID(clz_, name, sig);
+    jmethodID mid = GetMethodID(clz_, name, sig);
     va_list argptr;
     va_start(argptr, sig);
     int r = Env()->CallIntMethodV(obj_, mid, argptr);
@@ -125,7 +148,7 @@ int LocalObject::CallIntMethod(const char* name, const char* sig, ...) const {
 }
 bool LocalObject::CallBooleanMethod(const char* name, const char* sig,
                                     ...) const {
-    jmethodID mid = Env()->GetMethodID(clz_, name, sig);
+    jmethodID mid = GetMethodID(clz_, name, sig);
     va_list argptr;
     va_start(argptr, sig);
     bool r = Env()->CallBooleanMethodV(obj_, mid, argptr);
@@ -138,7 +161,7 @@ std::string GetExceptionMessage() {
     Env()->ExceptionClear();
     jclass oclass = FindClass("java/lang/Object");
     jmethodID toString =
-        Env()->GetMethodID(oclass, "toString", "()Ljava/lang/String;");
+        GetMethodID(oclass, "toString", "()Ljava/lang/String;");
     jstring s = (jstring)Env()->CallObjectMethod(exception, toString);
     const char* utf = Env()->GetStringUTFChars(s, nullptr);
     msg = utf;
@@ -166,7 +189,7 @@ bool CheckForException(std::string& msg) {
 }
 LocalObject LocalObject::GetObjectField(const char* field_name,
                                         const char* sig) const {
-    jfieldID fid = Env()->GetFieldID(clz_, field_name, sig);
+    jfieldID fid = GetFieldID(clz_, field_name, sig);
     if (!RawExceptionCheck()) {
         auto out = Env()->GetObjectField(obj_, fid);
         return LocalObject(out, nullptr);
@@ -175,21 +198,21 @@ LocalObject LocalObject::GetObjectField(const char* field_name,
     }
 }
 int LocalObject::GetIntField(const char* field_name) const {
-    jfieldID fid = Env()->GetFieldID(clz_, field_name, "I");
+    jfieldID fid = GetFieldID(clz_, field_name, "I");
     if (!RawExceptionCheck())
         return Env()->GetIntField(obj_, fid);
     else
         return BAD_FIELD;
 }
 bool LocalObject::GetBooleanField(const char* field_name) const {
-    jfieldID fid = Env()->GetFieldID(clz_, field_name, "Z");
+    jfieldID fid = GetFieldID(clz_, field_name, "Z");
     if (!RawExceptionCheck())
         return Env()->GetBooleanField(obj_, fid);
     else
         return false;
 }
 int64_t LocalObject::GetLongField(const char* field_name) const {
-    jfieldID fid = Env()->GetFieldID(clz_, field_name, "J");
+    jfieldID fid = GetFieldID(clz_, field_name, "J");
     if (!RawExceptionCheck())
         return Env()->GetLongField(obj_, fid);
     else
@@ -209,7 +232,7 @@ jni::String GetStaticStringField(const char* class_name,
     LocalObject obj;
     obj.Cast(class_name);
     jclass clz = obj;
-    jfieldID fid = env->GetStaticFieldID(clz, field_name, "Ljava/lang/String;");
+    jfieldID fid = GetStaticFieldID(clz, field_name, "Ljava/lang/String;");
     return (jstring)env->GetStaticObjectField(clz, fid);
 }
 
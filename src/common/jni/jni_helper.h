@@ -52,6 +52,11 @@ jobject AppContextGlobalRef();
 // It is the responsibility of the caller to delete the returned local
 // reference.
 jclass FindClass(const char* class_name);
+// These are the same as the JNIEnv methods but cached, see IdCache.
+jmethodID GetMethodID(jclass clz, const char* name, const char* sig);
+jmethodID GetStaticMethodID(jclass clz, const char* name, const char* sig);
+jfieldID GetFieldID(jclass clz, const char* name, const char* sig);
+jfieldID GetStaticFieldID(jclass clz, const char* name, const char* sig);
 
 // A wrapper around a jni jstring.
 // Releases the jstring and any c string pointer generated from it upon
@@ -64,6 +64,10 @@ class Object {
     String CallVSMethod(const char* name) {
         return obj_.CallStringMethod(name, "()Ljava/lang/String;");
     }
+    String CallSSMethod(const char* name, const char* a) {
+        return obj_.CallStringMethod(
+            name, "(Ljava/lang/String;)Ljava/lang/String;", String(a).J());
+    }
     void CallSSVMethod(const char* name, const char* a, const char* b) {
         obj_.CallVoidMethod(name, "(Ljava/lang/String;Ljava/lang/String;)V",
                             String(a).J(), String(b).J());
@@ -143,6 +147,15 @@ namespace io {
 class OutputStream : public Object {
    public:
     OutputStream(Object&& o) : Object(std::move(o)) {}
+    void write(const std::string& bs) {
+        auto env = Env();
+        jbyteArray jbs = env->NewByteArray(bs.size());
+        env->SetByteArrayRegion(jbs, 0, bs.size(),
+                                reinterpret_cast<const jbyte*>(bs.data()));
+        obj_.CallVoidMethod("write", "([B)V", jbs);
+        env->DeleteLocalRef(jbs);
+    }
+    void flush() { CallVVMethod("flush"); }
     void close() { CallVVMethod("close"); }
 };
 
@@ -172,6 +185,23 @@ class BufferedWriter : public Writer {
 class InputStream : public Object {
    public:
     InputStream(Object&& o) : Object(std::move(o)) {}
+    // Read until the end of the stream, in chunks rather than lines.
+    std::string readAll() {
+        constexpr int kChunkSize = 8192;
+        auto env = Env();
+        jbyteArray jbs = env->NewByteArray(kChunkSize);
+        std::string bs;
+        while (true) {
+            int n = obj_.CallIntMethod("read", "([B)I", jbs);
+            if (n <= 0 || RawExceptionCheck()) break;
+            size_t size = bs.size();
+            bs.resize(size + n);
+            env->GetByteArrayRegion(jbs, 0, n,
+                                    reinterpret_cast<jbyte*>(&bs[size]));
+        }
+        env->DeleteLocalRef(jbs);
+        return bs;
+    }
     void close() { CallVVMethod("close"); }
 };
 
@@ -211,7 +241,7 @@ class UUID : public Object {
    public:
     UUID(LocalObject&& o) : Object(std::move(o)) {}
     static UUID randomUUID() {
-        LocalObject obj(nullptr, Env()->FindClass("java/util/UUID"));
+        LocalObject obj(nullptr, FindClass("java/util/UUID"));
         auto o = obj.CallStaticObjectMethod("randomUUID", "()Ljava/util/UUID;");
         obj.SetObj(o);
         return obj;
@@ -265,6 +295,10 @@ class HttpURLConnection : public URLConnection {
     jni::String getResponseMessage() {
         return CallVSMethod("getResponseMessage");
     }
+    // Null if there's no such header.
+    jni::String getHeaderField(const std::string& name) {
+        return CallSSMethod("getHeaderField", name.c_str());
+    }
     io::InputStream getInputStream() {
         return CallVOMethod("getInputStream", "java/io/InputStream");
     }
@@ -476,8 +510,8 @@ class DebugClass {
             LocalObject obj;
             obj.Cast("android/os/Debug");
             jclass clz = obj;
-            jmethodID method = env->GetStaticMethodID(
-                clz, "getNativeHeapAllocatedSize", "()J");
+            jmethodID method =
+                GetStaticMethodID(clz, "getNativeHeapAllocatedSize", "()J");
             if (method != NULL)
                 return (uint64_t)env->CallStaticLongMethod(clz, method);
         }
@@ -491,7 +525,7 @@ class DebugClass {
             obj.Cast("android/os/Debug");
             jclass clz = obj;
             jmethodID method =
-                env->GetStaticMethodID(clz, "getNativeHeapFreeSize", "()J");
+                GetStaticMethodID(clz, "getNativeHeapFreeSize", "()J");
             if (method != NULL)
                 return (uint64_t)env->CallStaticLongMethod(clz, method);
         }
@@ -505,7 +539,7 @@ class DebugClass {
             obj.Cast("android/os/Debug");
             jclass clz = obj;
             jmethodID method =
-                env->GetStaticMethodID(clz, "getNativeHeapSize", "()J");
+                GetStaticMethodID(clz, "getNativeHeapSize", "()J");
             if (method != NULL)
                 return (uint64_t)env->CallStaticLongMethod(clz, method);
         }
@@ -518,7 +552,7 @@ class DebugClass {
             LocalObject obj;
             obj.Cast("android/os/Debug");
             jclass clz = obj;
-            jmethodID method = env->GetStaticMethodID(clz, "getPss", "()J");
+            jmethodID method = GetStaticMethodID(clz, "getPss", "()J");
             if (method != NULL)
                 return (uint64_t)env->CallStaticLongMethod(clz, method);
         }
@@ -561,7 +595,7 @@ class Process {
             LocalObject obj;
             obj.Cast("android/os/Process");
             jclass clz = obj;
-            jmethodID method = env->GetStaticMethodID(clz, "myPid", "()I");
+            jmethodID method = GetStaticMethodID(clz, "myPid", "()I");
             if (method != NULL)
                 return (uint64_t)env->CallStaticIntMethod(clz, method);
         }
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "proc_file.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstring>
+
+namespace gamesdk {
+
+constexpr size_t ProcFile::kBufferSize;
+
+namespace {
+
+bool IsSpace(char c) { return c == ' ' || c == '\t'; }
+bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+
+}  // anonymous namespace
+
+ProcFile::~ProcFile() {
+    if (fd_ >= 0) close(fd_);
+}
+
+bool ProcFile::Read() {
+    size_ = 0;
+    if (fd_ < 0) {
+        fd_ = open(path_, O_RDONLY | O_CLOEXEC);
+        if (fd_ < 0) return false;
+    }
+    // Files in /proc are generated as they are read, so a read from the
+    // start gives the current values without needing to reopen the file.
+    while (size_ < kBufferSize) {
+        ssize_t n = pread(fd_, buffer_ + size_, kBufferSize - size_, size_);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            close(fd_);
+            fd_ = -1;
+            size_ = 0;
+            return false;
+        }
+        if (n == 0) return true;
+        size_ += n;
+    }
+    // The buffer is full: drop the last line, which may be cut off.
+    while (size_ > 0 && buffer_[size_ - 1] != '\n') --size_;
+    return true;
+}
+
+/*static*/ bool ProcFile::ParseLine(const char*& p, const char* end,
+                                    const char*& key, size_t& key_size,
+                                    uint64_t& value, bool& kb) {
+    const char* line_end =
+        static_cast<const char*>(memchr(p, '\n', end - p));
+    if (line_end == nullptr) line_end = end;
+    const char* q = p;
+    p = line_end < end ? line_end + 1 : end;
+
+    key = q;
+    while (q < line_end && *q != ':') ++q;
+    if (q == line_end || q == key) return false;
+    key_size = q - key;
+    ++q;
+    while (q < line_end && IsSpace(*q)) ++q;
+    if (q == line_end || !IsDigit(*q)) return false;
+    value = 0;
+    while (q < line_end && IsDigit(*q)) value = value * 10 + (*q++ - '0');
+    while (q < line_end && IsSpace(*q)) ++q;
+    kb = line_end - q >= 2 && q[0] == 'k' && q[1] == 'B';
+    return true;
+}
+
+size_t ProcFile::GetFields(ProcField* fields, size_t n_fields) const {
+    size_t n_found = 0;
+    for (size_t i = 0; i < n_fields; ++i) fields[i].found = false;
+    ForEachField([&](const char* key, size_t key_size, uint64_t value,
+                     bool kb) {
+        for (size_t i = 0; i < n_fields; ++i) {
+            auto& field = fields[i];
+            if (!field.found && strncmp(field.key, key, key_size) == 0 &&
+                field.key[key_size] == '\0') {
+                field.value = value;
+                field.kb = kb;
+                field.found = true;
+                ++n_found;
+                break;
+            }
+        }
+    });
+    return n_found;
+}
+
+size_t ProcFile::GetNumbers(int64_t* values, size_t n_values) const {
+    const char* p = buffer_;
+    const char* end = buffer_ + size_;
+    size_t n = 0;
+    while (n < n_values) {
+        while (p < end && (IsSpace(*p) || *p == '\n')) ++p;
+        bool negative = p < end && *p == '-';
+        if (negative) ++p;
+        if (p == end || !IsDigit(*p)) break;
+        int64_t x = 0;
+        while (p < end && IsDigit(*p)) x = x * 10 + (*p++ - '0');
+        values[n++] = negative ? -x : x;
+    }
+    return n;
+}
+
+}  // namespace gamesdk
@@ -0,0 +1,98 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace gamesdk {
+
+// A field to look up in a file of "Key:   value [kB]" lines, such as
+// /proc/meminfo, /proc/self/status or /proc/self/smaps_rollup.
+struct ProcField {
+    const char* key;
+    uint64_t value = 0;
+    // Whether the value was followed by "kB".
+    bool kb = false;
+    bool found = false;
+
+    ProcField(const char* k) : key(k) {}
+};
+
+// A file under /proc that is sampled repeatedly. The file is kept open and
+// each Read rereads it with pread into a fixed buffer, so sampling doesn't
+// allocate. Files bigger than the buffer are cut at the last complete line.
+//
+// Not thread safe: each sampling thread should have its own.
+class ProcFile {
+   public:
+    static constexpr size_t kBufferSize = 4096;
+
+    // The file is opened on the first Read.
+    explicit ProcFile(const char* path) : path_(path) {}
+    ~ProcFile();
+
+    ProcFile(const ProcFile&) = delete;
+    ProcFile& operator=(const ProcFile&) = delete;
+
+    const char* Path() const { return path_; }
+
+    // Read the current contents of the file. Returns false if the file
+    // can't be opened or read.
+    bool Read();
+
+    const char* Data() const { return buffer_; }
+    size_t Size() const { return size_; }
+
+    // Fill in the given fields from the "Key: value" lines read by the last
+    // call to Read, in a single pass. Returns the number of fields found.
+    size_t GetFields(ProcField* fields, size_t n_fields) const;
+
+    // Call f(key, key_size, value, kb) for each "Key: value" line read by
+    // the last call to Read. key is not null-terminated.
+    template <typename F>
+    void ForEachField(F f) const {
+        const char* p = buffer_;
+        const char* end = buffer_ + size_;
+        while (p < end) {
+            const char* key;
+            size_t key_size;
+            uint64_t value;
+            bool kb;
+            if (ParseLine(p, end, key, key_size, value, kb))
+                f(key, key_size, value, kb);
+        }
+    }
+
+    // Read whitespace-separated numbers, as in /proc/self/statm or
+    // /proc/self/oom_score, from the start of the last read. Returns how
+    // many were read.
+    size_t GetNumbers(int64_t* values, size_t n_values) const;
+
+   private:
+    // Parse the line starting at p, leaving p at the start of the next one.
+    // Returns false if the line isn't "Key: value".
+    static bool ParseLine(const char*& p, const char* end, const char*& key,
+                          size_t& key_size, uint64_t& value, bool& kb);
+
+    const char* path_;
+    int fd_ = -1;
+    size_t size_ = 0;
+    char buffer_[kBufferSize];
+};
+
+}  // namespace gamesdk
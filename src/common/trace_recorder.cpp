@@ -0,0 +1,387 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "trace_recorder.h"
+
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace gamesdk {
+
+std::atomic<bool> TraceRecorder::recording_{false};
+std::atomic<uint32_t> TraceRecorder::generation_{0};
+
+namespace {
+
+using Event = TraceRecorder::Event;
+using EventType = TraceRecorder::EventType;
+
+// A single-producer, single-consumer ring: only the owning thread writes
+// events and advances head, and only Drain, under the registry's lock,
+// advances tail.
+struct ThreadBuffer {
+    explicit ThreadBuffer(size_t capacity)
+        : events(capacity), mask(capacity - 1) {}
+    std::vector<Event> events;
+    const uint64_t mask;
+    std::atomic<uint64_t> head{0};
+    std::atomic<uint64_t> tail{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<bool> exited{false};
+    int32_t tid = 0;
+    char name[16] = {};
+
+    // The rest is only used by the owning thread.
+    uint32_t generation = 0;
+    // The number of open sections, and for the innermost 64, whether their
+    // Begin was recorded, so that the matching End can be too.
+    int depth = 0;
+    uint64_t recorded = 0;
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    std::atomic<size_t> capacity{TraceRecorder::kDefaultEventsPerThread};
+};
+
+// Never destroyed, so that threads still running at exit can record.
+Registry& GetRegistry() {
+    static Registry* registry = new Registry;
+    return *registry;
+}
+
+struct ThreadBufferHolder {
+    ThreadBuffer* buffer = nullptr;
+    ~ThreadBufferHolder() {
+        // Drain frees the buffer once it has been emptied.
+        if (buffer != nullptr) buffer->exited.store(true);
+        buffer = nullptr;
+    }
+};
+
+thread_local ThreadBufferHolder this_thread_buffer;
+
+ThreadBuffer* ThisThreadBuffer() {
+    auto& holder = this_thread_buffer;
+    if (holder.buffer == nullptr) {
+        auto& registry = GetRegistry();
+        std::unique_ptr<ThreadBuffer> buffer(
+            new ThreadBuffer(registry.capacity.load()));
+        buffer->tid = static_cast<int32_t>(syscall(SYS_gettid));
+        prctl(PR_GET_NAME, buffer->name, 0, 0, 0);
+        holder.buffer = buffer.get();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.buffers.push_back(std::move(buffer));
+    }
+    return holder.buffer;
+}
+
+bool Push(ThreadBuffer& b, EventType type, const char* name, int64_t value) {
+    uint64_t head = b.head.load(std::memory_order_relaxed);
+    if (head - b.tail.load(std::memory_order_acquire) > b.mask) {
+        b.dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now().time_since_epoch())
+                      .count();
+    b.events[head & b.mask] = Event{now, name, value, type};
+    b.head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+void AppendJsonString(std::string& out, const char* s) {
+    out += '"';
+    for (; *s != '\0'; ++s) {
+        char c = *s;
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<uint8_t>(c) < 0x20) {
+            char esc[8];
+            snprintf(esc, sizeof(esc), "\\u%04x", c);
+            out += esc;
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+// Protobuf wire format.
+void AppendVarint(std::string& out, uint64_t x) {
+    while (x >= 0x80) {
+        out += static_cast<char>((x & 0x7f) | 0x80);
+        x >>= 7;
+    }
+    out += static_cast<char>(x);
+}
+
+void AppendVarintField(std::string& out, uint32_t field, uint64_t x) {
+    AppendVarint(out, field << 3);
+    AppendVarint(out, x);
+}
+
+void AppendBytesField(std::string& out, uint32_t field, const char* data,
+                      size_t size) {
+    AppendVarint(out, (field << 3) | 2);
+    AppendVarint(out, size);
+    out.append(data, size);
+}
+
+void AppendBytesField(std::string& out, uint32_t field, const std::string& s) {
+    AppendBytesField(out, field, s.data(), s.size());
+}
+
+void AppendBytesField(std::string& out, uint32_t field, const char* s) {
+    AppendBytesField(out, field, s, strlen(s));
+}
+
+// Field numbers from perfetto/protos/perfetto/trace/.
+constexpr uint32_t kTracePacket = 1;                 // Trace.packet
+constexpr uint32_t kPacketTimestamp = 8;             // TracePacket.timestamp
+constexpr uint32_t kPacketSequenceId = 10;           // .trusted_packet_sequence_id
+constexpr uint32_t kPacketTrackEvent = 11;           // .track_event
+constexpr uint32_t kPacketClockId = 58;              // .timestamp_clock_id
+constexpr uint32_t kPacketTrackDescriptor = 60;      // .track_descriptor
+constexpr uint32_t kTrackEventType = 9;              // TrackEvent.type
+constexpr uint32_t kTrackEventTrackUuid = 11;        // .track_uuid
+constexpr uint32_t kTrackEventName = 23;             // .name
+constexpr uint32_t kTrackEventCounterValue = 30;     // .counter_value
+constexpr uint32_t kDescriptorUuid = 1;              // TrackDescriptor.uuid
+constexpr uint32_t kDescriptorName = 2;              // .name
+constexpr uint32_t kDescriptorProcess = 3;           // .process
+constexpr uint32_t kDescriptorThread = 4;            // .thread
+constexpr uint32_t kDescriptorParentUuid = 5;        // .parent_uuid
+constexpr uint32_t kDescriptorCounter = 8;           // .counter
+constexpr uint32_t kProcessPid = 1;                  // ProcessDescriptor.pid
+constexpr uint32_t kThreadPid = 1;                   // ThreadDescriptor.pid
+constexpr uint32_t kThreadTid = 2;                   // .tid
+constexpr uint32_t kThreadName = 5;                  // .thread_name
+// TrackEvent.Type
+constexpr uint64_t kTypeSliceBegin = 1;
+constexpr uint64_t kTypeSliceEnd = 2;
+constexpr uint64_t kTypeCounter = 4;
+// BuiltinClock.BUILTIN_CLOCK_MONOTONIC, which steady_clock uses.
+constexpr uint64_t kClockMonotonic = 3;
+
+// Track uuids only need to be unique within the trace.
+uint64_t ProcessUuid(int32_t pid) { return (1ull << 32) | uint32_t(pid); }
+uint64_t ThreadUuid(int32_t tid) { return (2ull << 32) | uint32_t(tid); }
+uint64_t CounterUuid(size_t index) { return (3ull << 32) | index; }
+
+}  // anonymous namespace
+
+/*static*/ void TraceRecorder::Start(size_t events_per_thread) {
+    size_t capacity = 1;
+    while (capacity < events_per_thread) capacity <<= 1;
+    GetRegistry().capacity = capacity;
+    generation_.fetch_add(1);
+    recording_ = true;
+}
+
+/*static*/ void TraceRecorder::Stop() { recording_ = false; }
+
+/*static*/ void TraceRecorder::Record(EventType type, const char* name,
+                                      int64_t value) {
+    ThreadBuffer& b = *ThisThreadBuffer();
+    uint32_t generation = generation_.load(std::memory_order_relaxed);
+    if (b.generation != generation) {
+        b.generation = generation;
+        b.depth = 0;
+        b.recorded = 0;
+    }
+    switch (type) {
+        case EventType::BEGIN: {
+            bool pushed = Push(b, type, name, value);
+            if (b.depth < 64) {
+                uint64_t bit = uint64_t(1) << b.depth;
+                b.recorded = pushed ? (b.recorded | bit) : (b.recorded & ~bit);
+            }
+            ++b.depth;
+            break;
+        }
+        case EventType::END:
+            // Sections begun before recording started aren't recorded.
+            if (b.depth == 0) return;
+            --b.depth;
+            if (b.depth >= 64 || (b.recorded >> b.depth) & 1)
+                Push(b, type, name, value);
+            break;
+        case EventType::COUNTER:
+            Push(b, type, name, value);
+            break;
+    }
+}
+
+/*static*/ std::vector<TraceRecorder::ThreadEvents> TraceRecorder::Drain() {
+    std::vector<ThreadEvents> threads;
+    auto& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    auto& buffers = registry.buffers;
+    for (auto it = buffers.begin(); it != buffers.end();) {
+        ThreadBuffer& b = **it;
+        // Once a thread has exited, nothing more is written to its buffer.
+        bool exited = b.exited.load(std::memory_order_acquire);
+        uint64_t tail = b.tail.load(std::memory_order_relaxed);
+        uint64_t head = b.head.load(std::memory_order_acquire);
+        uint64_t dropped = b.dropped.exchange(0, std::memory_order_relaxed);
+        if (head != tail || dropped != 0) {
+            threads.push_back({b.tid, b.name, {}, dropped});
+            auto& events = threads.back().events;
+            events.reserve(head - tail);
+            for (uint64_t i = tail; i != head; ++i)
+                events.push_back(b.events[i & b.mask]);
+            b.tail.store(head, std::memory_order_release);
+        }
+        if (exited)
+            it = buffers.erase(it);
+        else
+            ++it;
+    }
+    return threads;
+}
+
+/*static*/ void TraceRecorder::WriteChromeJson(
+    const std::vector<ThreadEvents>& threads, std::string& out) {
+    char buf[96];
+    int32_t pid = getpid();
+    out += "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    for (auto& thread : threads) {
+        // Every event for the thread ends the same way.
+        snprintf(buf, sizeof(buf), "\"pid\":%" PRId32 ",\"tid\":%" PRId32 "}",
+                 pid, thread.tid);
+        std::string ids = buf;
+        if (!first) out += ',';
+        first = false;
+        out += "{\"ph\":\"M\",\"name\":\"thread_name\",\"args\":{\"name\":";
+        AppendJsonString(out, thread.thread_name.c_str());
+        out += "},";
+        out += ids;
+        for (auto& e : thread.events) {
+            out += ",{\"ph\":\"";
+            out += e.type == EventType::BEGIN ? 'B'
+                   : e.type == EventType::END ? 'E'
+                                              : 'C';
+            out += '"';
+            if (e.name != nullptr) {
+                out += ",\"name\":";
+                AppendJsonString(out, e.name);
+            }
+            if (e.type == EventType::COUNTER) {
+                snprintf(buf, sizeof(buf), ",\"args\":{\"value\":%" PRId64 "}",
+                         e.value);
+                out += buf;
+            }
+            // Timestamps are in microseconds.
+            snprintf(buf, sizeof(buf), ",\"ts\":%" PRId64 ".%03d,",
+                     e.time_ns / 1000, static_cast<int>(e.time_ns % 1000));
+            out += buf;
+            out += ids;
+        }
+    }
+    out += "]}";
+}
+
+/*static*/ void TraceRecorder::WritePerfettoTrace(
+    const std::vector<ThreadEvents>& threads, std::string& out) {
+    int32_t pid = getpid();
+    std::string packet, message, sub_message;
+    auto append_descriptor = [&](const std::string& descriptor) {
+        packet.clear();
+        AppendBytesField(packet, kPacketTrackDescriptor, descriptor);
+        AppendBytesField(out, kTracePacket, packet);
+    };
+
+    message.clear();
+    AppendVarintField(message, kDescriptorUuid, ProcessUuid(pid));
+    sub_message.clear();
+    AppendVarintField(sub_message, kProcessPid, pid);
+    AppendBytesField(message, kDescriptorProcess, sub_message);
+    append_descriptor(message);
+
+    std::map<std::string, uint64_t> counters;
+    uint32_t sequence_id = 0;
+    for (auto& thread : threads) {
+        message.clear();
+        AppendVarintField(message, kDescriptorUuid, ThreadUuid(thread.tid));
+        AppendVarintField(message, kDescriptorParentUuid, ProcessUuid(pid));
+        sub_message.clear();
+        AppendVarintField(sub_message, kThreadPid, pid);
+        AppendVarintField(sub_message, kThreadTid, thread.tid);
+        AppendBytesField(sub_message, kThreadName, thread.thread_name);
+        AppendBytesField(message, kDescriptorThread, sub_message);
+        append_descriptor(message);
+
+        // Each thread's events are in order, so each gets its own sequence.
+        ++sequence_id;
+        for (auto& e : thread.events) {
+            uint64_t track_uuid = ThreadUuid(thread.tid);
+            if (e.type == EventType::COUNTER) {
+                auto it = counters.find(e.name);
+                if (it == counters.end()) {
+                    it = counters
+                             .insert({e.name, CounterUuid(counters.size())})
+                             .first;
+                    message.clear();
+                    AppendVarintField(message, kDescriptorUuid, it->second);
+                    AppendVarintField(message, kDescriptorParentUuid,
+                                      ProcessUuid(pid));
+                    AppendBytesField(message, kDescriptorName, it->first);
+                    AppendBytesField(message, kDescriptorCounter, "");
+                    append_descriptor(message);
+                }
+                track_uuid = it->second;
+            }
+            message.clear();
+            switch (e.type) {
+                case EventType::BEGIN:
+                    AppendVarintField(message, kTrackEventType,
+                                      kTypeSliceBegin);
+                    AppendBytesField(message, kTrackEventName, e.name);
+                    break;
+                case EventType::END:
+                    AppendVarintField(message, kTrackEventType, kTypeSliceEnd);
+                    break;
+                case EventType::COUNTER:
+                    AppendVarintField(message, kTrackEventType, kTypeCounter);
+                    AppendVarintField(message, kTrackEventCounterValue,
+                                      static_cast<uint64_t>(e.value));
+                    break;
+            }
+            AppendVarintField(message, kTrackEventTrackUuid, track_uuid);
+            packet.clear();
+            AppendVarintField(packet, kPacketTimestamp, e.time_ns);
+            AppendVarintField(packet, kPacketClockId, kClockMonotonic);
+            AppendVarintField(packet, kPacketSequenceId, sequence_id);
+            AppendBytesField(packet, kPacketTrackEvent, message);
+            AppendBytesField(out, kTracePacket, packet);
+        }
+    }
+}
+
+}  // namespace gamesdk
@@ -0,0 +1,99 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace gamesdk {
+
+// Records trace sections and counters in memory, so that timelines can be
+// collected without systrace attached, including in host tests. Trace and
+// ScopedTrace record through it while it is started.
+//
+// Each thread writes to its own ring buffer without locking; Drain empties
+// them all. Events that don't fit before the next Drain are dropped and
+// counted. Names aren't copied, so they must outlive the recording: string
+// literals and __PRETTY_FUNCTION__ are fine.
+class TraceRecorder {
+   public:
+    static constexpr size_t kDefaultEventsPerThread = 2048;
+
+    enum class EventType : uint8_t { BEGIN, END, COUNTER };
+
+    struct Event {
+        // steady_clock, which is CLOCK_MONOTONIC.
+        int64_t time_ns;
+        // Null for END.
+        const char* name;
+        // Only for COUNTER.
+        int64_t value;
+        EventType type;
+    };
+
+    struct ThreadEvents {
+        int32_t tid;
+        std::string thread_name;
+        std::vector<Event> events;
+        // The number of events dropped since the last drain.
+        uint64_t dropped;
+    };
+
+    // Start recording. Threads that haven't recorded anything yet get buffers
+    // with room for events_per_thread events, rounded up to a power of 2.
+    static void Start(size_t events_per_thread = kDefaultEventsPerThread);
+    static void Stop();
+    static bool IsRecording() {
+        return recording_.load(std::memory_order_relaxed);
+    }
+
+    static void Begin(const char* name) {
+        if (IsRecording()) Record(EventType::BEGIN, name, 0);
+    }
+    // Ends that don't match a recorded Begin on the same thread are ignored.
+    static void End() {
+        if (IsRecording()) Record(EventType::END, nullptr, 0);
+    }
+    static void Counter(const char* name, int64_t value) {
+        if (IsRecording()) Record(EventType::COUNTER, name, value);
+    }
+
+    // Remove the events recorded so far, for each thread that has recorded
+    // any. This may be called while other threads are recording.
+    static std::vector<ThreadEvents> Drain();
+
+    // Append the events in Chrome's JSON trace event format, which Perfetto
+    // and chrome://tracing can both open.
+    static void WriteChromeJson(const std::vector<ThreadEvents>& threads,
+                                std::string& out);
+    // Append the events as a serialized perfetto.protos.Trace, with a track
+    // for each thread and each counter.
+    static void WritePerfettoTrace(const std::vector<ThreadEvents>& threads,
+                                   std::string& out);
+
+   private:
+    static void Record(EventType type, const char* name, int64_t value);
+
+    static std::atomic<bool> recording_;
+    // Incremented by Start, so threads know to forget sections left open by
+    // an earlier recording.
+    static std::atomic<uint32_t> generation_;
+};
+
+}  // namespace gamesdk
@@ -20,14 +20,8 @@
 #include <unistd.h>
 
 #include <chrono>
-#include <fstream>
-#include <iterator>
 #include <map>
-#include <regex>
-#include <sstream>
-#include <streambuf>
 #include <utility>
-#include <vector>
 
 #include "jni/jni_wrap.h"
 
@@ -35,21 +29,17 @@ using namespace gamesdk::jni;
 
 constexpr double BYTES_IN_KB = 1024;
 constexpr double BYTES_IN_MB = 1024 * 1024;
-const std::regex MEMINFO_REGEX("([^:]+)[^\\d]*(\\d+).*\n");
-const std::regex STATUS_REGEX("([a-zA-Z]+)[^\\d]*(\\d+) kB.*\n");
 
 namespace memory_advice {
 
 using namespace json11;
 
 Json::object DefaultMetricsProvider::GetMeminfoValues() {
-    return GetMemoryValuesFromFile("/proc/meminfo", MEMINFO_REGEX);
+    return GetMemoryValuesFromFile(meminfo_file_, false);
 }
 
 Json::object DefaultMetricsProvider::GetStatusValues() {
-    std::stringstream ss_path;
-    ss_path << "/proc/" << getpid() << "/status";
-    return GetMemoryValuesFromFile(ss_path.str(), STATUS_REGEX);
+    return GetMemoryValuesFromFile(status_file_, true);
 }
 
 Json::object DefaultMetricsProvider::GetProcValues() {
@@ -101,38 +91,31 @@ Json::object DefaultMetricsProvider::GetDebugValues() {
 }
 
 Json::object DefaultMetricsProvider::GetMemoryValuesFromFile(
-    const std::string &path, const std::regex &pattern) {
-    std::ifstream file_stream(path);
+    gamesdk::ProcFile &file, bool kb_only) {
+    std::lock_guard<std::mutex> lock(files_mutex_);
     Json::object metrics_map;
-    if (!file_stream) {
-        ALOGE("Could not open %s", path.c_str());
+    if (!file.Read()) {
+        ALOGE("Could not open %s", file.Path());
         return metrics_map;
     }
-
-    std::string file((std::istreambuf_iterator<char>(file_stream)),
-                     std::istreambuf_iterator<char>());
-    std::smatch match;
-    while (std::regex_search(file, match, pattern)) {
-        metrics_map[match[1].str()] =
-            Json((double)(strtoll(match[2].str().c_str(), nullptr, 10) *
-                          BYTES_IN_KB));
-        file = match.suffix().str();
-    }
+    file.ForEachField(
+        [&](const char *key, size_t key_size, uint64_t value, bool kb) {
+            if (kb_only && !kb) return;
+            metrics_map[std::string(key, key_size)] =
+                Json((double)value * BYTES_IN_KB);
+        });
     return metrics_map;
 }
 
 int32_t DefaultMetricsProvider::GetOomScore() {
-    std::stringstream ss_path;
-    ss_path << "/proc/" << getpid() << "/oom_score";
-    std::ifstream oom_file(ss_path.str());
-    if (!oom_file) {
-        ALOGE_ONCE("Could not open %s", ss_path.str().c_str());
+    std::lock_guard<std::mutex> lock(files_mutex_);
+    int64_t oom_score;
+    if (!oom_score_file_.Read() ||
+        oom_score_file_.GetNumbers(&oom_score, 1) != 1) {
+        ALOGE_ONCE("Could not open %s", oom_score_file_.Path());
         return -1;
-    } else {
-        int32_t oom_score;
-        oom_file >> oom_score;
-        return oom_score;
     }
+    return static_cast<int32_t>(oom_score);
 }
 
 }  // namespace memory_advice
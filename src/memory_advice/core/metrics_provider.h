@@ -18,11 +18,12 @@
 
 #include <map>
 #include <memory>
-#include <regex>
+#include <mutex>
 #include <string>
 
 #include "jni/jni_wrap.h"
 #include "json11/json11.hpp"
+#include "proc_file.h"
 
 #define LOG_TAG "MemoryAdvice"
 #include "Log.h"
@@ -86,11 +87,17 @@ class DefaultMetricsProvider : public IMetricsProvider {
 
    private:
     android::os::DebugClass android_debug_;
+    /** @brief Guards the files below, which keep their last read. */
+    std::mutex files_mutex_;
+    gamesdk::ProcFile meminfo_file_{"/proc/meminfo"};
+    gamesdk::ProcFile status_file_{"/proc/self/status"};
+    gamesdk::ProcFile oom_score_file_{"/proc/self/oom_score"};
     /**
      * @brief Reads the given file and dumps the memory values within as a map
+     * @param kb_only Whether to only include values given in kB.
      */
-    Json::object GetMemoryValuesFromFile(const std::string &path,
-                                         const std::regex &pattern);
+    Json::object GetMemoryValuesFromFile(gamesdk::ProcFile &file,
+                                         bool kb_only);
     /** @brief Reads the OOM Score of the app from /proc/{pid}/oom_score */
     int32_t GetOomScore();
 };
@@ -16,8 +16,11 @@
 
 #include "annotation_map.h"
 
+#include <cstring>
 #include <functional>
 
+#include "annotation_util.h"
+
 namespace {
 
 // We expect the serializations to be small, so a Murmur2 hash should be
@@ -59,29 +62,140 @@ static uint32_t Murmur2Hash(const uint8_t* data, int len) {
 
 namespace tuningfork {
 
-AnnotationMap::AnnotationMap() : hash_table_(kHashTableSize) {}
+constexpr uint32_t AnnotationMap::kMaxAnnotations;
+constexpr size_t AnnotationMap::kEntriesPerChunk;
+constexpr size_t AnnotationMap::kMaxEntryChunks;
+constexpr size_t AnnotationMap::kArenaChunkSize;
+constexpr size_t AnnotationMap::kInitialTableSize;
+
+AnnotationMap::Table::Table(size_t capacity)
+    : mask(capacity - 1), slots(new std::atomic<uint64_t>[capacity]) {
+    for (size_t i = 0; i < capacity; ++i) slots[i].store(0);
+}
+
+AnnotationMap::AnnotationMap()
+    : next_id_(1), entry_chunks_(new std::atomic<Entry*>[kMaxEntryChunks]) {
+    for (size_t i = 0; i < kMaxEntryChunks; ++i)
+        entry_chunks_[i].store(nullptr);
+    tables_.push_back(std::make_unique<Table>(kInitialTableSize));
+    table_.store(tables_.back().get());
+}
+
+AnnotationMap::~AnnotationMap() {
+    for (size_t i = 0; i < kMaxEntryChunks; ++i) delete[] entry_chunks_[i];
+}
+
+const AnnotationMap::Entry& AnnotationMap::EntryFor(AnnotationId id) const {
+    auto chunk = entry_chunks_[id / kEntriesPerChunk].load(
+        std::memory_order_acquire);
+    return chunk[id % kEntriesPerChunk];
+}
+
+AnnotationId AnnotationMap::Find(const Table& table, const uint8_t* data,
+                                 size_t size, uint32_t hash) const {
+    for (size_t i = hash & table.mask;; i = (i + 1) & table.mask) {
+        uint64_t slot = table.slots[i].load(std::memory_order_acquire);
+        if (slot == 0) return 0;
+        if (slot >> 32 != hash) continue;
+        AnnotationId id = static_cast<AnnotationId>(slot);
+        auto& entry = EntryFor(id);
+        if (entry.size == size &&
+            (size == 0 || memcmp(entry.data, data, size) == 0))
+            return id;
+    }
+}
+
+const uint8_t* AnnotationMap::CopyToArena(const uint8_t* data, size_t size) {
+    if (size == 0) return nullptr;
+    if (size > kArenaChunkSize / 4) {
+        // Large serializations get a chunk of their own.
+        arena_.emplace_back(new uint8_t[size]);
+        arena_used_ = kArenaChunkSize;
+        memcpy(arena_.back().get(), data, size);
+        return arena_.back().get();
+    }
+    if (arena_used_ + size > kArenaChunkSize) {
+        arena_.emplace_back(new uint8_t[kArenaChunkSize]);
+        arena_used_ = 0;
+    }
+    auto p = arena_.back().get() + arena_used_;
+    memcpy(p, data, size);
+    arena_used_ += size;
+    return p;
+}
+
+void AnnotationMap::Grow() {
+    auto& old_table = *tables_.back();
+    size_t capacity = 2 * (old_table.mask + 1);
+    auto table = std::make_unique<Table>(capacity);
+    for (size_t i = 0; i <= old_table.mask; ++i) {
+        uint64_t slot = old_table.slots[i].load(std::memory_order_relaxed);
+        if (slot == 0) continue;
+        size_t j = (slot >> 32) & table->mask;
+        while (table->slots[j].load(std::memory_order_relaxed) != 0)
+            j = (j + 1) & table->mask;
+        table->slots[j].store(slot, std::memory_order_relaxed);
+    }
+    // Readers may still be using the old table, so it isn't freed.
+    tables_.push_back(std::move(table));
+    table_.store(tables_.back().get(), std::memory_order_release);
+}
 
 TuningFork_ErrorCode AnnotationMap::GetOrInsert(
     const ProtobufSerialization& ser, AnnotationId& id) {
-    id = Murmur2Hash(ser.data(), ser.size());
-    auto& ls = hash_table_[HashIndex(id)];
-    for (auto& l : ls) {
-        if (l.first == id) return TUNINGFORK_ERROR_OK;
+    uint32_t hash = Murmur2Hash(ser.data(), ser.size());
+    id = Find(*table_.load(std::memory_order_acquire), ser.data(), ser.size(),
+              hash);
+    if (id != 0) return TUNINGFORK_ERROR_OK;
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Check again in case another thread has just inserted it.
+    id = Find(*tables_.back(), ser.data(), ser.size(), hash);
+    if (id != 0) return TUNINGFORK_ERROR_OK;
+    AnnotationId new_id = next_id_.load(std::memory_order_relaxed);
+    if (new_id >= kMaxAnnotations) {
+        id = annotation_util::kAnnotationError;
+        return TUNINGFORK_ERROR_INVALID_ANNOTATION;
     }
-    ls.push_back({id, ser});
+    auto& chunk = entry_chunks_[new_id / kEntriesPerChunk];
+    if (chunk.load(std::memory_order_relaxed) == nullptr)
+        chunk.store(new Entry[kEntriesPerChunk], std::memory_order_release);
+    chunk.load(std::memory_order_relaxed)[new_id % kEntriesPerChunk] =
+        Entry{CopyToArena(ser.data(), ser.size()),
+              static_cast<uint32_t>(ser.size())};
+    // Keep the table at most half full.
+    if (2 * new_id > tables_.back()->mask + 1) Grow();
+    auto& table = *tables_.back();
+    size_t i = hash & table.mask;
+    while (table.slots[i].load(std::memory_order_relaxed) != 0)
+        i = (i + 1) & table.mask;
+    table.slots[i].store((uint64_t(hash) << 32) | new_id,
+                         std::memory_order_release);
+    next_id_.store(new_id + 1, std::memory_order_release);
+    id = new_id;
     return TUNINGFORK_ERROR_OK;
 }
 
 TuningFork_ErrorCode AnnotationMap::Get(AnnotationId id,
                                         ProtobufSerialization& ser) {
-    auto& ls = hash_table_[HashIndex(id)];
-    for (auto& l : ls) {
-        if (l.first == id) {
-            ser = l.second;
-            return TUNINGFORK_ERROR_OK;
-        }
+    if (id == 0 || id >= next_id_.load(std::memory_order_acquire))
+        return TUNINGFORK_ERROR_INVALID_ANNOTATION;
+    auto& entry = EntryFor(id);
+    ser.assign(entry.data, entry.data + entry.size);
+    return TUNINGFORK_ERROR_OK;
+}
+
+bool AnnotationMap::View(AnnotationId id, const uint8_t*& data,
+                         size_t& size) const {
+    if (id == 0) {
+        data = nullptr;
+        size = 0;
+        return true;
     }
-    return TUNINGFORK_ERROR_INVALID_ANNOTATION;
+    if (!Contains(id)) return false;
+    auto& entry = EntryFor(id);
+    data = entry.data;
+    size = entry.size;
+    return true;
 }
 
 }  // namespace tuningfork
@@ -16,7 +16,8 @@
 
 #pragma once
 
-#include <list>
+#include <atomic>
+#include <memory>
 #include <mutex>
 #include <vector>
 
@@ -26,25 +27,74 @@ namespace tuningfork {
 
 // Stores the mapping from annotation serializations to annotation ids
 // and back again.
+//
+// Ids are allocated in order, starting at 1, so different serializations
+// always get different ids. Serializations are copied into an arena that
+// never moves and are found through an open-addressing hash table that
+// compares the full serialization. Lookups of existing annotations don't
+// lock: inserts are serialized by a mutex and published with release stores,
+// and when the table grows the old one is kept so that readers still using
+// it remain safe.
 class AnnotationMap {
-    // We store in a hash table of fixed size to avoid having to lock when
-    // inserting. If we used an STL unordered map there's the possibility of
-    // rehashing.
-    static const int kHashTableSize = 256;
-    typedef std::vector<
-        std::list<std::pair<AnnotationId, ProtobufSerialization>>>
-        InnerContainer;
-    typedef InnerContainer::iterator Iterator;
-    InnerContainer hash_table_;
-
    public:
+    // The most annotations that can be stored.
+    static constexpr uint32_t kMaxAnnotations = 1 << 24;
+
     AnnotationMap();
+    ~AnnotationMap();
+
+    AnnotationMap(const AnnotationMap&) = delete;
+    AnnotationMap& operator=(const AnnotationMap&) = delete;
+
     TuningFork_ErrorCode GetOrInsert(const ProtobufSerialization& ser,
                                      AnnotationId& id);
     TuningFork_ErrorCode Get(AnnotationId id, ProtobufSerialization& ser);
 
+    // Get the serialization of id without copying it. This neither locks nor
+    // allocates, so it can be used from a signal handler. Id 0 has an empty
+    // serialization.
+    bool View(AnnotationId id, const uint8_t*& data, size_t& size) const;
+
+    size_t Size() const { return next_id_.load(std::memory_order_acquire) - 1; }
+
+    // Whether id has been returned by GetOrInsert.
+    bool Contains(AnnotationId id) const {
+        return id != 0 && id < next_id_.load(std::memory_order_acquire);
+    }
+
    private:
-    inline int HashIndex(AnnotationId id) { return id & 0xff; }
+    struct Entry {
+        const uint8_t* data;
+        uint32_t size;
+    };
+    // Slots hold the hash in the top 32 bits and the id in the bottom 32
+    // bits, or zero if empty.
+    struct Table {
+        explicit Table(size_t capacity);
+        size_t mask;
+        std::unique_ptr<std::atomic<uint64_t>[]> slots;
+    };
+    static constexpr size_t kEntriesPerChunk = 4096;
+    static constexpr size_t kMaxEntryChunks =
+        kMaxAnnotations / kEntriesPerChunk;
+    static constexpr size_t kArenaChunkSize = 64 * 1024;
+    static constexpr size_t kInitialTableSize = 256;
+
+    AnnotationId Find(const Table& table, const uint8_t* data, size_t size,
+                      uint32_t hash) const;
+    const Entry& EntryFor(AnnotationId id) const;
+    const uint8_t* CopyToArena(const uint8_t* data, size_t size);
+    void Grow();
+
+    std::atomic<Table*> table_;
+    std::atomic<uint32_t> next_id_;
+    // Entries, by id, in chunks that are never moved.
+    std::unique_ptr<std::atomic<Entry*>[]> entry_chunks_;
+    // Everything below is only accessed with mutex_ held.
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<Table>> tables_;
+    std::vector<std::unique_ptr<uint8_t[]>> arena_;
+    size_t arena_used_ = kArenaChunkSize;
 };
 
 }  // namespace tuningfork
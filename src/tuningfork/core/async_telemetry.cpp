@@ -24,38 +24,49 @@ namespace tuningfork {
 using namespace std::chrono;
 
 const Duration AsyncTelemetry::kNoWorkPollPeriod = milliseconds(100);
-
-// Compare by the task's next_time.
-// We want the lowest time at the top of the heap.
-struct RepeatingTaskPtrComparator {
-    bool operator()(const std::shared_ptr<RepeatingTask>& a,
-                    const std::shared_ptr<RepeatingTask>& b) const {
-        return a->next_time > b->next_time;
-    }
-};
+const Duration AsyncTelemetry::kCoalescingWindow = seconds(1);
 
 AsyncTelemetry::AsyncTelemetry(ITimeProvider* time_provider)
-    : Runnable(time_provider) {}
+    : Runnable(time_provider), tasks_(kCoalescingWindow) {}
 
 void AsyncTelemetry::AddTask(const std::shared_ptr<RepeatingTask>& m) {
-    metrics_.push_back(m);
-    std::push_heap(metrics_.begin(), metrics_.end(),
-                   RepeatingTaskPtrComparator());
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.Add(m, time_provider_->Now());
+    }
+    cv_.notify_one();
 }
 
 Duration AsyncTelemetry::DoWork() {
-    if (metrics_.empty()) return kNoWorkPollPeriod;
-    // Look at the queue of metrics and see if we need to execute them.
-    while (true) {
-        auto m = metrics_.front();
-        auto now = time_provider_->Now();
-        if (m->next_time > now) return m->next_time - now;
+    ++stats_.wakeups;
+    if (tasks_.Empty()) return kNoWorkPollPeriod;
+    auto now = time_provider_->Now();
+    tasks_.Expire(now, [&](const std::shared_ptr<RepeatingTask>& m,
+                           TimePoint deadline) {
+        auto start = time_provider_->Now();
+        auto lateness = std::max(start - deadline, Duration::zero());
+        ++stats_.tasks_run;
+        stats_.total_lateness += lateness;
+        stats_.max_lateness = std::max(stats_.max_lateness, lateness);
+        if (deadline > start) ++stats_.tasks_coalesced;
         m->DoWork(session_);
-        auto elapsed = time_provider_->Now() - now;
-        m->next_time = now + elapsed + m->min_work_interval;
-        std::make_heap(metrics_.begin(), metrics_.end(),
-                       RepeatingTaskPtrComparator());
-    }
+        // If the deadlines have fallen behind, e.g. because the device was
+        // suspended, skip the missed runs rather than running them all now.
+        auto next = deadline + m->min_work_interval;
+        if (next <= start) {
+            if (m->min_work_interval > Duration::zero())
+                stats_.runs_skipped += (start - next) / m->min_work_interval + 1;
+            next = start + m->min_work_interval;
+        }
+        tasks_.Add(m, next);
+    });
+    return std::max(tasks_.NextDeadline() - time_provider_->Now(),
+                    Duration::zero());
+}
+
+AsyncTelemetry::Stats AsyncTelemetry::GetStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
 }
 
 }  // namespace tuningfork
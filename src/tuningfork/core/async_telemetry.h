@@ -16,11 +16,11 @@
 
 #pragma once
 
-#include <deque>
 #include <memory>
 
 #include "core/runnable.h"
 #include "core/time_provider.h"
+#include "core/timer_wheel.h"
 
 namespace tuningfork {
 
@@ -35,29 +35,51 @@ class RepeatingTask {
     virtual void DoWork(Session* session) = 0;
 
    private:
-    // When to wake to call this next.
-    TimePoint next_time = TimePoint::min();
     // The minimum time between calling DoWork.
     Duration min_work_interval = Duration::zero();
 
     friend class AsyncTelemetry;
-    friend class RepeatingTaskPtrComparator;
 };
 
 // Scheduler of metric recordings.
+//
+// All the tasks run on the one thread. Each task's deadline is kept as an
+// absolute time that advances by its interval, so time spent working doesn't
+// push later runs back. Tasks due within kCoalescingWindow of each other are
+// run on the same wakeup.
 class AsyncTelemetry : public Runnable {
-    // This is maintained as a heap, ordered by next_time.
-    std::deque<std::shared_ptr<RepeatingTask>> metrics_;
-    Session* session_ = 0;
-
    public:
+    struct Stats {
+        // Number of times the thread woke up, with or without work to do.
+        uint64_t wakeups = 0;
+        uint64_t tasks_run = 0;
+        // How long after their deadlines tasks were run. Tasks run early
+        // because they were coalesced with an earlier one count as on time.
+        Duration total_lateness = Duration::zero();
+        Duration max_lateness = Duration::zero();
+        // Tasks run before their deadline because they were due within
+        // kCoalescingWindow of an earlier one.
+        uint64_t tasks_coalesced = 0;
+        // Runs skipped because their deadlines had all passed, e.g. while the
+        // device was suspended.
+        uint64_t runs_skipped = 0;
+    };
+
     AsyncTelemetry(ITimeProvider* time_provider);
+    // The task is first run as soon as possible.
     void AddTask(const std::shared_ptr<RepeatingTask>& m);
     virtual Duration DoWork() override;
     void SetSession(Session* session) { session_ = session; }
+    Stats GetStats();
 
     // How often to check if there has been any work added.
     static const Duration kNoWorkPollPeriod;
+    static const Duration kCoalescingWindow;
+
+   private:
+    TimerWheel<std::shared_ptr<RepeatingTask>> tasks_;
+    Session* session_ = 0;
+    Stats stats_;
 };
 
 }  // namespace tuningfork
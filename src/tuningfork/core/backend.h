@@ -24,10 +24,14 @@
 
 namespace tuningfork {
 
-// Constants used by the upload threads for coordinating persisting and
-// uploading histograms.
+// Keys where earlier versions kept a single paused session and a single
+// pending upload. UploadQueue::Load moves them into the queue.
 const uint64_t HISTOGRAMS_PAUSED = 0;
 const uint64_t HISTOGRAMS_UPLOADING = 1;
+// Keys used by UploadQueue: sessions are stored from UPLOAD_QUEUE_FIRST_ENTRY
+// upwards.
+const uint64_t UPLOAD_QUEUE_INDEX = 2;
+const uint64_t UPLOAD_QUEUE_FIRST_ENTRY = 0x100;
 
 // Interface for download and upload of information from Tuning Fork.
 class IBackend {
@@ -23,16 +23,11 @@ class Session;
 void BatteryReportingTask::DoWork(Session *session) {
     if (battery_provider_ != nullptr &&
         battery_provider_->IsBatteryReportingEnabled()) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        session->GetData<BatteryMetricData>(id_)->Record(
+        auto id = MetricId::Battery(annotation_id_->load());
+        session->GetData<BatteryMetricData>(id)->Record(
             activity_lifecycle_state_->IsAppOnForeground(),
             time_provider_->TimeSinceProcessStart(), battery_provider_);
     }
 }
 
-void BatteryReportingTask::UpdateMetricId(MetricId id) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    id_ = id;
-}
-
 }  // namespace tuningfork
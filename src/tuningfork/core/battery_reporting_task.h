@@ -16,7 +16,7 @@
 
 #pragma once
 
-#include <mutex>
+#include <atomic>
 #include <string>
 
 #include "activity_lifecycle_state.h"
@@ -32,20 +32,21 @@ class BatteryReportingTask : public RepeatingTask {
     ActivityLifecycleState* activity_lifecycle_state_;
     ITimeProvider* time_provider_;
     IBatteryProvider* battery_provider_;
-    std::mutex mutex_;
-    MetricId id_;
+    const std::atomic<AnnotationId>* annotation_id_;
 
    public:
+    // Data is recorded against the annotation that annotation_id holds at the
+    // time.
     BatteryReportingTask(ActivityLifecycleState* activity_lifecycle_state,
                          ITimeProvider* time_provider,
-                         IBatteryProvider* battery_provider, MetricId id)
+                         IBatteryProvider* battery_provider,
+                         const std::atomic<AnnotationId>* annotation_id)
         : RepeatingTask(std::chrono::seconds(60)),
           activity_lifecycle_state_(activity_lifecycle_state),
           time_provider_(time_provider),
           battery_provider_(battery_provider),
-          id_(id) {}
+          annotation_id_(annotation_id) {}
     virtual void DoWork(Session* session) override;
-    void UpdateMetricId(MetricId id);
 };
 
 }  // namespace tuningfork
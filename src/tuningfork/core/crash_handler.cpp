@@ -24,6 +24,7 @@ void CrashHandler::Init(std::function<bool(void)> callback) {}
 }  // namespace tuningfork
 #else
 
+#include <fcntl.h>
 #include <pthread.h>
 #include <sys/syscall.h>
 #include <unistd.h>
@@ -31,7 +32,6 @@ void CrashHandler::Init(std::function<bool(void)> callback) {}
 #include <algorithm>
 #include <cstdlib>
 #include <cstring>
-#include <fstream>
 #include <functional>
 #include <iomanip>
 #include <sstream>
@@ -267,9 +267,17 @@ bool CrashHandler::HandlerSignal(int sig, siginfo_t *info, void *ucontext) {
     ALOGI("HandlerSignal: sig %d, name %s, pid %d", sig, GetSignalName(sig),
           info->si_pid);
 
-    std::ofstream file(tf_crash_info_file_);
-    if (file.is_open()) {
-        file << sig;
+    // Only use async-signal-safe calls to store the signal number.
+    int fd = open(tf_crash_info_file_.c_str(),
+                  O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd >= 0) {
+        char digits[16];
+        size_t n = 0;
+        for (int s = sig; n == 0 || s > 0; s /= 10) digits[n++] = '0' + s % 10;
+        char text[16];
+        for (size_t i = 0; i < n; ++i) text[i] = digits[n - 1 - i];
+        write(fd, text, n);
+        close(fd);
     } else {
         ALOGE_ONCE("Crash reason couldn't be stored.");
     }
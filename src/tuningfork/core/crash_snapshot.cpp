@@ -0,0 +1,324 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "crash_snapshot.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include "annotation_util.h"
+
+#define LOG_TAG "TuningFork"
+#include "Log.h"
+
+namespace tuningfork {
+
+constexpr size_t CrashSnapshot::kDefaultCapacity;
+
+namespace {
+
+// File layout:
+//  header: magic, version, crc32 of the records, size of the records
+//   (uint64), which is zero until the snapshot is committed.
+//  records: annotation serialization, instrument key, duration in
+//   nanoseconds, kind, then for histograms the number of buckets and the non-zero
+//   (index, count) pairs, or for quantile sketches k, the count and the
+//   levels. Integers are varints.
+constexpr uint32_t kMagic = 0x53434654;  // "TFCS"
+constexpr uint32_t kVersion = 1;
+constexpr size_t kCrcOffset = 8;
+constexpr size_t kSizeOffset = 16;
+constexpr size_t kHeaderSize = 24;
+// More than any histogram has, to bound the memory used reading a snapshot.
+constexpr uint64_t kMaxBuckets = 1 << 20;
+
+enum Kind { LINEAR = 0, LOG_LINEAR = 1, QUANTILE_SKETCH = 2 };
+
+template <typename T>
+T Load(const uint8_t* p) {
+    T x;
+    memcpy(&x, p, sizeof(x));
+    return x;
+}
+
+template <typename T>
+void Store(uint8_t* p, T x) {
+    memcpy(p, &x, sizeof(x));
+}
+
+class Reader {
+   public:
+    Reader(const std::string& in) : in_(in) {}
+    bool Ok() const { return ok_; }
+    void Fail() { ok_ = false; }
+    bool AtEnd() const { return pos_ >= in_.size(); }
+    uint64_t Varint() {
+        uint64_t x = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (pos_ >= in_.size()) break;
+            uint8_t b = in_[pos_++];
+            x |= uint64_t(b & 0x7f) << shift;
+            if ((b & 0x80) == 0) return x;
+        }
+        ok_ = false;
+        return 0;
+    }
+    // A count of items of at least min_size bytes each.
+    size_t Count(size_t min_size = 1) {
+        uint64_t n = Varint();
+        if (n > (in_.size() - pos_) / min_size) ok_ = false;
+        return ok_ ? n : 0;
+    }
+    std::string Bytes() {
+        size_t n = Count();
+        if (!ok_) return {};
+        pos_ += n;
+        return in_.substr(pos_ - n, n);
+    }
+    float Float() {
+        if (in_.size() - pos_ < sizeof(float)) {
+            ok_ = false;
+            return 0;
+        }
+        auto p = reinterpret_cast<const uint8_t*>(in_.data() + pos_);
+        pos_ += sizeof(float);
+        return Load<float>(p);
+    }
+
+   private:
+    const std::string& in_;
+    size_t pos_ = 0;
+    bool ok_ = true;
+};
+
+}  // anonymous namespace
+
+CrashSnapshot::~CrashSnapshot() { Close(); }
+
+bool CrashSnapshot::Open(const std::string& path, size_t capacity) {
+    Close();
+    if (capacity <= kHeaderSize) return false;
+    fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd_ < 0) {
+        ALOGW("Couldn't open crash snapshot %s", path.c_str());
+        return false;
+    }
+    // Allocate the blocks now: running out of disk space while writing to
+    // the mapping would raise SIGBUS in the crash handler.
+    if (posix_fallocate(fd_, 0, capacity) != 0) {
+        ALOGW("Couldn't allocate crash snapshot %s", path.c_str());
+        Close();
+        return false;
+    }
+    void* p =
+        mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (p == MAP_FAILED) {
+        Close();
+        return false;
+    }
+    map_ = static_cast<uint8_t*>(p);
+    capacity_ = capacity;
+    Store<uint32_t>(map_, kMagic);
+    Store<uint32_t>(map_ + 4, kVersion);
+    Begin();
+    return true;
+}
+
+void CrashSnapshot::Close() {
+    if (map_ != nullptr) munmap(map_, capacity_);
+    if (fd_ >= 0) close(fd_);
+    map_ = nullptr;
+    fd_ = -1;
+    capacity_ = 0;
+    end_ = 0;
+}
+
+void CrashSnapshot::Begin() {
+    if (map_ == nullptr) return;
+    Store<uint64_t>(map_ + kSizeOffset, 0);
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    end_ = kHeaderSize;
+}
+
+bool CrashSnapshot::PutVarint(uint64_t x) {
+    while (x >= 0x80) {
+        if (end_ >= capacity_) return false;
+        map_[end_++] = static_cast<uint8_t>((x & 0x7f) | 0x80);
+        x >>= 7;
+    }
+    if (end_ >= capacity_) return false;
+    map_[end_++] = static_cast<uint8_t>(x);
+    return true;
+}
+
+bool CrashSnapshot::PutBytes(const void* p, size_t n) {
+    if (capacity_ - end_ < n) return false;
+    if (n > 0) memcpy(map_ + end_, p, n);
+    end_ += n;
+    return true;
+}
+
+bool CrashSnapshot::Add(const uint8_t* annotation, size_t annotation_size,
+                        InstrumentationKey key,
+                        const FrameTimeMetricData& data) {
+    if (map_ == nullptr) return false;
+    size_t start = end_;
+    bool ok = PutVarint(annotation_size) &&
+              PutBytes(annotation, annotation_size) && PutVarint(key);
+    ok = ok && PutVarint(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             data.duration_)
+                             .count());
+    if (data.use_quantiles_) {
+        auto& q = data.quantiles_;
+        ok = ok && PutVarint(QUANTILE_SKETCH) && PutVarint(q.K()) &&
+             PutVarint(q.Count()) && PutVarint(q.Levels().size());
+        for (auto& level : q.Levels()) {
+            ok = ok && PutVarint(level.size());
+            for (float x : level) ok = ok && PutBytes(&x, sizeof(x));
+        }
+    } else {
+        auto& h = data.histogram_;
+        size_t n_nonzero = 0;
+        h.ForEachNonZeroBucket([&](uint32_t, uint32_t) { ++n_nonzero; });
+        ok = ok &&
+             PutVarint(h.GetMode() == HistogramBase::Mode::LOG_LINEAR
+                           ? LOG_LINEAR
+                           : LINEAR) &&
+             PutVarint(h.NumBuckets()) && PutVarint(n_nonzero);
+        h.ForEachNonZeroBucket([&](uint32_t i, uint32_t c) {
+            ok = ok && PutVarint(i) && PutVarint(c);
+        });
+    }
+    // Leave out data that doesn't fit rather than truncating it.
+    if (!ok) end_ = start;
+    return ok;
+}
+
+void CrashSnapshot::Commit() {
+    if (map_ == nullptr) return;
+    uint64_t size = end_ - kHeaderSize;
+    Store<uint32_t>(map_ + kCrcOffset,
+                    crc32(0, map_ + kHeaderSize, static_cast<uInt>(size)));
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    Store<uint64_t>(map_ + kSizeOffset, size);
+}
+
+/*static*/ bool CrashSnapshot::Recover(const std::string& path,
+                                       std::string& snapshot) {
+    std::ifstream f(path, std::ios::binary);
+    if (!f.good()) return false;
+    std::stringstream buffer;
+    buffer << f.rdbuf();
+    f.close();
+    unlink(path.c_str());
+    std::string contents = buffer.str();
+    if (contents.size() < kHeaderSize) return false;
+    auto header = reinterpret_cast<const uint8_t*>(contents.data());
+    if (Load<uint32_t>(header) != kMagic ||
+        Load<uint32_t>(header + 4) != kVersion)
+        return false;
+    uint64_t size = Load<uint64_t>(header + kSizeOffset);
+    if (size == 0 || size > contents.size() - kHeaderSize) return false;
+    if (Load<uint32_t>(header + kCrcOffset) !=
+        crc32(0, header + kHeaderSize, static_cast<uInt>(size))) {
+        ALOGW("Crash snapshot is corrupt");
+        return false;
+    }
+    snapshot = contents.substr(kHeaderSize, size);
+    return true;
+}
+
+/*static*/ TuningFork_ErrorCode CrashSnapshot::Merge(
+    const std::string& snapshot, IdProvider& id_provider, Session& session) {
+    Reader r(snapshot);
+    while (r.Ok() && !r.AtEnd()) {
+        auto annotation_str = r.Bytes();
+        ProtobufSerialization annotation(annotation_str.begin(),
+                                         annotation_str.end());
+        InstrumentationKey key = r.Varint();
+        auto duration = std::chrono::nanoseconds(r.Varint());
+        auto kind = r.Varint();
+        int k = 0;
+        uint64_t count = 0;
+        std::vector<std::vector<float>> levels;
+        std::vector<uint32_t> counts;
+        if (kind == QUANTILE_SKETCH) {
+            k = r.Varint();
+            count = r.Varint();
+            levels.resize(r.Count());
+            for (auto& level : levels) {
+                level.resize(r.Count(sizeof(float)));
+                for (auto& x : level) x = r.Float();
+            }
+        } else if (kind == LINEAR || kind == LOG_LINEAR) {
+            uint64_t n_buckets = r.Varint();
+            if (n_buckets > kMaxBuckets) r.Fail();
+            size_t n_nonzero = r.Count(2);
+            if (r.Ok()) counts.resize(n_buckets);
+            for (size_t i = 0; r.Ok() && i < n_nonzero; ++i) {
+                uint64_t index = r.Varint();
+                uint64_t c = r.Varint();
+                if (index < counts.size())
+                    counts[index] += c;
+                else
+                    r.Fail();
+            }
+        } else {
+            return TUNINGFORK_ERROR_BAD_PARAMETER;
+        }
+        if (!r.Ok()) break;
+
+        AnnotationId annotation_id;
+        id_provider.SerializedAnnotationToAnnotationId(annotation,
+                                                       annotation_id);
+        if (annotation_id == annotation_util::kAnnotationError)
+            return TUNINGFORK_ERROR_BAD_PARAMETER;
+        MetricId id{0};
+        auto err = id_provider.MakeCompoundId(key, annotation_id, id);
+        if (err != TUNINGFORK_ERROR_OK) return err;
+        auto p = session.GetData<FrameTimeMetricData>(id);
+        if (p == nullptr)
+            return TUNINGFORK_ERROR_NO_MORE_SPACE_FOR_FRAME_TIME_DATA;
+        if ((kind == QUANTILE_SKETCH) != p->use_quantiles_)
+            return TUNINGFORK_ERROR_BAD_PARAMETER;
+        p->duration_ += duration;
+        if (kind == QUANTILE_SKETCH) {
+            if (k != p->quantiles_.K()) return TUNINGFORK_ERROR_BAD_PARAMETER;
+            err = p->quantiles_.MergeLevels(levels, count);
+            if (err != TUNINGFORK_ERROR_OK) return err;
+            continue;
+        }
+        if ((kind == LOG_LINEAR) !=
+            (p->histogram_.GetMode() == HistogramBase::Mode::LOG_LINEAR))
+            return TUNINGFORK_ERROR_BAD_PARAMETER;
+        err = p->histogram_.AddCounts(counts);
+        if (err != TUNINGFORK_ERROR_OK) return err;
+    }
+    if (!r.Ok()) {
+        ALOGE("Failed to read crash snapshot");
+        return TUNINGFORK_ERROR_BAD_PARAMETER;
+    }
+    return TUNINGFORK_ERROR_OK;
+}
+
+}  // namespace tuningfork
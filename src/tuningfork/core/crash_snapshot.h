@@ -0,0 +1,77 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "frametime_metric.h"
+#include "id_provider.h"
+#include "session.h"
+
+namespace tuningfork {
+
+// A preallocated, memory-mapped file that the crash handler writes the frame
+// time data recorded since the last flush into, so that it can be recovered
+// and uploaded on the next launch.
+//
+// Begin, Add and Commit only write to the mapping, without allocating or
+// locking, so they are safe to call from a signal handler. The snapshot only
+// becomes visible to Recover once Commit has written its size and checksum.
+class CrashSnapshot {
+   public:
+    static constexpr size_t kDefaultCapacity = 256 * 1024;
+
+    CrashSnapshot() {}
+    ~CrashSnapshot();
+
+    CrashSnapshot(const CrashSnapshot&) = delete;
+    CrashSnapshot& operator=(const CrashSnapshot&) = delete;
+
+    // Create and map the snapshot file. Any snapshot left at path by a
+    // previous run is discarded, so Recover it first.
+    bool Open(const std::string& path, size_t capacity = kDefaultCapacity);
+    void Close();
+    bool IsOpen() const { return map_ != nullptr; }
+
+    // Start a new snapshot, discarding the last one.
+    void Begin();
+    // Add the data for an instrument key and annotation, given by its
+    // serialization. Returns false if there isn't room.
+    bool Add(const uint8_t* annotation, size_t annotation_size,
+             InstrumentationKey key, const FrameTimeMetricData& data);
+    void Commit();
+
+    // Read the snapshot left at path by a crashed run, if any, and delete the
+    // file.
+    static bool Recover(const std::string& path, std::string& snapshot);
+
+    // Add the frame time data in a recovered snapshot to session.
+    static TuningFork_ErrorCode Merge(const std::string& snapshot,
+                                      IdProvider& id_provider,
+                                      Session& session);
+
+   private:
+    bool PutVarint(uint64_t x);
+    bool PutBytes(const void* p, size_t n);
+
+    int fd_ = -1;
+    uint8_t* map_ = nullptr;
+    size_t capacity_ = 0;
+    size_t end_ = 0;
+};
+
+}  // namespace tuningfork
@@ -0,0 +1,151 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fidelity_params_cache.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#define LOG_TAG "TuningFork:FPCache"
+#include "Log.h"
+#include "tuningfork_utils.h"
+
+namespace tuningfork {
+
+namespace {
+
+// A serialized protobuf can't start with 'T', which would be an end group
+// tag, so files without the magic number hold just the params.
+constexpr char kMagic[] = {'T', 'F', 'F', 'P'};
+constexpr uint8_t kFormatVersion = 1;
+
+void PutInt(std::string& bytes, uint64_t x, int n_bytes) {
+    for (int i = 0; i < n_bytes; ++i) bytes.push_back(char(x >> (8 * i)));
+}
+
+void PutBytes(std::string& bytes, const void* data, size_t size) {
+    PutInt(bytes, size, 4);
+    bytes.append(static_cast<const char*>(data), size);
+}
+
+class Reader {
+    const std::string& bytes_;
+    size_t pos_;
+
+   public:
+    Reader(const std::string& bytes, size_t pos) : bytes_(bytes), pos_(pos) {}
+
+    bool GetInt(uint64_t& x, int n_bytes) {
+        if (bytes_.size() - pos_ < size_t(n_bytes)) return false;
+        x = 0;
+        for (int i = 0; i < n_bytes; ++i)
+            x |= uint64_t(uint8_t(bytes_[pos_++])) << (8 * i);
+        return true;
+    }
+    bool GetString(std::string& s) {
+        uint64_t size;
+        if (!GetInt(size, 4) || bytes_.size() - pos_ < size) return false;
+        s = bytes_.substr(pos_, size);
+        pos_ += size;
+        return true;
+    }
+    bool Done() const { return pos_ == bytes_.size(); }
+};
+
+}  // anonymous namespace
+
+void FidelityParamsCache::Encode(const CachedFidelityParams& entry,
+                                 std::string& bytes) {
+    bytes.assign(kMagic, sizeof(kMagic));
+    bytes.push_back(char(kFormatVersion));
+    auto expiry_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                         entry.expiry.time_since_epoch())
+                         .count();
+    PutInt(bytes, uint64_t(expiry_ms), 8);
+    PutBytes(bytes, entry.version.data(), entry.version.size());
+    PutBytes(bytes, entry.experiment_id.data(), entry.experiment_id.size());
+    PutBytes(bytes, entry.params.data(), entry.params.size());
+}
+
+bool FidelityParamsCache::Decode(const std::string& bytes,
+                                 CachedFidelityParams& entry) {
+    if (bytes.compare(0, sizeof(kMagic), kMagic, sizeof(kMagic)) != 0) {
+        entry.params.assign(bytes.begin(), bytes.end());
+        entry.experiment_id.clear();
+        entry.version.clear();
+        entry.expiry = SystemTimePoint();
+        return true;
+    }
+    Reader reader(bytes, sizeof(kMagic));
+    uint64_t format, expiry_ms;
+    std::string version, experiment_id, params;
+    if (!reader.GetInt(format, 1) || format != kFormatVersion ||
+        !reader.GetInt(expiry_ms, 8) || !reader.GetString(version) ||
+        !reader.GetString(experiment_id) || !reader.GetString(params) ||
+        !reader.Done())
+        return false;
+    entry.version = version;
+    entry.experiment_id = experiment_id;
+    entry.params.assign(params.begin(), params.end());
+    entry.expiry = SystemTimePoint(std::chrono::duration_cast<SystemDuration>(
+        std::chrono::milliseconds(int64_t(expiry_ms))));
+    return true;
+}
+
+bool FidelityParamsCache::Exists() const {
+    return file_utils::FileExists(path_);
+}
+
+bool FidelityParamsCache::Load(CachedFidelityParams& entry) const {
+    std::ifstream file(path_, std::ios::binary);
+    if (!file.good()) {
+        ALOGI("Couldn't load fps from %s", path_.c_str());
+        return false;
+    }
+    std::stringstream bytes;
+    bytes << file.rdbuf();
+    if (!Decode(bytes.str(), entry)) {
+        ALOGW("Bad fps file %s", path_.c_str());
+        return false;
+    }
+    ALOGI("Loaded fps from %s (%zu bytes)", path_.c_str(),
+          entry.params.size());
+    return true;
+}
+
+bool FidelityParamsCache::Save(const CachedFidelityParams& entry) const {
+    std::string bytes;
+    Encode(entry, bytes);
+    // Write a new file and rename it, so a reader never sees half an entry.
+    std::string temp_path = path_ + ".tmp";
+    std::ofstream file(temp_path, std::ios::binary);
+    file.write(bytes.data(), bytes.size());
+    file.close();
+    if (file.fail() || std::rename(temp_path.c_str(), path_.c_str()) != 0) {
+        ALOGI("Couldn't save fps to %s", path_.c_str());
+        file_utils::DeleteFile(temp_path);
+        return false;
+    }
+    ALOGI("Saved fps to %s (%zu bytes)", path_.c_str(), entry.params.size());
+    return true;
+}
+
+bool FidelityParamsCache::Remove() const {
+    return file_utils::DeleteFile(path_);
+}
+
+}  // namespace tuningfork
@@ -0,0 +1,64 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "common.h"
+#include "proto/protobuf_util.h"
+
+namespace tuningfork {
+
+// How long downloaded fidelity params are used without revalidating them, if
+// the server doesn't say.
+constexpr Duration kDefaultFidelityParamsMaxAge = std::chrono::hours(24);
+
+// Fidelity params downloaded from the server, with what's needed to check
+// whether they are still current.
+struct CachedFidelityParams {
+    ProtobufSerialization params;
+    std::string experiment_id;
+    // The server's tag for this version of the params, sent back to it when
+    // revalidating. Empty if the server didn't give one.
+    std::string version;
+    // The params are used without waiting for the server until then. Params
+    // of unknown age expire at the epoch.
+    SystemTimePoint expiry;
+
+    bool Expired(SystemTimePoint now) const { return now >= expiry; }
+};
+
+// Persists CachedFidelityParams to a file. Files holding just the params, as
+// saved by earlier versions, load as params of unknown age.
+class FidelityParamsCache {
+    std::string path_;
+
+   public:
+    explicit FidelityParamsCache(const std::string& path) : path_(path) {}
+
+    const std::string& Path() const { return path_; }
+
+    bool Exists() const;
+    bool Load(CachedFidelityParams& entry) const;
+    bool Save(const CachedFidelityParams& entry) const;
+    bool Remove() const;
+
+    static void Encode(const CachedFidelityParams& entry, std::string& bytes);
+    static bool Decode(const std::string& bytes, CachedFidelityParams& entry);
+};
+
+}  // namespace tuningfork
@@ -0,0 +1,81 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include "settings.h"
+
+namespace tuningfork {
+
+// Chooses which frames of an instrument key are recorded when the key's
+// histogram settings ask for sampling. Each frame is chosen either every
+// period'th time or at random with probability 1/period, so each recorded
+// frame stands for period frames.
+//
+// A frame time from ticks is the time between the tick ending the frame and
+// the previous one, so that previous tick needs to be stamped too. Ticks that
+// neither end nor come just before a chosen frame are skipped entirely.
+class FrameSampler {
+   public:
+    enum class Action { SKIP, STAMP, RECORD };
+
+    FrameSampler(const Settings::Histogram& settings, uint32_t seed)
+        : period_(settings.SamplePeriod()),
+          random_(settings.sampling == Settings::Histogram::Sampling::RANDOM),
+          threshold_(static_cast<uint32_t>((uint64_t(1) << 32) / period_)),
+          state_(seed != 0 ? seed : 1),
+          next_(period_ == 1) {}
+
+    uint32_t Period() const { return period_; }
+
+    // What to do with the next tick.
+    Action Tick() {
+        bool chosen = next_;
+        next_ = Choose();
+        if (chosen) return Action::RECORD;
+        return next_ ? Action::STAMP : Action::SKIP;
+    }
+
+    // Whether to record the next frame time given directly.
+    bool Record() { return Choose(); }
+
+   private:
+    bool Choose() {
+        if (period_ == 1) return true;
+        if (random_) {
+            // xorshift32
+            state_ ^= state_ << 13;
+            state_ ^= state_ >> 17;
+            state_ ^= state_ << 5;
+            return state_ < threshold_;
+        }
+        if (++count_ < period_) return false;
+        count_ = 0;
+        return true;
+    }
+
+    uint32_t period_;
+    bool random_;
+    uint32_t threshold_;
+    uint32_t state_;
+    uint32_t count_ = 0;
+    // Whether the frame ended by the next tick is chosen.
+    bool next_;
+};
+
+}  // namespace tuningfork
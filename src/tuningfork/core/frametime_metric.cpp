@@ -20,26 +20,91 @@
 namespace tuningfork {
 
 void FrameTimeMetricData::Tick(TimePoint t, bool record) {
-    if (last_time_ != TimePoint::min() && t > last_time_ && record)
-        Record(t - last_time_);
+    if (last_time_ != TimePoint::min() && t > last_time_ && record) {
+        auto dt = t - last_time_;
+        Record(dt);
+    }
     last_time_ = t;
 }
 
 void FrameTimeMetricData::Record(Duration dt) {
     if (dt.count() > 0) {
+        auto ns =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(dt).count();
         // The histogram stores millisecond values as doubles
-        histogram_.Add(
-            double(std::chrono::duration_cast<std::chrono::nanoseconds>(dt)
-                       .count()) /
-            1000000);
-        duration_ += dt;
+        double ms = double(ns) / 1000000;
+        if (sample_period_ == 1) jank_.Record(ns);
+        if (use_quantiles_)
+            quantiles_.Add(ms);
+        else
+            histogram_.Add(ms);
+        duration_ += dt * sample_period_;
+    }
+}
+
+void FrameTimeMetricData::RecordBatch(const uint64_t* dts_ns, size_t n) {
+    double ms[HistogramBase::kBatchChunkSize];
+    while (n > 0) {
+        size_t m = n < HistogramBase::kBatchChunkSize
+                       ? n
+                       : HistogramBase::kBatchChunkSize;
+        size_t n_recorded = 0;
+        uint64_t total_ns = 0;
+        for (size_t i = 0; i < m; ++i) {
+            if (dts_ns[i] == 0) continue;
+            ms[n_recorded++] = double(dts_ns[i]) / 1000000;
+            if (sample_period_ == 1) jank_.Record(dts_ns[i]);
+            total_ns += dts_ns[i];
+        }
+        if (use_quantiles_) {
+            for (size_t i = 0; i < n_recorded; ++i) quantiles_.Add(ms[i]);
+        } else {
+            histogram_.AddBatch(ms, n_recorded);
+        }
+        duration_ += std::chrono::nanoseconds(total_ns * sample_period_);
+        dts_ns += m;
+        n -= m;
+    }
+}
+
+TuningFork_ErrorCode FrameTimeMetricData::Merge(
+    const FrameTimeMetricData& other) {
+    if (use_quantiles_ != other.use_quantiles_)
+        return TUNINGFORK_ERROR_BAD_PARAMETER;
+    auto err = use_quantiles_ ? quantiles_.Merge(other.quantiles_)
+                              : histogram_.Merge(other.histogram_);
+    if (err == TUNINGFORK_ERROR_OK) {
+        duration_ += other.duration_;
+        jank_.Merge(other.jank_);
     }
+    return err;
+}
+
+std::vector<uint32_t> FrameTimeMetricData::ScaledCounts() const {
+    auto counts = histogram_.buckets();
+    if (sample_period_ > 1)
+        for (auto& c : counts) c *= sample_period_;
+    return counts;
+}
+
+void FrameTimeMetricData::AddScaledCounts(std::vector<uint32_t> counts) {
+    if (sample_period_ > 1)
+        for (auto& c : counts) c /= sample_period_;
+    histogram_.AddCounts(counts);
+}
+
+TuningFork_ErrorCode FrameTimeMetricData::MergeScaledQuantiles(
+    const std::vector<std::vector<float>>& levels, uint64_t count) {
+    if (count % sample_period_ != 0) return TUNINGFORK_ERROR_BAD_PARAMETER;
+    return quantiles_.MergeLevels(levels, count / sample_period_);
 }
 
 void FrameTimeMetricData::Clear() {
     last_time_ = TimePoint::min();
     histogram_.Clear();
+    quantiles_.Clear();
     duration_ = Duration::zero();
+    jank_.Clear();
 }
 
 }  // namespace tuningfork
@@ -17,7 +17,9 @@
 #pragma once
 
 #include "histogram.h"
+#include "jank_metric.h"
 #include "metricdata.h"
+#include "quantile_sketch.h"
 #include "settings.h"
 
 namespace tuningfork {
@@ -35,16 +37,52 @@ struct FrameTimeMetricData : public MetricData {
         : MetricData(MetricType()),
           metric_id_(metric_id),
           histogram_(settings, false /*isLoading*/),
+          use_quantiles_(settings.storage ==
+                         Settings::Histogram::Storage::QUANTILE_SKETCH),
+          quantiles_(settings.n_buckets > 0 ? settings.n_buckets
+                                            : QuantileSketch::kDefaultK),
+          sample_period_(settings.SamplePeriod()),
           last_time_(TimePoint::min()),
           duration_(Duration::zero()) {}
     MetricId metric_id_;
     Histogram<double> histogram_;
+    // If set, frame times go in quantiles_ rather than histogram_.
+    bool use_quantiles_;
+    QuantileSketch quantiles_;
+    // Each recorded frame stands for this many frames when sampling. The
+    // duration is scaled as frames are recorded and histogram counts when
+    // serialized, as is the count of the quantile sketch. Jank needs every
+    // frame, so isn't recorded when sampling.
+    uint32_t sample_period_;
     TimePoint last_time_;
     Duration duration_;
+    // Jank in the recorded frame times, however they were recorded.
+    JankMetricData jank_;
     void Tick(TimePoint t, bool record = true);
     void Record(Duration dt);
+    // Record n durations given in nanoseconds.
+    void RecordBatch(const uint64_t* dts_ns, size_t n);
+    // Add the histogram or quantiles and duration recorded in another metric
+    // with the same settings.
+    TuningFork_ErrorCode Merge(const FrameTimeMetricData& other);
+    // Histogram counts scaled by the sample period, for serialization.
+    std::vector<uint32_t> ScaledCounts() const;
+    // Add serialized histogram counts, undoing the scaling.
+    void AddScaledCounts(std::vector<uint32_t> counts);
+    // The quantile sketch's count scaled by the sample period, for
+    // serialization.
+    uint64_t ScaledQuantileCount() const {
+        return quantiles_.Count() * sample_period_;
+    }
+    // Merge serialized quantile sketch levels, undoing the scaling of count.
+    TuningFork_ErrorCode MergeScaledQuantiles(
+        const std::vector<std::vector<float>>& levels, uint64_t count);
+    // The number of frames the recorded frame times stand for.
+    size_t FrameCount() const { return Count() * sample_period_; }
     virtual void Clear() override;
-    virtual size_t Count() const override { return histogram_.Count(); }
+    virtual size_t Count() const override {
+        return use_quantiles_ ? quantiles_.Count() : histogram_.Count();
+    }
     static Metric::Type MetricType() { return Metric::Type::FRAME_TIME; }
 };
 
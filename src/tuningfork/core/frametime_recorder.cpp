@@ -0,0 +1,378 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "frametime_recorder.h"
+
+#include <thread>
+
+#define LOG_TAG "TuningFork"
+#include "Log.h"
+
+namespace tuningfork {
+
+namespace {
+
+std::atomic<uint64_t> s_next_recorder_id{1};
+
+// Each thread caches the slots it was given by the last recorder it used and
+// releases them when it exits or uses another recorder.
+struct ThreadCache {
+    uint64_t recorder_id = 0;
+    void* slots = nullptr;
+    // Points into the slots and keeps them alive.
+    std::shared_ptr<std::atomic<bool>> released;
+
+    ~ThreadCache() { Release(); }
+    void Release() {
+        if (released) released->store(true, std::memory_order_release);
+        released.reset();
+        slots = nullptr;
+        recorder_id = 0;
+    }
+};
+thread_local ThreadCache t_cache;
+
+}  // anonymous namespace
+
+constexpr size_t FrameTimeRecorder::kMaxThreads;
+constexpr size_t FrameTimeRecorder::kMaxCountedIds;
+
+FrameTimeRecorder::FrameTimeRecorder(
+    IdProvider* id_provider,
+    const std::vector<Settings::Histogram>& histogram_settings,
+    uint32_t max_instrumentation_keys, uint32_t num_annotations,
+    uint32_t max_num_metrics)
+    : id_(s_next_recorder_id++),
+      id_provider_(id_provider),
+      histogram_settings_(histogram_settings),
+      max_instrumentation_keys_(max_instrumentation_keys) {
+    if (max_instrumentation_keys_ == 0) max_instrumentation_keys_ = 1;
+    for (const auto& settings : histogram_settings_) {
+        if (settings.SamplePeriod() > 1) sampling_ = true;
+    }
+    // The session cycles through instrument keys when creating its frame time
+    // histograms, so do the same here.
+    metrics_per_ikey_.resize(max_instrumentation_keys_, 0);
+    for (uint32_t i = 0; i < max_num_metrics; ++i) {
+        metrics_per_ikey_[i % max_instrumentation_keys_]++;
+    }
+    for (int b = 0; b < 2; ++b) {
+        available_[b].reset(
+            new std::atomic<int32_t>[max_instrumentation_keys_]);
+        for (uint32_t i = 0; i < max_instrumentation_keys_; ++i) {
+            available_[b][i].store(metrics_per_ikey_[i]);
+        }
+    }
+    num_counted_ids_ = std::min<size_t>(
+        size_t(num_annotations) * max_instrumentation_keys_, kMaxCountedIds);
+    size_t n_words = (num_counted_ids_ + 63) / 64;
+    for (int b = 0; b < 2; ++b) {
+        counted_[b].reset(new std::atomic<uint64_t>[n_words]);
+        for (size_t i = 0; i < n_words; ++i) counted_[b][i].store(0);
+    }
+}
+
+FrameTimeRecorder::ThreadSlots* FrameTimeRecorder::ThisThreadSlots() {
+    if (t_cache.recorder_id != id_) {
+        t_cache.Release();
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::shared_ptr<ThreadSlots> slots;
+        size_t n = num_threads_.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < n; ++i) {
+            if (threads_[i]->released.load(std::memory_order_acquire)) {
+                slots = threads_[i];
+                break;
+            }
+        }
+        if (slots) {
+            // Keep any data not yet merged, but don't time a frame from the
+            // previous owner's last tick.
+            for (auto& buffer : slots->buffers)
+                for (auto& slot : buffer)
+                    slot.data->last_time_ = TimePoint::min();
+            slots->released.store(false, std::memory_order_relaxed);
+        } else if (n < kMaxThreads) {
+            slots = std::make_shared<ThreadSlots>();
+            for (auto& buffer : slots->buffers) {
+                for (uint32_t i = 0; i < max_instrumentation_keys_; ++i) {
+                    buffer.push_back(
+                        Slot{false, 0, 0, false,
+                             std::unique_ptr<FrameTimeMetricData>(
+                                 new FrameTimeMetricData(
+                                     MetricId::FrameTime(0, i),
+                                     HistogramSettings(i)))});
+                }
+            }
+            threads_[n] = slots;
+            num_threads_.store(n + 1, std::memory_order_release);
+        } else {
+            ALOGW_ONCE("Too many threads recording frame times");
+            return nullptr;
+        }
+        t_cache.slots = slots.get();
+        t_cache.released =
+            std::shared_ptr<std::atomic<bool>>(slots, &slots->released);
+        t_cache.recorder_id = id_;
+    }
+    return static_cast<ThreadSlots*>(t_cache.slots);
+}
+
+size_t FrameTimeRecorder::NumThreadSlots() {
+    return num_threads_.load(std::memory_order_acquire);
+}
+
+uint64_t FrameTimeRecorder::BeginWrite(ThreadSlots& slots) {
+    // If a merge starts between reading the epoch and publishing that we're
+    // writing, it may already have checked this thread, so try again.
+    uint64_t epoch;
+    do {
+        epoch = epoch_.load(std::memory_order_acquire);
+        slots.writing.store(epoch + 1, std::memory_order_seq_cst);
+    } while (epoch_.load(std::memory_order_seq_cst) != epoch);
+    return epoch;
+}
+
+TuningFork_ErrorCode FrameTimeRecorder::GetData(ThreadSlots& slots,
+                                                uint64_t epoch,
+                                                InstrumentationKey key,
+                                                AnnotationId annotation,
+                                                FrameTimeMetricData** pdata) {
+    int b = epoch & 1;
+    auto& buffer = slots.buffers[b];
+    size_t& last = slots.last_used[b];
+    auto matches = [key, annotation](const Slot& s) {
+        return s.assigned && s.key == key && s.annotation == annotation;
+    };
+    Slot* slot = nullptr;
+    if (last < buffer.size() && matches(buffer[last])) {
+        slot = &buffer[last];
+    } else {
+        for (size_t i = 0; i < buffer.size(); ++i) {
+            if (matches(buffer[i])) {
+                slot = &buffer[i];
+                last = i;
+                break;
+            }
+        }
+    }
+    if (slot == nullptr) {
+        MetricId id;
+        auto err = id_provider_->MakeCompoundId(key, annotation, id);
+        if (err != TUNINGFORK_ERROR_OK) return err;
+        auto ikey = id.detail.frame_time.ikey;
+        if (ikey >= max_instrumentation_keys_)
+            return TUNINGFORK_ERROR_INVALID_INSTRUMENT_KEY;
+        // Use a free slot with the right settings if there is one.
+        size_t i = 0;
+        while (i < buffer.size() &&
+               (buffer[i].assigned ||
+                buffer[i].data->metric_id_.detail.frame_time.ikey != ikey))
+            ++i;
+        if (i == buffer.size()) {
+            // This thread hasn't recorded this many metrics for the instrument
+            // key before.
+            buffer.push_back(Slot{false, key, annotation, false,
+                                  std::unique_ptr<FrameTimeMetricData>(
+                                      new FrameTimeMetricData(
+                                          id, HistogramSettings(ikey)))});
+        }
+        last = i;
+        slot = &buffer[i];
+        slot->assigned = true;
+        slot->key = key;
+        slot->annotation = annotation;
+        slot->data->metric_id_ = id;
+    }
+    if (!slot->active) {
+        auto err = CountMetric(b, slot->data->metric_id_);
+        if (err != TUNINGFORK_ERROR_OK) return err;
+        slot->active = true;
+    }
+    *pdata = slot->data.get();
+    return TUNINGFORK_ERROR_OK;
+}
+
+TuningFork_ErrorCode FrameTimeRecorder::CountMetric(int b, MetricId id) {
+    auto ikey = id.detail.frame_time.ikey;
+    size_t i = size_t(id.detail.annotation) * max_instrumentation_keys_ + ikey;
+    std::atomic<uint64_t>* word = nullptr;
+    uint64_t bit = 0;
+    if (i < num_counted_ids_) {
+        word = &counted_[b][i / 64];
+        bit = uint64_t(1) << (i % 64);
+        if (word->load(std::memory_order_relaxed) & bit)
+            return TUNINGFORK_ERROR_OK;
+    }
+    // Each metric takes up one of the session's metrics when it is merged.
+    auto& available = available_[b][ikey];
+    if (available.fetch_sub(1) <= 0) {
+        available.fetch_add(1);
+        return TUNINGFORK_ERROR_NO_MORE_SPACE_FOR_FRAME_TIME_DATA;
+    }
+    // Give it back if another thread counted the metric in the meantime.
+    if (word != nullptr && (word->fetch_or(bit) & bit)) available.fetch_add(1);
+    return TUNINGFORK_ERROR_OK;
+}
+
+FrameSampler* FrameTimeRecorder::GetSampler(ThreadSlots& slots,
+                                            InstrumentationKey key,
+                                            AnnotationId annotation) {
+    auto& samplers = slots.samplers;
+    size_t& last = slots.last_sampler;
+    if (last < samplers.size() && samplers[last].first == key)
+        return &samplers[last].second;
+    for (size_t i = 0; i < samplers.size(); ++i) {
+        if (samplers[i].first == key) {
+            last = i;
+            return &samplers[i].second;
+        }
+    }
+    MetricId id;
+    if (id_provider_->MakeCompoundId(key, annotation, id) !=
+        TUNINGFORK_ERROR_OK)
+        return nullptr;
+    auto ikey = id.detail.frame_time.ikey;
+    // Seed from the key and thread so that keys aren't sampled in step.
+    uint32_t seed = static_cast<uint32_t>(key) * 2654435761u ^
+                    static_cast<uint32_t>(reinterpret_cast<uintptr_t>(&slots));
+    samplers.emplace_back(key, FrameSampler(HistogramSettings(ikey), seed));
+    last = samplers.size() - 1;
+    return &samplers[last].second;
+}
+
+FrameSampler::Action FrameTimeRecorder::SampleTick(InstrumentationKey key,
+                                                   AnnotationId annotation) {
+    if (!sampling_) return FrameSampler::Action::RECORD;
+    auto slots = ThisThreadSlots();
+    // Let Tick report invalid keys and running out of slots.
+    if (slots == nullptr) return FrameSampler::Action::RECORD;
+    auto sampler = GetSampler(*slots, key, annotation);
+    if (sampler == nullptr) return FrameSampler::Action::RECORD;
+    return sampler->Tick();
+}
+
+TuningFork_ErrorCode FrameTimeRecorder::Tick(InstrumentationKey key,
+                                             AnnotationId annotation,
+                                             TimePoint t, bool record,
+                                             size_t* pcount) {
+    auto slots = ThisThreadSlots();
+    if (slots == nullptr)
+        return TUNINGFORK_ERROR_NO_MORE_SPACE_FOR_FRAME_TIME_DATA;
+    auto epoch = BeginWrite(*slots);
+    FrameTimeMetricData* data;
+    auto err = GetData(*slots, epoch, key, annotation, &data);
+    if (err == TUNINGFORK_ERROR_OK) {
+        data->Tick(t, record);
+        if (pcount != nullptr) *pcount = data->FrameCount();
+    }
+    EndWrite(*slots);
+    return err;
+}
+
+TuningFork_ErrorCode FrameTimeRecorder::Record(InstrumentationKey key,
+                                               AnnotationId annotation,
+                                               Duration dt, bool record,
+                                               size_t* pcount) {
+    auto slots = ThisThreadSlots();
+    if (slots == nullptr)
+        return TUNINGFORK_ERROR_NO_MORE_SPACE_FOR_FRAME_TIME_DATA;
+    if (sampling_) {
+        auto sampler = GetSampler(*slots, key, annotation);
+        if (sampler != nullptr && !sampler->Record())
+            return TUNINGFORK_ERROR_OK;
+    }
+    auto epoch = BeginWrite(*slots);
+    FrameTimeMetricData* data;
+    auto err = GetData(*slots, epoch, key, annotation, &data);
+    if (err == TUNINGFORK_ERROR_OK) {
+        if (record) data->Record(dt);
+        if (pcount != nullptr) *pcount = data->FrameCount();
+    }
+    EndWrite(*slots);
+    return err;
+}
+
+TuningFork_ErrorCode FrameTimeRecorder::RecordBatch(InstrumentationKey key,
+                                                    AnnotationId annotation,
+                                                    const uint64_t* dts_ns,
+                                                    size_t n, bool record,
+                                                    size_t* pcount) {
+    auto slots = ThisThreadSlots();
+    if (slots == nullptr)
+        return TUNINGFORK_ERROR_NO_MORE_SPACE_FOR_FRAME_TIME_DATA;
+    auto epoch = BeginWrite(*slots);
+    FrameTimeMetricData* data;
+    auto err = GetData(*slots, epoch, key, annotation, &data);
+    if (err == TUNINGFORK_ERROR_OK) {
+        // GetData succeeded, so the key is valid and, if any key is sampled,
+        // there is a sampler.
+        FrameSampler* sampler = nullptr;
+        if (sampling_) sampler = GetSampler(*slots, key, annotation);
+        if (record && (sampler == nullptr || sampler->Period() == 1)) {
+            data->RecordBatch(dts_ns, n);
+        } else if (record) {
+            for (size_t i = 0; i < n; ++i)
+                if (sampler->Record())
+                    data->Record(std::chrono::nanoseconds(dts_ns[i]));
+        }
+        if (pcount != nullptr) *pcount = data->FrameCount();
+    }
+    EndWrite(*slots);
+    return err;
+}
+
+void FrameTimeRecorder::MergeInto(Session& session) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // New writes go to the other buffer from now on.
+    uint64_t epoch = epoch_.fetch_add(1, std::memory_order_seq_cst);
+    int b = epoch & 1;
+    // When flushing from the crash handler, this thread may have been
+    // interrupted in the middle of a write, so don't wait for itself.
+    void* own_slots = t_cache.recorder_id == id_ ? t_cache.slots : nullptr;
+    size_t n = num_threads_.load(std::memory_order_relaxed);
+    for (size_t t = 0; t < n; ++t) {
+        auto& slots = threads_[t];
+        // Wait for any write that started before the switch.
+        while (slots.get() != own_slots &&
+               slots->writing.load(std::memory_order_acquire) == epoch + 1) {
+            std::this_thread::yield();
+        }
+        for (auto& slot : slots->buffers[b]) {
+            // Slots that weren't used this time around are freed for reuse.
+            if (!slot.active) {
+                slot.assigned = false;
+                continue;
+            }
+            if (slot.data->Count() > 0) {
+                auto p = session.GetData<FrameTimeMetricData>(
+                    slot.data->metric_id_);
+                if (p == nullptr || p->Merge(*slot.data) != TUNINGFORK_ERROR_OK)
+                    ALOGW_ONCE("Couldn't merge frame time data into session");
+            }
+            slot.data->Clear();
+            slot.active = false;
+        }
+        slots->last_used[b] = 0;
+    }
+    for (uint32_t i = 0; i < max_instrumentation_keys_; ++i) {
+        available_[b][i].store(metrics_per_ikey_[i]);
+    }
+    for (size_t i = 0; i < (num_counted_ids_ + 63) / 64; ++i) {
+        counted_[b][i].store(0, std::memory_order_relaxed);
+    }
+}
+
+}  // namespace tuningfork
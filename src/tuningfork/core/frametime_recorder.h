@@ -0,0 +1,193 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "frame_sampler.h"
+#include "frametime_metric.h"
+#include "id_provider.h"
+#include "session.h"
+
+namespace tuningfork {
+
+// Records frame times without taking any locks on the tick path.
+// Each thread that ticks gets its own set of slots, keyed by (annotation,
+// instrument key), which only that thread writes to. The slots are
+// double-buffered: MergeInto switches every thread over to its other buffer
+// and then adds the previous buffer to the session. This happens only when
+// the session is flushed. Each thread starts with a free slot per instrument
+// key index in each buffer and slots are reused after a merge, so ticks only
+// allocate when a thread records more metrics than it has before.
+class FrameTimeRecorder {
+   public:
+    // The most threads that can record at once. Threads release their slots
+    // when they exit, so this only limits threads that are alive together.
+    static constexpr size_t kMaxThreads = 64;
+
+    // max_num_metrics is the limit on frame time metrics in a session and is
+    // split between instrument keys in the same way as in the Session.
+    // Annotation ids are less than num_annotations.
+    FrameTimeRecorder(
+        IdProvider* id_provider,
+        const std::vector<Settings::Histogram>& histogram_settings,
+        uint32_t max_instrumentation_keys, uint32_t num_annotations,
+        uint32_t max_num_metrics);
+
+    FrameTimeRecorder(const FrameTimeRecorder&) = delete;
+    FrameTimeRecorder& operator=(const FrameTimeRecorder&) = delete;
+
+    // What to do with this thread's next tick of key, according to the
+    // sampling in its histogram settings. SKIP means Tick needn't be called;
+    // STAMP means it should be called with record false.
+    FrameSampler::Action SampleTick(InstrumentationKey key,
+                                    AnnotationId annotation);
+
+    // Record the time between t and the previous tick for key and annotation,
+    // if record is true. Fills *pcount, if non-null, with the number of frames
+    // this thread has recorded for them since the last merge, counting each
+    // sampled frame time as the frames it stands for.
+    TuningFork_ErrorCode Tick(InstrumentationKey key, AnnotationId annotation,
+                              TimePoint t, bool record, size_t* pcount);
+
+    // Record dt for key and annotation, if record is true and it is sampled.
+    TuningFork_ErrorCode Record(InstrumentationKey key,
+                                AnnotationId annotation, Duration dt,
+                                bool record, size_t* pcount);
+
+    // Record n durations, in nanoseconds, for key and annotation, if record is
+    // true. Only the sampled ones are recorded.
+    TuningFork_ErrorCode RecordBatch(InstrumentationKey key,
+                                     AnnotationId annotation,
+                                     const uint64_t* dts_ns, size_t n,
+                                     bool record, size_t* pcount);
+
+    // Add all the data recorded since the last call to session and reset
+    // each thread's buffer, including the time of the last tick.
+    void MergeInto(Session& session);
+
+    // Stop merges while the returned lock is held, unless one is already in
+    // progress, in which case the lock isn't owned. This doesn't block, so the
+    // crash handler can use it to check that the data it reads isn't being
+    // merged into the session.
+    std::unique_lock<std::mutex> TryLockMerges() {
+        return std::unique_lock<std::mutex>(mutex_, std::try_to_lock);
+    }
+
+    // Call f for the data each thread is currently recording into, skipping
+    // threads that are part way through a write. This neither locks nor
+    // allocates, so it can be used from a signal handler.
+    template <typename F>
+    void ForEachLiveData(F f) const {
+        int b = epoch_.load(std::memory_order_acquire) & 1;
+        size_t n = num_threads_.load(std::memory_order_acquire);
+        for (size_t i = 0; i < n; ++i) {
+            const auto& slots = threads_[i];
+            if (slots->writing.load(std::memory_order_acquire) != 0) continue;
+            for (auto& slot : slots->buffers[b])
+                if (slot.assigned && slot.active) f(slot.data.get());
+        }
+    }
+
+    // The number of sets of slots, live or waiting for a new thread.
+    size_t NumThreadSlots();
+
+   private:
+    struct Slot {
+        // Free slots are set up for an instrument key index, in data's
+        // metric id, but not yet for a key and annotation.
+        bool assigned;
+        InstrumentationKey key;
+        AnnotationId annotation;
+        bool active;
+        std::unique_ptr<FrameTimeMetricData> data;
+    };
+    struct ThreadSlots {
+        // Set to epoch + 1 by the owning thread while it is writing and zero
+        // otherwise.
+        std::atomic<uint64_t> writing{0};
+        std::vector<Slot> buffers[2];
+        // Index of the slot last used in each buffer.
+        size_t last_used[2] = {0, 0};
+        // Samplers for the keys this thread has used. These aren't
+        // double-buffered since MergeInto doesn't touch them.
+        std::vector<std::pair<InstrumentationKey, FrameSampler>> samplers;
+        size_t last_sampler = 0;
+        // Set when the owning thread exits or moves to another recorder.
+        std::atomic<bool> released{false};
+    };
+
+    // Returns nullptr if there are already kMaxThreads threads recording.
+    ThreadSlots* ThisThreadSlots();
+
+    const Settings::Histogram& HistogramSettings(uint32_t ikey) const {
+        return histogram_settings_[ikey < histogram_settings_.size() ? ikey
+                                                                     : 0];
+    }
+
+    // Returns the slot's data in the buffer for epoch, activating or creating
+    // the slot if needed. Only called by the thread owning slots.
+    TuningFork_ErrorCode GetData(ThreadSlots& slots, uint64_t epoch,
+                                 InstrumentationKey key,
+                                 AnnotationId annotation,
+                                 FrameTimeMetricData** pdata);
+
+    // Returns the sampler for key, or nullptr if key is invalid.
+    FrameSampler* GetSampler(ThreadSlots& slots, InstrumentationKey key,
+                             AnnotationId annotation);
+
+    // Take one of the metrics available in buffer b for id, unless another
+    // thread has already taken it.
+    TuningFork_ErrorCode CountMetric(int b, MetricId id);
+
+    // Mark this thread as writing and return the epoch it's writing for.
+    uint64_t BeginWrite(ThreadSlots& slots);
+    void EndWrite(ThreadSlots& slots) {
+        slots.writing.store(0, std::memory_order_release);
+    }
+
+    const uint64_t id_;
+    IdProvider* id_provider_;
+    std::vector<Settings::Histogram> histogram_settings_;
+    // Whether any histogram samples frames. If not, there's no need to look
+    // up samplers on the tick path.
+    bool sampling_ = false;
+    uint32_t max_instrumentation_keys_;
+    std::vector<int32_t> metrics_per_ikey_;
+    // Remaining metrics available for each instrument key index, per buffer.
+    std::unique_ptr<std::atomic<int32_t>[]> available_[2];
+    // Each metric is counted once per buffer, however many threads record it,
+    // by setting the bit at annotation * max_instrumentation_keys_ + ikey.
+    // Metrics past kMaxCountedIds are counted once per thread instead.
+    static constexpr size_t kMaxCountedIds = 1 << 20;
+    size_t num_counted_ids_;
+    std::unique_ptr<std::atomic<uint64_t>[]> counted_[2];
+    std::atomic<uint64_t> epoch_{0};
+    // Guards adding to threads_ and serializes merges.
+    std::mutex mutex_;
+    // Threads share ownership of their slots, so they can release them on
+    // exit even if the recorder has gone. Entries are only added, at
+    // num_threads_, and are published by incrementing it, so the first
+    // num_threads_ can be read without taking mutex_.
+    std::shared_ptr<ThreadSlots> threads_[kMaxThreads];
+    std::atomic<size_t> num_threads_{0};
+};
+
+}  // namespace tuningfork
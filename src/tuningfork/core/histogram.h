@@ -18,9 +18,12 @@
 
 #include <inttypes.h>
 
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <sstream>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "tuningfork_internal.h"
@@ -36,11 +39,21 @@ struct HistogramBase {
         AUTO_RANGE = 1,  // Store a buffer of events until they fill samples_,
                          // then bucket
         EVENTS_ONLY =
-            2  // Store a circular buffer of events and never bucket them
+            2,  // Store a circular buffer of events and never bucket them
+        LOG_LINEAR = 3  // Store in buckets that split each power of two into
+                        // 2^sub_bucket_bits equal parts
     };
     static constexpr int kAutoSizeNumStdDev = 3;
     static constexpr double kAutoSizeMinBucketSizeMs = 0.1;
     static constexpr int kDefaultNumBuckets = 200;
+    // A relative error of at most 1/16 in log-linear mode.
+    static constexpr int kDefaultSubBucketBits = 4;
+    static constexpr int kMaxSubBucketBits = 10;
+    // Samples added in batches are bucketed this many at a time.
+    static constexpr int kBatchChunkSize = 64;
+    // Bucket counts are stored sparsely until this fraction of the buckets is
+    // non-zero, at which point they are stored densely.
+    static constexpr int kSparseFillDivisor = 4;
 };
 
 template <typename Sample>
@@ -51,10 +64,16 @@ class Histogram : HistogramBase {
     Mode mode_;
     Sample start_, end_, bucket_size_;
     uint32_t num_buckets_;
+    // Either num_buckets_ counts, or empty if the counts are in sparse_.
     std::vector<uint32_t> buckets_;
+    // The non-zero counts, as (index, count) pairs ordered by index.
+    std::vector<std::pair<uint32_t, uint32_t>> sparse_;
     std::vector<Sample> samples_;
     size_t count_;
     size_t next_event_index_;
+    // Only used in LOG_LINEAR mode
+    uint32_t sub_bucket_bits_;
+    uint64_t start_key_;
 
    public:
     explicit Histogram(Sample start = 0, Sample end = 0,
@@ -65,6 +84,11 @@ class Histogram : HistogramBase {
     // Add a sample delta time
     void Add(Sample sample);
 
+    // Add n samples. Gives the same result as calling Add on each, but
+    // computes the bucket indices of bucketed histograms in a separate loop
+    // that the compiler can vectorize.
+    void AddBatch(const Sample* samples, size_t n);
+
     // Reset the histogram
     void Clear();
 
@@ -80,19 +104,93 @@ class Histogram : HistogramBase {
     void CalcBucketsFromSamples();
 
     // Only to be used for testing
-    void SetCounts(const std::vector<uint32_t>& counts) { buckets_ = counts; }
+    void SetCounts(const std::vector<uint32_t>& counts) {
+        buckets_ = counts;
+        sparse_.clear();
+    }
 
     TuningFork_ErrorCode AddCounts(const std::vector<uint32_t>& counts);
 
+    // Add the buckets or events of another histogram with the same settings.
+    TuningFork_ErrorCode Merge(const Histogram& h);
+
     bool operator==(const Histogram& h) const;
 
-    const std::vector<uint32_t>& buckets() const { return buckets_; }
+    // Get the count in each bucket. Histograms with few non-zero buckets
+    // don't store the zero counts, so this makes a copy.
+    std::vector<uint32_t> buckets() const;
+
+    // The memory used for bucket counts, in bytes.
+    size_t BucketBytes() const {
+        return buckets_.capacity() * sizeof(uint32_t) +
+               sparse_.capacity() * sizeof(sparse_[0]);
+    }
+
+    size_t NumBuckets() const {
+        return Dense() ? buckets_.size() : num_buckets_;
+    }
+
+    // Call f(index, count) for each non-zero bucket, in order of index.
+    // Unlike buckets(), this doesn't allocate.
+    template <typename F>
+    void ForEachNonZeroBucket(F f) const {
+        if (Dense()) {
+            for (uint32_t i = 0; i < buckets_.size(); ++i)
+                if (buckets_[i] != 0) f(i, buckets_[i]);
+        } else {
+            for (auto& e : sparse_) f(e.first, e.second);
+        }
+    }
 
     const std::vector<Sample>& samples() const { return samples_; }
 
     Mode GetMode() const { return mode_; }
     Sample BucketStart() const { return start_; }
     Sample BucketEnd() const { return end_; }
+    uint32_t SubBucketBits() const { return sub_bucket_bits_; }
+
+   private:
+    bool Bucketed() const {
+        return mode_ == Mode::HISTOGRAM || mode_ == Mode::LOG_LINEAR;
+    }
+
+    bool Dense() const { return !buckets_.empty(); }
+
+    void AddToBucket(uint32_t i, uint32_t n = 1) {
+        if (Dense())
+            buckets_[i] += n;
+        else
+            AddToSparseBucket(i, n);
+    }
+
+    void AddToSparseBucket(uint32_t i, uint32_t n);
+
+    // Zero all the counts, keeping their representation.
+    void ClearCounts() {
+        std::fill(buckets_.begin(), buckets_.end(), 0);
+        sparse_.clear();
+    }
+
+    // Switch to log-linear buckets covering [start_, end_).
+    void InitLogLinear(int sub_bucket_bits);
+
+    // The exponent and top mantissa bits of a positive double increase
+    // with its value, so they can be used directly as a bucket key.
+    uint64_t LogLinearKey(double x) const {
+        uint64_t bits;
+        memcpy(&bits, &x, sizeof(bits));
+        return bits >> (52 - sub_bucket_bits_);
+    }
+    static double LogLinearKeyStart(uint64_t key, uint32_t sub_bucket_bits) {
+        uint64_t bits = key << (52 - sub_bucket_bits);
+        double x;
+        memcpy(&x, &bits, sizeof(x));
+        return x;
+    }
+
+   public:
+    // The lower bound of bucket i, which must not be the underflow bucket.
+    Sample BucketLowerBound(uint32_t i) const;
 
     friend class ClearcutSerializer;
 };
@@ -111,27 +209,55 @@ Histogram<Sample>::Histogram(Sample start, Sample end, int num_buckets_between,
                    (num_buckets_between <= 0 ? 1 : num_buckets_between)),
       num_buckets_(num_buckets_between <= 0 ? kDefaultNumBuckets
                                             : (num_buckets_between + 2)),
-      buckets_(num_buckets_),
       count_(0),
-      next_event_index_(0) {
-    std::fill(buckets_.begin(), buckets_.end(), 0);
+      next_event_index_(0),
+      sub_bucket_bits_(0),
+      start_key_(0) {
     switch (mode_) {
         case Mode::HISTOGRAM:
             if (bucket_size_ <= 0)
                 ALOGE("Histogram end needs to be larger than histogram begin");
             break;
         case Mode::AUTO_RANGE:
-            samples_.reserve(num_buckets_);
             break;
         case Mode::EVENTS_ONLY:
             samples_.resize(num_buckets_);
             break;
+        case Mode::LOG_LINEAR:
+            break;
     }
 }
 
 template <typename Sample>
 Histogram<Sample>::Histogram(const Settings::Histogram& hs, bool never_bucket)
-    : Histogram(hs.bucket_min, hs.bucket_max, hs.n_buckets, never_bucket) {}
+    : Histogram(hs.bucket_min, hs.bucket_max, hs.n_buckets, never_bucket) {
+    if (hs.scale == Settings::Histogram::Scale::LOG_LINEAR && !never_bucket)
+        InitLogLinear(hs.sub_bucket_bits);
+}
+
+template <typename Sample>
+void Histogram<Sample>::InitLogLinear(int sub_bucket_bits) {
+    if (sub_bucket_bits <= 0) sub_bucket_bits = kDefaultSubBucketBits;
+    sub_bucket_bits_ = sub_bucket_bits < kMaxSubBucketBits ? sub_bucket_bits
+                                                           : kMaxSubBucketBits;
+    // Logarithmic buckets can't start at zero.
+    double min_value = start_ > 0 ? start_ : kAutoSizeMinBucketSizeMs;
+    double max_value = end_ > min_value ? end_ : min_value;
+    if (end_ <= start_)
+        ALOGE("Histogram end needs to be larger than histogram begin");
+    start_key_ = LogLinearKey(min_value);
+    uint64_t end_key = LogLinearKey(max_value) + 1;
+    start_ = LogLinearKeyStart(start_key_, sub_bucket_bits_);
+    end_ = LogLinearKeyStart(end_key, sub_bucket_bits_);
+    bucket_size_ = 0;
+    // Extra buckets for values below start_ and above end_.
+    num_buckets_ = end_key - start_key_ + 2;
+    buckets_.clear();
+    sparse_.clear();
+    samples_.clear();
+    initial_mode_ = Mode::LOG_LINEAR;
+    mode_ = Mode::LOG_LINEAR;
+}
 
 template <typename Sample>
 void Histogram<Sample>::Add(Sample sample) {
@@ -139,11 +265,11 @@ void Histogram<Sample>::Add(Sample sample) {
         case Mode::HISTOGRAM: {
             int i = (sample - start_) / bucket_size_;
             if (i < 0)
-                buckets_[0]++;
+                AddToBucket(0);
             else if (i + 1 >= num_buckets_)
-                buckets_[num_buckets_ - 1]++;
+                AddToBucket(num_buckets_ - 1);
             else
-                buckets_[i + 1]++;
+                AddToBucket(i + 1);
         } break;
         case Mode::AUTO_RANGE: {
             samples_.push_back(sample);
@@ -155,10 +281,98 @@ void Histogram<Sample>::Add(Sample sample) {
             samples_[next_event_index_++] = sample;
             if (next_event_index_ >= samples_.size()) next_event_index_ = 0;
         } break;
+        case Mode::LOG_LINEAR: {
+            // Written so that NaN goes in the first bucket.
+            if (!(sample >= start_))
+                AddToBucket(0);
+            else if (sample >= end_)
+                AddToBucket(num_buckets_ - 1);
+            else
+                AddToBucket(LogLinearKey(sample) - start_key_ + 1);
+        } break;
     }
     ++count_;
 }
 
+template <typename Sample>
+void Histogram<Sample>::AddBatch(const Sample* samples, size_t n) {
+    if (!Bucketed()) {
+        for (size_t i = 0; i < n; ++i) Add(samples[i]);
+        return;
+    }
+    uint32_t indices[kBatchChunkSize];
+    const uint32_t last = num_buckets_ - 1;
+    while (n > 0) {
+        size_t m = n < kBatchChunkSize ? n : kBatchChunkSize;
+        if (mode_ == Mode::HISTOGRAM) {
+            for (size_t j = 0; j < m; ++j) {
+                // Clamp before converting so that the conversion is defined.
+                // This truncates towards zero, like Add.
+                double d = (samples[j] - start_) / bucket_size_;
+                d = d >= -1 ? d : -1;
+                d = d <= last ? d : last;
+                uint32_t i = static_cast<int32_t>(d) + 1;
+                indices[j] = i < last ? i : last;
+            }
+        } else {
+            for (size_t j = 0; j < m; ++j) {
+                double x = samples[j];
+                uint32_t i = LogLinearKey(x) - start_key_ + 1;
+                // Written so that NaN goes in the first bucket.
+                i = x >= start_ ? i : 0;
+                indices[j] = x >= end_ ? last : i;
+            }
+        }
+        if (Dense()) {
+            for (size_t j = 0; j < m; ++j) buckets_[indices[j]]++;
+        } else {
+            // This may switch to dense storage part way through.
+            for (size_t j = 0; j < m; ++j) AddToBucket(indices[j]);
+        }
+        count_ += m;
+        samples += m;
+        n -= m;
+    }
+}
+
+template <typename Sample>
+void Histogram<Sample>::AddToSparseBucket(uint32_t i, uint32_t n) {
+    auto it = std::lower_bound(
+        sparse_.begin(), sparse_.end(), i,
+        [](const std::pair<uint32_t, uint32_t>& e, uint32_t index) {
+            return e.first < index;
+        });
+    if (it != sparse_.end() && it->first == i) {
+        it->second += n;
+        return;
+    }
+    if ((sparse_.size() + 1) * kSparseFillDivisor > num_buckets_) {
+        // Too many non-zero buckets: switch to dense storage.
+        buckets_.assign(num_buckets_, 0);
+        for (auto& e : sparse_) buckets_[e.first] = e.second;
+        buckets_[i] += n;
+        sparse_.clear();
+        sparse_.shrink_to_fit();
+        return;
+    }
+    sparse_.insert(it, {i, n});
+}
+
+template <typename Sample>
+std::vector<uint32_t> Histogram<Sample>::buckets() const {
+    if (Dense()) return buckets_;
+    std::vector<uint32_t> counts(num_buckets_);
+    for (auto& e : sparse_) counts[e.first] = e.second;
+    return counts;
+}
+
+template <typename Sample>
+Sample Histogram<Sample>::BucketLowerBound(uint32_t i) const {
+    if (mode_ == Mode::LOG_LINEAR)
+        return LogLinearKeyStart(start_key_ + i - 1, sub_bucket_bits_);
+    return start_ + (i - 1) * bucket_size_;
+}
+
 template <typename Sample>
 void Histogram<Sample>::CalcBucketsFromSamples() {
     if (mode_ != Mode::AUTO_RANGE) return;
@@ -201,7 +415,7 @@ std::string Histogram<Sample>::ToDebugJSON() const {
     std::stringstream str;
     str.precision(2);
     str << std::fixed;
-    if (mode_ != Mode::HISTOGRAM) {
+    if (!Bucketed()) {
         bool first = true;
         str << "{\"events\":[";
         for (int i = 0; i < samples_.size(); ++i) {
@@ -216,14 +430,16 @@ std::string Histogram<Sample>::ToDebugJSON() const {
         str << "{\"pmax\":[";
         Sample x = start_;
         for (int i = 0; i < num_buckets_ - 1; ++i) {
+            if (mode_ == Mode::LOG_LINEAR) x = BucketLowerBound(i + 1);
             str << x << ",";
             x += bucket_size_;
         }
         str << "99999],\"cnts\":[";
+        auto counts = buckets();
         for (int i = 0; i < num_buckets_ - 1; ++i) {
-            str << buckets_[i] << ",";
+            str << counts[i] << ",";
         }
-        if (num_buckets_ > 0) str << buckets_.back();
+        if (num_buckets_ > 0) str << counts.back();
         str << "]}";
     }
     return str.str();
@@ -231,7 +447,8 @@ std::string Histogram<Sample>::ToDebugJSON() const {
 
 template <typename Sample>
 void Histogram<Sample>::Clear() {
-    std::fill(buckets_.begin(), buckets_.end(), 0);
+    // Histograms that needed dense storage are likely to again.
+    ClearCounts();
     // Reset the mode so we switch back to auto-ranging if that was initially
     // specified.
     mode_ = initial_mode_;
@@ -246,16 +463,50 @@ void Histogram<Sample>::Clear() {
 
 template <typename Sample>
 bool Histogram<Sample>::operator==(const Histogram& h) const {
-    return buckets_ == h.buckets_ && samples_ == h.samples_;
+    if (Dense() == h.Dense())
+        return buckets_ == h.buckets_ && sparse_ == h.sparse_ &&
+               samples_ == h.samples_;
+    return buckets() == h.buckets() && samples_ == h.samples_;
 }
 
 template <typename Sample>
 TuningFork_ErrorCode Histogram<Sample>::AddCounts(
     const std::vector<uint32_t>& counts) {
-    if (counts.size() != buckets_.size()) return TUNINGFORK_ERROR_BAD_PARAMETER;
-    auto c = counts.begin();
-    for (auto& c_orig : buckets_) {
-        c_orig += *c++;
+    if (counts.size() != NumBuckets()) return TUNINGFORK_ERROR_BAD_PARAMETER;
+    if (Dense()) {
+        auto c = counts.begin();
+        for (auto& c_orig : buckets_) {
+            c_orig += *c++;
+        }
+    } else {
+        for (uint32_t i = 0; i < counts.size(); ++i) {
+            if (counts[i] != 0) AddToBucket(i, counts[i]);
+        }
+    }
+    return TUNINGFORK_ERROR_OK;
+}
+
+template <typename Sample>
+TuningFork_ErrorCode Histogram<Sample>::Merge(const Histogram& h) {
+    if (h.Bucketed()) {
+        // Bucket ranges must match so we can't merge into an auto-ranging
+        // histogram that hasn't bucketed yet.
+        if (mode_ != h.mode_) return TUNINGFORK_ERROR_BAD_PARAMETER;
+        if (h.Dense()) {
+            auto err = AddCounts(h.buckets_);
+            if (err == TUNINGFORK_ERROR_OK) count_ += h.count_;
+            return err;
+        }
+        if (h.num_buckets_ != NumBuckets())
+            return TUNINGFORK_ERROR_BAD_PARAMETER;
+        for (auto& e : h.sparse_) AddToBucket(e.first, e.second);
+        count_ += h.count_;
+        return TUNINGFORK_ERROR_OK;
+    }
+    // The other histogram is still storing events, so add them individually.
+    size_t n = std::min(h.count_, h.samples_.size());
+    for (size_t i = 0; i < n; ++i) {
+        Add(h.samples_[i]);
     }
     return TUNINGFORK_ERROR_OK;
 }
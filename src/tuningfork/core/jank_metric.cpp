@@ -0,0 +1,108 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "jank_metric.h"
+
+#include <algorithm>
+
+namespace tuningfork {
+
+constexpr int JankMetricData::kMaxRunLength;
+constexpr uint32_t JankMetricData::kBigJankMissedFrames;
+constexpr int JankMetricData::kStutterJanks;
+constexpr uint64_t JankMetricData::kStutterWindowFrames;
+constexpr uint64_t JankMetricData::kDefaultSwapIntervalNs;
+
+std::atomic<uint64_t> JankMetricData::swap_interval_ns_{
+    kDefaultSwapIntervalNs};
+
+void JankMetricData::SetSwapIntervalNs(uint64_t swap_interval_ns) {
+    swap_interval_ns_.store(swap_interval_ns, std::memory_order_relaxed);
+}
+
+uint64_t JankMetricData::SwapIntervalNs() {
+    return swap_interval_ns_.load(std::memory_order_relaxed);
+}
+
+void JankMetricData::Record(uint64_t dt_ns) {
+    ++frames_;
+    uint64_t interval = SwapIntervalNs();
+    // Round to the nearest number of vsyncs, so that jitter in the frame
+    // times isn't counted.
+    uint64_t vsyncs = (dt_ns + interval / 2) / interval;
+    if (vsyncs <= 1) {
+        if (current_run_ > 0) {
+            EndRun(current_run_);
+            current_run_ = 0;
+        }
+        return;
+    }
+    uint64_t missed = vsyncs - 1;
+    ++janky_frames_;
+    missed_frames_ += missed;
+    if (missed >= kBigJankMissedFrames) ++big_janks_;
+    ++current_run_;
+    if (n_recent_janks_ == kStutterJanks - 1) {
+        if (frames_ - recent_janks_[0] < kStutterWindowFrames) {
+            ++stutter_clusters_;
+            n_recent_janks_ = 0;
+            return;
+        }
+        std::copy(recent_janks_ + 1, recent_janks_ + n_recent_janks_,
+                  recent_janks_);
+        --n_recent_janks_;
+    }
+    recent_janks_[n_recent_janks_++] = frames_;
+}
+
+void JankMetricData::EndRun(uint64_t length) {
+    ++runs_[std::min<uint64_t>(length, kMaxRunLength) - 1];
+    longest_run_ = std::max(longest_run_, length);
+}
+
+JankMetricData JankMetricData::Finished() const {
+    JankMetricData ret(*this);
+    if (ret.current_run_ > 0) {
+        ret.EndRun(ret.current_run_);
+        ret.current_run_ = 0;
+    }
+    return ret;
+}
+
+void JankMetricData::Merge(const JankMetricData& other) {
+    auto o = other.Finished();
+    frames_ += o.frames_;
+    janky_frames_ += o.janky_frames_;
+    missed_frames_ += o.missed_frames_;
+    big_janks_ += o.big_janks_;
+    stutter_clusters_ += o.stutter_clusters_;
+    longest_run_ = std::max(longest_run_, o.longest_run_);
+    for (int i = 0; i < kMaxRunLength; ++i) runs_[i] += o.runs_[i];
+}
+
+void JankMetricData::Clear() {
+    frames_ = 0;
+    janky_frames_ = 0;
+    missed_frames_ = 0;
+    big_janks_ = 0;
+    stutter_clusters_ = 0;
+    longest_run_ = 0;
+    std::fill(runs_, runs_ + kMaxRunLength, 0);
+    current_run_ = 0;
+    n_recent_janks_ = 0;
+}
+
+}  // namespace tuningfork
@@ -0,0 +1,87 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+
+#include "metricdata.h"
+
+namespace tuningfork {
+
+// Counts of janky frames, found by comparing each frame time with the swap
+// interval as frames are ticked. A frame is janky if it took one or more
+// swap intervals longer than it should have, i.e. if vsyncs were missed.
+//
+// Unlike a histogram, this keeps some of the ordering of frames: runs of
+// consecutive janky frames are counted by length and bursts of janky frames
+// close together are counted as stutter clusters.
+//
+// The data is kept inside the FrameTimeMetricData it is computed from, so it
+// shares its annotation and instrument key.
+struct JankMetricData : public MetricData {
+    // Runs of this many or more janky frames are counted together.
+    static constexpr int kMaxRunLength = 5;
+    // A frame missing at least this many vsyncs is a big jank.
+    static constexpr uint32_t kBigJankMissedFrames = 3;
+    // A stutter cluster is kStutterJanks janky frames within
+    // kStutterWindowFrames frames.
+    static constexpr int kStutterJanks = 3;
+    static constexpr uint64_t kStutterWindowFrames = 30;
+    static constexpr uint64_t kDefaultSwapIntervalNs = 16666667;
+
+    JankMetricData() : MetricData(MetricType()) {}
+
+    uint64_t frames_ = 0;
+    uint64_t janky_frames_ = 0;
+    // Total vsyncs missed over all janky frames.
+    uint64_t missed_frames_ = 0;
+    uint64_t big_janks_ = 0;
+    uint64_t stutter_clusters_ = 0;
+    uint64_t longest_run_ = 0;
+    // runs_[i] is the number of runs of i + 1 janky frames. The last entry
+    // also counts longer runs.
+    uint64_t runs_[kMaxRunLength] = {};
+
+    // Record a frame time.
+    void Record(uint64_t dt_ns);
+    // Add the counts from another. A run in progress in other is counted as
+    // finished.
+    void Merge(const JankMetricData& other);
+    // A copy with any run in progress counted as finished, for serialization.
+    JankMetricData Finished() const;
+    virtual void Clear() override;
+    virtual size_t Count() const override { return janky_frames_; }
+    static Metric::Type MetricType() { return Metric::Type::JANK; }
+
+    // The swap interval frames are compared to, shared by all instruments.
+    static void SetSwapIntervalNs(uint64_t swap_interval_ns);
+    static uint64_t SwapIntervalNs();
+
+   private:
+    void EndRun(uint64_t length);
+
+    // Length of the run of janky frames ending at the last frame.
+    uint64_t current_run_ = 0;
+    // Frame numbers of the most recent janky frames, oldest first, since the
+    // last stutter cluster.
+    uint64_t recent_janks_[kStutterJanks - 1] = {};
+    int n_recent_janks_ = 0;
+
+    static std::atomic<uint64_t> swap_interval_ns_;
+};
+
+}  // namespace tuningfork
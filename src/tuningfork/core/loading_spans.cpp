@@ -0,0 +1,181 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "loading_spans.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace tuningfork {
+
+namespace {
+
+// A span, or the group itself at index 0, clipped to its parent.
+struct Node {
+    int64_t start;
+    int64_t end;
+    uint32_t source;
+    std::vector<uint32_t> children;
+};
+
+// Time in the node that isn't in any of its children.
+int64_t ExclusiveTime(const std::vector<Node>& nodes, const Node& node) {
+    std::vector<std::pair<int64_t, int64_t>> intervals;
+    for (auto c : node.children)
+        intervals.push_back({nodes[c].start, nodes[c].end});
+    std::sort(intervals.begin(), intervals.end());
+    int64_t covered = 0;
+    int64_t covered_to = node.start;
+    for (auto& i : intervals) {
+        if (i.second <= covered_to) continue;
+        covered += i.second - std::max(i.first, covered_to);
+        covered_to = i.second;
+    }
+    return (node.end - node.start) - covered;
+}
+
+// Working back from the end of the node, the child that finished last is what
+// the node was waiting for, and before that child started, the one that
+// finished last before then, and so on. The gaps between them are the node's
+// own time on the critical path.
+void AddCriticalPath(const std::vector<Node>& nodes, uint32_t index,
+                     LoadingBreakdown& breakdown) {
+    const Node& node = nodes[index];
+    std::vector<uint32_t> children = node.children;
+    // Latest end first, and the longest of those that end together.
+    std::sort(children.begin(), children.end(), [&](uint32_t a, uint32_t b) {
+        const Node& x = nodes[a];
+        const Node& y = nodes[b];
+        return x.end > y.end || (x.end == y.end && x.start < y.start);
+    });
+    auto& critical_path = breakdown.stages[node.source].critical_path;
+    int64_t t = node.end;
+    for (auto c : children) {
+        const Node& child = nodes[c];
+        if (child.end > t || child.end == child.start) continue;
+        critical_path += std::chrono::nanoseconds(t - child.end);
+        AddCriticalPath(nodes, c, breakdown);
+        t = child.start;
+    }
+    critical_path += std::chrono::nanoseconds(t - node.start);
+}
+
+}  // anonymous namespace
+
+LoadingSpans::LoadingSpans() {
+    for (auto& span : spans_) {
+        span.generation.store(0, std::memory_order_relaxed);
+        span.end_ns.store(kRunning, std::memory_order_relaxed);
+    }
+}
+
+void LoadingSpans::BeginGroup(ProcessTime start) {
+    if (++last_generation_ == 0) ++last_generation_;
+    group_start_ = start;
+    next_.store(0, std::memory_order_relaxed);
+    generation_.store(last_generation_, std::memory_order_release);
+}
+
+LoadingSpans::Span* LoadingSpans::Find(LoadingSpanHandle handle,
+                                       uint32_t generation) {
+    if (generation == 0 || (handle >> 32) != generation) return nullptr;
+    uint32_t slot = static_cast<uint32_t>(handle) - 1;
+    if (slot >= kMaxSpans) return nullptr;
+    Span& span = spans_[slot];
+    if (span.generation.load(std::memory_order_acquire) != generation)
+        return nullptr;
+    return &span;
+}
+
+TuningFork_ErrorCode LoadingSpans::Start(uint32_t source,
+                                         LoadingSpanHandle parent,
+                                         ProcessTime now,
+                                         LoadingSpanHandle& handle) {
+    uint32_t generation = generation_.load(std::memory_order_acquire);
+    if (generation == 0) return TUNINGFORK_ERROR_NO_ACTIVE_LOADING_GROUP;
+    if (source >= LoadingBreakdown::kNumStages)
+        return TUNINGFORK_ERROR_BAD_PARAMETER;
+    if (parent != 0 && Find(parent, generation) == nullptr)
+        return TUNINGFORK_ERROR_INVALID_LOADING_HANDLE;
+    uint32_t slot = next_.fetch_add(1, std::memory_order_relaxed);
+    if (slot >= kMaxSpans)
+        return TUNINGFORK_ERROR_NO_MORE_SPACE_FOR_LOADING_TIME_DATA;
+    Span& span = spans_[slot];
+    span.parent = static_cast<uint32_t>(parent);
+    span.source = source;
+    span.start_ns = now.count();
+    span.end_ns.store(kRunning, std::memory_order_relaxed);
+    span.generation.store(generation, std::memory_order_release);
+    handle = (static_cast<uint64_t>(generation) << 32) | (slot + 1);
+    return TUNINGFORK_ERROR_OK;
+}
+
+TuningFork_ErrorCode LoadingSpans::Stop(LoadingSpanHandle handle,
+                                        ProcessTime now) {
+    Span* span = Find(handle, generation_.load(std::memory_order_acquire));
+    if (span == nullptr) return TUNINGFORK_ERROR_INVALID_LOADING_HANDLE;
+    int64_t running = kRunning;
+    if (!span->end_ns.compare_exchange_strong(running, now.count(),
+                                              std::memory_order_release))
+        return TUNINGFORK_ERROR_INVALID_LOADING_HANDLE;
+    return TUNINGFORK_ERROR_OK;
+}
+
+LoadingBreakdown LoadingSpans::EndGroup(ProcessTime end) {
+    LoadingBreakdown breakdown;
+    uint32_t generation = generation_.exchange(0, std::memory_order_acq_rel);
+    if (generation == 0) return breakdown;
+    uint32_t n = std::min<uint32_t>(next_.load(std::memory_order_relaxed),
+                                    kMaxSpans);
+    // A parent always has a lower index than its children, having been
+    // started first.
+    std::vector<Node> nodes(n + 1);
+    std::vector<bool> present(n + 1);
+    nodes[0] = {group_start_.count(), std::max(end, group_start_).count(),
+                TuningFork_LoadingTimeMetadata::TOTAL_USER_WAIT_FOR_GROUP,
+                {}};
+    present[0] = true;
+    for (uint32_t i = 0; i < n; ++i) {
+        Span& span = spans_[i];
+        if (span.generation.load(std::memory_order_acquire) != generation)
+            continue;
+        uint32_t p = span.parent;
+        if (p > i || !present[p]) continue;
+        Node& parent = nodes[p];
+        int64_t span_end = span.end_ns.load(std::memory_order_acquire);
+        if (span_end == kRunning) span_end = parent.end;
+        int64_t start =
+            std::min(std::max(span.start_ns, parent.start), parent.end);
+        span_end = std::max(std::min(span_end, parent.end), start);
+        nodes[i + 1] = {start, span_end, span.source, {}};
+        present[i + 1] = true;
+        parent.children.push_back(i + 1);
+    }
+    // Groups without spans have nothing to break down.
+    if (nodes[0].children.empty()) return breakdown;
+    for (uint32_t i = 0; i <= n; ++i) {
+        if (!present[i]) continue;
+        auto exclusive =
+            std::chrono::nanoseconds(ExclusiveTime(nodes, nodes[i]));
+        breakdown.stages[nodes[i].source].exclusive += exclusive;
+        if (i != 0) breakdown.work += exclusive;
+    }
+    AddCriticalPath(nodes, 0, breakdown);
+    breakdown.wall = std::chrono::nanoseconds(nodes[0].end - nodes[0].start);
+    return breakdown;
+}
+
+}  // namespace tuningfork
@@ -0,0 +1,76 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+
+#include "loadingtime_metric.h"
+#include "process_time.h"
+
+namespace tuningfork {
+
+// Spans of work within the current loading group, each nested in the group
+// or in another span, and each for a stage of loading. When the group ends,
+// they give a breakdown of its time by stage and its critical path.
+//
+// Spans are started and stopped from worker threads without locking: each
+// takes the next slot of a fixed array, which is published by storing the
+// group's generation in it. Handles also hold the generation, so handles
+// from earlier groups are rejected.
+//
+// BeginGroup and EndGroup must not be called concurrently with each other.
+class LoadingSpans {
+   public:
+    static constexpr size_t kMaxSpans = 256;
+
+    LoadingSpans();
+
+    void BeginGroup(ProcessTime start);
+
+    // parent is 0 for a span directly in the group.
+    TuningFork_ErrorCode Start(uint32_t source, LoadingSpanHandle parent,
+                               ProcessTime now, LoadingSpanHandle& handle);
+    TuningFork_ErrorCode Stop(LoadingSpanHandle handle, ProcessTime now);
+
+    // Spans still running are cut off at the group's end, as are spans that
+    // run past their parent's end. A span started just as one group ends and
+    // the next begins may be lost.
+    LoadingBreakdown EndGroup(ProcessTime end);
+
+   private:
+    static constexpr int64_t kRunning = -1;
+
+    struct Span {
+        // The generation of the group the span is in, stored last.
+        std::atomic<uint32_t> generation;
+        uint32_t parent;  // Slot + 1, or 0 for the group.
+        uint32_t source;
+        int64_t start_ns;
+        std::atomic<int64_t> end_ns;
+    };
+
+    Span* Find(LoadingSpanHandle handle, uint32_t generation);
+
+    Span spans_[kMaxSpans];
+    std::atomic<uint32_t> next_{0};
+    // 0 between groups.
+    std::atomic<uint32_t> generation_{0};
+    uint32_t last_generation_ = 0;
+    ProcessTime group_start_ = ProcessTime::zero();
+};
+
+}  // namespace tuningfork
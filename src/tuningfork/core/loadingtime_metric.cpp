@@ -31,4 +31,19 @@ void LoadingTimeMetricData::Record(ProcessTimeInterval dt) {
     duration_ += dt.Duration();
 }
 
+double LoadingBreakdown::Parallelism() const {
+    if (wall <= Duration::zero()) return 0;
+    return std::chrono::duration<double>(work).count() /
+           std::chrono::duration<double>(wall).count();
+}
+
+void LoadingBreakdown::Merge(const LoadingBreakdown& other) {
+    for (int i = 0; i < kNumStages; ++i) {
+        stages[i].exclusive += other.stages[i].exclusive;
+        stages[i].critical_path += other.stages[i].critical_path;
+    }
+    work += other.work;
+    wall += other.wall;
+}
+
 }  // namespace tuningfork
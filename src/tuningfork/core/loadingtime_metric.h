@@ -29,6 +29,32 @@ struct LoadingTimeMetric {
     SerializedAnnotation annotation_;
 };
 
+// Where the time of loading groups went, from the spans of work recorded in
+// them. Stages are loading sources; time in a group but in none of its spans
+// is counted against TOTAL_USER_WAIT_FOR_GROUP.
+struct LoadingBreakdown {
+    static constexpr int kNumStages =
+        TuningFork_LoadingTimeMetadata::TOTAL_USER_WAIT_FOR_GROUP + 1;
+    struct Stage {
+        // Time in spans of this stage but not in any of their child spans.
+        Duration exclusive = Duration::zero();
+        // Time this stage was on the critical path, the chain of spans that
+        // determined when the group finished.
+        Duration critical_path = Duration::zero();
+    };
+    Stage stages[kNumStages];
+    // The total exclusive time of all the spans, and the total duration of
+    // the groups.
+    Duration work = Duration::zero();
+    Duration wall = Duration::zero();
+
+    // The mean number of spans doing work at once.
+    double Parallelism() const;
+    bool Empty() const { return wall == Duration::zero(); }
+    void Merge(const LoadingBreakdown& other);
+    void Clear() { *this = LoadingBreakdown(); }
+};
+
 struct LoadingTimeMetricData : public MetricData {
     static constexpr int kDefaultTimeSeriesCapacity = 200;
     LoadingTimeMetricData(MetricId metric_id)
@@ -39,11 +65,14 @@ struct LoadingTimeMetricData : public MetricData {
     MetricId metric_id_;
     TimeSeries<ProcessTimeInterval> data_;
     Duration duration_;
+    // Only for loading groups.
+    LoadingBreakdown breakdown_;
     void Record(Duration dt);
     void Record(ProcessTimeInterval interval);
     virtual void Clear() override {
         data_.Clear();
         duration_ = Duration::zero();
+        breakdown_.Clear();
     }
     virtual size_t Count() const override { return data_.Count(); }
     static Metric::Type MetricType() { return Metric::Type::LOADING_TIME; }
@@ -0,0 +1,378 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mapped_file_cache.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdlib>
+#include <cstring>
+
+#include "proto/protobuf_util.h"
+#include "tuningfork_utils.h"
+
+#define LOG_TAG "TuningFork"
+#include "Log.h"
+
+namespace tf = tuningfork;
+
+namespace {
+
+extern "C" TuningFork_ErrorCode MappedFileCacheGet(
+    uint64_t key, TuningFork_CProtobufSerialization* value, void* _self) {
+    if (_self == nullptr) return TUNINGFORK_ERROR_BAD_PARAMETER;
+    tf::MappedFileCache* self = static_cast<tf::MappedFileCache*>(_self);
+    return self->Get(key, value);
+}
+extern "C" TuningFork_ErrorCode MappedFileCacheSet(
+    uint64_t key, const TuningFork_CProtobufSerialization* value, void* _self) {
+    if (_self == nullptr) return TUNINGFORK_ERROR_BAD_PARAMETER;
+    tf::MappedFileCache* self = static_cast<tf::MappedFileCache*>(_self);
+    return self->Set(key, value);
+}
+extern "C" TuningFork_ErrorCode MappedFileCacheRemove(uint64_t key,
+                                                      void* _self) {
+    if (_self == nullptr) return TUNINGFORK_ERROR_BAD_PARAMETER;
+    tf::MappedFileCache* self = static_cast<tf::MappedFileCache*>(_self);
+    return self->Remove(key);
+}
+
+// File layout:
+//  header: magic, version, committed length of the log (uint64).
+//  records, each 8-byte aligned: crc32 of the rest of the record, flags, key,
+//   value size (uint64), value.
+constexpr uint32_t kMagic = 0x434d4654;  // "TFMC"
+constexpr uint32_t kVersion = 1;
+constexpr size_t kHeaderSize = 16;
+constexpr size_t kCommittedOffset = 8;
+constexpr size_t kRecordHeaderSize = 24;
+constexpr uint32_t kTombstone = 1;
+constexpr size_t kPageSize = 4096;
+constexpr size_t kInitialCapacity = 16 * kPageSize;
+constexpr char kLogName[] = "/local_cache.log";
+
+size_t RecordSize(size_t value_size) {
+    return (kRecordHeaderSize + value_size + 7) & ~size_t(7);
+}
+
+size_t RoundToPages(size_t n) { return (n + kPageSize - 1) & ~(kPageSize - 1); }
+
+uint32_t RecordCrc(const uint8_t* record, size_t value_size) {
+    return crc32(0, record + 4, kRecordHeaderSize - 4 + value_size);
+}
+
+template <typename T>
+T Load(const uint8_t* p) {
+    T x;
+    memcpy(&x, p, sizeof(x));
+    return x;
+}
+
+template <typename T>
+void Store(uint8_t* p, T x) {
+    memcpy(p, &x, sizeof(x));
+}
+
+// Write bytes [begin, end) of the mapping to the file. msync needs a start
+// aligned to the system's page size, which may be larger than kPageSize.
+void SyncRange(uint8_t* map, size_t begin, size_t end) {
+    static const size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t page_begin = begin - begin % page_size;
+    msync(map + page_begin, end - page_begin, MS_SYNC);
+}
+
+uint8_t* MapFile(int fd, size_t capacity) {
+    void* p =
+        mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    return p == MAP_FAILED ? nullptr : static_cast<uint8_t*>(p);
+}
+
+}  // anonymous namespace
+
+namespace tuningfork {
+
+using namespace file_utils;
+
+constexpr size_t MappedFileCache::kMinCompactionBytes;
+
+MappedFileCache::MappedFileCache(const std::string& path) : path_(path) {
+    c_cache_ =
+        TuningFork_Cache{(void*)this, &MappedFileCacheSet, &MappedFileCacheGet,
+                         &MappedFileCacheRemove};
+}
+
+MappedFileCache::~MappedFileCache() { Close(); }
+
+void MappedFileCache::SetDir(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Close();
+    path_ = path;
+}
+
+void MappedFileCache::Close() {
+    if (map_ != nullptr) munmap(map_, capacity_);
+    if (fd_ >= 0) close(fd_);
+    map_ = nullptr;
+    fd_ = -1;
+    capacity_ = 0;
+    end_ = 0;
+    live_bytes_ = 0;
+    dead_bytes_ = 0;
+    index_.clear();
+}
+
+bool MappedFileCache::Map(size_t capacity) {
+    if (ftruncate(fd_, capacity) != 0) return false;
+    if (map_ != nullptr) munmap(map_, capacity_);
+    map_ = MapFile(fd_, capacity);
+    capacity_ = map_ != nullptr ? capacity : 0;
+    return map_ != nullptr;
+}
+
+void MappedFileCache::CommitEnd(size_t end) {
+    Store<uint64_t>(map_ + kCommittedOffset, end);
+}
+
+bool MappedFileCache::Open() {
+    if (map_ != nullptr) return true;
+    if (!CheckAndCreateDir(path_)) return false;
+    auto file_name = path_ + kLogName;
+    fd_ = open(file_name.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd_ < 0) {
+        ALOGW("Can't open %s", file_name.c_str());
+        return false;
+    }
+    struct stat st;
+    size_t file_size = fstat(fd_, &st) == 0 ? st.st_size : 0;
+    if (!Map(std::max(RoundToPages(file_size), kInitialCapacity))) {
+        Close();
+        return false;
+    }
+    size_t committed = Load<uint64_t>(map_ + kCommittedOffset);
+    if (file_size < kHeaderSize || Load<uint32_t>(map_) != kMagic ||
+        Load<uint32_t>(map_ + 4) != kVersion || committed < kHeaderSize ||
+        committed > file_size) {
+        if (file_size > 0) ALOGW("Ignoring invalid cache %s", file_name.c_str());
+        Store<uint32_t>(map_, kMagic);
+        Store<uint32_t>(map_ + 4, kVersion);
+        end_ = kHeaderSize;
+        CommitEnd(end_);
+        return true;
+    }
+    // Replay the log, stopping at the first record that doesn't check out.
+    size_t pos = kHeaderSize;
+    while (pos + kRecordHeaderSize <= committed) {
+        const uint8_t* record = map_ + pos;
+        uint32_t flags = Load<uint32_t>(record + 4);
+        uint64_t key = Load<uint64_t>(record + 8);
+        uint64_t size = Load<uint64_t>(record + 16);
+        if (size > committed - pos - kRecordHeaderSize ||
+            Load<uint32_t>(record) != RecordCrc(record, size))
+            break;
+        size_t record_size = RecordSize(size);
+        auto it = index_.find(key);
+        if (it != index_.end()) {
+            size_t old_size = RecordSize(it->second.size);
+            live_bytes_ -= old_size;
+            dead_bytes_ += old_size;
+        }
+        if (flags & kTombstone) {
+            if (it != index_.end()) index_.erase(it);
+            dead_bytes_ += record_size;
+        } else {
+            index_[key] = Record{pos + kRecordHeaderSize, size};
+            live_bytes_ += record_size;
+        }
+        pos += record_size;
+    }
+    end_ = pos;
+    if (end_ != committed) {
+        ALOGW("Truncating cache %s from %zu to %zu bytes", file_name.c_str(),
+              committed, end_);
+        CommitEnd(end_);
+    }
+    return true;
+}
+
+bool MappedFileCache::Append(uint64_t key, uint32_t flags, const uint8_t* data,
+                             size_t size, size_t* value_offset) {
+    size_t record_size = RecordSize(size);
+    if (end_ + record_size > capacity_) {
+        size_t capacity =
+            std::max(2 * capacity_, RoundToPages(end_ + record_size));
+        if (!Map(capacity)) {
+            ALOGE("Can't grow cache to %zu bytes", capacity);
+            Close();
+            return false;
+        }
+    }
+    uint8_t* record = map_ + end_;
+    Store<uint32_t>(record + 4, flags);
+    Store<uint64_t>(record + 8, key);
+    Store<uint64_t>(record + 16, size);
+    if (size > 0) memcpy(record + kRecordHeaderSize, data, size);
+    Store<uint32_t>(record, RecordCrc(record, size));
+    if (value_offset) *value_offset = end_ + kRecordHeaderSize;
+    // The record only becomes visible once it is complete, and on disk, so
+    // that the header is never written back with an end past a record that
+    // wasn't.
+    SyncRange(map_, end_, end_ + record_size);
+    end_ += record_size;
+    CommitEnd(end_);
+    return true;
+}
+
+TuningFork_ErrorCode MappedFileCache::Get(
+    uint64_t key, TuningFork_CProtobufSerialization* value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!Open()) return TUNINGFORK_ERROR_NO_SUCH_KEY;
+    auto it = index_.find(key);
+    if (it == index_.end()) return TUNINGFORK_ERROR_NO_SUCH_KEY;
+    value->bytes = (uint8_t*)::malloc(it->second.size);
+    memcpy(value->bytes, map_ + it->second.offset, it->second.size);
+    value->size = it->second.size;
+    value->dealloc = TuningFork_CProtobufSerialization_Dealloc;
+    return TUNINGFORK_ERROR_OK;
+}
+
+TuningFork_ErrorCode MappedFileCache::GetView(uint64_t key,
+                                              const uint8_t** data,
+                                              size_t* size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!Open()) return TUNINGFORK_ERROR_NO_SUCH_KEY;
+    auto it = index_.find(key);
+    if (it == index_.end()) return TUNINGFORK_ERROR_NO_SUCH_KEY;
+    *data = map_ + it->second.offset;
+    *size = it->second.size;
+    return TUNINGFORK_ERROR_OK;
+}
+
+TuningFork_ErrorCode MappedFileCache::Set(
+    uint64_t key, const TuningFork_CProtobufSerialization* value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ALOGV("MappedFileCache::Set %" PRIu64, key);
+    if (!Open()) return TUNINGFORK_ERROR_BAD_FILE_OPERATION;
+    size_t offset;
+    if (!Append(key, 0, value->bytes, value->size, &offset))
+        return TUNINGFORK_ERROR_BAD_FILE_OPERATION;
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        size_t old_size = RecordSize(it->second.size);
+        live_bytes_ -= old_size;
+        dead_bytes_ += old_size;
+    }
+    index_[key] = Record{offset, value->size};
+    live_bytes_ += RecordSize(value->size);
+    MaybeCompact();
+    return TUNINGFORK_ERROR_OK;
+}
+
+TuningFork_ErrorCode MappedFileCache::Remove(uint64_t key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ALOGV("MappedFileCache::Remove %" PRIu64, key);
+    if (!Open()) return TUNINGFORK_ERROR_NO_SUCH_KEY;
+    auto it = index_.find(key);
+    if (it == index_.end()) return TUNINGFORK_ERROR_NO_SUCH_KEY;
+    if (!Append(key, kTombstone, nullptr, 0, nullptr))
+        return TUNINGFORK_ERROR_BAD_FILE_OPERATION;
+    size_t old_size = RecordSize(it->second.size);
+    live_bytes_ -= old_size;
+    dead_bytes_ += old_size + RecordSize(0);
+    index_.erase(it);
+    MaybeCompact();
+    return TUNINGFORK_ERROR_OK;
+}
+
+void MappedFileCache::MaybeCompact() {
+    if (dead_bytes_ >= kMinCompactionBytes && dead_bytes_ > live_bytes_) {
+        if (!Compact()) ALOGW("Cache compaction failed");
+    }
+}
+
+bool MappedFileCache::Compact() {
+    auto file_name = path_ + kLogName;
+    auto tmp_name = file_name + ".tmp";
+    int fd = open(tmp_name.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC,
+                  0600);
+    if (fd < 0) return false;
+    size_t capacity =
+        std::max(RoundToPages(kHeaderSize + live_bytes_), kInitialCapacity);
+    uint8_t* map = nullptr;
+    if (ftruncate(fd, capacity) == 0) map = MapFile(fd, capacity);
+    if (map == nullptr) {
+        close(fd);
+        unlink(tmp_name.c_str());
+        return false;
+    }
+    Store<uint32_t>(map, kMagic);
+    Store<uint32_t>(map + 4, kVersion);
+    size_t end = kHeaderSize;
+    for (auto& entry : index_) {
+        // Records are copied whole: the checksum doesn't depend on where they
+        // are.
+        size_t record_size = RecordSize(entry.second.size);
+        memcpy(map + end, map_ + entry.second.offset - kRecordHeaderSize,
+               record_size);
+        entry.second.offset = end + kRecordHeaderSize;
+        end += record_size;
+    }
+    Store<uint64_t>(map + kCommittedOffset, end);
+    // The new log must be on disk before it replaces the old one.
+    msync(map, end, MS_SYNC);
+    if (rename(tmp_name.c_str(), file_name.c_str()) != 0) {
+        // The index now refers to the new file, so start again from the old
+        // one.
+        munmap(map, capacity);
+        close(fd);
+        unlink(tmp_name.c_str());
+        Close();
+        return false;
+    }
+    munmap(map_, capacity_);
+    close(fd_);
+    fd_ = fd;
+    map_ = map;
+    capacity_ = capacity;
+    end_ = end;
+    dead_bytes_ = 0;
+    ALOGV("Compacted cache to %zu bytes", end_);
+    return true;
+}
+
+TuningFork_ErrorCode MappedFileCache::Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ALOGV("MappedFileCache::Clear");
+    Close();
+    if (DeleteDir(path_))
+        return TUNINGFORK_ERROR_OK;
+    else
+        return TUNINGFORK_ERROR_BAD_FILE_OPERATION;
+}
+
+bool MappedFileCache::IsValid() const { return CheckAndCreateDir(path_); }
+
+size_t MappedFileCache::DeadBytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return dead_bytes_;
+}
+
+}  // namespace tuningfork
@@ -0,0 +1,98 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "tuningfork/tuningfork.h"
+
+// Implementation of a TuningFork_Cache that persists all keys to a single
+// memory-mapped log file.
+namespace tuningfork {
+
+// Values are appended to the log as checksummed records and an in-memory
+// index maps each key to its latest record. A record only becomes part of the
+// log once the committed length in the file header has been updated after
+// it, so a crash part way through a Set leaves the previous value. Removals
+// are appended as tombstones. When more than half the log, and at least
+// kMinCompactionBytes, is dead space, the live records are copied to a new
+// file which is renamed over the old one.
+class MappedFileCache {
+   public:
+    static constexpr size_t kMinCompactionBytes = 64 * 1024;
+
+    explicit MappedFileCache(const std::string& path = "");
+    ~MappedFileCache();
+
+    MappedFileCache(const MappedFileCache&) = delete;
+    MappedFileCache& operator=(const MappedFileCache&) = delete;
+
+    // Set the directory the log is kept in, closing any open log.
+    void SetDir(const std::string& path = "");
+
+    const TuningFork_Cache* GetCCache() const { return &c_cache_; }
+
+    TuningFork_ErrorCode Get(uint64_t key,
+                             TuningFork_CProtobufSerialization* value);
+    TuningFork_ErrorCode Set(uint64_t key,
+                             const TuningFork_CProtobufSerialization* value);
+    TuningFork_ErrorCode Remove(uint64_t key);
+
+    // Get a pointer to the value in the mapped file, without copying it. The
+    // pointer is only valid until the next call to Set, Remove, Clear or
+    // SetDir.
+    TuningFork_ErrorCode GetView(uint64_t key, const uint8_t** data,
+                                 size_t* size);
+
+    TuningFork_ErrorCode Clear();
+
+    // Returns false if path is non-writeable
+    bool IsValid() const;
+
+    // Bytes in the log taken by overwritten values and tombstones.
+    size_t DeadBytes() const;
+
+   private:
+    struct Record {
+        size_t offset;  // Of the value, from the start of the file
+        size_t size;
+    };
+
+    bool Open();
+    void Close();
+    bool Map(size_t capacity);
+    bool Append(uint64_t key, uint32_t flags, const uint8_t* data,
+                size_t size, size_t* value_offset);
+    void CommitEnd(size_t end);
+    void MaybeCompact();
+    bool Compact();
+
+    std::string path_;
+    TuningFork_Cache c_cache_;
+    mutable std::mutex mutex_;
+    int fd_ = -1;
+    uint8_t* map_ = nullptr;
+    size_t capacity_ = 0;
+    size_t end_ = 0;
+    size_t live_bytes_ = 0;
+    size_t dead_bytes_ = 0;
+    std::unordered_map<uint64_t, Record> index_;
+};
+
+}  // namespace tuningfork
@@ -20,17 +20,9 @@
 #include <unistd.h>
 
 #include <chrono>
-#include <fstream>
-#include <iterator>
-#include <sstream>
-#include <unordered_map>
 #include <utility>
-#include <vector>
 
 #define LOG_TAG "TuningFork"
-#include <iostream>
-#include <string>
-
 #include "Log.h"
 #include "jni.h"
 #include "session.h"
@@ -43,21 +35,18 @@ static const uint32_t NUM_BUCKETS = 200;
 
 constexpr size_t BYTES_IN_KB = 1024;
 
-using memInfoMap = std::unordered_map<std::string, size_t>;
-
 using namespace std::chrono;
 
 Duration MemoryTelemetry::UploadPeriod() { return kMemoryMetricInterval; }
 
 void MemoryReportingTask::DoWork(Session *session) {
     if (mem_info_provider_ != nullptr && mem_info_provider_->GetEnabled()) {
-        auto d = session->GetData<MemoryMetricData>(metric_id_);
+        auto d = session->GetData<MemoryMetricData>(
+            MetricId::Memory(annotation_id_->load()));
         d->Record(mem_info_provider_, time_provider_->TimeSinceProcessStart());
     }
 }
 
-void MemoryReportingTask::UpdateMetricId(MetricId id) { metric_id_ = id; }
-
 uint64_t DefaultMemInfoProvider::GetNativeHeapAllocatedSize() {
     if (gamesdk::jni::IsValid()) {
         // Call android.os.Debug.getNativeHeapAllocatedSize()
@@ -89,80 +78,36 @@ uint64_t DefaultMemInfoProvider::GetAvailMem() {
     return 0;
 }
 
-// Add entries to the given memInfoMap structure, or update the entries if the
-// new value is higher.
-static void getMemInfoFromFile(memInfoMap &data, const std::string &path) {
-    std::ifstream file_stream(path);
-    if (!file_stream) {
-        ALOGE("Could not open %s", path.c_str());
-        return;
-    }
-    for (std::string line; std::getline(file_stream, line);) {
-        std::istringstream ss(line);
-        std::vector<std::string> split(std::istream_iterator<std::string>{ss},
-                                       std::istream_iterator<std::string>());
-        if (split.size() == 3 && split[2] == "kB") {
-            std::string &key = split[0];
-            // Remove colon at end of first word
-            key.pop_back();
-            size_t value = atoi(split[1].c_str()) * BYTES_IN_KB;
-            if (data.find(key) == data.end() || data[key] < value) {
-                data[split[0]] = value;
-            }
-        }
-    }
-}
-
-static std::pair<uint64_t, bool> getMemInfoValueFromData(
-    const memInfoMap &data, const std::string &key) {
-    if (data.count(key)) {
-        return std::make_pair(data.at(key), true);
+static std::pair<uint64_t, bool> getMemInfoValue(
+    const gamesdk::ProcField &field) {
+    if (field.found && field.kb) {
+        return std::make_pair(field.value * BYTES_IN_KB, true);
     } else {
         return std::make_pair(0, false);
     }
 }
 
 void DefaultMemInfoProvider::UpdateMemInfo() {
-    std::stringstream ss_path;
-    memInfoMap data;
-
-    getMemInfoFromFile(data, "/proc/meminfo");
-    ss_path << "/proc/" << memInfo.pid << "/status";
-    getMemInfoFromFile(data, ss_path.str());
-
     // For the time being, only swap total is being used.
-    // Disabling the rest for efficiency
-    /*
-    memInfo.active = getMemInfoValueFromData(data, "Active");
-    memInfo.activeAnon = getMemInfoValueFromData(data, "Active(anon)");
-    memInfo.activeFile = getMemInfoValueFromData(data, "Active(file)");
-    memInfo.anonPages = getMemInfoValueFromData(data, "AnonPages");
-    memInfo.commitLimit = getMemInfoValueFromData(data, "CommitLimit");
-    memInfo.highTotal = getMemInfoValueFromData(data, "HighTotal");
-    memInfo.lowTotal = getMemInfoValueFromData(data, "LowTotal");
-    memInfo.memAvailable = getMemInfoValueFromData(data, "MemAvailable");
-    memInfo.memFree = getMemInfoValueFromData(data, "MemFree");
-    memInfo.memTotal = getMemInfoValueFromData(data, "MemTotal");
-    */
-    memInfo.swapTotal = getMemInfoValueFromData(data, "SwapTotal");
-    /*
-    memInfo.vmData = getMemInfoValueFromData(data, "VmData");
-    memInfo.vmRss = getMemInfoValueFromData(data, "VmRSS");
-    memInfo.vmSize = getMemInfoValueFromData(data, "VmSize");
-    */
+    // The other /proc/meminfo fields, and VmData, VmRSS and VmSize from
+    // /proc/self/status, are disabled for efficiency.
+    gamesdk::ProcField swap_total("SwapTotal");
+    if (!meminfo_file_.Read()) {
+        ALOGE("Could not read %s", meminfo_file_.Path());
+    } else {
+        meminfo_file_.GetFields(&swap_total, 1);
+    }
+    memInfo.swapTotal = getMemInfoValue(swap_total);
 }
 
 void DefaultMemInfoProvider::UpdateOomScore() {
-    std::stringstream ss_path;
-    ss_path << "/proc/" << memInfo.pid << "/oom_score";
-    std::ifstream oom_file(ss_path.str());
-    if (!oom_file) {
-        ALOGE_ONCE("Could not open %s", ss_path.str().c_str());
+    int64_t oom_score;
+    if (!oom_score_file_.Read()) {
+        ALOGE_ONCE("Could not open %s", oom_score_file_.Path());
+    } else if (oom_score_file_.GetNumbers(&oom_score, 1) != 1) {
+        ALOGE_ONCE("Bad conversion in %s", oom_score_file_.Path());
     } else {
-        oom_file >> memInfo.oom_score;
-        if (!oom_file) {
-            ALOGE_ONCE("Bad conversion in %s", ss_path.str().c_str());
-        }
+        memInfo.oom_score = static_cast<int>(oom_score);
     }
 }
 
@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <utility>
 
 #include "core/async_telemetry.h"
@@ -23,6 +24,7 @@
 #include "core/histogram.h"
 #include "core/memory_metric.h"
 #include "jni/jni_wrap.h"
+#include "proc_file.h"
 #include "session.h"
 
 namespace tuningfork {
@@ -59,6 +61,8 @@ class DefaultMemInfoProvider : public IMemInfoProvider {
     uint64_t device_memory_bytes = 0;
     gamesdk::jni::android::os::DebugClass android_debug_;
     gamesdk::jni::android::os::Process android_process_;
+    gamesdk::ProcFile meminfo_file_{"/proc/meminfo"};
+    gamesdk::ProcFile oom_score_file_{"/proc/self/oom_score"};
 
    protected:
     MemInfo memInfo;
@@ -106,18 +110,19 @@ class DefaultMemInfoProvider : public IMemInfoProvider {
 class MemoryReportingTask : public RepeatingTask {
    protected:
     IMemInfoProvider* mem_info_provider_;
-    MetricId metric_id_;
+    const std::atomic<AnnotationId>* annotation_id_;
     ITimeProvider* time_provider_;
 
    public:
+    // Data is recorded against the annotation that annotation_id holds at the
+    // time.
     MemoryReportingTask(ITimeProvider* time_provider, IMemInfoProvider* m,
-                        MetricId metric_id)
+                        const std::atomic<AnnotationId>* annotation_id)
         : RepeatingTask(MemoryTelemetry::UploadPeriod()),
           mem_info_provider_(m),
-          metric_id_(metric_id),
+          annotation_id_(annotation_id),
           time_provider_(time_provider) {}
     virtual void DoWork(Session* session) override;
-    void UpdateMetricId(MetricId id);
 };
 
 }  // namespace tuningfork
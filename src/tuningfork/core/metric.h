@@ -30,6 +30,7 @@ struct Metric {
         MEMORY = 2,
         BATTERY = 3,
         THERMAL = 4,
+        JANK = 5,
         ERROR = 0xff
     };
 };
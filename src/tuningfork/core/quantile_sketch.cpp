@@ -0,0 +1,153 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "quantile_sketch.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace tuningfork {
+
+namespace {
+
+// Fixed so that results are repeatable.
+constexpr uint64_t kRandomSeed = 0x9e3779b97f4a7c15ull;
+
+}  // anonymous namespace
+
+QuantileSketch::QuantileSketch(int k)
+    : k_(k < kMinLevelCapacity ? kMinLevelCapacity : k),
+      levels_(1),
+      random_state_(kRandomSeed) {
+    total_capacity_ = TotalCapacity();
+}
+
+uint32_t QuantileSketch::Capacity(size_t level) const {
+    // Levels below the top shrink by 2/3 each.
+    double capacity = k_;
+    for (size_t h = level + 1; h < levels_.size(); ++h) capacity *= 2.0 / 3.0;
+    uint32_t c = static_cast<uint32_t>(capacity);
+    return c < kMinLevelCapacity ? kMinLevelCapacity : c;
+}
+
+uint32_t QuantileSketch::TotalCapacity() const {
+    uint32_t total = 0;
+    for (size_t h = 0; h < levels_.size(); ++h) total += Capacity(h);
+    return total;
+}
+
+bool QuantileSketch::RandomBit() {
+    // xorshift64
+    random_state_ ^= random_state_ << 13;
+    random_state_ ^= random_state_ >> 7;
+    random_state_ ^= random_state_ << 17;
+    return random_state_ & 1;
+}
+
+void QuantileSketch::Add(float sample) {
+    levels_[0].push_back(sample);
+    ++count_;
+    ++num_retained_;
+    if (num_retained_ >= total_capacity_) Compress();
+}
+
+void QuantileSketch::CompactLevel(size_t level) {
+    if (level + 1 >= levels_.size()) {
+        levels_.emplace_back();
+        levels_.back().reserve(k_);
+        total_capacity_ = TotalCapacity();
+    }
+    auto& from = levels_[level];
+    auto& to = levels_[level + 1];
+    std::sort(from.begin(), from.end());
+    // With an odd number of samples, the largest stays behind.
+    size_t n_pairs = from.size() / 2;
+    size_t offset = RandomBit() ? 1 : 0;
+    for (size_t i = 0; i < n_pairs; ++i) {
+        to.push_back(from[2 * i + offset]);
+    }
+    bool odd = from.size() % 2 == 1;
+    float leftover = odd ? from.back() : 0;
+    from.clear();
+    if (odd) from.push_back(leftover);
+    num_retained_ -= n_pairs;
+}
+
+void QuantileSketch::Compress() {
+    while (num_retained_ >= total_capacity_) {
+        size_t h = 0;
+        while (h < levels_.size() && levels_[h].size() < Capacity(h)) ++h;
+        if (h == levels_.size()) break;
+        CompactLevel(h);
+    }
+}
+
+TuningFork_ErrorCode QuantileSketch::Merge(const QuantileSketch& other) {
+    if (other.k_ != k_) return TUNINGFORK_ERROR_BAD_PARAMETER;
+    return MergeLevels(other.levels_, other.count_);
+}
+
+TuningFork_ErrorCode QuantileSketch::MergeLevels(
+    const std::vector<std::vector<float>>& levels, uint64_t count) {
+    // Each sample at level h stands for 2^h samples.
+    uint64_t weight = 0;
+    for (size_t h = 0; h < levels.size(); ++h) {
+        if (h >= 64) return TUNINGFORK_ERROR_BAD_PARAMETER;
+        weight += levels[h].size() * (uint64_t(1) << h);
+    }
+    if (weight != count) return TUNINGFORK_ERROR_BAD_PARAMETER;
+    if (levels.size() > levels_.size()) {
+        levels_.resize(levels.size());
+        total_capacity_ = TotalCapacity();
+    }
+    for (size_t h = 0; h < levels.size(); ++h) {
+        levels_[h].insert(levels_[h].end(), levels[h].begin(),
+                          levels[h].end());
+        num_retained_ += levels[h].size();
+    }
+    count_ += count;
+    Compress();
+    return TUNINGFORK_ERROR_OK;
+}
+
+float QuantileSketch::Quantile(double q) const {
+    if (count_ == 0) return 0;
+    q = std::max(0.0, std::min(1.0, q));
+    std::vector<std::pair<float, uint64_t>> weighted;
+    weighted.reserve(num_retained_);
+    for (size_t h = 0; h < levels_.size(); ++h) {
+        for (float x : levels_[h]) weighted.push_back({x, uint64_t(1) << h});
+    }
+    std::sort(weighted.begin(), weighted.end());
+    double rank = q * count_;
+    uint64_t cumulative = 0;
+    for (auto& w : weighted) {
+        cumulative += w.second;
+        if (cumulative >= rank) return w.first;
+    }
+    return weighted.back().first;
+}
+
+void QuantileSketch::Clear() {
+    levels_.resize(1);
+    levels_[0].clear();
+    count_ = 0;
+    num_retained_ = 0;
+    total_capacity_ = TotalCapacity();
+    random_state_ = kRandomSeed;
+}
+
+}  // namespace tuningfork
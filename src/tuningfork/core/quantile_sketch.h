@@ -0,0 +1,85 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "tuningfork/tuningfork.h"
+
+namespace tuningfork {
+
+// A KLL quantile sketch (Karnin, Lang & Liberty, 2016).
+// Samples are kept in a stack of compactors: level h holds samples of weight
+// 2^h and, when it fills up, half of them, chosen at random from the sorted
+// level, are promoted to level h+1. The capacity of each level shrinks by a
+// factor of 2/3 going down the stack, so the sketch retains fewer than about
+// 3k samples however many are added.
+// With k = 200, the rank of a returned quantile is within about 1.7% of the
+// one requested with 99% probability. Merging two sketches gives the same
+// guarantee as a single sketch fed all the samples.
+class QuantileSketch {
+   public:
+    static constexpr int kDefaultK = 200;
+    // The smallest capacity of any level.
+    static constexpr int kMinLevelCapacity = 8;
+
+    explicit QuantileSketch(int k = kDefaultK);
+
+    void Add(float sample);
+
+    // Add the samples of a sketch with the same k.
+    TuningFork_ErrorCode Merge(const QuantileSketch& other);
+
+    // Add serialized levels, as returned by Levels(), holding count samples.
+    TuningFork_ErrorCode MergeLevels(
+        const std::vector<std::vector<float>>& levels, uint64_t count);
+
+    // Returns the sample at normalized rank q, which is clamped to [0,1].
+    // Returns 0 if the sketch is empty.
+    float Quantile(double q) const;
+
+    void Clear();
+
+    // The number of samples added.
+    uint64_t Count() const { return count_; }
+
+    // The number of samples retained in the sketch.
+    size_t NumRetained() const { return num_retained_; }
+
+    int K() const { return k_; }
+
+    const std::vector<std::vector<float>>& Levels() const { return levels_; }
+
+   private:
+    uint32_t Capacity(size_t level) const;
+    uint32_t TotalCapacity() const;
+    // Compact levels until the retained samples fit.
+    void Compress();
+    void CompactLevel(size_t level);
+    bool RandomBit();
+
+    int k_;
+    uint64_t count_ = 0;
+    size_t num_retained_ = 0;
+    uint32_t total_capacity_;
+    std::vector<std::vector<float>> levels_;
+    uint64_t random_state_;
+};
+
+}  // namespace tuningfork
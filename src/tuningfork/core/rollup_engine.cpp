@@ -0,0 +1,72 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rollup_engine.h"
+
+#define LOG_TAG "TuningFork"
+#include "Log.h"
+
+namespace tuningfork {
+
+constexpr uint32_t RollupEngine::kSlotsPerWindow[];
+constexpr size_t RollupEngine::kWindowsKept[];
+
+RollupEngine::RollupEngine(Duration slot_length) : slot_length_(slot_length) {
+    if (slot_length_ <= Duration::zero()) {
+        ALOGE("Rollup slots must have a positive length");
+        slot_length_ = std::chrono::minutes(1);
+    }
+}
+
+uint32_t RollupEngine::Add(const Session& session) {
+    auto t = session.time().end;
+    if (t == SystemTimePoint()) return 0;
+    auto frame_times = session.GetNonEmptyHistograms<FrameTimeMetricData>();
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint32_t completed = 0;
+    for (int level = 0; level < kNumLevels; ++level) {
+        auto length = std::chrono::duration_cast<SystemDuration>(
+            WindowLength(level));
+        auto start = SystemTimePoint(length * (t.time_since_epoch() / length));
+        auto& windows = windows_[level];
+        if (windows.empty() || windows.back().start < start) {
+            if (!windows.empty()) completed |= 1 << level;
+            windows.push_back({start, WindowLength(level), {}});
+            if (windows.size() > kWindowsKept[level]) windows.pop_front();
+        } else if (start < windows.back().start) {
+            // Sessions are added in order, so this only happens if the clock
+            // has gone back. Count it in the latest window.
+            ALOGV("Rollup session is earlier than the current window");
+        }
+        auto& window = windows.back().frame_times;
+        for (auto d : frame_times) {
+            auto it = window.find(d->metric_id_);
+            if (it == window.end())
+                window.emplace(d->metric_id_, *d);
+            else if (it->second.Merge(*d) != TUNINGFORK_ERROR_OK)
+                ALOGW_ONCE("Couldn't merge frame time data into rollup");
+        }
+    }
+    return completed;
+}
+
+std::vector<RollupWindow> RollupEngine::Windows(int level) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (level < 0 || level >= kNumLevels) return {};
+    return {windows_[level].begin(), windows_[level].end()};
+}
+
+}  // namespace tuningfork
@@ -0,0 +1,75 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "frametime_metric.h"
+#include "session.h"
+
+namespace tuningfork {
+
+// Frame time histograms for one window of time.
+struct RollupWindow {
+    SystemTimePoint start;
+    Duration length;
+    std::unordered_map<MetricId, FrameTimeMetricData> frame_times;
+};
+
+// Keeps the frame time histograms of flushed sessions in windows of several
+// lengths, so that recent detail is kept on the device while coarser windows
+// cover a longer period.
+//
+// Level 0 has one window per slot, level 1 one per kSlotsPerWindow[1] slots
+// and so on. Windows are aligned to multiples of their length since the
+// epoch. Each session added is merged into the window containing its end
+// time at every level, and the most recent kWindowsKept[level] windows are
+// kept at each level.
+class RollupEngine {
+   public:
+    static constexpr int kNumLevels = 3;
+    static constexpr uint32_t kSlotsPerWindow[kNumLevels] = {1, 10, 60};
+    static constexpr size_t kWindowsKept[kNumLevels] = {60, 36, 24};
+
+    explicit RollupEngine(Duration slot_length);
+
+    RollupEngine(const RollupEngine&) = delete;
+    RollupEngine& operator=(const RollupEngine&) = delete;
+
+    // Add the frame time data in session. Returns a bit mask with bit l set
+    // if the session is later than the window at level l that the previous
+    // one went in, i.e. if that window is now complete.
+    uint32_t Add(const Session& session);
+
+    // Get the windows kept at a level, oldest first. The last one may still
+    // be added to.
+    std::vector<RollupWindow> Windows(int level) const;
+
+    Duration WindowLength(int level) const {
+        return slot_length_ * kSlotsPerWindow[level];
+    }
+
+   private:
+    Duration slot_length_;
+    mutable std::mutex mutex_;
+    std::deque<RollupWindow> windows_[kNumLevels];
+};
+
+}  // namespace tuningfork
@@ -17,17 +17,71 @@
 
 #include "session.h"
 
+#include <algorithm>
+
 namespace tuningfork {
 
+constexpr size_t Session::kMaxDenseFrameTimeSlots;
+
 FrameTimeMetricData* Session::CreateFrameTimeHistogram(
     MetricId id, const Settings::Histogram& settings) {
+    std::lock_guard<std::mutex> lock(mutex_);
     frame_time_data_.push_back(
         std::make_unique<FrameTimeMetricData>(id, settings));
     auto p = frame_time_data_.back().get();
-    available_frame_time_data_.push_back(p);
+    auto ikey = id.detail.frame_time.ikey;
+    if (ikey >= ikey_stride_) {
+        // Lay out any data that is already in use for the new stride.
+        std::vector<FrameTimeMetricData*> in_use;
+        ForEachDenseFrameTimeData(
+            [&in_use](FrameTimeMetricData* d) { in_use.push_back(d); });
+        for (auto it = metric_data_.begin(); it != metric_data_.end();) {
+            if (it->second->type == Metric::Type::FRAME_TIME) {
+                in_use.push_back(
+                    reinterpret_cast<FrameTimeMetricData*>(it->second));
+                it = metric_data_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        ikey_stride_ = ikey + 1;
+        available_frame_time_data_.resize(ikey_stride_);
+        frame_time_slots_.clear();
+        frame_time_occupied_.clear();
+        for (auto d : in_use) {
+            if (IsDense(d->metric_id_))
+                SetDenseFrameTimeData(d);
+            else
+                metric_data_.insert({d->metric_id_, d});
+        }
+    }
+    available_frame_time_data_[ikey].push_back(p);
     return p;
 }
 
+FrameTimeMetricData* Session::GetDenseFrameTimeData(MetricId id) {
+    size_t i = DenseIndex(id);
+    if (i < frame_time_slots_.size() && frame_time_slots_[i] != nullptr)
+        return frame_time_slots_[i];
+    auto p = TakeFrameTimeData(id);
+    if (p != nullptr) SetDenseFrameTimeData(p);
+    return p;
+}
+
+void Session::SetDenseFrameTimeData(FrameTimeMetricData* d) {
+    size_t i = DenseIndex(d->metric_id_);
+    if (i >= frame_time_slots_.size()) {
+        // Annotation ids are allocated in order, so doubling keeps this
+        // amortized constant.
+        size_t n = std::max(i + 1, 2 * frame_time_slots_.size());
+        n = std::min(n, kMaxDenseFrameTimeSlots);
+        frame_time_slots_.resize(n, nullptr);
+        frame_time_occupied_.resize((n + 63) / 64, 0);
+    }
+    frame_time_slots_[i] = d;
+    frame_time_occupied_[i / 64] |= uint64_t(1) << (i % 64);
+}
+
 LoadingTimeMetricData* Session::CreateLoadingTimeSeries(MetricId id) {
     loading_time_data_.push_back(std::make_unique<LoadingTimeMetricData>(id));
     auto p = loading_time_data_.back().get();
@@ -68,15 +122,20 @@ std::vector<CrashReason> Session::GetCrashReports() const {
 
 void Session::ClearData() {
     std::lock_guard<std::mutex> lock(mutex_);
+    ForEachDenseFrameTimeData([this](FrameTimeMetricData* d) {
+        frame_time_slots_[DenseIndex(d->metric_id_)] = nullptr;
+    });
+    std::fill(frame_time_occupied_.begin(), frame_time_occupied_.end(), 0);
     metric_data_.clear();
-    available_frame_time_data_.clear();
+    for (auto& a : available_frame_time_data_) a.clear();
     available_loading_time_data_.clear();
     available_memory_data_.clear();
     available_battery_data_.clear();
     available_thermal_data_.clear();
     for (auto& p : frame_time_data_) {
         p->Clear();
-        available_frame_time_data_.push_back(p.get());
+        available_frame_time_data_[p->metric_id_.detail.frame_time.ikey]
+            .push_back(p.get());
     }
     for (auto& p : loading_time_data_) {
         p->Clear();
@@ -98,6 +157,83 @@ void Session::ClearData() {
     time_.end = SystemTimePoint();
 }
 
+TuningFork_ErrorCode Session::MergeMetric(MetricId id, MetricData* m) {
+    switch (m->type) {
+        case Metric::Type::FRAME_TIME: {
+            auto d = GetData<FrameTimeMetricData>(id);
+            auto o = reinterpret_cast<FrameTimeMetricData*>(m);
+            if (d == nullptr || d->Merge(*o) != TUNINGFORK_ERROR_OK)
+                return TUNINGFORK_ERROR_NO_MORE_SPACE_FOR_FRAME_TIME_DATA;
+            break;
+        }
+        case Metric::Type::LOADING_TIME: {
+            auto d = GetData<LoadingTimeMetricData>(id);
+            auto o = reinterpret_cast<LoadingTimeMetricData*>(m);
+            if (d == nullptr)
+                return TUNINGFORK_ERROR_NO_MORE_SPACE_FOR_LOADING_TIME_DATA;
+            for (auto& s : o->data_.Samples()) d->data_.Add(s);
+            d->duration_ += o->duration_;
+            d->breakdown_.Merge(o->breakdown_);
+            break;
+        }
+        case Metric::Type::MEMORY: {
+            auto d = GetData<MemoryMetricData>(id);
+            auto o = reinterpret_cast<MemoryMetricData*>(m);
+            if (d == nullptr) break;
+            for (auto& s : o->data_) {
+                if (d->data_.size() >= kBufferSize) break;
+                d->data_.push_back(s);
+            }
+            break;
+        }
+        case Metric::Type::BATTERY: {
+            auto d = GetData<BatteryMetricData>(id);
+            auto o = reinterpret_cast<BatteryMetricData*>(m);
+            if (d == nullptr) break;
+            d->data_.insert(d->data_.end(), o->data_.begin(), o->data_.end());
+            break;
+        }
+        case Metric::Type::THERMAL: {
+            auto d = GetData<ThermalMetricData>(id);
+            auto o = reinterpret_cast<ThermalMetricData*>(m);
+            if (d == nullptr) break;
+            d->data_.insert(d->data_.end(), o->data_.begin(), o->data_.end());
+            break;
+        }
+        case Metric::Type::JANK:
+        case Metric::Type::ERROR:
+            break;
+    }
+    return TUNINGFORK_ERROR_OK;
+}
+
+TuningFork_ErrorCode Session::Merge(const Session& other) {
+    TuningFork_ErrorCode ret = TUNINGFORK_ERROR_OK;
+    {
+        std::lock_guard<std::mutex> lock(other.mutex_);
+        other.ForEachDenseFrameTimeData([&](FrameTimeMetricData* d) {
+            if (d->Empty()) return;
+            auto err = MergeMetric(d->metric_id_, d);
+            if (err != TUNINGFORK_ERROR_OK) ret = err;
+        });
+        for (auto& m : other.metric_data_) {
+            if (m.second->Empty()) continue;
+            auto err = MergeMetric(m.first, m.second);
+            if (err != TUNINGFORK_ERROR_OK) ret = err;
+        }
+    }
+    if (other.time_.start != SystemTimePoint()) {
+        if (time_.start == SystemTimePoint() || other.time_.start < time_.start)
+            time_.start = other.time_.start;
+        if (other.time_.end > time_.end) time_.end = other.time_.end;
+    }
+    instrumentation_keys_ = other.instrumentation_keys_;
+    auto crashes = other.GetCrashReports();
+    std::lock_guard<std::mutex> lock(crash_mutex_);
+    crash_data_.insert(crash_data_.end(), crashes.begin(), crashes.end());
+    return ret;
+}
+
 void Session::Ping(SystemTimePoint t) {
     if (time_.start == SystemTimePoint()) {
         time_.start = t;
@@ -16,7 +16,6 @@
 
 #pragma once
 
-#include <list>
 #include <memory>
 #include <mutex>
 #include <unordered_map>
@@ -44,7 +43,7 @@ typedef enum CrashReason {
 } CrashReason;
 
 // A recording session which stores histograms and time-series.
-// These are double-buffered inside TuningForkImpl.
+// These are recycled through a SessionRing inside TuningForkImpl.
 class Session {
    public:
     // Get functions return nullptr if there is no availability of this type
@@ -52,6 +51,8 @@ class Session {
     template <typename T>
     T* GetData(MetricId id) {
         std::lock_guard<std::mutex> lock(mutex_);
+        if (T::MetricType() == Metric::Type::FRAME_TIME && IsDense(id))
+            return reinterpret_cast<T*>(GetDenseFrameTimeData(id));
         auto it = metric_data_.find(id);
         if (it == metric_data_.end()) {
             MetricData* d;
@@ -71,6 +72,8 @@ class Session {
                 case Metric::Type::THERMAL:
                     d = TakeThermalData(id);
                     break;
+                // Jank is kept in the frame time data.
+                case Metric::Type::JANK:
                 case Metric::Type::ERROR:
                     return nullptr;
             }
@@ -104,10 +107,21 @@ class Session {
     // Clear the data in each created histogram or time series.
     void ClearData();
 
+    // Add the data recorded in other, which must have been created with the
+    // same settings, to this session. Data that there is no space for is
+    // lost and TUNINGFORK_ERROR_NO_MORE_SPACE_FOR_FRAME_TIME_DATA or
+    // TUNINGFORK_ERROR_NO_MORE_SPACE_FOR_LOADING_TIME_DATA is returned.
+    TuningFork_ErrorCode Merge(const Session& other);
+
     template <typename T>
     std::vector<const T*> GetNonEmptyHistograms() const {
         // Note that this must only be called once the session has been frozen
         std::vector<const T*> ret;
+        if (T::MetricType() == Metric::Type::FRAME_TIME) {
+            ForEachDenseFrameTimeData([&ret](const FrameTimeMetricData* d) {
+                if (!d->Empty()) ret.push_back(reinterpret_cast<const T*>(d));
+            });
+        }
         for (const auto& t : metric_data_) {
             if (!t.second->Empty()) {
                 if (t.second->type == T::MetricType())
@@ -117,6 +131,18 @@ class Session {
         return ret;
     }
 
+    // Call f for each frame time metric. This neither locks nor allocates,
+    // so it can be used from a signal handler, at the risk of seeing a metric
+    // part way through an update.
+    template <typename F>
+    void ForEachFrameTimeData(F f) const {
+        ForEachDenseFrameTimeData(f);
+        for (const auto& t : metric_data_) {
+            if (t.second->type == Metric::Type::FRAME_TIME)
+                f(reinterpret_cast<const FrameTimeMetricData*>(t.second));
+        }
+    }
+
     // Update times
     void Ping(SystemTimePoint t);
 
@@ -136,19 +162,51 @@ class Session {
     std::vector<CrashReason> GetCrashReports() const;
 
    private:
-    // Get an available metric that has been set up to work with this id.
-    FrameTimeMetricData* TakeFrameTimeData(MetricId id) {
-        for (auto it = available_frame_time_data_.begin();
-             it != available_frame_time_data_.end(); ++it) {
-            auto p = *it;
-            if (p->metric_id_.detail.frame_time.ikey ==
-                id.detail.frame_time.ikey) {
-                available_frame_time_data_.erase(it);
-                p->metric_id_ = id;
-                return p;
+    TuningFork_ErrorCode MergeMetric(MetricId id, MetricData* m);
+
+    // Frame time data for an annotation and instrumentation key is kept at
+    // annotation * ikey_stride_ + ikey in frame_time_slots_, with a bit set in
+    // frame_time_occupied_ for each slot that is in use. Ids that would make
+    // the array larger than kMaxDenseFrameTimeSlots go in metric_data_.
+    static constexpr size_t kMaxDenseFrameTimeSlots = 1 << 20;
+
+    size_t DenseIndex(MetricId id) const {
+        return size_t(id.detail.annotation) * ikey_stride_ +
+               id.detail.frame_time.ikey;
+    }
+
+    bool IsDense(MetricId id) const {
+        return id.detail.type == Metric::Type::FRAME_TIME &&
+               id.detail.frame_time.ikey < ikey_stride_ &&
+               DenseIndex(id) < kMaxDenseFrameTimeSlots;
+    }
+
+    // Get the data in id's slot, taking an available metric if it is empty.
+    FrameTimeMetricData* GetDenseFrameTimeData(MetricId id);
+
+    // Put d in its slot, growing the array if needed.
+    void SetDenseFrameTimeData(FrameTimeMetricData* d);
+
+    template <typename F>
+    void ForEachDenseFrameTimeData(F f) const {
+        for (size_t w = 0; w < frame_time_occupied_.size(); ++w) {
+            for (uint64_t bits = frame_time_occupied_[w]; bits != 0;
+                 bits &= bits - 1) {
+                f(frame_time_slots_[w * 64 + __builtin_ctzll(bits)]);
             }
         }
-        return nullptr;
+    }
+
+    // Get an available metric that has been set up to work with this id.
+    FrameTimeMetricData* TakeFrameTimeData(MetricId id) {
+        auto ikey = id.detail.frame_time.ikey;
+        if (ikey >= available_frame_time_data_.size() ||
+            available_frame_time_data_[ikey].empty())
+            return nullptr;
+        auto p = available_frame_time_data_[ikey].back();
+        available_frame_time_data_[ikey].pop_back();
+        p->metric_id_ = id;
+        return p;
     }
 
     // Get an available metric that has been set up to work with this id.
@@ -193,15 +251,19 @@ class Session {
     std::vector<std::unique_ptr<MemoryMetricData>> memory_data_;
     std::vector<std::unique_ptr<BatteryMetricData>> battery_data_;
     std::vector<std::unique_ptr<ThermalMetricData>> thermal_data_;
-    std::list<FrameTimeMetricData*> available_frame_time_data_;
+    // Indexed by instrumentation key.
+    std::vector<std::vector<FrameTimeMetricData*>> available_frame_time_data_;
     std::vector<LoadingTimeMetricData*> available_loading_time_data_;
     std::vector<MemoryMetricData*> available_memory_data_;
     std::vector<BatteryMetricData*> available_battery_data_;
     std::vector<ThermalMetricData*> available_thermal_data_;
+    uint32_t ikey_stride_ = 0;
+    std::vector<FrameTimeMetricData*> frame_time_slots_;
+    std::vector<uint64_t> frame_time_occupied_;
     std::unordered_map<MetricId, MetricData*> metric_data_;
     std::vector<CrashReason> crash_data_;
     std::vector<InstrumentationKey> instrumentation_keys_;
-    std::mutex mutex_;
+    mutable std::mutex mutex_;
     mutable std::mutex crash_mutex_;
 };
 
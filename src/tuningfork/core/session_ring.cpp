@@ -0,0 +1,127 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "session_ring.h"
+
+#define LOG_TAG "TuningFork"
+#include "Log.h"
+
+namespace tuningfork {
+
+constexpr size_t SessionRing::kMinSlots;
+constexpr size_t SessionRing::kMaxSlots;
+
+SessionRing::SessionRing(std::vector<std::unique_ptr<Session>> sessions,
+                         Settings::SessionBackpressure policy,
+                         Duration max_block_time)
+    : sessions_(std::move(sessions)),
+      policy_(policy),
+      max_block_time_(max_block_time),
+      upload_(sessions_.size(), true) {
+    free_.reserve(sessions_.size());
+    for (size_t i = sessions_.size(); i > 1; --i) free_.push_back(i - 1);
+}
+
+bool SessionRing::MakeSpace(std::unique_lock<std::mutex>& lock, bool upload,
+                            bool& merged) {
+    merged = false;
+    if (!free_.empty()) return true;
+    // Queued sessions other than one being uploaded can be changed.
+    size_t first_unused = front_taken_ ? 1 : 0;
+    switch (policy_) {
+        case Settings::SessionBackpressure::MERGE_INTO_PENDING:
+            if (queued_.size() > first_unused) {
+                size_t newest = queued_.back();
+                auto err = sessions_[newest]->Merge(*Current());
+                if (err != TUNINGFORK_ERROR_OK)
+                    ALOGW("Some data was lost merging sessions (%d)", err);
+                // The merged session holds data to upload if either did.
+                upload_[newest] = upload_[newest] || upload;
+                merged = true;
+                return true;
+            }
+            break;
+        case Settings::SessionBackpressure::DROP_OLDEST:
+            if (queued_.size() > first_unused) {
+                size_t oldest = queued_[first_unused];
+                queued_.erase(queued_.begin() + first_unused);
+                sessions_[oldest]->ClearData();
+                free_.push_back(oldest);
+                ++dropped_sessions_;
+                ALOGW("Dropped a session waiting to be uploaded");
+                return true;
+            }
+            break;
+        case Settings::SessionBackpressure::BLOCK:
+            return released_.wait_for(lock, max_block_time_,
+                                      [this] { return !free_.empty(); });
+    }
+    return false;
+}
+
+TuningFork_ErrorCode SessionRing::Submit(bool upload) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    bool merged;
+    if (!MakeSpace(lock, upload, merged))
+        return TUNINGFORK_ERROR_PREVIOUS_UPLOAD_PENDING;
+    if (merged) {
+        Current()->ClearData();
+        return TUNINGFORK_ERROR_OK;
+    }
+    upload_[current_] = upload;
+    queued_.push_back(current_);
+    current_ = free_.back();
+    free_.pop_back();
+    return TUNINGFORK_ERROR_OK;
+}
+
+const Session* SessionRing::Front(bool& upload) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (queued_.empty()) return nullptr;
+    front_taken_ = true;
+    upload = upload_[queued_.front()];
+    return sessions_[queued_.front()].get();
+}
+
+void SessionRing::Release() {
+    size_t released;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!front_taken_) return;
+        released = queued_.front();
+        queued_.pop_front();
+        front_taken_ = false;
+    }
+    // Clear it outside the lock so that Submit isn't held up.
+    sessions_[released]->ClearData();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_.push_back(released);
+    }
+    released_.notify_all();
+}
+
+size_t SessionRing::NumQueued() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queued_.size();
+}
+
+uint64_t SessionRing::DroppedSessions() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return dropped_sessions_;
+}
+
+}  // namespace tuningfork
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "session.h"
+#include "settings.h"
+
+namespace tuningfork {
+
+// A fixed set of sessions that are recycled between recording and uploading.
+//
+// One session is current and is recorded into. Submit queues it to be
+// uploaded and makes a free session current, so no sessions are allocated
+// after construction. The upload thread takes the queued sessions, oldest
+// first, with Front and gives each back with Release once it is done with it.
+//
+// When there is no free session to make current, Submit applies the
+// backpressure policy:
+//  MERGE_INTO_PENDING adds the current session to the newest queued one,
+//   which is uploaded rather than saved if either of them was to be.
+//  DROP_OLDEST discards the oldest queued session.
+//  BLOCK waits up to max_block_time for the upload thread to release one.
+// If that isn't possible, e.g. because the only queued session is being
+// uploaded, the data stays in the current session until the next Submit.
+class SessionRing {
+   public:
+    static constexpr size_t kMinSlots = 2;
+    static constexpr size_t kMaxSlots = 16;
+
+    SessionRing(std::vector<std::unique_ptr<Session>> sessions,
+                Settings::SessionBackpressure policy, Duration max_block_time);
+
+    SessionRing(const SessionRing&) = delete;
+    SessionRing& operator=(const SessionRing&) = delete;
+
+    // Only to be called by the thread that calls Submit.
+    Session* Current() const { return sessions_[current_].get(); }
+
+    // Returns TUNINGFORK_ERROR_PREVIOUS_UPLOAD_PENDING if the current session
+    // could be neither queued nor merged. If upload is false, the session is
+    // to be saved rather than uploaded.
+    TuningFork_ErrorCode Submit(bool upload);
+
+    // Get the oldest queued session, or nullptr if there is none. It stays
+    // queued until Release is called.
+    const Session* Front(bool& upload);
+
+    // Clear the session returned by Front and make it free.
+    void Release();
+
+    size_t NumQueued() const;
+
+    // Number of sessions discarded by DROP_OLDEST.
+    uint64_t DroppedSessions() const;
+
+   private:
+    bool MakeSpace(std::unique_lock<std::mutex>& lock, bool upload,
+                   bool& merged);
+
+    std::vector<std::unique_ptr<Session>> sessions_;
+    Settings::SessionBackpressure policy_;
+    Duration max_block_time_;
+    size_t current_ = 0;
+    mutable std::mutex mutex_;
+    std::condition_variable released_;
+    // Indices into sessions_.
+    std::vector<size_t> free_;
+    std::deque<size_t> queued_;
+    std::vector<bool> upload_;
+    // Whether the front of queued_ has been taken by Front.
+    bool front_taken_ = false;
+    uint64_t dropped_sessions_ = 0;
+};
+
+}  // namespace tuningfork
@@ -28,10 +28,31 @@ namespace tuningfork {
 //  and the settings loaded from the tuningfork_settings.bin file.
 struct Settings {
     struct Histogram {
+        enum class Scale { LINEAR = 0, LOG_LINEAR = 1 };
+        enum class Storage { HISTOGRAM = 0, QUANTILE_SKETCH = 1 };
+        enum class Sampling { ALL = 0, EVERY_NTH = 1, RANDOM = 2 };
         int32_t instrument_key;
         float bucket_min;
         float bucket_max;
         int32_t n_buckets;
+        // With LOG_LINEAR, n_buckets is ignored and each power of two between
+        // bucket_min and bucket_max is split into 2^sub_bucket_bits buckets.
+        // Zero means the default.
+        Scale scale = Scale::LINEAR;
+        int32_t sub_bucket_bits = 0;
+        // With QUANTILE_SKETCH, frame times are kept in a quantile sketch of
+        // size n_buckets rather than a histogram. Zero means the default size.
+        Storage storage = Storage::HISTOGRAM;
+        // With EVERY_NTH or RANDOM, only one in sample_period frames is
+        // recorded and histogram counts are scaled up when serialized.
+        Sampling sampling = Sampling::ALL;
+        uint32_t sample_period = 0;
+        // The number of frames each recorded frame stands for.
+        uint32_t SamplePeriod() const {
+            return sampling == Sampling::ALL || sample_period < 2
+                       ? 1
+                       : sample_period;
+        }
     };
     struct AggregationStrategy {
         enum class Submission { TICK_BASED, TIME_BASED };
@@ -50,6 +71,36 @@ struct Settings {
     uint32_t ultimate_request_timeout_ms;
     int32_t loading_annotation_index;
     int32_t level_annotation_index;
+    // With BINARY, telemetry is uploaded and saved using BinarySerializer
+    // rather than JsonSerializer.
+    enum class TelemetryEncoding { JSON = 0, BINARY = 1 };
+    TelemetryEncoding telemetry_encoding = TelemetryEncoding::JSON;
+    // Uploads of at least this size are gzipped. Negative means never.
+    int32_t upload_compression_threshold_bytes;
+    // Budget for sessions waiting to be uploaded.
+    uint32_t max_upload_queue_bytes;
+    // Storage used by the default persister.
+    enum class LocalCache { FILE_PER_KEY = 0, MAPPED_LOG = 1 };
+    LocalCache local_cache = LocalCache::FILE_PER_KEY;
+    // Sessions recycled between recording and uploading, and what to do when
+    // they are all waiting to be uploaded.
+    uint32_t session_slots;
+    enum class SessionBackpressure {
+        MERGE_INTO_PENDING = 0,
+        DROP_OLDEST = 1,
+        BLOCK = 2
+    };
+    SessionBackpressure session_backpressure =
+        SessionBackpressure::MERGE_INTO_PENDING;
+    // Frame time rollups kept on the device, or 0 for none, and which level
+    // of them to upload.
+    uint32_t rollup_slot_ms;
+    enum class RollupUploadLevel {
+        EVERY_SESSION = 0,
+        TEN_SLOTS = 1,
+        SIXTY_SLOTS = 2
+    };
+    RollupUploadLevel rollup_upload_level = RollupUploadLevel::EVERY_SESSION;
 
     std::string EndpointUri() const {
         std::string uri;
@@ -23,15 +23,10 @@ class Session;
 void ThermalReportingTask::DoWork(Session *session) {
     if (battery_provider_ != nullptr &&
         battery_provider_->IsBatteryReportingEnabled()) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        session->GetData<ThermalMetricData>(id_)->Record(
+        auto id = MetricId::Thermal(annotation_id_->load());
+        session->GetData<ThermalMetricData>(id)->Record(
             time_provider_->TimeSinceProcessStart(), battery_provider_);
     }
 }
 
-void ThermalReportingTask::UpdateMetricId(MetricId id) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    id_ = id;
-}
-
 }  // namespace tuningfork
@@ -0,0 +1,99 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+#include "core/common.h"
+
+namespace tuningfork {
+
+// A hashed timer wheel: items are kept in the slot their deadline falls in,
+// each slot covering slot_duration, with deadlines further out than the whole
+// wheel wrapping around. Everything due in the same slot expires together, so
+// the slot duration is the window within which timers are coalesced.
+template <typename T, size_t kNumSlots = 64>
+class TimerWheel {
+   public:
+    explicit TimerWheel(Duration slot_duration)
+        : slot_duration_(slot_duration) {}
+
+    void Add(const T& item, TimePoint deadline) {
+        // Items due in a slot that has already expired go in the current one.
+        auto tick = std::max(Tick(deadline), current_tick_);
+        slots_[tick % kNumSlots].push_back({item, deadline});
+        ++size_;
+    }
+
+    bool Empty() const { return size_ == 0; }
+    size_t Size() const { return size_; }
+
+    // The earliest deadline, or TimePoint::max() if there are no items.
+    TimePoint NextDeadline() const {
+        TimePoint next = TimePoint::max();
+        for (auto& slot : slots_)
+            for (auto& entry : slot) next = std::min(next, entry.deadline);
+        return next;
+    }
+
+    // Remove the items due up to the end of the slot that now falls in and
+    // call f(item, deadline) for each, earliest first. f may Add items.
+    template <typename F>
+    void Expire(TimePoint now, F f) {
+        auto now_tick = Tick(now);
+        if (now_tick < current_tick_) return;
+        auto n_slots = std::min<int64_t>(now_tick - current_tick_ + 1,
+                                         kNumSlots);
+        expired_.clear();
+        for (int64_t i = 0; i < n_slots; ++i) {
+            auto& slot = slots_[(current_tick_ + i) % kNumSlots];
+            auto due = std::partition(
+                slot.begin(), slot.end(),
+                [&](const Entry& e) { return Tick(e.deadline) > now_tick; });
+            expired_.insert(expired_.end(), due, slot.end());
+            slot.erase(due, slot.end());
+        }
+        size_ -= expired_.size();
+        current_tick_ = now_tick + 1;
+        std::sort(expired_.begin(), expired_.end(),
+                  [](const Entry& a, const Entry& b) {
+                      return a.deadline < b.deadline;
+                  });
+        for (auto& e : expired_) f(e.item, e.deadline);
+    }
+
+   private:
+    struct Entry {
+        T item;
+        TimePoint deadline;
+    };
+
+    int64_t Tick(TimePoint t) const {
+        return t.time_since_epoch() / slot_duration_;
+    }
+
+    Duration slot_duration_;
+    std::array<std::vector<Entry>, kNumSlots> slots_;
+    // Slots before this tick have been expired.
+    int64_t current_tick_ = 0;
+    size_t size_ = 0;
+    std::vector<Entry> expired_;
+};
+
+}  // namespace tuningfork
@@ -29,6 +29,7 @@
 #include "Log.h"
 #include "annotation_util.h"
 #include "histogram.h"
+#include "jank_metric.h"
 #include "memory_telemetry.h"
 #include "metric.h"
 #include "tuningfork_utils.h"
@@ -110,6 +111,26 @@ TuningFork_ErrorCode GetFidelityParameters(
     }
 }
 
+TuningFork_ErrorCode GetFidelityParameters(
+    const ProtobufSerialization &defaultParams, ProtobufSerialization &params,
+    uint32_t timeout_ms, CachedFidelityParams &cached) {
+    if (!s_impl) {
+        return TUNINGFORK_ERROR_TUNINGFORK_NOT_INITIALIZED;
+    } else {
+        return s_impl->GetFidelityParameters(defaultParams, params, timeout_ms,
+                                             &cached);
+    }
+}
+
+TuningFork_ErrorCode UseCachedFidelityParameters(
+    const CachedFidelityParams &cached) {
+    if (!s_impl) {
+        return TUNINGFORK_ERROR_TUNINGFORK_NOT_INITIALIZED;
+    } else {
+        return s_impl->UseCachedFidelityParameters(cached);
+    }
+}
+
 TuningFork_ErrorCode FrameTick(InstrumentationKey id) {
     if (!s_impl) {
         return TUNINGFORK_ERROR_TUNINGFORK_NOT_INITIALIZED;
@@ -126,6 +147,25 @@ TuningFork_ErrorCode FrameDeltaTimeNanos(InstrumentationKey id, Duration dt) {
     }
 }
 
+TuningFork_ErrorCode FrameDeltaTimeNanosBatch(InstrumentationKey id,
+                                              const uint64_t *dts_ns,
+                                              size_t n) {
+    if (!s_impl) {
+        return TUNINGFORK_ERROR_TUNINGFORK_NOT_INITIALIZED;
+    } else {
+        return s_impl->FrameDeltaTimeNanosBatch(id, dts_ns, n);
+    }
+}
+
+TuningFork_ErrorCode FrameDeltaTimeNanosMultiKeyBatch(
+    const InstrumentationKey *ids, const uint64_t *dts_ns, size_t n) {
+    if (!s_impl) {
+        return TUNINGFORK_ERROR_TUNINGFORK_NOT_INITIALIZED;
+    } else {
+        return s_impl->FrameDeltaTimeNanosMultiKeyBatch(ids, dts_ns, n);
+    }
+}
+
 TuningFork_ErrorCode StartTrace(InstrumentationKey key, TraceHandle &handle) {
     if (!s_impl) {
         return TUNINGFORK_ERROR_TUNINGFORK_NOT_INITIALIZED;
@@ -155,6 +195,28 @@ TuningFork_ErrorCode SetCurrentAnnotation(const ProtobufSerialization &ann) {
     }
 }
 
+TuningFork_ErrorCode RegisterAnnotation(const ProtobufSerialization &ann,
+                                        AnnotationId &id) {
+    if (!s_impl)
+        return TUNINGFORK_ERROR_TUNINGFORK_NOT_INITIALIZED;
+    else
+        return s_impl->RegisterAnnotation(ann, id);
+}
+
+TuningFork_ErrorCode SetCurrentAnnotationById(AnnotationId id) {
+    if (!s_impl)
+        return TUNINGFORK_ERROR_TUNINGFORK_NOT_INITIALIZED;
+    else
+        return s_impl->SetCurrentAnnotationById(id);
+}
+
+TuningFork_ErrorCode SetSwapIntervalNanos(uint64_t swap_interval_ns) {
+    if (swap_interval_ns == 0) return TUNINGFORK_ERROR_BAD_PARAMETER;
+    // Shared by all sessions, so this doesn't need an instance.
+    JankMetricData::SetSwapIntervalNs(swap_interval_ns);
+    return TUNINGFORK_ERROR_OK;
+}
+
 TuningFork_ErrorCode SetUploadCallback(TuningFork_UploadCallback cbk) {
     if (!s_impl) {
         return TUNINGFORK_ERROR_TUNINGFORK_NOT_INITIALIZED;
@@ -265,6 +327,21 @@ TuningFork_ErrorCode StopLoadingGroup(LoadingHandle handle) {
         return s_impl->StopLoadingGroup(handle);
 }
 
+TuningFork_ErrorCode StartLoadingSpan(uint32_t source, LoadingSpanHandle parent,
+                                      LoadingSpanHandle &handle) {
+    if (!s_impl)
+        return TUNINGFORK_ERROR_TUNINGFORK_NOT_INITIALIZED;
+    else
+        return s_impl->StartLoadingSpan(source, parent, handle);
+}
+
+TuningFork_ErrorCode StopLoadingSpan(LoadingSpanHandle handle) {
+    if (!s_impl)
+        return TUNINGFORK_ERROR_TUNINGFORK_NOT_INITIALIZED;
+    else
+        return s_impl->StopLoadingSpan(handle);
+}
+
 TuningFork_ErrorCode ReportLifecycleEvent(TuningFork_LifecycleState state) {
     if (!s_impl)
         return TUNINGFORK_ERROR_TUNINGFORK_NOT_INITIALIZED;
@@ -303,4 +380,27 @@ TuningFork_ErrorCode SetAggregationStrategyInterval(
                                                       interval_ms_or_count);
 }
 
+TuningFork_ErrorCode GetUploadQueueStats(TuningFork_UploadQueueStats& stats) {
+    if (!s_impl)
+        return TUNINGFORK_ERROR_TUNINGFORK_NOT_INITIALIZED;
+    else
+        return s_impl->GetUploadQueueStats(stats);
+}
+
+TuningFork_ErrorCode GetRollupWindows(
+    uint32_t level, InstrumentationKey key,
+    std::vector<TuningFork_RollupWindow> &windows) {
+    if (!s_impl)
+        return TUNINGFORK_ERROR_TUNINGFORK_NOT_INITIALIZED;
+    else
+        return s_impl->GetRollupWindows(level, key, windows);
+}
+
+TuningFork_ErrorCode GetAsyncTelemetryStats(AsyncTelemetry::Stats &stats) {
+    if (!s_impl)
+        return TUNINGFORK_ERROR_TUNINGFORK_NOT_INITIALIZED;
+    else
+        return s_impl->GetAsyncTelemetryStats(stats);
+}
+
 }  // namespace tuningfork
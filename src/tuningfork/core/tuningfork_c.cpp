@@ -14,12 +14,14 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 
 #include "jni/jni_helper.h"
 #include "proto/protobuf_util.h"
 #include "settings.h"
+#include "trace_recorder.h"
 #include "tuningfork/tuningfork.h"
 #include "tuningfork/tuningfork_extra.h"
 #include "tuningfork_internal.h"
@@ -82,6 +84,23 @@ TuningFork_ErrorCode TuningFork_setCurrentAnnotation(
         return TUNINGFORK_ERROR_INVALID_ANNOTATION;
 }
 
+TuningFork_ErrorCode TuningFork_registerAnnotation(
+    const TuningFork_CProtobufSerialization *annotation, uint32_t *id) {
+    if (annotation == nullptr || id == nullptr)
+        return TUNINGFORK_ERROR_BAD_PARAMETER;
+    return tf::RegisterAnnotation(tf::ToProtobufSerialization(*annotation),
+                                  *id);
+}
+
+TuningFork_ErrorCode TuningFork_setCurrentAnnotationById(uint32_t id) {
+    return tf::SetCurrentAnnotationById(id);
+}
+
+TuningFork_ErrorCode TuningFork_setSwapIntervalNanos(
+    uint64_t swap_interval_ns) {
+    return tf::SetSwapIntervalNanos(swap_interval_ns);
+}
+
 // Record a frame tick that will be associated with the instrumentation key and
 // the current
 //   annotation
@@ -95,6 +114,22 @@ TuningFork_ErrorCode TuningFork_frameDeltaTimeNanos(TuningFork_InstrumentKey id,
     return tf::FrameDeltaTimeNanos(id, std::chrono::nanoseconds(dt));
 }
 
+// Record several external times for the same key
+TuningFork_ErrorCode TuningFork_frameDeltaTimeNanosBatch(
+    TuningFork_InstrumentKey id, const TuningFork_Duration *dts, size_t n) {
+    if (dts == nullptr && n > 0) return TUNINGFORK_ERROR_BAD_PARAMETER;
+    return tf::FrameDeltaTimeNanosBatch(id, dts, n);
+}
+
+// Record several external times, each with its own key
+TuningFork_ErrorCode TuningFork_frameDeltaTimeNanosMultiKeyBatch(
+    const TuningFork_InstrumentKey *ids, const TuningFork_Duration *dts,
+    size_t n) {
+    if ((ids == nullptr || dts == nullptr) && n > 0)
+        return TUNINGFORK_ERROR_BAD_PARAMETER;
+    return tf::FrameDeltaTimeNanosMultiKeyBatch(ids, dts, n);
+}
+
 // Start a trace segment
 TuningFork_ErrorCode TuningFork_startTrace(TuningFork_InstrumentKey key,
                                            TuningFork_TraceHandle *handle) {
@@ -220,6 +255,18 @@ TuningFork_ErrorCode TuningFork_stopLoadingGroup(
     return tf::StopLoadingGroup(handle);
 }
 
+TuningFork_ErrorCode TuningFork_startLoadingSpan(
+    uint32_t source, TuningFork_LoadingSpanHandle parent,
+    TuningFork_LoadingSpanHandle *handle) {
+    if (handle == nullptr) return TUNINGFORK_ERROR_INVALID_LOADING_HANDLE;
+    return tf::StartLoadingSpan(source, parent, *handle);
+}
+
+TuningFork_ErrorCode TuningFork_stopLoadingSpan(
+    TuningFork_LoadingSpanHandle handle) {
+    return tf::StopLoadingSpan(handle);
+}
+
 void TUNINGFORK_VERSION_SYMBOL() {
     // Intentionally empty: this function is used to ensure that the proper
     // version of the library is linked against the proper headers.
@@ -239,4 +286,59 @@ TuningFork_ErrorCode TuningFork_setAggregationStrategyInterval(
     return tf::SetAggregationStrategyInterval(method, interval_ms_or_count);
 }
 
+TuningFork_ErrorCode TuningFork_getUploadQueueStats(
+    TuningFork_UploadQueueStats* stats) {
+    if (stats == nullptr) return TUNINGFORK_ERROR_BAD_PARAMETER;
+    return tf::GetUploadQueueStats(*stats);
+}
+
+TuningFork_ErrorCode TuningFork_startTraceRecording(
+    uint32_t events_per_thread) {
+    gamesdk::TraceRecorder::Start(
+        events_per_thread > 0
+            ? events_per_thread
+            : gamesdk::TraceRecorder::kDefaultEventsPerThread);
+    return TUNINGFORK_ERROR_OK;
+}
+
+TuningFork_ErrorCode TuningFork_stopTraceRecording() {
+    gamesdk::TraceRecorder::Stop();
+    return TUNINGFORK_ERROR_OK;
+}
+
+TuningFork_ErrorCode TuningFork_drainTraceRecording(
+    TuningFork_TraceFormat format, TuningFork_CProtobufSerialization* trace) {
+    if (trace == nullptr) return TUNINGFORK_ERROR_BAD_PARAMETER;
+    std::string out;
+    switch (format) {
+        case TUNINGFORK_TRACE_FORMAT_CHROME_JSON:
+            gamesdk::TraceRecorder::WriteChromeJson(
+                gamesdk::TraceRecorder::Drain(), out);
+            break;
+        case TUNINGFORK_TRACE_FORMAT_PERFETTO:
+            gamesdk::TraceRecorder::WritePerfettoTrace(
+                gamesdk::TraceRecorder::Drain(), out);
+            break;
+        default:
+            return TUNINGFORK_ERROR_BAD_PARAMETER;
+    }
+    tf::ToCProtobufSerialization(out, *trace);
+    return TUNINGFORK_ERROR_OK;
+}
+
+TuningFork_ErrorCode TuningFork_getRollupWindows(
+    uint32_t level, TuningFork_InstrumentKey key,
+    TuningFork_RollupWindow* windows, uint32_t* n_windows) {
+    if (n_windows == nullptr || (windows == nullptr && *n_windows != 0))
+        return TUNINGFORK_ERROR_BAD_PARAMETER;
+    std::vector<TuningFork_RollupWindow> kept;
+    auto err = tf::GetRollupWindows(level, key, kept);
+    if (err != TUNINGFORK_ERROR_OK) return err;
+    // Write the most recent windows that fit.
+    size_t n = std::min<size_t>(*n_windows, kept.size());
+    std::copy(kept.end() - n, kept.end(), windows);
+    *n_windows = kept.size();
+    return TUNINGFORK_ERROR_OK;
+}
+
 }  // extern "C" {
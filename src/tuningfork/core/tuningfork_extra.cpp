@@ -59,36 +59,40 @@ bool GetSavedFileName(std::string& name) {
     return true;
 }
 
+// The cache of fidelity params from the server, or null if there's nowhere to
+// save them.
+std::shared_ptr<FidelityParamsCache> SavedFidelityParamsCache() {
+    std::string save_filename;
+    if (!gamesdk::jni::IsValid() || !GetSavedFileName(save_filename))
+        return nullptr;
+    return std::make_shared<FidelityParamsCache>(save_filename);
+}
+
 // Get a previously save fidelity param serialization.
 bool GetSavedFidelityParams(ProtobufSerialization& params) {
     std::string save_filename;
     if (GetSavedFileName(save_filename)) {
-        TuningFork_CProtobufSerialization c_params;
-        if (file_utils::LoadBytesFromFile(save_filename, &c_params)) {
-            ALOGI("Loaded fps from %s (%u bytes)", save_filename.c_str(),
-                  c_params.size);
-            params = ToProtobufSerialization(c_params);
-            TuningFork_CProtobufSerialization_free(&c_params);
+        CachedFidelityParams entry;
+        if (FidelityParamsCache(save_filename).Load(entry)) {
+            params = entry.params;
             return true;
         }
-        ALOGI("Couldn't load fps from %s", save_filename.c_str());
     }
     return false;
 }
 
-// Save fidelity params to the save file.
+// Save fidelity params to the save file. Saving the params that are already
+// cached keeps their version and expiry. Other params aren't from the server,
+// so have no version and are revalidated before they are relied on.
 bool SaveFidelityParams(const ProtobufSerialization& params) {
     std::string save_filename;
     if (GetSavedFileName(save_filename)) {
-        std::ofstream save_file(save_filename, std::ios::binary);
-        if (save_file.good()) {
-            save_file.write(reinterpret_cast<const char*>(params.data()),
-                            params.size());
-            ALOGI("Saved fps to %s (%zu bytes)", save_filename.c_str(),
-                  params.size());
-            return true;
-        }
-        ALOGI("Couldn't save fps to %s", save_filename.c_str());
+        FidelityParamsCache cache(save_filename);
+        CachedFidelityParams entry;
+        if (cache.Load(entry) && entry.params == params) return true;
+        entry = CachedFidelityParams();
+        entry.params = params;
+        return cache.Save(entry);
     }
     return false;
 }
@@ -97,7 +101,7 @@ bool SaveFidelityParams(const ProtobufSerialization& params) {
 bool SavedFidelityParamsFileExists() {
     std::string save_filename;
     if (GetSavedFileName(save_filename)) {
-        return file_utils::FileExists(save_filename);
+        return FidelityParamsCache(save_filename).Exists();
     }
     return false;
 }
@@ -105,11 +109,14 @@ bool SavedFidelityParamsFileExists() {
 static bool s_kill_thread = false;
 static std::unique_ptr<std::thread> s_fp_thread;
 
-// Download FPs on a separate thread
+// Download FPs on a separate thread. If the cache holds params that haven't
+// expired, they are passed to the callback straight away and the download
+// only revalidates them, calling back again if the server's params differ.
 TuningFork_ErrorCode StartFidelityParamDownloadThread(
     const ProtobufSerialization& default_params,
     TuningFork_FidelityParamsCallback fidelity_params_callback,
-    int initialTimeoutMs, int ultimateTimeoutMs) {
+    int initialTimeoutMs, int ultimateTimeoutMs,
+    std::shared_ptr<FidelityParamsCache> cache) {
     if (fidelity_params_callback == nullptr)
         return TUNINGFORK_ERROR_BAD_PARAMETER;
     static std::mutex threadMutex;
@@ -123,33 +130,44 @@ TuningFork_ErrorCode StartFidelityParamDownloadThread(
         ProtobufSerialization params;
         auto waitTime = std::chrono::milliseconds(initialTimeoutMs);
         bool first_time = true;
+        bool revalidating = false;
+        auto callback = [&](const ProtobufSerialization& fps) {
+            TuningFork_CProtobufSerialization cpbs;
+            ToCProtobufSerialization(fps, cpbs);
+            if (fidelity_params_callback) fidelity_params_callback(&cpbs);
+            TuningFork_CProtobufSerialization_free(&cpbs);
+            first_time = false;
+        };
         auto upload_defaults_first_time = [&]() {
-            if (first_time) {
-                TuningFork_CProtobufSerialization cpbs;
-                ToCProtobufSerialization(default_params, cpbs);
-                if (fidelity_params_callback) fidelity_params_callback(&cpbs);
-                TuningFork_CProtobufSerialization_free(&cpbs);
-                first_time = false;
-            }
+            if (first_time) callback(default_params);
         };
+        CachedFidelityParams cached;
+        if (cache && cache->Load(cached) &&
+            UseCachedFidelityParameters(cached) == TUNINGFORK_ERROR_OK) {
+            ALOGI("Using cached fidelity params while revalidating them");
+            callback(cached.params);
+            revalidating = true;
+        }
+        const ProtobufSerialization cached_params = cached.params;
         while (!s_kill_thread) {
             auto startTime = std::chrono::steady_clock::now();
-            auto err =
-                GetFidelityParameters(default_params, params, waitTime.count());
-            if (err == TUNINGFORK_ERROR_OK ||
-                err == TUNINGFORK_ERROR_NO_FIDELITY_PARAMS) {
+            auto err = GetFidelityParameters(default_params, params,
+                                             waitTime.count(), cached);
+            if (err == TUNINGFORK_ERROR_FIDELITY_PARAMS_NOT_MODIFIED) {
+                ALOGI("Cached fidelity params are up to date");
+                if (cache) cache->Save(cached);
+                if (first_time) callback(params);
+                break;
+            } else if (err == TUNINGFORK_ERROR_OK ||
+                       err == TUNINGFORK_ERROR_NO_FIDELITY_PARAMS) {
                 if (err == TUNINGFORK_ERROR_NO_FIDELITY_PARAMS) {
                     ALOGI("Got empty fidelity params from server");
                     upload_defaults_first_time();
                 } else {
                     ALOGI("Got fidelity params from server");
-                    if (gamesdk::jni::IsValid()) SaveFidelityParams(params);
-                    TuningFork_CProtobufSerialization cpbs;
-                    ToCProtobufSerialization(params, cpbs);
-                    if (fidelity_params_callback) {
-                        fidelity_params_callback(&cpbs);
-                    }
-                    TuningFork_CProtobufSerialization_free(&cpbs);
+                    if (cache) cache->Save(cached);
+                    if (!revalidating || params != cached_params)
+                        callback(params);
                 }
                 break;
             } else {
@@ -225,7 +243,7 @@ TuningFork_ErrorCode GetDefaultsFromAPKAndDownloadFPs(
     StartFidelityParamDownloadThread(
         default_params, settings.c_settings.fidelity_params_callback,
         settings.initial_request_timeout_ms,
-        settings.ultimate_request_timeout_ms);
+        settings.ultimate_request_timeout_ms, SavedFidelityParamsCache());
     return TUNINGFORK_ERROR_OK;
 }
 
@@ -257,7 +275,7 @@ TuningFork_ErrorCode TuningFork_startFidelityParamDownloadThread(
     return StartFidelityParamDownloadThread(
         ToProtobufSerialization(*c_default_params), fidelity_params_callback,
         settings->initial_request_timeout_ms,
-        settings->ultimate_request_timeout_ms);
+        settings->ultimate_request_timeout_ms, SavedFidelityParamsCache());
 }
 
 // Load fidelity params from assets/tuningfork/<filename>
@@ -14,8 +14,10 @@
  * limitations under the License.
  */
 
+#include <memory>
 #include <string>
 
+#include "fidelity_params_cache.h"
 #include "proto/protobuf_util.h"
 #include "settings.h"
 #include "tuningfork/tuningfork.h"
@@ -27,6 +29,16 @@ namespace tuningfork {
 //  thread.
 TuningFork_ErrorCode GetDefaultsFromAPKAndDownloadFPs(const Settings& settings);
 
+// Call fidelity_params_callback with params from the server, retrying with
+//  backoff until ultimateTimeoutMs, or with default_params if there are none
+//  by the first timeout. If cache holds params that haven't expired, they are
+//  used straight away and revalidated in the background. cache may be null.
+TuningFork_ErrorCode StartFidelityParamDownloadThread(
+    const ProtobufSerialization& default_params,
+    TuningFork_FidelityParamsCallback fidelity_params_callback,
+    int initialTimeoutMs, int ultimateTimeoutMs,
+    std::shared_ptr<FidelityParamsCache> cache);
+
 // Kill all the threads the GetDefaults... may have started.
 TuningFork_ErrorCode KillDownloadThreads();
 
@@ -39,6 +39,8 @@
 namespace tuningfork {
 
 static constexpr Duration kMinAllowedFlushInterval = std::chrono::seconds(60);
+// Longest a flush waits for a free session with the BLOCK backpressure policy.
+static constexpr Duration kMaxFlushBlockTime = std::chrono::seconds(1);
 
 TuningForkImpl::TuningForkImpl(const Settings &settings, IBackend *backend,
                                ITimeProvider *time_provider,
@@ -49,7 +51,7 @@ TuningForkImpl::TuningForkImpl(const Settings &settings, IBackend *backend,
       trace_(gamesdk::Trace::create()),
       backend_(backend),
       upload_thread_(this),
-      current_annotation_id_(MetricId::FrameTime(0, 0)),
+      current_annotation_id_(0),
       time_provider_(time_provider),
       meminfo_provider_(meminfo_provider),
       battery_provider_(battery_provider),
@@ -57,9 +59,16 @@ TuningForkImpl::TuningForkImpl(const Settings &settings, IBackend *backend,
       next_ikey_(0),
       before_first_tick_(true),
       app_first_run_(first_run) {
+    if (settings.c_settings.persistent_cache != nullptr) {
+        upload_queue_ = std::make_shared<UploadQueue>(
+            settings.c_settings.persistent_cache,
+            settings.max_upload_queue_bytes);
+        upload_queue_->Load();
+    }
     if (backend == nullptr) {
         default_backend_ = std::make_unique<HttpBackend>();
-        TuningFork_ErrorCode err = default_backend_->Init(settings);
+        TuningFork_ErrorCode err =
+            default_backend_->Init(settings, upload_queue_);
         if (err == TUNINGFORK_ERROR_OK) {
             ALOGI("TuningFork.GoogleEndpoint: OK");
             backend_ = default_backend_.get();
@@ -70,6 +79,7 @@ TuningForkImpl::TuningForkImpl(const Settings &settings, IBackend *backend,
         }
     }
     upload_thread_.SetBackend(backend_);
+    upload_thread_.SetTelemetryEncoding(settings_.telemetry_encoding);
 
     if (time_provider_ == nullptr) {
         default_time_provider_ = std::make_unique<ChronoTimeProvider>();
@@ -124,29 +134,60 @@ TuningForkImpl::TuningForkImpl(const Settings &settings, IBackend *backend,
             "Neither max_annotations nor max_instrumentation_keys can be zero");
     else
         max_num_frametime_metrics = max_ikeys * annotation_radix_mult_.back();
-    for (int i = 0; i < 2; ++i) {
-        sessions_[i] = std::make_unique<Session>();
-        CreateSessionFrameHistograms(*sessions_[i], max_num_frametime_metrics,
-                                     max_ikeys, settings_.histograms,
+    std::vector<std::unique_ptr<Session>> sessions;
+    for (uint32_t i = 0; i < settings_.session_slots; ++i) {
+        sessions.push_back(std::make_unique<Session>());
+        CreateSessionFrameHistograms(*sessions.back(),
+                                     max_num_frametime_metrics, max_ikeys,
+                                     settings_.histograms,
                                      settings.c_settings.max_num_metrics);
     }
-    current_session_ = sessions_[0].get();
+    sessions_ = std::make_unique<SessionRing>(std::move(sessions),
+                                              settings_.session_backpressure,
+                                              kMaxFlushBlockTime);
+    current_session_ = sessions_->Current();
+    if (settings_.rollup_slot_ms > 0) {
+        rollup_ = std::make_unique<RollupEngine>(
+            std::chrono::milliseconds(settings_.rollup_slot_ms));
+        if (settings_.rollup_upload_level !=
+            Settings::RollupUploadLevel::EVERY_SESSION) {
+            rollup_session_ = std::make_unique<Session>();
+            CreateSessionFrameHistograms(*rollup_session_,
+                                         max_num_frametime_metrics, max_ikeys,
+                                         settings_.histograms,
+                                         settings.c_settings.max_num_metrics);
+        }
+        upload_thread_.SetRollup(
+            rollup_.get(), rollup_session_.get(),
+            static_cast<int>(settings_.rollup_upload_level));
+    }
+    upload_thread_.SetSessionRing(sessions_.get());
+    frame_time_recorder_ = std::make_unique<FrameTimeRecorder>(
+        this, settings_.histograms, max_ikeys,
+        annotation_radix_mult_.empty() ? 1 : annotation_radix_mult_.back(),
+        settings.c_settings.max_num_metrics.frame_time);
     live_traces_.resize(max_num_frametime_metrics);
+#if __ANDROID_API__ >= 29
+    trace_marker_chunks_.reset(
+        new std::atomic<std::atomic<const char *> *>[kMaxTraceMarkerChunks]);
+    for (size_t i = 0; i < kMaxTraceMarkerChunks; ++i)
+        trace_marker_chunks_[i].store(nullptr);
+#endif
     for (auto &t : live_traces_) t = TimePoint::min();
     auto crash_callback = [this]() -> bool {
-        std::stringstream ss;
-        ss << std::this_thread::get_id();
-        TuningFork_ErrorCode ret = this->Flush(true);
-        ALOGI("Crash flush result : %d", ret);
+        WriteCrashSnapshot();
         return true;
     };
 
     crash_handler_.Init(crash_callback);
 
     // Check if there are any files waiting to be uploaded
-    // + merge any histograms that are persisted.
-    upload_thread_.InitialChecks(*current_session_, *this,
-                                 settings_.c_settings.persistent_cache);
+    // + merge any histograms that are persisted or left by a crash.
+    std::string crash_snapshot_path =
+        DefaultTuningForkSaveDirectory() + "/crash_snapshot.bin";
+    upload_thread_.InitialChecks(*current_session_, *this, upload_queue_,
+                                 crash_snapshot_path);
+    crash_snapshot_.Open(crash_snapshot_path);
 
     InitAsyncTelemetry();
 
@@ -170,7 +211,20 @@ TuningForkImpl::~TuningForkImpl() {
     // Stop the threads before we delete Tuning Fork internals
     if (backend_) backend_->Stop();
     upload_thread_.Stop();
-    if (async_telemetry_) async_telemetry_->Stop();
+    if (async_telemetry_) {
+        async_telemetry_->Stop();
+        auto stats = async_telemetry_->GetStats();
+        ALOGI(
+            "Async telemetry: %llu wakeups, %llu tasks (%llu coalesced), %llu "
+            "runs skipped, max lateness %lldms",
+            (unsigned long long)stats.wakeups,
+            (unsigned long long)stats.tasks_run,
+            (unsigned long long)stats.tasks_coalesced,
+            (unsigned long long)stats.runs_skipped,
+            (long long)std::chrono::duration_cast<std::chrono::milliseconds>(
+                stats.max_lateness)
+                .count());
+    }
 }
 
 void TuningForkImpl::CreateSessionFrameHistograms(
@@ -208,55 +262,91 @@ void TuningForkImpl::CreateSessionFrameHistograms(
 // Return the set annotation id or -1 if it could not be set
 MetricId TuningForkImpl::SetCurrentAnnotation(
     const ProtobufSerialization &annotation) {
-    current_annotation_ = annotation;
     AnnotationId id;
     SerializedAnnotationToAnnotationId(annotation, id);
     if (id == annotation_util::kAnnotationError) {
         ALOGW("Error setting annotation of size %zu", annotation.size());
-        current_annotation_id_ = MetricId::FrameTime(0, 0);
+        current_annotation_id_.store(0, std::memory_order_relaxed);
         return MetricId{annotation_util::kAnnotationError};
-    } else {
-        ALOGV("Set annotation id to %" PRIu32, id);
-        bool changed = current_annotation_id_.detail.annotation != id;
-        if (!changed) return current_annotation_id_;
+    }
 #if __ANDROID_API__ >= 29
-        if (ATrace_isEnabled()) {
-            // Finish the last section if there was one and start a new one.
-            static constexpr int32_t kATraceAsyncCookie = 0x5eaf00d;
-            if (trace_started_) {
-                auto last_annotation = trace_marker_cache_.find(last_id_);
-                if (last_annotation == trace_marker_cache_.end()) {
-                    ALOGE("Annotation %u has vanished!", last_id_);
-                } else {
-                    ATrace_endAsyncSection(last_annotation->second.c_str(),
-                                           kATraceAsyncCookie);
-                    trace_marker_cache_.erase(last_annotation);
-                }
-            } else {
-                trace_started_ = true;
-            }
-            // Guard against concurrent access to the cache
-            std::lock_guard<std::mutex> lock(trace_marker_cache_mutex_);
-            auto it = trace_marker_cache_.find(id);
-            if (it == trace_marker_cache_.end()) {
-                it = trace_marker_cache_
-                         .insert(
-                             {id, "APTAnnotation@" +
-                                      annotation_util::HumanReadableAnnotation(
-                                          annotation)})
-                         .first;
-            }
-            ATrace_beginAsyncSection(it->second.c_str(), kATraceAsyncCookie);
-            last_id_ = id;
-        }
+    MakeTraceMarker(id);
+#endif
+    SetCurrentAnnotationById(id);
+    return MetricId::FrameTime(id, 0);
+}
+
+TuningFork_ErrorCode TuningForkImpl::RegisterAnnotation(
+    const ProtobufSerialization &annotation, AnnotationId &id) {
+    auto err = SerializedAnnotationToAnnotationId(annotation, id);
+    if (err != TUNINGFORK_ERROR_OK) return err;
+#if __ANDROID_API__ >= 29
+    // Make the trace marker now so that switching to it doesn't allocate,
+    // even if tracing only starts later.
+    MakeTraceMarker(id);
 #endif
-        current_annotation_id_ = MetricId::FrameTime(id, 0);
-        battery_reporting_task_->UpdateMetricId(MetricId::Battery(id));
-        thermal_reporting_task_->UpdateMetricId(MetricId::Thermal(id));
-        memory_reporting_task_->UpdateMetricId(MetricId::Memory(id));
-        return current_annotation_id_;
+    return TUNINGFORK_ERROR_OK;
+}
+
+TuningFork_ErrorCode TuningForkImpl::SetCurrentAnnotationById(
+    AnnotationId id) {
+    if (!annotation_map_.Contains(id))
+        return TUNINGFORK_ERROR_INVALID_ANNOTATION;
+    // The reporting tasks read the annotation from here, too.
+    AnnotationId old_id =
+        current_annotation_id_.exchange(id, std::memory_order_relaxed);
+    if (old_id == id) return TUNINGFORK_ERROR_OK;
+    ALOGV("Set annotation id to %" PRIu32, id);
+#if __ANDROID_API__ >= 29
+    if (ATrace_isEnabled()) {
+        // Finish the last section if there was one and start a new one. If
+        // threads set annotations at the same time, the sections may overlap.
+        static constexpr int32_t kATraceAsyncCookie = 0x5eaf00d;
+        if (trace_started_.exchange(true, std::memory_order_relaxed))
+            ATrace_endAsyncSection(TraceMarker(old_id), kATraceAsyncCookie);
+        ATrace_beginAsyncSection(TraceMarker(id), kATraceAsyncCookie);
     }
+#endif
+    return TUNINGFORK_ERROR_OK;
+}
+
+#if __ANDROID_API__ >= 29
+void TuningForkImpl::MakeTraceMarker(AnnotationId id) {
+    if (id >= AnnotationMap::kMaxAnnotations) return;
+    std::lock_guard<std::mutex> lock(trace_marker_mutex_);
+    auto &chunk = trace_marker_chunks_[id / kTraceMarkersPerChunk];
+    if (chunk.load(std::memory_order_relaxed) == nullptr) {
+        trace_marker_storage_.emplace_back(
+            new std::atomic<const char *>[kTraceMarkersPerChunk]);
+        auto markers = trace_marker_storage_.back().get();
+        for (size_t i = 0; i < kTraceMarkersPerChunk; ++i)
+            markers[i].store(nullptr, std::memory_order_relaxed);
+        chunk.store(markers, std::memory_order_release);
+    }
+    auto &marker =
+        chunk.load(std::memory_order_relaxed)[id % kTraceMarkersPerChunk];
+    if (marker.load(std::memory_order_relaxed) != nullptr) return;
+    SerializedAnnotation annotation;
+    annotation_map_.Get(id, annotation);
+    trace_marker_names_.push_back(
+        "APTAnnotation@" +
+        annotation_util::HumanReadableAnnotation(annotation));
+    marker.store(trace_marker_names_.back().c_str(), std::memory_order_release);
+}
+
+const char *TuningForkImpl::TraceMarker(AnnotationId id) const {
+    const char *marker = nullptr;
+    if (id < AnnotationMap::kMaxAnnotations) {
+        auto chunk = trace_marker_chunks_[id / kTraceMarkersPerChunk].load(
+            std::memory_order_acquire);
+        if (chunk != nullptr)
+            marker = chunk[id % kTraceMarkersPerChunk].load(
+                std::memory_order_acquire);
+    }
+    // Annotations that weren't registered or set by serialization have none.
+    return marker != nullptr ? marker : "APTAnnotation";
 }
+#endif
 
 TuningFork_ErrorCode TuningForkImpl::SerializedAnnotationToAnnotationId(
     const tuningfork::SerializedAnnotation &ser, tuningfork::AnnotationId &id) {
@@ -275,7 +365,8 @@ TuningFork_ErrorCode TuningForkImpl::MakeCompoundId(InstrumentationKey key,
 
 TuningFork_ErrorCode TuningForkImpl::GetFidelityParameters(
     const ProtobufSerialization &default_params,
-    ProtobufSerialization &params_ser, uint32_t timeout_ms) {
+    ProtobufSerialization &params_ser, uint32_t timeout_ms,
+    CachedFidelityParams *cached) {
     std::string experiment_id;
     if (settings_.EndpointUri().empty()) {
         ALOGW("The base URI in Tuning Fork TuningFork_Settings is invalid");
@@ -291,20 +382,54 @@ TuningFork_ErrorCode TuningForkImpl::GetFidelityParameters(
             : std::chrono::milliseconds(timeout_ms);
     HttpRequest web_request(settings_.EndpointUri(), settings_.api_key,
                             timeout);
+    // Unexpired cached params are already in use while they are revalidated.
+    bool revalidating = cached != nullptr &&
+                        !cached->Expired(time_provider_->SystemNow());
+    if (cached != nullptr) web_request.IfNoneMatch(cached->version);
     auto result = backend_->GenerateTuningParameters(
         web_request, training_mode_params_.get(), params_ser, experiment_id);
-    if (result == TUNINGFORK_ERROR_OK) {
+    if (result == TUNINGFORK_ERROR_FIDELITY_PARAMS_NOT_MODIFIED &&
+        cached != nullptr) {
+        params_ser = cached->params;
+        experiment_id = cached->experiment_id;
+    }
+    if (result == TUNINGFORK_ERROR_OK ||
+        result == TUNINGFORK_ERROR_FIDELITY_PARAMS_NOT_MODIFIED) {
         RequestInfo::CachedValue().current_fidelity_parameters = params_ser;
-    } else if (training_mode_params_.get()) {
-        RequestInfo::CachedValue().current_fidelity_parameters =
-            *training_mode_params_;
+        if (cached != nullptr) {
+            auto max_age = web_request.ResponseMaxAge();
+            if (max_age < Duration::zero())
+                max_age = kDefaultFidelityParamsMaxAge;
+            cached->params = params_ser;
+            cached->experiment_id = experiment_id;
+            if (result == TUNINGFORK_ERROR_OK)
+                cached->version = web_request.ResponseETag();
+            cached->expiry =
+                time_provider_->SystemNow() +
+                std::chrono::duration_cast<SystemDuration>(max_age);
+        }
+        RequestInfo::CachedValue().experiment_id = experiment_id;
+    } else if (!revalidating) {
+        if (training_mode_params_.get())
+            RequestInfo::CachedValue().current_fidelity_parameters =
+                *training_mode_params_;
+        RequestInfo::CachedValue().experiment_id = experiment_id;
     }
-    RequestInfo::CachedValue().experiment_id = experiment_id;
     if (Debugging() && gamesdk::jni::IsValid()) {
         backend_->UploadDebugInfo(web_request);
     }
     return result;
 }
+
+TuningFork_ErrorCode TuningForkImpl::UseCachedFidelityParameters(
+    const CachedFidelityParams &cached) {
+    if (cached.Expired(time_provider_->SystemNow()))
+        return TUNINGFORK_ERROR_NO_FIDELITY_PARAMS;
+    RequestInfo::CachedValue().current_fidelity_parameters = cached.params;
+    RequestInfo::CachedValue().experiment_id = cached.experiment_id;
+    return TUNINGFORK_ERROR_OK;
+}
+
 TuningFork_ErrorCode TuningForkImpl::GetOrCreateInstrumentKeyIndex(
     InstrumentationKey key, int &index) {
     int nkeys = next_ikey_;
@@ -332,8 +457,7 @@ TuningFork_ErrorCode TuningForkImpl::StartTrace(InstrumentationKey key,
     if (Loading()) return TUNINGFORK_ERROR_OK;  // No recording when loading
 
     MetricId id{0};
-    auto err =
-        MakeCompoundId(key, current_annotation_id_.detail.annotation, id);
+    auto err = MakeCompoundId(key, CurrentAnnotationId(), id);
     if (err != TUNINGFORK_ERROR_OK) return err;
     handle = id.detail.annotation *
                  settings_.aggregation_strategy.max_instrumentation_keys +
@@ -363,37 +487,71 @@ TuningFork_ErrorCode TuningForkImpl::EndTrace(TraceHandle h) {
 
 TuningFork_ErrorCode TuningForkImpl::FrameTick(InstrumentationKey key) {
     if (Loading()) return TUNINGFORK_ERROR_OK;  // No recording when loading
-    MetricId id{0};
-    auto err =
-        MakeCompoundId(key, current_annotation_id_.detail.annotation, id);
-    if (err != TUNINGFORK_ERROR_OK) return err;
+    // Ticks skipped by sampling don't read the clock or touch the session.
+    auto action = frame_time_recorder_->SampleTick(key, CurrentAnnotationId());
+    if (action == FrameSampler::Action::SKIP && !before_first_tick_)
+        return TUNINGFORK_ERROR_OK;
     trace_->beginSection("TFTick");
     current_session_->Ping(time_provider_->SystemNow());
     auto t = time_provider_->Now();
-    MetricData *p;
-    err = TickNanos(id, t, &p);
-    if (err != TUNINGFORK_ERROR_OK) return err;
-    if (p) CheckForSubmit(t, p);
+    size_t count = 0;
+    auto err =
+        TickNanos(key, t, action == FrameSampler::Action::RECORD, &count);
+    if (err == TUNINGFORK_ERROR_OK) CheckForSubmit(t, count);
     trace_->endSection();
-    return TUNINGFORK_ERROR_OK;
+    return err;
 }
 
 TuningFork_ErrorCode TuningForkImpl::FrameDeltaTimeNanos(InstrumentationKey key,
                                                          Duration dt) {
     if (Loading()) return TUNINGFORK_ERROR_OK;  // No recording when loading
-    MetricId id{0};
-    auto err =
-        MakeCompoundId(key, current_annotation_id_.detail.annotation, id);
+    size_t count = 0;
+    auto err = DeltaNanos(key, dt, &count);
     if (err != TUNINGFORK_ERROR_OK) return err;
-    MetricData *p;
-    err = TraceNanos(id, dt, &p);
+    CheckForSubmit(time_provider_->Now(), count);
+    return TUNINGFORK_ERROR_OK;
+}
+
+TuningFork_ErrorCode TuningForkImpl::FrameDeltaTimeNanosBatch(
+    InstrumentationKey key, const uint64_t *dts_ns, size_t n) {
+    if (Loading()) return TUNINGFORK_ERROR_OK;  // No recording when loading
+    size_t count = 0;
+    auto err = frame_time_recorder_->RecordBatch(
+        key, CurrentAnnotationId(), dts_ns, n, !logging_paused_ /*record*/,
+        &count);
     if (err != TUNINGFORK_ERROR_OK) return err;
-    if (p) CheckForSubmit(time_provider_->Now(), p);
+    CheckForSubmit(time_provider_->Now(), count);
     return TUNINGFORK_ERROR_OK;
 }
 
-TuningFork_ErrorCode TuningForkImpl::TickNanos(MetricId compound_id,
-                                               TimePoint t, MetricData **pp) {
+TuningFork_ErrorCode TuningForkImpl::FrameDeltaTimeNanosMultiKeyBatch(
+    const InstrumentationKey *keys, const uint64_t *dts_ns, size_t n) {
+    if (Loading()) return TUNINGFORK_ERROR_OK;  // No recording when loading
+    auto annotation = CurrentAnnotationId();
+    TuningFork_ErrorCode ret = TUNINGFORK_ERROR_OK;
+    size_t max_count = 0;
+    // Record each run of samples with the same key in one go.
+    size_t start = 0;
+    while (start < n) {
+        size_t end = start + 1;
+        while (end < n && keys[end] == keys[start]) ++end;
+        size_t count = 0;
+        auto err = frame_time_recorder_->RecordBatch(
+            keys[start], annotation, dts_ns + start, end - start,
+            !logging_paused_ /*record*/, &count);
+        if (err == TUNINGFORK_ERROR_OK)
+            max_count = std::max(max_count, count);
+        else if (ret == TUNINGFORK_ERROR_OK)
+            ret = err;
+        start = end;
+    }
+    CheckForSubmit(time_provider_->Now(), max_count);
+    return ret;
+}
+
+TuningFork_ErrorCode TuningForkImpl::TickNanos(InstrumentationKey key,
+                                               TimePoint t, bool record,
+                                               size_t *pcount) {
     if (before_first_tick_) {
         before_first_tick_ = false;
         // Record the time to the first tick.
@@ -415,16 +573,19 @@ TuningFork_ErrorCode TuningForkImpl::TickNanos(MetricId compound_id,
     // Don't record while we have any loading events live
     if (Loading()) return TUNINGFORK_ERROR_OK;
 
-    // Find the appropriate histogram and add this time
-    auto p = current_session_->GetData<FrameTimeMetricData>(compound_id);
-    if (p) {
-        // Continue ticking even while logging is paused but don't record values
-        p->Tick(t, !logging_paused_ /*record*/);
-        if (pp != nullptr) *pp = p;
-        return TUNINGFORK_ERROR_OK;
-    } else {
-        return TUNINGFORK_ERROR_NO_MORE_SPACE_FOR_FRAME_TIME_DATA;
-    }
+    // Continue ticking even while logging is paused but don't record values.
+    // This thread's data is only added to the session when it is flushed.
+    return frame_time_recorder_->Tick(key, CurrentAnnotationId(), t,
+                                      record && !logging_paused_, pcount);
+}
+
+TuningFork_ErrorCode TuningForkImpl::DeltaNanos(InstrumentationKey key,
+                                                Duration dt, size_t *pcount) {
+    // Don't record while we have any loading events live
+    if (Loading()) return TUNINGFORK_ERROR_OK;
+
+    return frame_time_recorder_->Record(key, CurrentAnnotationId(), dt,
+                                        !logging_paused_ /*record*/, pcount);
 }
 
 TuningFork_ErrorCode TuningForkImpl::TraceNanos(MetricId compound_id,
@@ -449,22 +610,23 @@ void TuningForkImpl::SetUploadCallback(TuningFork_UploadCallback cbk) {
     upload_thread_.SetUploadCallback(cbk);
 }
 
-bool TuningForkImpl::ShouldSubmit(TimePoint t, MetricData *histogram) {
+bool TuningForkImpl::ShouldSubmit(TimePoint t, size_t count) {
     auto method = settings_.aggregation_strategy.method;
-    auto count = settings_.aggregation_strategy.intervalms_or_count;
+    auto interval = settings_.aggregation_strategy.intervalms_or_count;
     switch (settings_.aggregation_strategy.method) {
         case Settings::AggregationStrategy::Submission::TIME_BASED:
-            return (t - last_submit_time_) >= std::chrono::milliseconds(count);
+            return (t - last_submit_time_) >=
+                   std::chrono::milliseconds(interval);
         case Settings::AggregationStrategy::Submission::TICK_BASED:
-            if (histogram) return histogram->Count() >= count;
+            return count >= interval;
     }
     return false;
 }
 
 TuningFork_ErrorCode TuningForkImpl::CheckForSubmit(TimePoint t,
-                                                    MetricData *histogram) {
+                                                    size_t count) {
     TuningFork_ErrorCode ret_code = TUNINGFORK_ERROR_OK;
-    if (ShouldSubmit(t, histogram)) {
+    if (ShouldSubmit(t, count)) {
         ret_code = Flush(t, true);
     }
     return ret_code;
@@ -517,7 +679,11 @@ void TuningForkImpl::InitHistogramSettings() {
     // If there was an instrument key but no other settings, update the
     // histogram
     auto check_histogram = [](Settings::Histogram &h) {
-        if (h.bucket_max == 0 || h.n_buckets == 0) {
+        // Quantile sketches don't use buckets at all.
+        if (h.storage == Settings::Histogram::Storage::QUANTILE_SKETCH) return;
+        // Log-linear histograms don't use n_buckets.
+        bool log_linear = h.scale == Settings::Histogram::Scale::LOG_LINEAR;
+        if (h.bucket_max == 0 || (h.n_buckets == 0 && !log_linear)) {
             h = Settings::DefaultHistogram(h.instrument_key);
         }
     };
@@ -545,25 +711,20 @@ TuningFork_ErrorCode TuningForkImpl::Flush(bool upload) {
     return Flush(t, upload);
 }
 
-void TuningForkImpl::SwapSessions() {
-    if (current_session_ == sessions_[0].get()) {
-        sessions_[1]->ClearData();
-        current_session_ = sessions_[1].get();
-    } else {
-        sessions_[0]->ClearData();
-        current_session_ = sessions_[0].get();
-    }
+void TuningForkImpl::UpdateCurrentSession() {
+    current_session_ = sessions_->Current();
     async_telemetry_->SetSession(current_session_);
 }
 TuningFork_ErrorCode TuningForkImpl::Flush(TimePoint t, bool upload) {
     ALOGV("Flush %d", upload);
-    TuningFork_ErrorCode ret_code;
+    // Frame times are recorded per-thread and only added to the session here.
+    // If the session can't be submitted, they stay in it until the next flush.
+    frame_time_recorder_->MergeInto(*current_session_);
     current_session_->SetInstrumentationKeys(ikeys_);
-    if (upload_thread_.Submit(current_session_, upload)) {
-        SwapSessions();
-        ret_code = TUNINGFORK_ERROR_OK;
-    } else {
-        ret_code = TUNINGFORK_ERROR_PREVIOUS_UPLOAD_PENDING;
+    TuningFork_ErrorCode ret_code = sessions_->Submit(upload);
+    if (ret_code == TUNINGFORK_ERROR_OK) {
+        UpdateCurrentSession();
+        upload_thread_.NotifySubmitted();
     }
     if (upload) last_submit_time_ = t;
     return ret_code;
@@ -581,7 +742,9 @@ TuningFork_ErrorCode TuningForkImpl::SetFidelityParameters(
     auto flush_result = Flush(true);
     if (flush_result != TUNINGFORK_ERROR_OK) {
         ALOGW("Warning, previous data could not be flushed.");
-        SwapSessions();
+        // Discard the frame times recorded with the old parameters, too.
+        frame_time_recorder_->MergeInto(*current_session_);
+        current_session_->ClearData();
     }
     RequestInfo::CachedValue().current_fidelity_parameters = params;
     // We clear the experiment id here.
@@ -629,18 +792,47 @@ void TuningForkImpl::InitAsyncTelemetry() {
     async_telemetry_ = std::make_unique<AsyncTelemetry>(time_provider_);
     battery_reporting_task_ = std::make_shared<BatteryReportingTask>(
         &activity_lifecycle_state_, time_provider_, battery_provider_,
-        MetricId::Battery(0));
+        &current_annotation_id_);
     async_telemetry_->AddTask(battery_reporting_task_);
     thermal_reporting_task_ = std::make_shared<ThermalReportingTask>(
-        time_provider_, battery_provider_, MetricId::Thermal(0));
+        time_provider_, battery_provider_, &current_annotation_id_);
     async_telemetry_->AddTask(thermal_reporting_task_);
     memory_reporting_task_ = std::make_shared<MemoryReportingTask>(
-        time_provider_, meminfo_provider_, MetricId::Memory(0));
+        time_provider_, meminfo_provider_, &current_annotation_id_);
     async_telemetry_->AddTask(memory_reporting_task_);
     async_telemetry_->SetSession(current_session_);
     async_telemetry_->Start();
 }
 
+void TuningForkImpl::WriteCrashSnapshot() {
+    if (!crash_snapshot_.IsOpen()) return;
+    crash_snapshot_.Begin();
+    // The session is only given the instrument keys when it is flushed, so
+    // take them from ikeys_. next_ikey_ can briefly be past the end.
+    int nkeys = std::min<int>(next_ikey_, ikeys_.size());
+    auto add = [this, nkeys](const FrameTimeMetricData *d) {
+        if (d->Empty()) return;
+        auto ikey_index = d->metric_id_.detail.frame_time.ikey;
+        if (ikey_index >= nkeys) return;
+        const uint8_t *annotation;
+        size_t annotation_size;
+        if (!annotation_map_.View(d->metric_id_.detail.annotation, annotation,
+                                  annotation_size))
+            return;
+        crash_snapshot_.Add(annotation, annotation_size, ikeys_[ikey_index],
+                            *d);
+    };
+    // Ticks are still in the recorder; traces go straight to the session. If
+    // a flush was merging them into the session, possibly on this thread,
+    // neither can be read safely, so the snapshot is left empty.
+    auto merge_lock = frame_time_recorder_->TryLockMerges();
+    if (merge_lock.owns_lock()) {
+        frame_time_recorder_->ForEachLiveData(add);
+        current_session_->ForEachFrameTimeData(add);
+    }
+    crash_snapshot_.Commit();
+}
+
 TuningFork_ErrorCode TuningForkImpl::AnnotationIdToSerializedAnnotation(
     tuningfork::AnnotationId id, tuningfork::SerializedAnnotation &ser) {
     auto err = annotation_map_.Get(id, ser);
@@ -731,13 +923,15 @@ TuningFork_ErrorCode TuningForkImpl::StartRecordingLoadingTime(
 }
 
 TuningFork_ErrorCode TuningForkImpl::RecordLoadingTime(
-    LoadingHandle handle, ProcessTimeInterval interval) {
+    LoadingHandle handle, ProcessTimeInterval interval,
+    const LoadingBreakdown *breakdown) {
     MetricId metric_id;
     metric_id.base = handle;
     auto data = current_session_->GetData<LoadingTimeMetricData>(metric_id);
     if (data == nullptr)
         return TUNINGFORK_ERROR_NO_MORE_SPACE_FOR_LOADING_TIME_DATA;
     data->Record(interval);
+    if (breakdown != nullptr) data->breakdown_.Merge(*breakdown);
     return TUNINGFORK_ERROR_OK;
 }
 
@@ -787,6 +981,7 @@ TuningFork_ErrorCode TuningForkImpl::StartLoadingGroup(
     current_loading_group_ = new_loading_group;
     current_loading_group_metric_ = metric_id;
     current_loading_group_start_time_ = time_provider_->TimeSinceProcessStart();
+    loading_spans_.BeginGroup(current_loading_group_start_time_);
     return TUNINGFORK_ERROR_OK;
 }
 
@@ -803,10 +998,22 @@ TuningFork_ErrorCode TuningForkImpl::StopLoadingGroup(LoadingHandle handle) {
     }
     ProcessTimeInterval interval = {current_loading_group_start_time_,
                                     time_provider_->TimeSinceProcessStart()};
+    auto breakdown = loading_spans_.EndGroup(interval.End());
     current_loading_group_metric_.base = 0;
     current_loading_group_.clear();
     current_loading_group_start_time_ = {};
-    return RecordLoadingTime(handle, interval);
+    return RecordLoadingTime(handle, interval,
+                             breakdown.Empty() ? nullptr : &breakdown);
+}
+
+TuningFork_ErrorCode TuningForkImpl::StartLoadingSpan(
+    uint32_t source, LoadingSpanHandle parent, LoadingSpanHandle &handle) {
+    auto now = time_provider_->TimeSinceProcessStart();
+    return loading_spans_.Start(source, parent, now, handle);
+}
+
+TuningFork_ErrorCode TuningForkImpl::StopLoadingSpan(LoadingSpanHandle handle) {
+    return loading_spans_.Stop(handle, time_provider_->TimeSinceProcessStart());
 }
 
 std::vector<LifecycleLoadingEvent> TuningForkImpl::GetLiveLoadingEvents() {
@@ -866,4 +1073,51 @@ TuningFork_ErrorCode TuningForkImpl::SetAggregationStrategyInterval(
     return TUNINGFORK_ERROR_OK;
 }
 
+TuningFork_ErrorCode TuningForkImpl::GetUploadQueueStats(
+    TuningFork_UploadQueueStats &stats) {
+    stats = {};
+    if (upload_queue_) upload_queue_->GetStats(stats);
+    return TUNINGFORK_ERROR_OK;
+}
+
+TuningFork_ErrorCode TuningForkImpl::GetAsyncTelemetryStats(
+    AsyncTelemetry::Stats &stats) {
+    stats = {};
+    if (async_telemetry_) stats = async_telemetry_->GetStats();
+    return TUNINGFORK_ERROR_OK;
+}
+
+TuningFork_ErrorCode TuningForkImpl::GetRollupWindows(
+    uint32_t level, InstrumentationKey key,
+    std::vector<TuningFork_RollupWindow> &windows) {
+    windows.clear();
+    if (level >= RollupEngine::kNumLevels)
+        return TUNINGFORK_ERROR_BAD_PARAMETER;
+    if (!rollup_) return TUNINGFORK_ERROR_OK;
+    int nkeys = std::min<int>(next_ikey_, ikeys_.size());
+    for (const auto &window : rollup_->Windows(level)) {
+        TuningFork_RollupWindow stats = {};
+        stats.start_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                             window.start.time_since_epoch())
+                             .count();
+        stats.length_ms =
+            std::chrono::duration_cast<std::chrono::milliseconds>(
+                window.length)
+                .count();
+        for (const auto &frame_times : window.frame_times) {
+            int ikey_index = frame_times.first.detail.frame_time.ikey;
+            if (ikey_index >= nkeys || ikeys_[ikey_index] != key) continue;
+            const auto &d = frame_times.second;
+            stats.frames += d.FrameCount();
+            stats.frame_time_ns +=
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    d.duration_)
+                    .count();
+            stats.janky_frames += d.jank_.janky_frames_;
+        }
+        windows.push_back(stats);
+    }
+    return TUNINGFORK_ERROR_OK;
+}
+
 }  // namespace tuningfork
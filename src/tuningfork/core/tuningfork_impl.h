@@ -15,6 +15,7 @@
  */
 
 #include <atomic>
+#include <deque>
 #include <map>
 #include <memory>
 
@@ -25,10 +26,15 @@
 #include "battery_metric.h"
 #include "battery_reporting_task.h"
 #include "crash_handler.h"
+#include "crash_snapshot.h"
+#include "frametime_recorder.h"
+#include "loading_spans.h"
 #include "http_backend/http_backend.h"
 #include "meminfo_provider.h"
 #include "memory_telemetry.h"
+#include "rollup_engine.h"
 #include "session.h"
+#include "session_ring.h"
 #include "thermal_metric.h"
 #include "thermal_reporting_task.h"
 #include "time_provider.h"
@@ -41,17 +47,25 @@ namespace tuningfork {
 class TuningForkImpl : public IdProvider {
    private:
     CrashHandler crash_handler_;
+    // Written by the crash handler and recovered by the next run.
+    CrashSnapshot crash_snapshot_;
     Settings settings_;
-    std::unique_ptr<Session> sessions_[2];
+    std::unique_ptr<SessionRing> sessions_;
     Session *current_session_ = nullptr;
+    // Only set if rollups are enabled, and the session only if rollups are
+    // uploaded rather than each session.
+    std::unique_ptr<RollupEngine> rollup_;
+    std::unique_ptr<Session> rollup_session_;
+    std::unique_ptr<FrameTimeRecorder> frame_time_recorder_;
     TimePoint last_submit_time_ = TimePoint::min();
     std::unique_ptr<gamesdk::Trace> trace_;
     std::vector<TimePoint> live_traces_;
     IBackend *backend_;
     UploadThread upload_thread_;
-    SerializedAnnotation current_annotation_;
     std::vector<uint32_t> annotation_radix_mult_;
-    MetricId current_annotation_id_;
+    // Read by the tick functions and by the battery, thermal and memory
+    // reporting tasks.
+    std::atomic<AnnotationId> current_annotation_id_;
     ITimeProvider *time_provider_ = nullptr;
     IMemInfoProvider *meminfo_provider_ = nullptr;
     IBatteryProvider *battery_provider_ = nullptr;
@@ -76,6 +90,9 @@ class TuningForkImpl : public IdProvider {
 
     std::unique_ptr<ITimeProvider> default_time_provider_;
     std::unique_ptr<HttpBackend> default_backend_;
+    // Sessions waiting to be uploaded by the default backend, and sessions
+    // saved while logging was paused.
+    std::shared_ptr<UploadQueue> upload_queue_;
     std::unique_ptr<IMemInfoProvider> default_meminfo_provider_;
     std::unique_ptr<IBatteryProvider> default_battery_provider_;
 
@@ -87,13 +104,25 @@ class TuningForkImpl : public IdProvider {
     std::string current_loading_group_;
     MetricId current_loading_group_metric_;
     Duration current_loading_group_start_time_ = Duration::zero();
+    LoadingSpans loading_spans_;
 
-    // Caching of ATrace markers
+    // ATrace section names, made when annotations are registered, so that
+    // setting an annotation by id doesn't lock or allocate. They are found by
+    // id in chunks that are never moved, as in AnnotationMap.
 #if __ANDROID_API__ >= 29
-    bool trace_started_ = false;
-    std::mutex trace_marker_cache_mutex_;
-    std::map<AnnotationId, std::string> trace_marker_cache_;
-    AnnotationId last_id_;
+    static constexpr size_t kTraceMarkersPerChunk = 4096;
+    static constexpr size_t kMaxTraceMarkerChunks =
+        AnnotationMap::kMaxAnnotations / kTraceMarkersPerChunk;
+    // Set when the first section is begun. The section to end is the one for
+    // the annotation being replaced, so no other state is needed.
+    std::atomic<bool> trace_started_{false};
+    std::unique_ptr<std::atomic<std::atomic<const char *> *>[]>
+        trace_marker_chunks_;
+    // Everything below is only accessed with trace_marker_mutex_ held.
+    std::mutex trace_marker_mutex_;
+    std::vector<std::unique_ptr<std::atomic<const char *>[]>>
+        trace_marker_storage_;
+    std::deque<std::string> trace_marker_names_;
 #endif
 
    public:
@@ -117,16 +146,35 @@ class TuningForkImpl : public IdProvider {
     // Returns true if the fidelity params were retrieved
     TuningFork_ErrorCode GetFidelityParameters(
         const ProtobufSerialization &defaultParams,
-        ProtobufSerialization &fidelityParams, uint32_t timeout_ms);
+        ProtobufSerialization &fidelityParams, uint32_t timeout_ms,
+        CachedFidelityParams *cached = nullptr);
+
+    TuningFork_ErrorCode UseCachedFidelityParameters(
+        const CachedFidelityParams &cached);
 
     // Returns the set annotation id or -1 if it could not be set
     MetricId SetCurrentAnnotation(const ProtobufSerialization &annotation);
 
+    // Get an id for the annotation that can be passed to
+    // SetCurrentAnnotationById.
+    TuningFork_ErrorCode RegisterAnnotation(
+        const ProtobufSerialization &annotation, AnnotationId &id);
+
+    // Switch to a registered annotation without hashing or allocating.
+    TuningFork_ErrorCode SetCurrentAnnotationById(AnnotationId id);
+
     TuningFork_ErrorCode FrameTick(InstrumentationKey id);
 
     TuningFork_ErrorCode FrameDeltaTimeNanos(InstrumentationKey id,
                                              Duration dt);
 
+    TuningFork_ErrorCode FrameDeltaTimeNanosBatch(InstrumentationKey id,
+                                                  const uint64_t *dts_ns,
+                                                  size_t n);
+
+    TuningFork_ErrorCode FrameDeltaTimeNanosMultiKeyBatch(
+        const InstrumentationKey *ids, const uint64_t *dts_ns, size_t n);
+
     // Fills handle with that to be used by EndTrace
     TuningFork_ErrorCode StartTrace(InstrumentationKey key,
                                     TraceHandle &handle);
@@ -168,6 +216,12 @@ class TuningForkImpl : public IdProvider {
 
     TuningFork_ErrorCode StopLoadingGroup(LoadingHandle handle);
 
+    TuningFork_ErrorCode StartLoadingSpan(uint32_t source,
+                                          LoadingSpanHandle parent,
+                                          LoadingSpanHandle &handle);
+
+    TuningFork_ErrorCode StopLoadingSpan(LoadingSpanHandle handle);
+
     TuningFork_ErrorCode ReportLifecycleEvent(TuningFork_LifecycleState state);
 
     TuningFork_ErrorCode InitializationErrorCode() {
@@ -177,12 +231,28 @@ class TuningForkImpl : public IdProvider {
     TuningFork_ErrorCode SetAggregationStrategyInterval(
         TuningFork_Submission method, uint32_t interval_ms_or_count);
 
+    TuningFork_ErrorCode GetUploadQueueStats(
+        TuningFork_UploadQueueStats &stats);
+
+    TuningFork_ErrorCode GetRollupWindows(
+        uint32_t level, InstrumentationKey key,
+        std::vector<TuningFork_RollupWindow> &windows);
+
+    TuningFork_ErrorCode GetAsyncTelemetryStats(AsyncTelemetry::Stats &stats);
+
    private:
-    // Record the time between t and the previous tick in the histogram
-    // associated with compound_id. Return the MetricData associated with
-    // compound_id in *ppdata if ppdata is non-null and there is no error.
-    TuningFork_ErrorCode TickNanos(MetricId compound_id, TimePoint t,
-                                   MetricData **ppdata);
+    // Record the time between t and the previous tick for key and the
+    // current annotation, if record is true. Return the number of frame times
+    // recorded for them in *pcount if pcount is non-null and there is no
+    // error.
+    TuningFork_ErrorCode TickNanos(InstrumentationKey key, TimePoint t,
+                                   bool record, size_t *pcount);
+
+    // Record dt for key and the current annotation.
+    // Return the number of frame times recorded for them in *pcount if
+    // pcount is non-null and there is no error.
+    TuningFork_ErrorCode DeltaNanos(InstrumentationKey key, Duration dt,
+                                    size_t *pcount);
 
     // Record dt in the histogram associated with compound_id.
     // Return the MetricData associated with compound_id in *ppdata if
@@ -190,9 +260,9 @@ class TuningForkImpl : public IdProvider {
     TuningFork_ErrorCode TraceNanos(MetricId compound_id, Duration dt,
                                     MetricData **ppdata);
 
-    TuningFork_ErrorCode CheckForSubmit(TimePoint t, MetricData *metric_data);
+    TuningFork_ErrorCode CheckForSubmit(TimePoint t, size_t count);
 
-    bool ShouldSubmit(TimePoint t, MetricData *metric_data);
+    bool ShouldSubmit(TimePoint t, size_t count);
 
     TuningFork_ErrorCode SerializedAnnotationToAnnotationId(
         const SerializedAnnotation &ser, AnnotationId &id) override;
@@ -220,12 +290,29 @@ class TuningForkImpl : public IdProvider {
 
     bool Loading() const { return live_loading_events_.size() > 0; }
 
-    void SwapSessions();
+    void UpdateCurrentSession();
+
+    AnnotationId CurrentAnnotationId() const {
+        return current_annotation_id_.load(std::memory_order_relaxed);
+    }
+
+#if __ANDROID_API__ >= 29
+    // Make the ATrace section name for an annotation, if not already made.
+    void MakeTraceMarker(AnnotationId id);
+
+    // Get the ATrace section name for an annotation, or a generic one if it
+    // wasn't made.
+    const char *TraceMarker(AnnotationId id) const;
+#endif
 
     bool Debugging() const;
 
     void InitAsyncTelemetry();
 
+    // Write the frame times recorded since the last flush to crash_snapshot_.
+    // This is called from the crash handler, so it mustn't allocate or lock.
+    void WriteCrashSnapshot();
+
     void CreateSessionFrameHistograms(
         Session &session, size_t size, int max_num_instrumentation_keys,
         const std::vector<Settings::Histogram> &histogram_settings,
@@ -233,8 +320,9 @@ class TuningForkImpl : public IdProvider {
 
     std::vector<LifecycleLoadingEvent> GetLiveLoadingEvents();
 
-    TuningFork_ErrorCode RecordLoadingTime(LoadingHandle handle,
-                                           ProcessTimeInterval interval);
+    TuningFork_ErrorCode RecordLoadingTime(
+        LoadingHandle handle, ProcessTimeInterval interval,
+        const LoadingBreakdown *breakdown = nullptr);
 };
 
 }  // namespace tuningfork
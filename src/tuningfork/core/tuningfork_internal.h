@@ -16,9 +16,11 @@
 
 #pragma once
 
+#include "core/async_telemetry.h"
 #include "core/backend.h"
 #include "core/battery_provider.h"
 #include "core/common.h"
+#include "core/fidelity_params_cache.h"
 #include "core/id_provider.h"
 #include "core/meminfo_provider.h"
 #include "core/request_info.h"
@@ -65,10 +67,35 @@ TuningFork_ErrorCode GetFidelityParameters(
     const ProtobufSerialization& default_params, ProtobufSerialization& params,
     uint32_t timeout_ms);
 
+// As GetFidelityParameters, but conditional on the version of the cached
+// params. If the server's params haven't changed, params are set to the
+// cached ones and TUNINGFORK_ERROR_FIDELITY_PARAMS_NOT_MODIFIED is returned.
+// Either way, cached is updated with the params in use and their expiry. If
+// the request fails while unexpired cached params are in use, the request
+// info keeps them.
+TuningFork_ErrorCode GetFidelityParameters(
+    const ProtobufSerialization& default_params, ProtobufSerialization& params,
+    uint32_t timeout_ms, CachedFidelityParams& cached);
+
+// Use cached params without asking the server, if they haven't expired.
+// Returns TUNINGFORK_ERROR_NO_FIDELITY_PARAMS if they have.
+TuningFork_ErrorCode UseCachedFidelityParameters(
+    const CachedFidelityParams& cached);
+
 // Protobuf serialization of the current annotation
 TuningFork_ErrorCode SetCurrentAnnotation(
     const ProtobufSerialization& annotation);
 
+// Get an id for an annotation that can be passed to SetCurrentAnnotationById
+TuningFork_ErrorCode RegisterAnnotation(const ProtobufSerialization& annotation,
+                                        AnnotationId& id);
+
+// Set the current annotation to a registered one
+TuningFork_ErrorCode SetCurrentAnnotationById(AnnotationId id);
+
+// Set the swap interval that jank is measured against
+TuningFork_ErrorCode SetSwapIntervalNanos(uint64_t swap_interval_ns);
+
 // Record a frame tick that will be associated with the instrumentation key and
 // the current
 //   annotation
@@ -77,6 +104,14 @@ TuningFork_ErrorCode FrameTick(InstrumentationKey id);
 // Record a frame tick using an external time, rather than system time
 TuningFork_ErrorCode FrameDeltaTimeNanos(InstrumentationKey id, Duration dt);
 
+// Record n external times, in nanoseconds, for the same key
+TuningFork_ErrorCode FrameDeltaTimeNanosBatch(InstrumentationKey id,
+                                              const uint64_t* dts_ns, size_t n);
+
+// Record n external times, in nanoseconds, each with its own key
+TuningFork_ErrorCode FrameDeltaTimeNanosMultiKeyBatch(
+    const InstrumentationKey* ids, const uint64_t* dts_ns, size_t n);
+
 // Start a trace segment
 TuningFork_ErrorCode StartTrace(InstrumentationKey key, TraceHandle& handle);
 
@@ -135,6 +170,14 @@ TuningFork_ErrorCode StartLoadingGroup(const LoadingTimeMetadata* metadata,
 // handle should be null in current implementation.
 TuningFork_ErrorCode StopLoadingGroup(LoadingHandle handle);
 
+// Start a span of work in the current loading group, nested in parent or, if
+// parent is 0, in the group. source is a LoadingSource.
+TuningFork_ErrorCode StartLoadingSpan(uint32_t source, LoadingSpanHandle parent,
+                                      LoadingSpanHandle& handle);
+
+// Stop a span started with StartLoadingSpan.
+TuningFork_ErrorCode StopLoadingSpan(LoadingSpanHandle handle);
+
 TuningFork_ErrorCode ReportLifecycleEvent(TuningFork_LifecycleState state);
 
 // Check if we have recorded a file in the app's cache dir yet.
@@ -145,4 +188,16 @@ std::string DefaultTuningForkSaveDirectory();
 TuningFork_ErrorCode SetAggregationStrategyInterval(
     TuningFork_Submission method, uint32_t interval_ms_or_count);
 
+TuningFork_ErrorCode GetUploadQueueStats(TuningFork_UploadQueueStats& stats);
+
+// Get the frame statistics for key in each rollup window kept at a level,
+// oldest first.
+TuningFork_ErrorCode GetRollupWindows(
+    uint32_t level, InstrumentationKey key,
+    std::vector<TuningFork_RollupWindow>& windows);
+
+// Get the timer wheel statistics of the async telemetry thread, all zero if
+// it isn't running.
+TuningFork_ErrorCode GetAsyncTelemetryStats(AsyncTelemetry::Stats& stats);
+
 }  // namespace tuningfork
@@ -27,15 +27,19 @@
 #include "Log.h"
 #include "annotation_util.h"
 #include "file_cache.h"
+#include "mapped_file_cache.h"
 #include "nano/tuningfork.pb.h"
 #include "pb_decode.h"
 #include "proto/protobuf_nano_util.h"
 #include "protobuf_util_internal.h"
+#include "session_ring.h"
+#include "upload_queue.h"
 using PBSettings = com_google_tuningfork_Settings;
 
 namespace tuningfork {
 
 static FileCache sFileCache;
+static MappedFileCache sMappedFileCache;
 
 constexpr char kPerformanceParametersBaseUri[] =
     "https://performanceparameters.googleapis.com/v1/";
@@ -44,19 +48,26 @@ constexpr uint64_t kDefaultFrameTimeAnnotationCombinationLimit = 64;
 
 // Use the default persister if the one passed in is null
 static void CheckPersister(const TuningFork_Cache*& persister,
-                           std::string save_dir) {
+                           std::string save_dir,
+                           Settings::LocalCache local_cache) {
     if (persister == nullptr) {
         if (save_dir.empty()) {
             save_dir = DefaultTuningForkSaveDirectory();
         }
-        ALOGI("Using local file cache at %s", save_dir.c_str());
-        sFileCache.SetDir(save_dir);
-        persister = sFileCache.GetCCache();
+        if (local_cache == Settings::LocalCache::MAPPED_LOG) {
+            ALOGI("Using mapped file cache at %s", save_dir.c_str());
+            sMappedFileCache.SetDir(save_dir);
+            persister = sMappedFileCache.GetCCache();
+        } else {
+            ALOGI("Using local file cache at %s", save_dir.c_str());
+            sFileCache.SetDir(save_dir);
+            persister = sFileCache.GetCCache();
+        }
     }
 }
 
 void Settings::Check(const std::string& save_dir) {
-    CheckPersister(c_settings.persistent_cache, save_dir);
+    CheckPersister(c_settings.persistent_cache, save_dir, local_cache);
     if (base_uri.empty()) base_uri = kPerformanceParametersBaseUri;
     if (base_uri.back() != '/') base_uri += '/';
     if (aggregation_strategy.intervalms_or_count == 0) {
@@ -72,6 +83,16 @@ void Settings::Check(const std::string& save_dir) {
     }
     if (initial_request_timeout_ms == 0) initial_request_timeout_ms = 1000;
     if (ultimate_request_timeout_ms == 0) ultimate_request_timeout_ms = 100000;
+    if (upload_compression_threshold_bytes == 0)
+        upload_compression_threshold_bytes = 1024;
+    if (max_upload_queue_bytes == 0)
+        max_upload_queue_bytes = UploadQueue::kDefaultMaxBytes;
+    if (session_slots < SessionRing::kMinSlots)
+        session_slots = SessionRing::kMinSlots;
+    if (session_slots > SessionRing::kMaxSlots) {
+        ALOGW("session_slots is limited to %zu", SessionRing::kMaxSlots);
+        session_slots = SessionRing::kMaxSlots;
+    }
 
     if (c_settings.max_num_metrics.frame_time == 0) {
         auto num_annotation_combinations = NumAnnotationCombinations();
@@ -127,8 +148,23 @@ static bool decodeHistograms(pb_istream_t* stream, const pb_field_t* field,
     com_google_tuningfork_Settings_Histogram hist;
     if (pb_decode(stream, com_google_tuningfork_Settings_Histogram_fields,
                   &hist)) {
-        settings->histograms.push_back({hist.instrument_key, hist.bucket_min,
-                                        hist.bucket_max, hist.n_buckets});
+        Settings::Histogram h{hist.instrument_key, hist.bucket_min,
+                              hist.bucket_max, hist.n_buckets};
+        if (hist.scale ==
+            com_google_tuningfork_Settings_Histogram_Scale_LOG_LINEAR)
+            h.scale = Settings::Histogram::Scale::LOG_LINEAR;
+        h.sub_bucket_bits = hist.sub_bucket_bits;
+        if (hist.storage ==
+            com_google_tuningfork_Settings_Histogram_Storage_QUANTILE_SKETCH)
+            h.storage = Settings::Histogram::Storage::QUANTILE_SKETCH;
+        if (hist.sampling ==
+            com_google_tuningfork_Settings_Histogram_Sampling_EVERY_NTH)
+            h.sampling = Settings::Histogram::Sampling::EVERY_NTH;
+        else if (hist.sampling ==
+                 com_google_tuningfork_Settings_Histogram_Sampling_RANDOM)
+            h.sampling = Settings::Histogram::Sampling::RANDOM;
+        h.sample_period = hist.sample_period > 0 ? hist.sample_period : 0;
+        settings->histograms.push_back(h);
         return true;
     } else {
         return false;
@@ -171,6 +207,33 @@ static bool decodeHistograms(pb_istream_t* stream, const pb_field_t* field,
         pbsettings.initial_request_timeout_ms;
     settings->ultimate_request_timeout_ms =
         pbsettings.ultimate_request_timeout_ms;
+    if (pbsettings.telemetry_encoding ==
+        com_google_tuningfork_Settings_TelemetryEncoding_BINARY)
+        settings->telemetry_encoding = Settings::TelemetryEncoding::BINARY;
+    settings->upload_compression_threshold_bytes =
+        pbsettings.upload_compression_threshold_bytes;
+    settings->max_upload_queue_bytes =
+        std::max(pbsettings.max_upload_queue_bytes, 0);
+    if (pbsettings.local_cache ==
+        com_google_tuningfork_Settings_LocalCache_MAPPED_LOG)
+        settings->local_cache = Settings::LocalCache::MAPPED_LOG;
+    settings->session_slots = std::max(pbsettings.session_slots, 0);
+    if (pbsettings.session_backpressure ==
+        com_google_tuningfork_Settings_SessionBackpressure_DROP_OLDEST)
+        settings->session_backpressure =
+            Settings::SessionBackpressure::DROP_OLDEST;
+    else if (pbsettings.session_backpressure ==
+             com_google_tuningfork_Settings_SessionBackpressure_BLOCK)
+        settings->session_backpressure = Settings::SessionBackpressure::BLOCK;
+    settings->rollup_slot_ms = std::max(pbsettings.rollup_slot_ms, 0);
+    if (pbsettings.rollup_upload_level ==
+        com_google_tuningfork_Settings_RollupUploadLevel_TEN_SLOTS)
+        settings->rollup_upload_level =
+            Settings::RollupUploadLevel::TEN_SLOTS;
+    else if (pbsettings.rollup_upload_level ==
+             com_google_tuningfork_Settings_RollupUploadLevel_SIXTY_SLOTS)
+        settings->rollup_upload_level =
+            Settings::RollupUploadLevel::SIXTY_SLOTS;
     // Convert from 1-based to 0 based indices (-1 = not present)
     settings->loading_annotation_index =
         pbsettings.loading_annotation_index - 1;
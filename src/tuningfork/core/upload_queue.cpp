@@ -0,0 +1,295 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "upload_queue.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <set>
+
+#include "backend.h"
+#include "proto/protobuf_util.h"
+
+#define LOG_TAG "TuningFork"
+#include "Log.h"
+
+namespace tuningfork {
+
+constexpr uint32_t UploadQueue::kDefaultMaxBytes;
+constexpr size_t UploadQueue::kMaxSessions;
+
+namespace {
+
+// Entries are: crc32 of the rest, sequence number, payload.
+// The index is: crc32 of the rest, next sequence number, dropped sessions,
+// number of sessions, then the sequence number and size of each session, with
+// the top bit of the size set if the session is held.
+constexpr size_t kCrcSize = 4;
+constexpr size_t kEntryHeaderSize = kCrcSize + 8;
+constexpr size_t kIndexHeaderSize = kCrcSize + 8 + 8 + 4;
+constexpr size_t kIndexItemSize = 8 + 4;
+constexpr uint32_t kHeldBit = 0x80000000;
+
+void PutLE(std::string& s, uint64_t x, int n) {
+    for (int i = 0; i < n; ++i) s.push_back(static_cast<char>(x >> (8 * i)));
+}
+
+uint64_t GetLE(const std::string& s, size_t pos, int n) {
+    uint64_t x = 0;
+    for (int i = 0; i < n; ++i) x |= uint64_t(uint8_t(s[pos + i])) << (8 * i);
+    return x;
+}
+
+uint32_t Crc(const std::string& s, size_t pos) {
+    return crc32(0, reinterpret_cast<const Bytef*>(s.data() + pos),
+                 s.size() - pos);
+}
+
+// Prepend the checksum of s.
+std::string WithCrc(const std::string& s) {
+    std::string out;
+    PutLE(out, crc32(0, reinterpret_cast<const Bytef*>(s.data()), s.size()),
+          kCrcSize);
+    return out + s;
+}
+
+bool CheckCrc(const std::string& s) {
+    return s.size() >= kCrcSize && GetLE(s, 0, kCrcSize) == Crc(s, kCrcSize);
+}
+
+uint64_t EntryKey(uint64_t seq) { return UPLOAD_QUEUE_FIRST_ENTRY + seq; }
+
+TuningFork_ErrorCode Set(const TuningFork_Cache* persister, uint64_t key,
+                         const std::string& value) {
+    TuningFork_CProtobufSerialization cser;
+    ToCProtobufSerialization(value, cser);
+    auto ret = persister->set(key, &cser, persister->user_data);
+    TuningFork_CProtobufSerialization_free(&cser);
+    return ret;
+}
+
+bool Get(const TuningFork_Cache* persister, uint64_t key, std::string& value) {
+    TuningFork_CProtobufSerialization cser;
+    if (persister->get(key, &cser, persister->user_data) !=
+        TUNINGFORK_ERROR_OK)
+        return false;
+    value = ToString(cser);
+    TuningFork_CProtobufSerialization_free(&cser);
+    return true;
+}
+
+}  // anonymous namespace
+
+UploadQueue::UploadQueue(const TuningFork_Cache* persister, uint32_t max_bytes)
+    : persister_(persister),
+      max_bytes_(std::min(max_bytes == 0 ? kDefaultMaxBytes : max_bytes,
+                          kHeldBit - 1)) {}
+
+void UploadQueue::Load() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string index;
+    if (Get(persister_, UPLOAD_QUEUE_INDEX, index)) {
+        size_t n = index.size() < kIndexHeaderSize
+                       ? 0
+                       : GetLE(index, kCrcSize + 16, 4);
+        if (index.size() < kIndexHeaderSize || !CheckCrc(index) ||
+            index.size() != kIndexHeaderSize + kIndexItemSize * n) {
+            ALOGW("Upload queue index is corrupt: starting a new queue");
+        } else {
+            next_seq_ = GetLE(index, kCrcSize, 8);
+            dropped_sessions_ = GetLE(index, kCrcSize + 8, 8);
+            for (size_t i = 0; i < n; ++i) {
+                size_t pos = kIndexHeaderSize + kIndexItemSize * i;
+                uint64_t seq = GetLE(index, pos, 8);
+                uint32_t size = GetLE(index, pos + 8, 4);
+                bool held = (size & kHeldBit) != 0;
+                size &= ~kHeldBit;
+                queued_.push_back({seq, size, held});
+                queued_bytes_ += size;
+            }
+            ALOGI("Loaded upload queue with %zu sessions (%" PRIu64 " bytes)",
+                  queued_.size(), queued_bytes_);
+        }
+    }
+    // Earlier versions kept a single pending upload and a single paused
+    // session.
+    std::string legacy;
+    if (Get(persister_, HISTOGRAMS_UPLOADING, legacy)) {
+        PushLocked(legacy, false, false);
+        persister_->remove(HISTOGRAMS_UPLOADING, persister_->user_data);
+    }
+    if (Get(persister_, HISTOGRAMS_PAUSED, legacy)) {
+        PushLocked(legacy, true, false);
+        persister_->remove(HISTOGRAMS_PAUSED, persister_->user_data);
+    }
+}
+
+TuningFork_ErrorCode UploadQueue::SaveLocked() {
+    std::string index;
+    PutLE(index, next_seq_, 8);
+    PutLE(index, dropped_sessions_, 8);
+    PutLE(index, queued_.size(), 4);
+    for (auto& q : queued_) {
+        PutLE(index, q.seq, 8);
+        PutLE(index, q.size | (q.held ? kHeldBit : 0), 4);
+    }
+    auto ret = Set(persister_, UPLOAD_QUEUE_INDEX, WithCrc(index));
+    for (auto seq : removed_)
+        persister_->remove(EntryKey(seq), persister_->user_data);
+    removed_.clear();
+    return ret;
+}
+
+template <typename Pred>
+size_t UploadQueue::RemoveLocked(Pred pred, bool dropped) {
+    size_t n = 0;
+    for (auto it = queued_.begin(); it != queued_.end();) {
+        if (pred(*it)) {
+            removed_.push_back(it->seq);
+            queued_bytes_ -= it->size;
+            it = queued_.erase(it);
+            ++n;
+        } else {
+            ++it;
+        }
+    }
+    if (dropped) dropped_sessions_ += n;
+    return n;
+}
+
+TuningFork_ErrorCode UploadQueue::Push(const std::string& evt_ser, bool held) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return PushLocked(evt_ser, held, false);
+}
+
+TuningFork_ErrorCode UploadQueue::ReplaceHeld(const std::string& evt_ser) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return PushLocked(evt_ser, true, true);
+}
+
+TuningFork_ErrorCode UploadQueue::PushLocked(const std::string& evt_ser,
+                                             bool held, bool replace_held) {
+    if (evt_ser.size() > max_bytes_) {
+        ALOGW("Session of %zu bytes is over the upload queue budget",
+              evt_ser.size());
+        ++dropped_sessions_;
+        SaveLocked();
+        return TUNINGFORK_ERROR_BAD_PARAMETER;
+    }
+    // Write the entry before the index refers to it.
+    uint64_t seq = next_seq_;
+    std::string entry;
+    PutLE(entry, seq, 8);
+    entry += evt_ser;
+    auto ret = Set(persister_, EntryKey(seq), WithCrc(entry));
+    if (ret != TUNINGFORK_ERROR_OK) return ret;
+    ++next_seq_;
+    if (replace_held)
+        RemoveLocked([](const Queued& q) { return q.held; }, false);
+    size_t evict = 0;
+    uint64_t bytes = queued_bytes_ + evt_ser.size();
+    while (evict < queued_.size() &&
+           (bytes > max_bytes_ || queued_.size() - evict >= kMaxSessions)) {
+        bytes -= queued_[evict].size;
+        ++evict;
+    }
+    if (evict > 0) {
+        ALOGI("Evicting %zu sessions from the upload queue", evict);
+        uint64_t keep = evict < queued_.size() ? queued_[evict].seq : seq;
+        RemoveLocked([keep](const Queued& q) { return q.seq < keep; }, true);
+    }
+    queued_.push_back({seq, static_cast<uint32_t>(evt_ser.size()), held});
+    queued_bytes_ += evt_ser.size();
+    return SaveLocked();
+}
+
+bool UploadQueue::ReadEntry(uint64_t seq, std::string& evt_ser) {
+    std::string entry;
+    if (!Get(persister_, EntryKey(seq), entry)) return false;
+    if (entry.size() < kEntryHeaderSize || !CheckCrc(entry) ||
+        GetLE(entry, kCrcSize, 8) != seq)
+        return false;
+    evt_ser = entry.substr(kEntryHeaderSize);
+    return true;
+}
+
+void UploadQueue::Front(size_t max_n, std::vector<Entry>& entries) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries.clear();
+    std::set<uint64_t> unreadable;
+    for (auto& q : queued_) {
+        if (entries.size() >= max_n) break;
+        if (q.held) continue;
+        std::string evt_ser;
+        if (ReadEntry(q.seq, evt_ser))
+            entries.push_back({q.seq, std::move(evt_ser)});
+        else
+            unreadable.insert(q.seq);
+    }
+    if (unreadable.empty()) return;
+    ALOGW("Dropping %zu unreadable sessions from the upload queue",
+          unreadable.size());
+    RemoveLocked(
+        [&unreadable](const Queued& q) { return unreadable.count(q.seq) > 0; },
+        true);
+    SaveLocked();
+}
+
+void UploadQueue::Pop(uint64_t seq, bool dropped) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Sessions evicted since Front are no longer in the queue.
+    if (RemoveLocked(
+            [seq](const Queued& q) { return !q.held && q.seq <= seq; },
+            dropped) > 0)
+        SaveLocked();
+}
+
+void UploadQueue::TakeHeld(std::vector<std::string>& sessions) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sessions.clear();
+    std::set<uint64_t> unreadable;
+    for (auto& q : queued_) {
+        if (!q.held) continue;
+        std::string evt_ser;
+        if (ReadEntry(q.seq, evt_ser))
+            sessions.push_back(std::move(evt_ser));
+        else
+            unreadable.insert(q.seq);
+    }
+    RemoveLocked(
+        [&unreadable](const Queued& q) { return unreadable.count(q.seq) > 0; },
+        true);
+    if (RemoveLocked([](const Queued& q) { return q.held; }, false) > 0 ||
+        !unreadable.empty())
+        SaveLocked();
+}
+
+void UploadQueue::RemoveHeld() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (RemoveLocked([](const Queued& q) { return q.held; }, false) > 0)
+        SaveLocked();
+}
+
+void UploadQueue::GetStats(TuningFork_UploadQueueStats& stats) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats.queued_sessions = queued_.size();
+    stats.queued_bytes = queued_bytes_;
+    stats.dropped_sessions = dropped_sessions_;
+}
+
+}  // namespace tuningfork
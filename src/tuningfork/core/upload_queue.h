@@ -0,0 +1,118 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "tuningfork/tuningfork.h"
+
+namespace tuningfork {
+
+// A bounded queue of serialized sessions waiting to be uploaded, kept in a
+// persister so that it survives the app being killed.
+//
+// Each session is written under its own key with a checksum, and only after
+// that is the index, which lists the queued sessions, updated. A crash
+// therefore leaves either the old or the new queue. Sessions that are missing
+// or fail their checksum when read back are dropped.
+//
+// Sessions saved while logging is paused are held: they aren't uploaded, but
+// are kept until the next run takes them to merge into its first session.
+//
+// When the queue would exceed its byte budget or kMaxSessions, the oldest
+// sessions are evicted and counted as dropped.
+class UploadQueue {
+   public:
+    static constexpr uint32_t kDefaultMaxBytes = 1024 * 1024;
+    static constexpr size_t kMaxSessions = 256;
+
+    UploadQueue(const TuningFork_Cache* persister, uint32_t max_bytes);
+
+    UploadQueue(const UploadQueue&) = delete;
+    UploadQueue& operator=(const UploadQueue&) = delete;
+
+    // Read the queue left by a previous run, if any. The single pending and
+    // paused sessions kept by earlier versions are moved into the queue.
+    void Load();
+
+    // Append a session, evicting the oldest ones if needed to stay within the
+    // budget. A single session larger than the budget is dropped. Held
+    // sessions aren't returned by Front.
+    TuningFork_ErrorCode Push(const std::string& evt_ser, bool held = false);
+
+    // Hold a session in place of the held ones, e.g. because it includes them.
+    TuningFork_ErrorCode ReplaceHeld(const std::string& evt_ser);
+
+    struct Entry {
+        // Sequence number, which stays the same however many sessions are
+        // evicted before it.
+        uint64_t seq;
+        std::string evt_ser;
+    };
+
+    // Get up to max_n of the oldest sessions that aren't held, oldest first.
+    // Sessions that can't be read back are dropped.
+    void Front(size_t max_n, std::vector<Entry>& entries);
+
+    // Remove the session with sequence number seq and any older ones that
+    // aren't held, e.g. once it has been uploaded. Nothing newer is removed, so
+    // this is safe even if sessions were evicted since Front. If dropped is
+    // true, the removed sessions count towards the dropped sessions.
+    void Pop(uint64_t seq, bool dropped = false);
+
+    // Remove the held sessions, returning them oldest first.
+    void TakeHeld(std::vector<std::string>& sessions);
+
+    // Remove the held sessions, e.g. once what they held has been uploaded.
+    void RemoveHeld();
+
+    void GetStats(TuningFork_UploadQueueStats& stats) const;
+
+   private:
+    struct Queued {
+        uint64_t seq;
+        uint32_t size;
+        bool held;
+    };
+
+    TuningFork_ErrorCode PushLocked(const std::string& evt_ser, bool held,
+                                    bool replace_held);
+    // Take the sessions that match pred out of the queue. They are deleted from
+    // the persister by SaveLocked, once the index no longer refers to them.
+    template <typename Pred>
+    size_t RemoveLocked(Pred pred, bool dropped);
+    // Write the index, then delete the removed sessions.
+    TuningFork_ErrorCode SaveLocked();
+    bool ReadEntry(uint64_t seq, std::string& evt_ser);
+
+    const TuningFork_Cache* persister_;
+    uint32_t max_bytes_;
+    mutable std::mutex mutex_;
+    // Sequence number of the next session pushed.
+    uint64_t next_seq_ = 0;
+    // The queued sessions, oldest first.
+    std::deque<Queued> queued_;
+    uint64_t queued_bytes_ = 0;
+    uint64_t dropped_sessions_ = 0;
+    // Sequence numbers of removed sessions still to be deleted.
+    std::vector<uint64_t> removed_;
+};
+
+}  // namespace tuningfork
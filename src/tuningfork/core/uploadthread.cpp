@@ -19,6 +19,8 @@
 #include <cstring>
 #include <sstream>
 
+#include "crash_snapshot.h"
+#include "http_backend/binary_serializer.h"
 #include "http_backend/http_request.h"
 #include "http_backend/json_serializer.h"
 #include "modp_b64.h"
@@ -34,19 +36,14 @@ class DebugBackend : public IBackend {
    public:
     TuningFork_ErrorCode UploadTelemetry(const std::string& s) override {
         if (s.size() == 0) return TUNINGFORK_ERROR_BAD_PARAMETER;
-        // Split the serialization into <128-byte chunks to avoid logcat line
-        //  truncation.
-        constexpr size_t maxStrLen = 128;
-        int n = (s.size() + maxStrLen - 1) / maxStrLen;  // Round up
-        for (int i = 0, j = 0; i < n; ++i) {
-            std::stringstream str;
-            str << "(TJS" << (i + 1) << "/" << n << ")";
-            int m = std::min(s.size() - j, maxStrLen);
-            str << s.substr(j, m);
-            j += m;
-            ALOGI("%s", str.str().c_str());
+        if (BinarySerializer::IsBinary(s)) {
+            std::string b64(modp_b64_encode_len(s.size()), ' ');
+            size_t l = modp_b64_encode(const_cast<char*>(b64.c_str()),
+                                       s.c_str(), s.size());
+            b64.resize(l);
+            return UploadChunks("TBS", b64);
         }
-        return TUNINGFORK_ERROR_OK;
+        return UploadChunks("TJS", s);
     }
     TuningFork_ErrorCode GenerateTuningParameters(
         HttpRequest& request, const ProtobufSerialization* training_mode_fps,
@@ -59,6 +56,23 @@ class DebugBackend : public IBackend {
     }
 
     void Stop() override {}
+
+   private:
+    TuningFork_ErrorCode UploadChunks(const char* tag, const std::string& s) {
+        // Split the serialization into <128-byte chunks to avoid logcat line
+        //  truncation.
+        constexpr size_t maxStrLen = 128;
+        int n = (s.size() + maxStrLen - 1) / maxStrLen;  // Round up
+        for (int i = 0, j = 0; i < n; ++i) {
+            std::stringstream str;
+            str << "(" << tag << (i + 1) << "/" << n << ")";
+            int m = std::min(s.size() - j, maxStrLen);
+            str << s.substr(j, m);
+            j += m;
+            ALOGI("%s", str.str().c_str());
+        }
+        return TUNINGFORK_ERROR_OK;
+    }
 };
 
 static std::unique_ptr<DebugBackend> s_debug_backend =
@@ -68,7 +82,6 @@ UploadThread::UploadThread(IdProvider* id_provider)
     : Runnable(nullptr),
       backend_(s_debug_backend.get()),
       upload_callback_(nullptr),
-      persister_(nullptr),
       id_provider_(id_provider) {
     Start();
 }
@@ -82,79 +95,119 @@ void UploadThread::SetBackend(IBackend* backend) {
 
 UploadThread::~UploadThread() { Stop(); }
 
-void UploadThread::Start() {
-    ready_ = nullptr;
-    Runnable::Start();
+void UploadThread::Start() { Runnable::Start(); }
+
+void UploadThread::Serialize(const Session& session, std::string& evt_ser) {
+    if (encoding_ == Settings::TelemetryEncoding::BINARY) {
+        BinarySerializer serializer(session, id_provider_);
+        serializer.SerializeEvent(RequestInfo::CachedValue(), evt_ser);
+    } else {
+        JsonSerializer serializer(session, id_provider_);
+        serializer.SerializeEvent(RequestInfo::CachedValue(), evt_ser);
+    }
+}
+
+void UploadThread::Send(const std::string& evt_ser, bool upload) {
+    if (upload_callback_) {
+        upload_callback_(evt_ser.c_str(), evt_ser.size());
+    }
+    if (upload)
+        backend_->UploadTelemetry(evt_ser);
+    else if (upload_queue_) {
+        // A rollup session includes what was saved before.
+        if (rollup_session_ != nullptr)
+            upload_queue_->ReplaceHeld(evt_ser);
+        else
+            upload_queue_->Push(evt_ser, true /* held */);
+    }
+}
+
+void UploadThread::AddToRollup(const Session& session, bool upload) {
+    uint32_t completed = upload ? rollup_->Add(session) : 0;
+    if (rollup_session_ == nullptr) return;
+    if ((completed >> rollup_upload_level_) & 1) {
+        Serialize(*rollup_session_, evt_ser_);
+        rollup_session_->ClearData();
+        Send(evt_ser_, true);
+        // Anything saved when paused has now been uploaded.
+        if (upload_queue_) upload_queue_->RemoveHeld();
+    }
+    if (rollup_session_->Merge(session) != TUNINGFORK_ERROR_OK)
+        ALOGW_ONCE("Couldn't merge session into rollup session");
+    if (!upload) {
+        // Save what would be lost if the app were killed now, but keep it to
+        // upload with the rest of the window.
+        Serialize(*rollup_session_, evt_ser_);
+        Send(evt_ser_, false);
+    }
 }
 
 Duration UploadThread::DoWork() {
-    if (ready_) {
-        std::string evt_ser_json;
-        JsonSerializer serializer(*ready_, id_provider_);
-        serializer.SerializeEvent(RequestInfo::CachedValue(), evt_ser_json);
-        if (upload_callback_) {
-            upload_callback_(evt_ser_json.c_str(), evt_ser_json.size());
-        }
-        if (upload_)
-            backend_->UploadTelemetry(evt_ser_json);
-        else {
-            TuningFork_CProtobufSerialization cser;
-            ToCProtobufSerialization(evt_ser_json, cser);
-            if (persister_)
-                persister_->set(HISTOGRAMS_PAUSED, &cser,
-                                persister_->user_data);
-            TuningFork_CProtobufSerialization_free(&cser);
+    bool upload;
+    const Session* ready;
+    while (sessions_ != nullptr && (ready = sessions_->Front(upload))) {
+        if (rollup_ != nullptr) {
+            AddToRollup(*ready, upload);
+            if (rollup_session_ != nullptr) {
+                sessions_->Release();
+                continue;
+            }
         }
-        ready_ = nullptr;
+        Serialize(*ready, evt_ser_);
+        // The session can be recycled as soon as it has been serialized.
+        sessions_->Release();
+        Send(evt_ser_, upload);
     }
     if (!lifecycle_event_.empty()) {
-        std::string evt_ser_json;
         JsonSerializer serializer(*lifecycle_event_session_, id_provider_);
         serializer.SerializeLifecycleEvent(
-            lifecycle_event_.back(), RequestInfo::CachedValue(), evt_ser_json);
+            lifecycle_event_.back(), RequestInfo::CachedValue(), evt_ser_);
         if (upload_callback_) {
-            upload_callback_(evt_ser_json.c_str(), evt_ser_json.size());
+            upload_callback_(evt_ser_.c_str(), evt_ser_.size());
         }
-        backend_->UploadTelemetry(evt_ser_json);
+        backend_->UploadTelemetry(evt_ser_);
         lifecycle_event_.pop_back();
         lifecycle_event_session_ = nullptr;
     }
     return std::chrono::seconds(1);
 }
 
-// Returns true if we submitted, false if we are waiting for a previous submit
-// to complete
-bool UploadThread::Submit(const Session* session, bool upload) {
-    if (ready_ == nullptr) {
-        {
-            std::lock_guard<std::mutex> lock(mutex_);
-            upload_ = upload;
-            ready_ = session;
-        }
-        cv_.notify_one();
-        return true;
-    } else
-        return false;
+void UploadThread::NotifySubmitted() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    cv_.notify_one();
 }
 
 void UploadThread::InitialChecks(Session& session, IdProvider& id_provider,
-                                 const TuningFork_Cache* persister) {
-    persister_ = persister;
-    if (!persister_) {
+                                 std::shared_ptr<UploadQueue> upload_queue,
+                                 const std::string& crash_snapshot_path) {
+    // Frame times recorded just before a crash go out with the crash reason,
+    // which is recorded in the same session.
+    std::string snapshot;
+    if (!crash_snapshot_path.empty() &&
+        CrashSnapshot::Recover(crash_snapshot_path, snapshot)) {
+        ALOGI("Got crash snapshot (%zu bytes)", snapshot.size());
+        CrashSnapshot::Merge(snapshot, id_provider, session);
+    }
+    upload_queue_ = upload_queue;
+    if (!upload_queue_) {
         ALOGE("No persistence mechanism given");
         return;
     }
-    // Check for PAUSED session
-    TuningFork_CProtobufSerialization paused_hists_ser;
-    if (persister->get(HISTOGRAMS_PAUSED, &paused_hists_ser,
-                       persister_->user_data) == TUNINGFORK_ERROR_OK) {
-        std::string paused_hists_str = ToString(paused_hists_ser);
-        ALOGI("Got PAUSED histograms: %s", paused_hists_str.c_str());
-        JsonSerializer::DeserializeAndMerge(paused_hists_str, id_provider,
-                                            session);
-        TuningFork_CProtobufSerialization_free(&paused_hists_ser);
-    } else {
-        ALOGI("No PAUSED histograms");
+    // Sessions saved while paused are uploaded with this one.
+    std::vector<std::string> paused;
+    upload_queue_->TakeHeld(paused);
+    if (paused.empty()) ALOGI("No PAUSED histograms");
+    for (const auto& paused_hists_str : paused) {
+        if (BinarySerializer::IsBinary(paused_hists_str)) {
+            ALOGI("Got PAUSED histograms (%zu bytes)",
+                  paused_hists_str.size());
+            BinarySerializer::DeserializeAndMerge(paused_hists_str,
+                                                  id_provider, session);
+        } else {
+            ALOGI("Got PAUSED histograms: %s", paused_hists_str.c_str());
+            JsonSerializer::DeserializeAndMerge(paused_hists_str, id_provider,
+                                                session);
+        }
     }
 }
 
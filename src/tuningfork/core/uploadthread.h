@@ -18,22 +18,31 @@
 
 #include "backend.h"
 #include "lifecycle_upload_event.h"
+#include "rollup_engine.h"
 #include "runnable.h"
 #include "session.h"
+#include "session_ring.h"
+#include "settings.h"
+#include "upload_queue.h"
 
 namespace tuningfork {
 
 class UploadThread : public Runnable {
    private:
-    const Session* ready_ = nullptr;
-    bool upload_ = false;
+    SessionRing* sessions_ = nullptr;
     IBackend* backend_ = nullptr;
     TuningFork_UploadCallback upload_callback_ = nullptr;
-    const TuningFork_Cache* persister_ = nullptr;
+    std::shared_ptr<UploadQueue> upload_queue_;
     IdProvider* id_provider_ = nullptr;
     // Optional isn't available until C++17 so use vector instead.
     std::vector<LifecycleUploadEvent> lifecycle_event_;
     const Session* lifecycle_event_session_ = nullptr;
+    Settings::TelemetryEncoding encoding_ = Settings::TelemetryEncoding::JSON;
+    RollupEngine* rollup_ = nullptr;
+    Session* rollup_session_ = nullptr;
+    int rollup_upload_level_ = 0;
+    // Serialized telemetry, kept so that its capacity is reused.
+    std::string evt_ser_;
 
    public:
     UploadThread(IdProvider* id_provider);
@@ -44,16 +53,39 @@ class UploadThread : public Runnable {
 
     void SetBackend(IBackend* backend);
 
+    // Choose the encoding of uploaded and paused sessions. Sessions paused with
+    // either encoding are read back by InitialChecks.
+    void SetTelemetryEncoding(Settings::TelemetryEncoding encoding) {
+        encoding_ = encoding;
+    }
+
+    // Merge any crash snapshot left at crash_snapshot_path and the sessions
+    // held in upload_queue, which are removed from it, into session. Sessions
+    // are held in upload_queue while logging is paused.
     void InitialChecks(Session& session, IdProvider& id_provider,
-                       const TuningFork_Cache* persister);
+                       std::shared_ptr<UploadQueue> upload_queue,
+                       const std::string& crash_snapshot_path = "");
 
     void Start() override;
     Duration DoWork() override;
 
-    // Returns true if we submitted, false if we are waiting for a previous
-    // submit to complete If upload is false, the cache is serialized and saved,
-    // not uploaded.
-    bool Submit(const Session* session, bool upload);
+    // Sessions submitted to the ring are serialized and either uploaded or
+    // saved, according to how they were submitted, and then released.
+    void SetSessionRing(SessionRing* sessions) { sessions_ = sessions; }
+
+    // Add uploaded sessions to rollup. If upload_session isn't null, sessions
+    // are merged into it instead of being uploaded, and it is uploaded each
+    // time a window at upload_level is complete. Must be called before any
+    // sessions are submitted.
+    void SetRollup(RollupEngine* rollup, Session* upload_session,
+                   int upload_level) {
+        rollup_ = rollup;
+        rollup_session_ = upload_session;
+        rollup_upload_level_ = upload_level;
+    }
+
+    // Wake the thread after a session has been submitted.
+    void NotifySubmitted();
 
     void SetUploadCallback(TuningFork_UploadCallback upload_callback) {
         upload_callback_ = upload_callback;
@@ -62,6 +94,12 @@ class UploadThread : public Runnable {
     // Returns true if there were no errors.
     bool SendLifecycleEvent(const LifecycleUploadEvent& event,
                             const Session* session);
+
+   private:
+    void Serialize(const Session& session, std::string& evt_ser);
+    // Upload evt_ser, or save it if upload is false.
+    void Send(const std::string& evt_ser, bool upload);
+    void AddToRollup(const Session& session, bool upload);
 };
 
 }  // namespace tuningfork
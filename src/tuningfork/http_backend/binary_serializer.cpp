@@ -0,0 +1,589 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "binary_serializer.h"
+
+#include <cstring>
+#include <map>
+#include <set>
+
+#define LOG_TAG "TuningFork"
+#include "Log.h"
+#include "core/annotation_util.h"
+
+namespace tuningfork {
+
+constexpr char BinarySerializer::kMagic[];
+constexpr size_t BinarySerializer::kMagicSize;
+constexpr char BinarySerializer::kMinVersion;
+constexpr char BinarySerializer::kContentType[];
+
+namespace {
+
+enum HistogramKind { LINEAR = 0, LOG_LINEAR = 1, QUANTILE_SKETCH = 2 };
+
+class Writer {
+   public:
+    explicit Writer(std::string& out) : out_(out) {}
+    void Varint(uint64_t x) {
+        while (x >= 0x80) {
+            out_.push_back(static_cast<char>((x & 0x7f) | 0x80));
+            x >>= 7;
+        }
+        out_.push_back(static_cast<char>(x));
+    }
+    void Signed(int64_t x) {
+        Varint((static_cast<uint64_t>(x) << 1) ^
+               static_cast<uint64_t>(x >> 63));
+    }
+    void Bytes(const void* p, size_t n) {
+        Varint(n);
+        out_.append(static_cast<const char*>(p), n);
+    }
+    void String(const std::string& s) { Bytes(s.data(), s.size()); }
+    void Float(float f) {
+        uint32_t bits;
+        memcpy(&bits, &f, sizeof(bits));
+        for (int i = 0; i < 4; ++i) out_.push_back((bits >> (8 * i)) & 0xff);
+    }
+    void Double(double d) {
+        uint64_t bits;
+        memcpy(&bits, &d, sizeof(bits));
+        for (int i = 0; i < 8; ++i) out_.push_back((bits >> (8 * i)) & 0xff);
+    }
+    void Nanos(Duration d) {
+        Signed(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+    }
+    // Zero if there was no jank, otherwise one followed by the counts.
+    void Jank(const JankMetricData& jank) {
+        if (jank.Empty()) {
+            Varint(0);
+            return;
+        }
+        auto j = jank.Finished();
+        Varint(1);
+        Varint(j.frames_);
+        Varint(j.janky_frames_);
+        Varint(j.missed_frames_);
+        Varint(j.big_janks_);
+        Varint(j.stutter_clusters_);
+        Varint(j.longest_run_);
+        for (auto r : j.runs_) Varint(r);
+    }
+    // Zero if there was no loading group, otherwise one followed by the times
+    // and the stages.
+    void Breakdown(const LoadingBreakdown& b) {
+        if (b.Empty()) {
+            Varint(0);
+            return;
+        }
+        Varint(1);
+        Nanos(b.work);
+        Nanos(b.wall);
+        Varint(LoadingBreakdown::kNumStages);
+        for (auto& stage : b.stages) {
+            Nanos(stage.exclusive);
+            Nanos(stage.critical_path);
+        }
+    }
+    // Zigzag deltas from the last non-zero count, plus one, with a zero
+    // followed by a count for each run of zeros.
+    void Counts(const std::vector<uint32_t>& counts) {
+        Varint(counts.size());
+        int64_t previous = 0;
+        size_t i = 0;
+        while (i < counts.size()) {
+            if (counts[i] == 0) {
+                size_t run = 0;
+                while (i < counts.size() && counts[i] == 0) {
+                    ++run;
+                    ++i;
+                }
+                Varint(0);
+                Varint(run);
+            } else {
+                int64_t delta = int64_t(counts[i]) - previous;
+                Varint(((static_cast<uint64_t>(delta) << 1) ^
+                        static_cast<uint64_t>(delta >> 63)) +
+                       1);
+                previous = counts[i];
+                ++i;
+            }
+        }
+    }
+
+   private:
+    std::string& out_;
+};
+
+// Every read fails once the reader has run out of input or seen bad data.
+class Reader {
+   public:
+    Reader(const std::string& in, size_t pos) : in_(in), pos_(pos) {}
+    bool Ok() const { return ok_; }
+    bool AtEnd() const { return pos_ == in_.size(); }
+    uint64_t Varint() {
+        uint64_t x = 0;
+        for (int shift = 0; ok_ && shift < 64; shift += 7) {
+            if (pos_ >= in_.size()) break;
+            uint8_t b = in_[pos_++];
+            x |= uint64_t(b & 0x7f) << shift;
+            if ((b & 0x80) == 0) return x;
+        }
+        ok_ = false;
+        return 0;
+    }
+    int64_t Signed() {
+        uint64_t x = Varint();
+        return static_cast<int64_t>((x >> 1) ^ (~(x & 1) + 1));
+    }
+    std::string String() {
+        uint64_t n = Varint();
+        if (!ok_ || n > in_.size() - pos_) {
+            ok_ = false;
+            return "";
+        }
+        std::string s = in_.substr(pos_, n);
+        pos_ += n;
+        return s;
+    }
+    float Float() {
+        uint32_t bits = static_cast<uint32_t>(Fixed(4));
+        float f;
+        memcpy(&f, &bits, sizeof(f));
+        return f;
+    }
+    double Double() {
+        uint64_t bits = Fixed(8);
+        double d;
+        memcpy(&d, &bits, sizeof(d));
+        return d;
+    }
+    Duration Nanos() { return std::chrono::nanoseconds(Signed()); }
+    // Read a count of items that each take at least min_item_size bytes.
+    size_t Count(size_t min_item_size = 1) {
+        uint64_t n = Varint();
+        if (!ok_ || n > (in_.size() - pos_) / min_item_size) {
+            ok_ = false;
+            return 0;
+        }
+        return n;
+    }
+    JankMetricData Jank() {
+        JankMetricData jank;
+        if (Varint() == 0) return jank;
+        jank.frames_ = Varint();
+        jank.janky_frames_ = Varint();
+        jank.missed_frames_ = Varint();
+        jank.big_janks_ = Varint();
+        jank.stutter_clusters_ = Varint();
+        jank.longest_run_ = Varint();
+        for (auto& r : jank.runs_) r = Varint();
+        return jank;
+    }
+    LoadingBreakdown Breakdown() {
+        LoadingBreakdown b;
+        if (Varint() == 0) return b;
+        b.work = Nanos();
+        b.wall = Nanos();
+        uint64_t n = Varint();
+        if (n > LoadingBreakdown::kNumStages) ok_ = false;
+        for (uint64_t i = 0; ok_ && i < n; ++i) {
+            b.stages[i].exclusive = Nanos();
+            b.stages[i].critical_path = Nanos();
+        }
+        return b;
+    }
+    std::vector<uint32_t> Counts() {
+        // Bucket counts can't be bounded by the input size because of the
+        // run-length encoding, so limit them to what a histogram can have.
+        uint64_t n = Varint();
+        if (n > kMaxBuckets) ok_ = false;
+        std::vector<uint32_t> counts;
+        if (!ok_) return counts;
+        counts.reserve(n);
+        int64_t previous = 0;
+        while (ok_ && counts.size() < n) {
+            uint64_t token = Varint();
+            if (token == 0) {
+                uint64_t run = Varint();
+                if (run > n - counts.size()) ok_ = false;
+                if (ok_) counts.insert(counts.end(), run, 0);
+            } else {
+                --token;
+                previous +=
+                    static_cast<int64_t>((token >> 1) ^ (~(token & 1) + 1));
+                counts.push_back(static_cast<uint32_t>(previous));
+            }
+        }
+        return counts;
+    }
+
+   private:
+    static constexpr uint64_t kMaxBuckets = 1 << 20;
+    uint64_t Fixed(int n) {
+        if (!ok_ || in_.size() - pos_ < size_t(n)) {
+            ok_ = false;
+            return 0;
+        }
+        uint64_t x = 0;
+        for (int i = 0; i < n; ++i)
+            x |= uint64_t(uint8_t(in_[pos_++])) << (8 * i);
+        return x;
+    }
+    const std::string& in_;
+    size_t pos_;
+    bool ok_ = true;
+};
+
+// Interns annotation and fidelity parameter serializations.
+class BlobTable {
+   public:
+    uint64_t Index(const ProtobufSerialization& blob) {
+        auto it = indices_.find(blob);
+        if (it != indices_.end()) return it->second;
+        uint64_t i = blobs_.size();
+        indices_.insert({blob, i});
+        blobs_.push_back(&indices_.find(blob)->first);
+        return i;
+    }
+    void Write(Writer& w) const {
+        w.Varint(blobs_.size());
+        for (auto b : blobs_) w.Bytes(b->data(), b->size());
+    }
+
+   private:
+    std::map<ProtobufSerialization, uint64_t> indices_;
+    std::vector<const ProtobufSerialization*> blobs_;
+};
+
+uint64_t MicrosSinceEpoch(std::chrono::system_clock::time_point t) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               t.time_since_epoch())
+        .count();
+}
+
+struct Hist {
+    ProtobufSerialization annotation;
+    uint64_t instrument_id;
+    int kind;
+    std::vector<uint32_t> counts;
+    // Only used for quantile sketches
+    int k;
+    uint64_t count;
+    std::vector<std::vector<float>> levels;
+    JankMetricData jank;
+};
+
+}  // anonymous namespace
+
+bool BinarySerializer::IsBinary(const std::string& ser) {
+    return ser.size() >= kMagicSize &&
+           ser.compare(0, kMagicSize - 1, kMagic, kMagicSize - 1) == 0 &&
+           ser[kMagicSize - 1] >= kMinVersion &&
+           ser[kMagicSize - 1] <= kMagic[kMagicSize - 1];
+}
+
+void BinarySerializer::SerializeEvent(const RequestInfo& request_info,
+                                      std::string& evt_ser) {
+    // The telemetry is written first so that the blob table is complete, then
+    // moved after it.
+    std::string telemetry;
+    Writer t(telemetry);
+    BlobTable blobs;
+    uint64_t fidelity_params_index =
+        blobs.Index(request_info.current_fidelity_parameters);
+
+    std::set<AnnotationId> annotations;
+    for (const auto& p :
+         session_.GetNonEmptyHistograms<FrameTimeMetricData>()) {
+        annotations.insert(p->metric_id_.detail.annotation);
+    }
+    for (const auto& p :
+         session_.GetNonEmptyHistograms<LoadingTimeMetricData>()) {
+        annotations.insert(p->metric_id_.detail.annotation);
+    }
+    t.Varint(annotations.size());
+    for (auto annotation : annotations) {
+        SerializedAnnotation ser;
+        id_provider_->AnnotationIdToSerializedAnnotation(annotation, ser);
+        t.Varint(blobs.Index(ser));
+        t.Varint(fidelity_params_index);
+
+        std::vector<const FrameTimeMetricData*> frame_times;
+        Duration duration = Duration::zero();
+        for (const auto& th :
+             session_.GetNonEmptyHistograms<FrameTimeMetricData>()) {
+            if (th->metric_id_.detail.annotation != annotation) continue;
+            frame_times.push_back(th);
+            duration = std::max(th->duration_, duration);
+        }
+        std::vector<std::pair<const LoadingTimeMetricData*,
+                              LoadingTimeMetadataWithGroup>>
+            loading_times;
+        for (const auto& th :
+             session_.GetNonEmptyHistograms<LoadingTimeMetricData>()) {
+            if (th->metric_id_.detail.annotation != annotation) continue;
+            duration = std::max(th->duration_, duration);
+            LoadingTimeMetadataWithGroup md;
+            if (id_provider_->MetricIdToLoadingTimeMetadata(
+                    th->metric_id_, md) == TUNINGFORK_ERROR_OK)
+                loading_times.push_back({th, md});
+        }
+        t.Nanos(duration);
+
+        t.Varint(frame_times.size());
+        for (auto th : frame_times) {
+            t.Varint(session_.GetInstrumentationKey(
+                th->metric_id_.detail.frame_time.ikey));
+            if (th->use_quantiles_) {
+                auto& q = th->quantiles_;
+                t.Varint(QUANTILE_SKETCH);
+                t.Varint(q.K());
+                t.Varint(th->ScaledQuantileCount());
+                t.Varint(q.Levels().size());
+                for (auto& level : q.Levels()) {
+                    t.Varint(level.size());
+                    for (float x : level) t.Float(x);
+                }
+            } else {
+                auto& h = th->histogram_;
+                if (h.GetMode() == HistogramBase::Mode::LOG_LINEAR) {
+                    t.Varint(LOG_LINEAR);
+                    t.Double(h.BucketStart());
+                    t.Varint(h.SubBucketBits());
+                } else {
+                    t.Varint(LINEAR);
+                }
+                t.Counts(th->ScaledCounts());
+            }
+            t.Jank(th->jank_);
+        }
+
+        t.Varint(loading_times.size());
+        for (auto& l : loading_times) {
+            const LoadingTimeMetadata& md = l.second.metadata;
+            t.Varint(md.state);
+            t.Varint(md.source);
+            t.Varint(md.compression_level);
+            t.Varint(md.network_connectivity);
+            t.Varint(md.network_transfer_speed_bps);
+            t.Varint(md.network_latency_ns);
+            t.String(l.second.group_id);
+            const auto& samples = l.first->data_.Samples();
+            t.Varint(samples.size());
+            for (const auto& c : samples) {
+                t.Nanos(c.Start());
+                t.Nanos(c.End());
+            }
+            t.Breakdown(l.first->breakdown_);
+        }
+
+        std::vector<const BatteryMetric*> battery;
+        for (const auto& th :
+             session_.GetNonEmptyHistograms<BatteryMetricData>()) {
+            if (th->metric_id_.detail.annotation != annotation) continue;
+            for (auto& report : th->data_) battery.push_back(&report);
+        }
+        t.Varint(battery.size());
+        for (auto report : battery) {
+            t.Nanos(report->time_since_process_start_);
+            t.Signed(report->percentage_);
+            t.Signed(report->current_charge_);
+            t.Varint((report->is_charging_ ? 1 : 0) |
+                     (report->app_on_foreground_ ? 2 : 0) |
+                     (report->power_save_mode_ ? 4 : 0));
+        }
+
+        std::vector<const ThermalMetric*> thermal;
+        for (const auto& th :
+             session_.GetNonEmptyHistograms<ThermalMetricData>()) {
+            if (th->metric_id_.detail.annotation != annotation) continue;
+            for (auto& report : th->data_) thermal.push_back(&report);
+        }
+        t.Varint(thermal.size());
+        for (auto report : thermal) {
+            t.Nanos(report->time_since_process_start_);
+            t.Varint(report->thermal_state_);
+        }
+
+        std::vector<const MemoryMetric*> memory;
+        for (const auto& th :
+             session_.GetNonEmptyHistograms<MemoryMetricData>()) {
+            if (th->metric_id_.detail.annotation != annotation) continue;
+            for (auto& report : th->data_) memory.push_back(&report);
+        }
+        t.Varint(memory.size());
+        for (auto report : memory) {
+            t.Nanos(report->time_since_process_start_);
+            t.Signed(report->avail_mem_);
+            t.Signed(report->oom_score_);
+            t.Signed(report->proportional_set_size_);
+        }
+    }
+
+    evt_ser.assign(kMagic, kMagicSize);
+    Writer w(evt_ser);
+    // Session context
+    w.Varint(MicrosSinceEpoch(session_.time().start));
+    w.Varint(MicrosSinceEpoch(session_.time().end));
+    w.String(request_info.experiment_id);
+    w.String(request_info.session_id);
+    w.String(request_info.previous_session_id);
+    w.String(request_info.apk_package_name);
+    w.Varint(request_info.apk_version_code);
+    w.Varint(request_info.tuningfork_version);
+    w.Varint(request_info.swappy_version);
+    w.String(request_info.build_fingerprint);
+    w.String(request_info.build_version_sdk);
+    w.String(request_info.model);
+    w.String(request_info.brand);
+    w.String(request_info.product);
+    w.String(request_info.device);
+    w.String(request_info.soc_model);
+    w.String(request_info.soc_manufacturer);
+    w.Varint(request_info.total_memory_bytes);
+    w.Signed(request_info.swap_total_bytes);
+    w.Varint(request_info.gl_es_version);
+    w.Varint(request_info.cpu_max_freq_hz.size());
+    for (auto f : request_info.cpu_max_freq_hz) w.Varint(f);
+    auto crash_reports = session_.GetCrashReports();
+    w.Varint(crash_reports.size());
+    for (auto c : crash_reports) w.Varint(c);
+    blobs.Write(w);
+    evt_ser += telemetry;
+}
+
+/* static */ TuningFork_ErrorCode BinarySerializer::DeserializeAndMerge(
+    const std::string& evt_ser, IdProvider& id_provider, Session& session) {
+    if (!IsBinary(evt_ser)) return TUNINGFORK_ERROR_BAD_PARAMETER;
+    ALOGI("Deserializing saved binary session");
+    char version = evt_ser[kMagicSize - 1];
+    Reader r(evt_ser, kMagicSize);
+
+    // Session context, which isn't merged.
+    r.Varint();
+    r.Varint();
+    for (int i = 0; i < 4; ++i) r.String();
+    for (int i = 0; i < 3; ++i) r.Varint();
+    for (int i = 0; i < 8; ++i) r.String();
+    r.Varint();
+    r.Signed();
+    r.Varint();
+    for (size_t i = 0, n = r.Count(); i < n; ++i) r.Varint();
+    for (size_t i = 0, n = r.Count(); i < n; ++i) r.Varint();
+    std::vector<std::string> blobs(r.Count());
+    for (auto& b : blobs) b = r.String();
+
+    std::vector<Hist> hists;
+    for (size_t i = 0, n = r.Count(); r.Ok() && i < n; ++i) {
+        uint64_t annotation_index = r.Varint();
+        r.Varint();  // Fidelity parameters
+        r.Nanos();   // Duration
+        if (annotation_index >= blobs.size())
+            return TUNINGFORK_ERROR_BAD_PARAMETER;
+        auto& a = blobs[annotation_index];
+        ProtobufSerialization annotation(a.begin(), a.end());
+        for (size_t j = 0, m = r.Count(); r.Ok() && j < m; ++j) {
+            Hist h{annotation, r.Varint(), static_cast<int>(r.Varint())};
+            switch (h.kind) {
+                case LINEAR:
+                    h.counts = r.Counts();
+                    break;
+                case LOG_LINEAR:
+                    r.Double();
+                    r.Varint();
+                    h.counts = r.Counts();
+                    break;
+                case QUANTILE_SKETCH:
+                    h.k = r.Varint();
+                    h.count = r.Varint();
+                    h.levels.resize(r.Count());
+                    for (auto& level : h.levels) {
+                        level.resize(r.Count(sizeof(float)));
+                        for (auto& x : level) x = r.Float();
+                    }
+                    break;
+                default:
+                    return TUNINGFORK_ERROR_BAD_PARAMETER;
+            }
+            if (version >= 2) h.jank = r.Jank();
+            hists.push_back(std::move(h));
+        }
+        // Loading, battery, thermal and memory events aren't merged.
+        for (size_t j = 0, m = r.Count(); r.Ok() && j < m; ++j) {
+            for (int k = 0; k < 6; ++k) r.Varint();
+            r.String();
+            for (size_t s = 0, l = r.Count(); s < l; ++s) {
+                r.Nanos();
+                r.Nanos();
+            }
+            if (version >= 3) r.Breakdown();
+        }
+        for (size_t j = 0, m = r.Count(); r.Ok() && j < m; ++j) {
+            r.Nanos();
+            r.Signed();
+            r.Signed();
+            r.Varint();
+        }
+        for (size_t j = 0, m = r.Count(); r.Ok() && j < m; ++j) {
+            r.Nanos();
+            r.Varint();
+        }
+        for (size_t j = 0, m = r.Count(); r.Ok() && j < m; ++j) {
+            r.Nanos();
+            r.Signed();
+            r.Signed();
+            r.Signed();
+        }
+    }
+    if (!r.Ok() || !r.AtEnd()) {
+        ALOGE("Failed to deserialize binary session");
+        return TUNINGFORK_ERROR_BAD_PARAMETER;
+    }
+
+    // Merge
+    for (auto& h : hists) {
+        MetricId id{0};
+        AnnotationId annotation_id;
+        id_provider.SerializedAnnotationToAnnotationId(h.annotation,
+                                                       annotation_id);
+        if (annotation_id == annotation_util::kAnnotationError)
+            return TUNINGFORK_ERROR_BAD_PARAMETER;
+        auto err =
+            id_provider.MakeCompoundId(h.instrument_id, annotation_id, id);
+        if (err != TUNINGFORK_ERROR_OK) return err;
+        auto p = session.GetData<FrameTimeMetricData>(id);
+        if (p == nullptr) return TUNINGFORK_ERROR_BAD_PARAMETER;
+        if ((h.kind == QUANTILE_SKETCH) != p->use_quantiles_)
+            return TUNINGFORK_ERROR_BAD_PARAMETER;
+        p->jank_.Merge(h.jank);
+        if (h.kind == QUANTILE_SKETCH) {
+            if (h.k != p->quantiles_.K()) return TUNINGFORK_ERROR_BAD_PARAMETER;
+            err = p->MergeScaledQuantiles(h.levels, h.count);
+            if (err != TUNINGFORK_ERROR_OK) return err;
+            continue;
+        }
+        // Counts only line up if the buckets are of the same kind.
+        if ((h.kind == LOG_LINEAR) !=
+            (p->histogram_.GetMode() == HistogramBase::Mode::LOG_LINEAR))
+            return TUNINGFORK_ERROR_BAD_PARAMETER;
+        p->AddScaledCounts(std::move(h.counts));
+    }
+    return TUNINGFORK_ERROR_OK;
+}
+
+}  // namespace tuningfork
@@ -0,0 +1,64 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "core/id_provider.h"
+#include "core/session.h"
+
+namespace tuningfork {
+
+// A compact binary encoding of the same session content as JsonSerializer.
+// Integers are written as varints, signed ones zigzag-encoded, and annotation
+// and fidelity parameter serializations are written once and referred to by
+// index. Histogram counts are written as zigzag deltas from the previous
+// non-zero count, with runs of zeros collapsed.
+//
+// The last byte of the magic is the format version. Version 2 added jank
+// and version 3 added loading breakdowns.
+class BinarySerializer {
+   public:
+    // The first bytes of every serialization.
+    static constexpr char kMagic[] = "TFB\x03";
+    static constexpr size_t kMagicSize = 4;
+    // The oldest version that can still be read.
+    static constexpr char kMinVersion = 1;
+    static constexpr char kContentType[] = "application/octet-stream";
+
+    BinarySerializer(const Session& session, IdProvider* id_provider)
+        : session_(session), id_provider_(id_provider) {}
+
+    void SerializeEvent(const RequestInfo& request_info, std::string& evt_ser);
+
+    // Merge the frame time histograms in evt_ser into session, as
+    // JsonSerializer::DeserializeAndMerge does.
+    static TuningFork_ErrorCode DeserializeAndMerge(const std::string& evt_ser,
+                                                    IdProvider& id_provider,
+                                                    Session& session);
+
+    // Returns true if ser starts with kMagic, or kMagic with an older version
+    // that can be read.
+    static bool IsBinary(const std::string& ser);
+
+   private:
+    const Session& session_;
+    IdProvider* id_provider_;
+};
+
+}  // namespace tuningfork
@@ -0,0 +1,54 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "compression.h"
+
+#include <zlib.h>
+
+#define LOG_TAG "TuningFork:Web"
+#include "Log.h"
+
+namespace tuningfork {
+
+// Adding 16 to the window bits gives a gzip header and trailer rather than a
+// zlib one.
+constexpr int kGzipWindowBits = 15 + 16;
+constexpr int kMemLevel = 8;
+
+bool GzipCompress(const std::string& in, std::string& out) {
+    z_stream stream = {};
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                     kGzipWindowBits, kMemLevel, Z_DEFAULT_STRATEGY) != Z_OK) {
+        ALOGE("Can't initialize gzip compression");
+        return false;
+    }
+    out.resize(deflateBound(&stream, in.size()));
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+    stream.avail_in = in.size();
+    stream.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    stream.avail_out = out.size();
+    int ret = deflate(&stream, Z_FINISH);
+    deflateEnd(&stream);
+    if (ret != Z_STREAM_END) {
+        ALOGE("gzip compression failed: %d", ret);
+        out.clear();
+        return false;
+    }
+    out.resize(stream.total_out);
+    return true;
+}
+
+}  // namespace tuningfork
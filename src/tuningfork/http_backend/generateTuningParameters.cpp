@@ -153,7 +153,10 @@ static TuningFork_ErrorCode DownloadFidelityParams(
         response_code, body);
     if (ret != TUNINGFORK_ERROR_OK) return ret;
 
-    if (response_code >= kSuccessCodeMin && response_code <= kSuccessCodeMax)
+    if (response_code == kHttpNotModified && !request.IfNoneMatch().empty())
+        ret = TUNINGFORK_ERROR_FIDELITY_PARAMS_NOT_MODIFIED;
+    else if (response_code >= kSuccessCodeMin &&
+             response_code <= kSuccessCodeMax)
         ret = DecodeResponse(body, fps, experiment_id);
     else
         ret = TUNINGFORK_ERROR_GENERATE_TUNING_PARAMETERS_RESPONSE_NOT_SUCCESS;
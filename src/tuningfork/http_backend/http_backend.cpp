@@ -12,7 +12,8 @@ namespace tuningfork {
 
 constexpr Duration kRequestTimeout = std::chrono::seconds(10);
 
-TuningFork_ErrorCode HttpBackend::Init(const Settings& settings) {
+TuningFork_ErrorCode HttpBackend::Init(
+    const Settings& settings, std::shared_ptr<UploadQueue> upload_queue) {
     if (settings.EndpointUri().empty()) {
         ALOGW("The base URI in Tuning Fork TuningFork_Settings is invalid");
         return TUNINGFORK_ERROR_BAD_PARAMETER;
@@ -24,14 +25,19 @@ TuningFork_ErrorCode HttpBackend::Init(const Settings& settings) {
 
     HttpRequest request(settings.EndpointUri(), settings.api_key,
                         kRequestTimeout);
+    request.CompressAbove(settings.upload_compression_threshold_bytes);
 
-    persister_ = settings.c_settings.persistent_cache;
+    if (upload_queue.get() == nullptr) {
+        ALOGW("No upload queue given");
+        return TUNINGFORK_ERROR_BAD_PARAMETER;
+    }
+    upload_queue_ = upload_queue;
 
     // TODO(b/140367226): Initialize a Java JobScheduler if we can
 
     if (ultimate_uploader_.get() == nullptr) {
         ultimate_uploader_ =
-            std::make_shared<UltimateUploader>(persister_, request);
+            std::make_shared<UltimateUploader>(upload_queue_, request);
         ultimate_uploader_->Start();
     }
 
@@ -40,19 +46,11 @@ TuningFork_ErrorCode HttpBackend::Init(const Settings& settings) {
 
 HttpBackend::~HttpBackend() {}
 
-// This persists the histograms and the ultimate uploader, above, uploads them.
+// This queues the histograms and the ultimate uploader, above, uploads them.
 TuningFork_ErrorCode HttpBackend::UploadTelemetry(const std::string& evt_ser) {
-    ALOGV("HttpBackend::Process %s", evt_ser.c_str());
-
-    // Save event to file
-    TuningFork_CProtobufSerialization uploading_hists_ser;
-    ToCProtobufSerialization(evt_ser, uploading_hists_ser);
-    auto ret = persister_->set(HISTOGRAMS_UPLOADING, &uploading_hists_ser,
-                               persister_->user_data);
-
-    TuningFork_CProtobufSerialization_free(&uploading_hists_ser);
-
-    return ret;
+    ALOGV("HttpBackend::Process %zu bytes", evt_ser.size());
+    if (upload_queue_.get() == nullptr) return TUNINGFORK_ERROR_BAD_PARAMETER;
+    return upload_queue_->Push(evt_ser);
 }
 
 void HttpBackend::Stop() {
@@ -23,6 +23,7 @@
 #include <string>
 
 #include "core/tuningfork_internal.h"
+#include "core/upload_queue.h"
 #include "http_request.h"
 
 namespace tuningfork {
@@ -32,7 +33,10 @@ class UltimateUploader;
 // Google Endpoint backend
 class HttpBackend : public IBackend {
    public:
-    TuningFork_ErrorCode Init(const Settings& settings);
+    // Sessions are uploaded from upload_queue, which is shared with the upload
+    // thread.
+    TuningFork_ErrorCode Init(const Settings& settings,
+                              std::shared_ptr<UploadQueue> upload_queue);
     ~HttpBackend() override;
 
     // Perform a blocking call to get fidelity parameters from the server.
@@ -41,7 +45,7 @@ class HttpBackend : public IBackend {
         ProtobufSerialization& fidelity_params,
         std::string& experiment_id) override;
 
-    // Perform a blocking call to upload telemetry info to a server.
+    // Queue telemetry to be uploaded by the ultimate uploader.
     virtual TuningFork_ErrorCode UploadTelemetry(
         const std::string& tuningfork_log_event) override;
 
@@ -52,7 +56,7 @@ class HttpBackend : public IBackend {
 
    private:
     std::shared_ptr<UltimateUploader> ultimate_uploader_;
-    const TuningFork_Cache* persister_ = nullptr;
+    std::shared_ptr<UploadQueue> upload_queue_;
 };
 
 }  // namespace tuningfork
@@ -16,8 +16,10 @@
 
 #include "http_request.h"
 
+#include <cstdlib>
 #include <sstream>
 
+#include "compression.h"
 #include "jni/jni_wrap.h"
 
 #define LOG_TAG "TuningFork:Web"
@@ -50,10 +52,57 @@ static TuningFork_ErrorCode ConnectionIsMetered(bool& value) {
     return TUNINGFORK_ERROR_OK;
 }
 
+// The max-age directive of a Cache-Control header, or -1 if there isn't one.
+// A response that mustn't be cached, or must be revalidated before each use,
+// has a max age of zero.
+static Duration MaxAge(const std::string& cache_control) {
+    if (cache_control.find("no-store") != std::string::npos ||
+        cache_control.find("no-cache") != std::string::npos)
+        return Duration::zero();
+    const std::string directive = "max-age=";
+    auto pos = cache_control.find(directive);
+    if (pos == std::string::npos) return Duration(-1);
+    char* end;
+    const char* start = cache_control.c_str() + pos + directive.size();
+    long seconds = strtol(start, &end, 10);
+    if (end == start || seconds < 0) return Duration(-1);
+    return std::chrono::seconds(seconds);
+}
+
 TuningFork_ErrorCode HttpRequest::Send(const std::string& rpc_name,
                                        const std::string& request_json,
                                        int& response_code,
                                        std::string& response_body) {
+    return SendBytes(rpc_name, request_json, "application/json",
+                     response_code, response_body);
+}
+
+TuningFork_ErrorCode HttpRequest::SendBytes(const std::string& rpc_name,
+                                            const std::string& request_body,
+                                            const std::string& content_type,
+                                            int& response_code,
+                                            std::string& response_body) {
+    if (compression_threshold_ >= 0 &&
+        request_body.size() >= size_t(compression_threshold_)) {
+        std::string compressed;
+        if (GzipCompress(request_body, compressed) &&
+            compressed.size() < request_body.size()) {
+            ALOGV("Compressed request body from %zu to %zu bytes",
+                  request_body.size(), compressed.size());
+            return Post(rpc_name, compressed, content_type, "gzip",
+                        response_code, response_body);
+        }
+    }
+    return Post(rpc_name, request_body, content_type, "", response_code,
+                response_body);
+}
+
+TuningFork_ErrorCode HttpRequest::Post(const std::string& rpc_name,
+                                       const std::string& body,
+                                       const std::string& content_type,
+                                       const std::string& content_encoding,
+                                       int& response_code,
+                                       std::string& response_body) {
     if (!gamesdk::jni::IsValid()) return TUNINGFORK_ERROR_JNI_BAD_ENV;
     bool connection_is_metered;
     auto err = ConnectionIsMetered(connection_is_metered);
@@ -87,7 +136,11 @@ TuningFork_ErrorCode HttpRequest::Send(const std::string& rpc_name,
     if (!api_key_.empty()) {
         connection.setRequestProperty("X-Goog-Api-Key", api_key_);
     }
-    connection.setRequestProperty("Content-Type", "application/json");
+    connection.setRequestProperty("Content-Type", content_type);
+    if (!content_encoding.empty())
+        connection.setRequestProperty("Content-Encoding", content_encoding);
+    if (!if_none_match_.empty())
+        connection.setRequestProperty("If-None-Match", if_none_match_);
 
     std::string package_name;
     apk_utils::GetVersionCode(&package_name);
@@ -97,22 +150,16 @@ TuningFork_ErrorCode HttpRequest::Send(const std::string& rpc_name,
     if (!signature.empty())
         connection.setRequestProperty("X-Android-Cert", signature);
 
-    // Write json request body
+    // Write request body
     auto os = connection.getOutputStream();
     SAFE_LOGGING_CHECK_FOR_JNI_EXCEPTION_AND_RETURN(
         TUNINGFORK_ERROR_JNI_EXCEPTION,
         g_verbose_logging_enabled);  // IOException
-    auto writer =
-        java::io::BufferedWriter(java::io::OutputStreamWriter(os, "UTF-8"));
-    writer.write(request_json);
-    SAFE_LOGGING_CHECK_FOR_JNI_EXCEPTION_AND_RETURN(
-        TUNINGFORK_ERROR_JNI_EXCEPTION,
-        g_verbose_logging_enabled);  // IOException
-    writer.flush();
+    os.write(body);
     SAFE_LOGGING_CHECK_FOR_JNI_EXCEPTION_AND_RETURN(
         TUNINGFORK_ERROR_JNI_EXCEPTION,
         g_verbose_logging_enabled);  // IOException
-    writer.close();
+    os.flush();
     SAFE_LOGGING_CHECK_FOR_JNI_EXCEPTION_AND_RETURN(
         TUNINGFORK_ERROR_JNI_EXCEPTION,
         g_verbose_logging_enabled);  // IOException
@@ -139,26 +186,33 @@ TuningFork_ErrorCode HttpRequest::Send(const std::string& rpc_name,
         TUNINGFORK_ERROR_JNI_EXCEPTION,
         g_verbose_logging_enabled);  // IOException
 
+    auto etag = connection.getHeaderField("ETag");
+    auto cache_control = connection.getHeaderField("Cache-Control");
+    SAFE_LOGGING_CHECK_FOR_JNI_EXCEPTION_AND_RETURN(
+        TUNINGFORK_ERROR_JNI_EXCEPTION, g_verbose_logging_enabled);
+    SetResponseCaching(etag.C() ? etag.C() : "",
+                       MaxAge(cache_control.C() ? cache_control.C() : ""));
+
+    // A 304 Not Modified response has no body.
+    if (response_code == kHttpNotModified) {
+        connection.disconnect();
+        response_body.clear();
+        return TUNINGFORK_ERROR_OK;
+    }
+
     // Read body from input stream
     auto is = connection.getInputStream();
     SAFE_LOGGING_CHECK_FOR_JNI_EXCEPTION_AND_RETURN(
         TUNINGFORK_ERROR_JNI_EXCEPTION,
         g_verbose_logging_enabled);  // IOException
-    auto reader =
-        java::io::BufferedReader(java::io::InputStreamReader(is, "UTF-8"));
-    std::stringstream body;
-    while (true) {
-        auto line = reader.readLine();
-        if (line.J() == nullptr) break;
-        body << line.C() << "\n";
-    }
+    response_body = is.readAll();
+    SAFE_LOGGING_CHECK_FOR_JNI_EXCEPTION_AND_RETURN(
+        TUNINGFORK_ERROR_JNI_EXCEPTION,
+        g_verbose_logging_enabled);  // IOException
 
-    reader.close();
     is.close();
     connection.disconnect();
 
-    response_body = body.str();
-
     return TUNINGFORK_ERROR_OK;
 }
 
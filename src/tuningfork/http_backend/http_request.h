@@ -24,12 +24,32 @@
 
 namespace tuningfork {
 
+const int kHttpNotModified = 304;
+
 // Request to an HTTP endpoint.
 class HttpRequest {
     std::string base_url_;
     std::string api_key_;
     Duration timeout_;
     bool allow_metered_ = false;
+    // Bodies of at least this many bytes are gzipped. Negative means never.
+    int32_t compression_threshold_ = -1;
+    // Sent as If-None-Match, if not empty.
+    std::string if_none_match_;
+    // From the response's ETag and Cache-Control max-age headers. A negative
+    // max age means there was none.
+    std::string response_etag_;
+    Duration response_max_age_ = Duration(-1);
+
+   protected:
+    // Make the POST request with an already encoded body. An empty
+    // content_encoding means the body is not compressed.
+    virtual TuningFork_ErrorCode Post(const std::string& rpc_name,
+                                      const std::string& body,
+                                      const std::string& content_type,
+                                      const std::string& content_encoding,
+                                      int& response_code,
+                                      std::string& response_body);
 
    public:
     HttpRequest(std::string base_url, std::string api_key, Duration timeout)
@@ -40,10 +60,33 @@ class HttpRequest {
                                       const std::string& request_json,
                                       int& response_code,
                                       std::string& response_body);
+    // Send a request body that isn't JSON.
+    virtual TuningFork_ErrorCode SendBytes(const std::string& rpc_name,
+                                           const std::string& request_body,
+                                           const std::string& content_type,
+                                           int& response_code,
+                                           std::string& response_body);
     HttpRequest& AllowMetered(bool allow) {
         allow_metered_ = allow;
         return *this;
     }
+    HttpRequest& CompressAbove(int32_t threshold_bytes) {
+        compression_threshold_ = threshold_bytes;
+        return *this;
+    }
+    // Make the request conditional: a server that still has the version
+    // tagged etag responds with 304 Not Modified and no body.
+    HttpRequest& IfNoneMatch(const std::string& etag) {
+        if_none_match_ = etag;
+        return *this;
+    }
+    const std::string& IfNoneMatch() const { return if_none_match_; }
+    void SetResponseCaching(const std::string& etag, Duration max_age) {
+        response_etag_ = etag;
+        response_max_age_ = max_age;
+    }
+    const std::string& ResponseETag() const { return response_etag_; }
+    Duration ResponseMaxAge() const { return response_max_age_; }
 };
 
 }  // namespace tuningfork
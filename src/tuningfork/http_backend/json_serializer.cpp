@@ -16,7 +16,7 @@
 
 #include "json_serializer.h"
 
-#include <set>
+#include <cstdlib>
 #include <sstream>
 
 #define LOG_TAG "TuningFork"
@@ -38,44 +38,28 @@ using namespace date;
 
 // Unfortunately, C++ conversion/rounding of numbers requires this.
 std::string JsonSerializer::FixedAndTruncated(double d) {
-    std::stringstream s;
-    s.precision(9);
-    s << std::fixed << d;
-    auto str = s.str();
-    if (str.find('.') != std::string::npos) {
-        // Remove trailing zeroes
-        str = str.substr(0, str.find_last_not_of('0') + 1);
-        // If the decimal point is now the last character, remove that as well
-        if (str.find('.') == str.size() - 1) {
-            str = str.substr(0, str.size() - 1);
-        }
-    }
+    std::string str;
+    JsonWriter::AppendFixedAndTruncated(str, d);
     return str;
 }
 
 static std::string GetVersionString(uint32_t ver) {
-    std::stringstream version_str;
-    version_str << ANDROID_GAMESDK_MAJOR_VERSION(ver) << "."
-                << ANDROID_GAMESDK_MINOR_VERSION(ver) << "."
-                << ANDROID_GAMESDK_BUGFIX_VERSION(ver);
-    return version_str.str();
+    return std::to_string(ANDROID_GAMESDK_MAJOR_VERSION(ver)) + "." +
+           std::to_string(ANDROID_GAMESDK_MINOR_VERSION(ver)) + "." +
+           std::to_string(ANDROID_GAMESDK_BUGFIX_VERSION(ver));
 }
-Json::object GameSdkInfoJson(const RequestInfo& request_info) {
-    Json::object info{
-        {"version", GetVersionString(request_info.tuningfork_version)},
-        {"session_id", request_info.session_id}};
+
+static void WriteGameSdkInfo(JsonWriter& w, const RequestInfo& request_info) {
+    w.BeginObject();
+    w.Key("session_id");
+    w.String(request_info.session_id);
     if (request_info.swappy_version != 0) {
-        info["swappy_version"] = GetVersionString(request_info.swappy_version);
+        w.Key("swappy_version");
+        w.String(GetVersionString(request_info.swappy_version));
     }
-    return info;
-}
-
-std::string TimeToRFC3339(system_clock::time_point tp) {
-    std::stringstream str;
-    //"{year}-{month}-{day}T{hour}:{min}:{sec}[.{frac_sec}]Z"
-    auto const dp = date::floor<days>(tp);
-    str << year_month_day(dp) << 'T' << make_time(tp - dp) << 'Z';
-    return str.str();
+    w.Key("version");
+    w.String(GetVersionString(request_info.tuningfork_version));
+    w.EndObject();
 }
 
 system_clock::time_point RFC3339ToTime(const std::string& s) {
@@ -91,12 +75,6 @@ system_clock::time_point RFC3339ToTime(const std::string& s) {
                (hours * 3600 + mins * 60 + secs) * 1000000.0));
 }
 
-std::string DurationToSecondsString(Duration d) {
-    std::stringstream str;
-    double duration_s = duration_cast<nanoseconds>(d).count() / 1000000000.0;
-    str << JsonSerializer::FixedAndTruncated(duration_s) << 's';
-    return str.str();
-}
 Duration StringToDuration(const std::string& s) {
     double d;
     std::stringstream str(s);
@@ -104,14 +82,15 @@ Duration StringToDuration(const std::string& s) {
     return nanoseconds(static_cast<int64_t>(d * 1000000000));
 }
 
-std::string B64Encode(const std::vector<uint8_t>& bytes) {
-    if (bytes.size() == 0) return "";
-    std::string enc(modp_b64_encode_len(bytes.size()), ' ');
-    size_t l = modp_b64_encode(const_cast<char*>(enc.c_str()),
-                               reinterpret_cast<const char*>(bytes.data()),
-                               bytes.size());
-    enc.resize(l);
-    return enc;
+static void WriteB64(JsonWriter& w, const std::vector<uint8_t>& bytes,
+                     std::string& scratch) {
+    scratch.resize(modp_b64_encode_len(bytes.size()));
+    size_t l = bytes.empty() ? 0
+                             : modp_b64_encode(
+                                   &scratch[0],
+                                   reinterpret_cast<const char*>(bytes.data()),
+                                   bytes.size());
+    w.String(scratch.data(), l);
 }
 std::vector<uint8_t> B64Decode(const std::string& s) {
     if (s.length() == 0) return std::vector<uint8_t>();
@@ -122,193 +101,325 @@ std::vector<uint8_t> B64Decode(const std::string& s) {
     return ret;
 }
 
-std::string JsonUint64(uint64_t x) {
-    // Json doesn't support 64-bit integers, so protobufs use strings
-    // https://developers.google.com/protocol-buffers/docs/proto3#json
-    std::stringstream s;
-    s << x;
-    return s.str();
-}
-Json::object JsonSerializer::TelemetryContextJson(
-    const AnnotationId& annotation_id, const RequestInfo& request_info,
-    const Duration& duration) {
-    SerializedAnnotation annotation;
-    id_provider_->AnnotationIdToSerializedAnnotation(annotation_id, annotation);
-    return Json::object{
-        {"annotations", B64Encode(annotation)},
-        {"tuning_parameters",
-         Json::object{{"experiment_id", request_info.experiment_id},
-                      {"serialized_fidelity_parameters",
-                       B64Encode(request_info.current_fidelity_parameters)}}},
-        {"duration", DurationToSecondsString(duration)}};
+void JsonSerializer::WriteTelemetryContext(JsonWriter& w,
+                                           const AnnotationId& annotation_id,
+                                           const RequestInfo& request_info,
+                                           Duration duration) {
+    // Don't write the previous annotation if this one can't be found.
+    annotation_.clear();
+    id_provider_->AnnotationIdToSerializedAnnotation(annotation_id,
+                                                     annotation_);
+    w.BeginObject();
+    w.Key("annotations");
+    WriteB64(w, annotation_, b64_);
+    w.Key("duration");
+    w.Seconds(duration);
+    w.Key("tuning_parameters");
+    w.BeginObject();
+    w.Key("experiment_id");
+    w.String(request_info.experiment_id);
+    w.Key("serialized_fidelity_parameters");
+    WriteB64(w, request_info.current_fidelity_parameters, b64_);
+    w.EndObject();
+    w.EndObject();
 }
 
-#define SET_METADATA_FIELD(OBJ, KEY) \
-    if (md.KEY != 0) OBJ[#KEY] = md.KEY;
-
-static std::string DurationJsonFromNanos(int64_t ns) {
-    // For JSON, we should return a string with the number of seconds.
-    // https://github.com/protocolbuffers/protobuf/blob/master/src/google/protobuf/duration.proto
-    double dns = ns;
-    dns /= 1000000000.0;
-    std::stringstream str;
-    str << JsonSerializer::FixedAndTruncated(dns) << "s";
-    return str.str();
-}
+#define WRITE_METADATA_FIELD(W, KEY) \
+    if (md.KEY != 0) {               \
+        W.Key(#KEY);                 \
+        W.Int(md.KEY);               \
+    }
 
-Json::object JsonSerializer::LoadingTimeMetadataJson(
-    const LoadingTimeMetadataWithGroup& mdg) {
+void JsonSerializer::WriteLoadingTimeMetadata(
+    JsonWriter& w, const LoadingTimeMetadataWithGroup& mdg) {
     const LoadingTimeMetadata& md = mdg.metadata;
-    Json::object ret;
-    SET_METADATA_FIELD(ret, state);
-    SET_METADATA_FIELD(ret, source);
-    SET_METADATA_FIELD(ret, compression_level);
+    w.BeginObject();
+    WRITE_METADATA_FIELD(w, compression_level);
+    if (!mdg.group_id.empty()) {
+        w.Key("group_id");
+        w.String(mdg.group_id);
+    }
     if (md.network_connectivity != 0 || md.network_transfer_speed_bps != 0 ||
         md.network_latency_ns != 0) {
-        Json::object network_info;
-        if (md.network_connectivity != 0)
-            network_info["connectivity"] = md.network_connectivity;
-        if (md.network_transfer_speed_bps != 0)
-            network_info["bandwidth_bps"] =
-                JsonUint64(md.network_transfer_speed_bps);
-        if (md.network_latency_ns != 0)
-            network_info["latency"] =
-                DurationJsonFromNanos(md.network_latency_ns);
-        ret["network_info"] = network_info;
+        w.Key("network_info");
+        w.BeginObject();
+        if (md.network_transfer_speed_bps != 0) {
+            w.Key("bandwidth_bps");
+            w.Uint64(md.network_transfer_speed_bps);
+        }
+        if (md.network_connectivity != 0) {
+            w.Key("connectivity");
+            w.Int(md.network_connectivity);
+        }
+        if (md.network_latency_ns != 0) {
+            w.Key("latency");
+            w.Seconds(static_cast<int64_t>(md.network_latency_ns));
+        }
+        w.EndObject();
     }
-    if (!mdg.group_id.empty()) ret["group_id"] = mdg.group_id;
-    return ret;
+    WRITE_METADATA_FIELD(w, source);
+    WRITE_METADATA_FIELD(w, state);
+    w.EndObject();
 }
 
-static Json::array SerializeIntervalVector(
-    const std::vector<ProcessTimeInterval>& intervals) {
-    Json::array result;
-    for (const auto& i : intervals) {
-        result.push_back(
-            Json::object{{"start", DurationToSecondsString(i.Start())},
-                         {"end", DurationToSecondsString(i.End())}});
+static void WriteJank(JsonWriter& w, const JankMetricData& jank) {
+    auto j = jank.Finished();
+    w.BeginObject();
+    w.Key("big_janks");
+    w.Uint64(j.big_janks_);
+    w.Key("frames");
+    w.Uint64(j.frames_);
+    w.Key("janky_frames");
+    w.Uint64(j.janky_frames_);
+    w.Key("longest_run");
+    w.Uint64(j.longest_run_);
+    w.Key("missed_frames");
+    w.Uint64(j.missed_frames_);
+    w.Key("runs");
+    w.BeginArray();
+    for (auto r : j.runs_) w.Uint64(r);
+    w.EndArray();
+    w.Key("stutter_clusters");
+    w.Uint64(j.stutter_clusters_);
+    w.EndObject();
+}
+
+static void WriteInterval(JsonWriter& w, const ProcessTimeInterval& i) {
+    w.BeginObject();
+    w.Key("end");
+    w.Seconds(i.End());
+    w.Key("start");
+    w.Seconds(i.Start());
+    w.EndObject();
+}
+
+static void WriteLoadingBreakdown(JsonWriter& w,
+                                  const LoadingBreakdown& breakdown) {
+    w.BeginObject();
+    w.Key("parallelism");
+    w.Double(breakdown.Parallelism());
+    w.Key("stages");
+    w.BeginArray();
+    for (int i = 0; i < LoadingBreakdown::kNumStages; ++i) {
+        auto& stage = breakdown.stages[i];
+        if (stage.exclusive == Duration::zero() &&
+            stage.critical_path == Duration::zero())
+            continue;
+        w.BeginObject();
+        w.Key("critical_path");
+        w.Seconds(stage.critical_path);
+        w.Key("exclusive");
+        w.Seconds(stage.exclusive);
+        w.Key("source");
+        w.Int(i);
+        w.EndObject();
     }
-    return result;
+    w.EndArray();
+    w.EndObject();
 }
 
-Json::object JsonSerializer::TelemetryReportJson(const AnnotationId& annotation,
-                                                 bool& empty,
-                                                 Duration& duration) {
-    std::vector<Json::object> render_histograms;
-    std::vector<Json::object> loading_events;
-    std::vector<Json::object> battery_events;
-    std::vector<Json::object> thermal_events;
-    std::vector<Json::object> memory_events;
-    duration = Duration::zero();
-    for (const auto& th :
-         session_.GetNonEmptyHistograms<FrameTimeMetricData>()) {
-        auto ft = th->metric_id_.detail;
-        if (ft.annotation != annotation) continue;
-        std::vector<int32_t> counts;
-        for (auto& c : th->histogram_.buckets())
-            counts.push_back(static_cast<int32_t>(c));
-        Json::object o{{"counts", counts}};
-        o["instrument_id"] = session_.GetInstrumentationKey(ft.frame_time.ikey);
-        render_histograms.push_back(o);
-        duration = std::max(th->duration_, duration);
+// Writes "key": {"array_key": [ before the first element of an array that is
+// left out if empty, and closes it at the end.
+class LazyArray {
+   public:
+    LazyArray(JsonWriter& w, const char* key, const char* array_key)
+        : w_(w), key_(key), array_key_(array_key) {}
+    ~LazyArray() {
+        if (started_) {
+            w_.EndArray();
+            w_.EndObject();
+        }
     }
-    for (const auto& th :
-         session_.GetNonEmptyHistograms<LoadingTimeMetricData>()) {
-        if (th->metric_id_.detail.annotation != annotation) continue;
-        std::vector<int> loading_events_times;
-        std::vector<ProcessTimeInterval> loading_events_intervals;
-        for (const auto& c : th->data_.Samples()) {
-            if (c.IsDuration()) {
-                loading_events_times.push_back(
-                    std::chrono::duration_cast<std::chrono::milliseconds>(
-                        c.Duration())
-                        .count());
-            } else {
-                loading_events_intervals.push_back(c);
+    void Element() {
+        if (started_) return;
+        w_.Key(key_);
+        w_.BeginObject();
+        w_.Key(array_key_);
+        w_.BeginArray();
+        started_ = true;
+    }
+    bool Started() const { return started_; }
+
+   private:
+    JsonWriter& w_;
+    const char* key_;
+    const char* array_key_;
+    bool started_ = false;
+};
+
+void JsonSerializer::WriteTelemetryReport(JsonWriter& w,
+                                          const AnnotationId& annotation,
+                                          bool& empty, Duration& duration) {
+    duration = Duration::zero();
+    empty = true;
+    w.BeginObject();
+    {
+        LazyArray battery(w, "battery", "battery_event");
+        for (const auto& th :
+             session_.GetNonEmptyHistograms<BatteryMetricData>()) {
+            if (th->metric_id_.detail.annotation != annotation) continue;
+            for (auto& report : th->data_) {
+                battery.Element();
+                w.BeginObject();
+                w.Key("app_on_foreground");
+                w.Bool(report.app_on_foreground_);
+                w.Key("charging");
+                w.Bool(report.is_charging_);
+                w.Key("current_charge_microampere_hours");
+                w.Int(report.current_charge_);
+                w.Key("event_time");
+                w.Seconds(report.time_since_process_start_);
+                w.Key("percentage");
+                w.Int(report.percentage_);
+                w.Key("power_save_mode");
+                w.Bool(report.power_save_mode_);
+                w.EndObject();
             }
-            duration = std::max(th->duration_, duration);
         }
-        if (loading_events_times.size() > 0 ||
-            loading_events_intervals.size() > 0) {
+    }
+    {
+        LazyArray loading(w, "loading", "loading_events");
+        for (const auto& th :
+             session_.GetNonEmptyHistograms<LoadingTimeMetricData>()) {
+            if (th->metric_id_.detail.annotation != annotation) continue;
+            bool has_times = false;
+            bool has_intervals = false;
+            for (const auto& c : th->data_.Samples()) {
+                (c.IsDuration() ? has_times : has_intervals) = true;
+                duration = std::max(th->duration_, duration);
+            }
+            if (!has_times && !has_intervals) continue;
             LoadingTimeMetadataWithGroup md;
             if (id_provider_->MetricIdToLoadingTimeMetadata(
-                    th->metric_id_, md) == TUNINGFORK_ERROR_OK) {
-                Json::object o({});
-                if (loading_events_times.size() > 0)
-                    o["times_ms"] = loading_events_times;
-                if (loading_events_intervals.size() > 0)
-                    o["intervals"] =
-                        SerializeIntervalVector(loading_events_intervals);
-                o["loading_metadata"] = LoadingTimeMetadataJson(md);
-                loading_events.push_back(o);
+                    th->metric_id_, md) != TUNINGFORK_ERROR_OK)
+                continue;
+            loading.Element();
+            w.BeginObject();
+            if (has_intervals) {
+                w.Key("intervals");
+                w.BeginArray();
+                for (const auto& c : th->data_.Samples())
+                    if (!c.IsDuration()) WriteInterval(w, c);
+                w.EndArray();
+            }
+            if (!th->breakdown_.Empty()) {
+                w.Key("loading_breakdown");
+                WriteLoadingBreakdown(w, th->breakdown_);
+            }
+            w.Key("loading_metadata");
+            WriteLoadingTimeMetadata(w, md);
+            if (has_times) {
+                w.Key("times_ms");
+                w.BeginArray();
+                for (const auto& c : th->data_.Samples())
+                    if (c.IsDuration())
+                        w.Int(static_cast<int>(
+                            duration_cast<milliseconds>(c.Duration()).count()));
+                w.EndArray();
             }
+            w.EndObject();
         }
+        if (loading.Started()) empty = false;
     }
-    for (const auto& th : session_.GetNonEmptyHistograms<BatteryMetricData>()) {
-        auto ft = th->metric_id_.detail;
-        if (ft.annotation != annotation) continue;
-        for (auto& report : th->data_) {
-            Json::object o({});
-            o["event_time"] =
-                DurationToSecondsString(report.time_since_process_start_);
-            o["percentage"] = report.percentage_;
-            o["current_charge_microampere_hours"] = report.current_charge_;
-            o["charging"] = report.is_charging_;
-            o["app_on_foreground"] = report.app_on_foreground_;
-            o["power_save_mode"] = report.power_save_mode_;
-            battery_events.push_back(o);
+    {
+        LazyArray memory(w, "memory", "memory_event");
+        for (const auto& th :
+             session_.GetNonEmptyHistograms<MemoryMetricData>()) {
+            if (th->metric_id_.detail.annotation != annotation) continue;
+            for (auto& report : th->data_) {
+                memory.Element();
+                w.BeginObject();
+                w.Key("avail_mem");
+                w.Double(static_cast<double>(report.avail_mem_));
+                w.Key("event_time");
+                w.Seconds(report.time_since_process_start_);
+                w.Key("oom_score");
+                w.Double(static_cast<double>(report.oom_score_));
+                w.Key("proportional_set_size");
+                w.Double(static_cast<double>(report.proportional_set_size_));
+                w.EndObject();
+            }
         }
     }
-    for (const auto& th : session_.GetNonEmptyHistograms<ThermalMetricData>()) {
-        auto ft = th->metric_id_.detail;
-        if (ft.annotation != annotation) continue;
-        for (auto& report : th->data_) {
-            Json::object o({});
-            o["event_time"] =
-                DurationToSecondsString(report.time_since_process_start_);
-            o["thermal_state"] = report.thermal_state_;
-            thermal_events.push_back(o);
+    {
+        LazyArray rendering(w, "rendering", "render_time_histogram");
+        for (const auto& th :
+             session_.GetNonEmptyHistograms<FrameTimeMetricData>()) {
+            auto ft = th->metric_id_.detail;
+            if (ft.annotation != annotation) continue;
+            rendering.Element();
+            w.BeginObject();
+            if (!th->use_quantiles_) {
+                w.Key("counts");
+                w.BeginArray();
+                for (auto c : th->ScaledCounts())
+                    w.Int(static_cast<int32_t>(c));
+                w.EndArray();
+            }
+            w.Key("instrument_id");
+            w.Int(session_.GetInstrumentationKey(ft.frame_time.ikey));
+            if (!th->jank_.Empty()) {
+                w.Key("jank");
+                WriteJank(w, th->jank_);
+            }
+            auto& h = th->histogram_;
+            if (!th->use_quantiles_ &&
+                h.GetMode() == HistogramBase::Mode::LOG_LINEAR) {
+                // The bucket boundaries can be reconstructed from these.
+                w.Key("log_linear_buckets");
+                w.BeginObject();
+                w.Key("start");
+                w.Double(h.BucketStart());
+                w.Key("sub_bucket_bits");
+                w.Int(static_cast<int>(h.SubBucketBits()));
+                w.EndObject();
+            }
+            if (th->use_quantiles_) {
+                auto& q = th->quantiles_;
+                w.Key("quantile_sketch");
+                w.BeginObject();
+                w.Key("count");
+                w.Uint64(th->ScaledQuantileCount());
+                w.Key("k");
+                w.Int(q.K());
+                w.Key("levels");
+                w.BeginArray();
+                for (auto& level : q.Levels()) {
+                    w.BeginArray();
+                    for (auto x : level) w.Double(x);
+                    w.EndArray();
+                }
+                w.EndArray();
+                w.EndObject();
+            }
+            // Counts, including the sketch's, are already scaled: this is for
+            // information.
+            if (th->sample_period_ > 1) {
+                w.Key("sample_period");
+                w.Int(static_cast<int>(th->sample_period_));
+            }
+            w.EndObject();
+            duration = std::max(th->duration_, duration);
         }
+        if (rendering.Started()) empty = false;
     }
-    for (const auto& th : session_.GetNonEmptyHistograms<MemoryMetricData>()) {
-        auto ft = th->metric_id_.detail;
-        if (ft.annotation != annotation) continue;
-        for (auto& report : th->data_) {
-            Json::object o({});
-            o["event_time"] =
-                DurationToSecondsString(report.time_since_process_start_);
-            o["avail_mem"] = static_cast<double>(report.avail_mem_);
-            o["oom_score"] = static_cast<double>(report.oom_score_);
-            o["proportional_set_size"] =
-                static_cast<double>(report.proportional_set_size_);
-            memory_events.push_back(o);
+    {
+        LazyArray thermal(w, "thermal", "thermal_event");
+        for (const auto& th :
+             session_.GetNonEmptyHistograms<ThermalMetricData>()) {
+            if (th->metric_id_.detail.annotation != annotation) continue;
+            for (auto& report : th->data_) {
+                thermal.Element();
+                w.BeginObject();
+                w.Key("event_time");
+                w.Seconds(report.time_since_process_start_);
+                w.Key("thermal_state");
+                w.Int(report.thermal_state_);
+                w.EndObject();
+            }
         }
     }
-
-    int total_size = render_histograms.size() + loading_events.size();
-    empty = (total_size == 0);
-    Json::object ret;
-    if (render_histograms.size() > 0) {
-        ret["rendering"] =
-            Json::object{{"render_time_histogram", render_histograms}};
-    }
-    // Loading events
-    if (loading_events.size() > 0) {
-        ret["loading"] = Json::object{{"loading_events", loading_events}};
-    }
-    // Battery events
-    if (battery_events.size() > 0) {
-        ret["battery"] = Json::object{{"battery_event", battery_events}};
-    }
-    // Thermal events
-    if (thermal_events.size() > 0) {
-        ret["thermal"] = Json::object{{"thermal_event", thermal_events}};
-    }
-    // Memory events
-    if (memory_events.size() > 0) {
-        ret["memory"] = Json::object{{"memory_event", memory_events}};
-    }
-    return ret;
+    w.EndObject();
 }
 
 static int LifecycleEventType(TuningFork_LifecycleState state) {
@@ -322,120 +433,150 @@ static int LifecycleEventType(TuningFork_LifecycleState state) {
     }
 }
 
-Json::object JsonSerializer::PartialLoadingTelemetryReportJson(
-    const AnnotationId& annotation, const LifecycleUploadEvent& lifecycle_event,
-    Duration& duration) {
-    std::vector<Json::object> loading_events;
+void JsonSerializer::WritePartialLoadingTelemetryReport(
+    JsonWriter& w, const AnnotationId& annotation,
+    const LifecycleUploadEvent& lifecycle_event, Duration& duration) {
+    w.BeginObject();
+    bool started = false;
     for (const auto& e : lifecycle_event.loading_events) {
         if (e.id.detail.annotation != annotation) continue;
         LoadingTimeMetadataWithGroup md;
-        if (id_provider_->MetricIdToLoadingTimeMetadata(e.id, md) ==
-            TUNINGFORK_ERROR_OK) {
-            Json::object o({});
-            o["intervals"] = SerializeIntervalVector({e.interval});
-            duration += e.interval.Duration();
-            o["loading_metadata"] = LoadingTimeMetadataJson(md);
-            loading_events.push_back(o);
+        if (id_provider_->MetricIdToLoadingTimeMetadata(e.id, md) !=
+            TUNINGFORK_ERROR_OK)
+            continue;
+        if (!started) {
+            w.Key("partial_loading");
+            w.BeginObject();
+            w.Key("event_type");
+            w.Int(LifecycleEventType(lifecycle_event.state));
+            w.Key("report");
+            w.BeginObject();
+            w.Key("loading_events");
+            w.BeginArray();
+            started = true;
         }
+        w.BeginObject();
+        w.Key("intervals");
+        w.BeginArray();
+        WriteInterval(w, e.interval);
+        w.EndArray();
+        duration += e.interval.Duration();
+        w.Key("loading_metadata");
+        WriteLoadingTimeMetadata(w, md);
+        w.EndObject();
     }
-    Json::object ret;
-    if (loading_events.size() > 0) {
-        ret["partial_loading"] = Json::object{
-            {"event_type", LifecycleEventType(lifecycle_event.state)},
-            {"report", Json::object{{"loading_events", loading_events}}}};
+    if (started) {
+        w.EndArray();
+        w.EndObject();
+        w.EndObject();
     }
-    return ret;
+    w.EndObject();
 }
 
-Json::object JsonSerializer::TelemetryJson(const AnnotationId& annotation,
-                                           const RequestInfo& request_info,
-                                           Duration& duration, bool& empty) {
-    auto report = TelemetryReportJson(annotation, empty, duration);
-    return Json::object{
-        {"context", TelemetryContextJson(annotation, request_info, duration)},
-        {"report", report}};
-}
-Json::object JsonSerializer::PartialLoadingTelemetryJson(
-    const AnnotationId& annotation, const LifecycleUploadEvent& event,
-    const RequestInfo& request_info) {
-    Duration duration = Duration::zero();
-    auto report =
-        PartialLoadingTelemetryReportJson(annotation, event, duration);
-    return Json::object{
-        {"context", TelemetryContextJson(annotation, request_info, duration)},
-        {"report", report}};
+void JsonSerializer::WriteTelemetry(JsonWriter& w,
+                                    const AnnotationId& annotation,
+                                    const RequestInfo& request_info,
+                                    Duration duration) {
+    // The context depends on the report's duration but comes first, so the
+    // report has already been written to report_.
+    w.BeginObject();
+    w.Key("context");
+    WriteTelemetryContext(w, annotation, request_info, duration);
+    w.Key("report");
+    w.Raw(report_);
+    w.EndObject();
 }
 
-void JsonSerializer::SerializeTelemetryRequest(
-    const RequestInfo& request_info, const std::vector<Json::object>& telemetry,
-    std::string& evt_json_ser) {
-    std::map<std::string, Json> context_items = {
-        {"device", json_utils::DeviceSpecJson(request_info)},
-        {"game_sdk_info", GameSdkInfoJson(request_info)},
-        {"time_period",
-         Json::object{{"start_time", TimeToRFC3339(session_.time().start)},
-                      {"end_time", TimeToRFC3339(session_.time().end)}}}};
-    if (!session_.GetCrashReports().empty())
-        context_items["crash_reports"] = CrashReportsJson(request_info);
-    Json session_context = Json::object{context_items};
-    Json telemetry_request =
-        Json::object{{"name", json_utils::GetResourceName(request_info)},
-                     {"session_context", session_context},
-                     {"telemetry", telemetry}};
-    evt_json_ser = telemetry_request.dump();
+void JsonSerializer::BeginTelemetryRequest(JsonWriter& w,
+                                           const RequestInfo& request_info) {
+    w.BeginObject();
+    w.Key("name");
+    w.String(json_utils::GetResourceName(request_info));
+    w.Key("session_context");
+    w.BeginObject();
+    if (!session_.GetCrashReports().empty()) {
+        w.Key("crash_reports");
+        WriteCrashReports(w, request_info);
+    }
+    // The device spec is shared with the generateTuningParameters request.
+    w.Key("device");
+    w.Raw(Json(json_utils::DeviceSpecJson(request_info)).dump());
+    w.Key("game_sdk_info");
+    WriteGameSdkInfo(w, request_info);
+    w.Key("time_period");
+    w.BeginObject();
+    w.Key("end_time");
+    w.Time(session_.time().end);
+    w.Key("start_time");
+    w.Time(session_.time().start);
+    w.EndObject();
+    w.EndObject();
+    w.Key("telemetry");
+    w.BeginArray();
 }
 
 void JsonSerializer::SerializeEvent(const RequestInfo& request_info,
                                     std::string& evt_json_ser) {
-    std::vector<Json::object> telemetry;
+    evt_json_ser.clear();
+    JsonWriter w(evt_json_ser);
+    BeginTelemetryRequest(w, request_info);
     // Loop over unique annotations
-    std::set<AnnotationId> annotations;
+    annotations_.clear();
     for (const auto& p :
          session_.GetNonEmptyHistograms<FrameTimeMetricData>()) {
-        annotations.insert(p->metric_id_.detail.annotation);
+        annotations_.insert(p->metric_id_.detail.annotation);
     }
     for (const auto& p :
          session_.GetNonEmptyHistograms<LoadingTimeMetricData>()) {
-        annotations.insert(p->metric_id_.detail.annotation);
+        annotations_.insert(p->metric_id_.detail.annotation);
     }
-    Duration max_duration = Duration::zero();
-    for (auto& a : annotations) {
+    for (auto& a : annotations_) {
         bool empty;
         Duration duration = Duration::zero();
-        auto tel = TelemetryJson(a, request_info, duration, empty);
-        max_duration = std::max(max_duration, duration);
-        if (!empty) telemetry.push_back(tel);
+        report_.clear();
+        JsonWriter report_writer(report_);
+        WriteTelemetryReport(report_writer, a, empty, duration);
+        if (!empty) WriteTelemetry(w, a, request_info, duration);
     }
-    SerializeTelemetryRequest(request_info, telemetry, evt_json_ser);
+    w.EndArray();
+    w.EndObject();
 }
 
 void JsonSerializer::SerializeLifecycleEvent(const LifecycleUploadEvent& event,
                                              const RequestInfo& request_info,
                                              std::string& evt_json_ser) {
-    std::vector<Json::object> telemetry;
+    evt_json_ser.clear();
+    JsonWriter w(evt_json_ser);
+    BeginTelemetryRequest(w, request_info);
     // Loop over unique annotations
-    std::set<AnnotationId> annotations;
+    annotations_.clear();
     for (const auto& p : event.loading_events) {
-        annotations.insert(p.id.detail.annotation);
+        annotations_.insert(p.id.detail.annotation);
     }
-    for (const auto& a : annotations) {
-        telemetry.push_back(
-            PartialLoadingTelemetryJson(a, event, request_info));
+    for (const auto& a : annotations_) {
+        Duration duration = Duration::zero();
+        report_.clear();
+        JsonWriter report_writer(report_);
+        WritePartialLoadingTelemetryReport(report_writer, a, event, duration);
+        WriteTelemetry(w, a, request_info, duration);
     }
-    SerializeTelemetryRequest(request_info, telemetry, evt_json_ser);
+    w.EndArray();
+    w.EndObject();
 }
 
-std::vector<Json::object> JsonSerializer::CrashReportsJson(
-    const RequestInfo& request_info) {
-    std::vector<Json::object> crash_reports;
-    std::vector<CrashReason> session_crash_reports = session_.GetCrashReports();
-    for (int i = 0; i < session_crash_reports.size(); i++) {
-        crash_reports.push_back(Json::object{
-            {"crash_reason", static_cast<int>(session_crash_reports[i])},
-            {"session_id", request_info.previous_session_id}});
+void JsonSerializer::WriteCrashReports(JsonWriter& w,
+                                       const RequestInfo& request_info) {
+    w.BeginArray();
+    for (auto crash_reason : session_.GetCrashReports()) {
+        w.BeginObject();
+        w.Key("crash_reason");
+        w.Int(static_cast<int>(crash_reason));
+        w.Key("session_id");
+        w.String(request_info.previous_session_id);
+        w.EndObject();
     }
-    return crash_reports;
-};
+    w.EndArray();
+}
 
 std::string Serialize(std::vector<uint32_t> vs) {
     std::stringstream str;
@@ -453,7 +594,33 @@ struct Hist {
     uint64_t instrument_id;
     Duration duration;
     std::vector<uint32_t> counts;
+    bool log_linear;
+    // Only used for quantile sketches
+    bool quantiles;
+    int k;
+    uint64_t count;
+    std::vector<std::vector<float>> levels;
+    JankMetricData jank;
 };
+
+uint64_t JsonToUint64(const Json& x) {
+    return strtoull(x.string_value().c_str(), nullptr, 10);
+}
+
+JankMetricData JankFromJson(const Json& in) {
+    JankMetricData jank;
+    jank.frames_ = JsonToUint64(in["frames"]);
+    jank.janky_frames_ = JsonToUint64(in["janky_frames"]);
+    jank.missed_frames_ = JsonToUint64(in["missed_frames"]);
+    jank.big_janks_ = JsonToUint64(in["big_janks"]);
+    jank.stutter_clusters_ = JsonToUint64(in["stutter_clusters"]);
+    jank.longest_run_ = JsonToUint64(in["longest_run"]);
+    auto& runs = in["runs"].array_items();
+    for (size_t i = 0; i < JankMetricData::kMaxRunLength && i < runs.size();
+         ++i)
+        jank.runs_[i] = JsonToUint64(runs[i]);
+    return jank;
+}
 }  // namespace
 
 /* static */ TuningFork_ErrorCode JsonSerializer::DeserializeAndMerge(
@@ -492,8 +659,28 @@ struct Hist {
             for (auto& c : histogram["counts"].array_items()) {
                 cs.push_back(c.int_value());
             }
-            if (cs.size() > 0)
-                hists.push_back({annotation, fps, instrument_id, duration, cs});
+            bool log_linear = !histogram["log_linear_buckets"].is_null();
+            auto& sketch = histogram["quantile_sketch"];
+            if (!sketch.is_null()) {
+                std::vector<std::vector<float>> levels;
+                for (auto& level : sketch["levels"].array_items()) {
+                    levels.emplace_back();
+                    for (auto& x : level.array_items())
+                        levels.back().push_back(x.number_value());
+                }
+                uint64_t count = JsonToUint64(sketch["count"]);
+                if (count == 0) continue;
+                hists.push_back({annotation, fps, instrument_id, duration, {},
+                                 false, true, sketch["k"].int_value(), count,
+                                 levels});
+            } else if (cs.size() > 0) {
+                hists.push_back({annotation, fps, instrument_id, duration, cs,
+                                 log_linear, false});
+            } else {
+                continue;
+            }
+            auto& jank = histogram["jank"];
+            if (!jank.is_null()) hists.back().jank = JankFromJson(jank);
         }
     }
 
@@ -509,8 +696,20 @@ struct Hist {
         if (r != TUNINGFORK_ERROR_OK) return r;
         auto p = session.GetData<FrameTimeMetricData>(id);
         if (p == nullptr) return TUNINGFORK_ERROR_BAD_PARAMETER;
-        auto& orig_counts = p->histogram_.buckets();
-        p->histogram_.AddCounts(h.counts);
+        if (h.quantiles != p->use_quantiles_)
+            return TUNINGFORK_ERROR_BAD_PARAMETER;
+        p->jank_.Merge(h.jank);
+        if (h.quantiles) {
+            if (h.k != p->quantiles_.K()) return TUNINGFORK_ERROR_BAD_PARAMETER;
+            auto result = p->MergeScaledQuantiles(h.levels, h.count);
+            if (result != TUNINGFORK_ERROR_OK) return result;
+            continue;
+        }
+        // Counts only line up if the buckets are of the same kind.
+        if (h.log_linear != (p->histogram_.GetMode() ==
+                             HistogramBase::Mode::LOG_LINEAR))
+            return TUNINGFORK_ERROR_BAD_PARAMETER;
+        p->AddScaledCounts(std::move(h.counts));
     }
     return TUNINGFORK_ERROR_OK;
 }
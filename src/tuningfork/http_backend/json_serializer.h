@@ -17,12 +17,14 @@
 #pragma once
 
 #include <json11/json11.hpp>
+#include <set>
 #include <string>
 #include <vector>
 
 #include "core/id_provider.h"
 #include "core/lifecycle_upload_event.h"
 #include "core/session.h"
+#include "json_writer.h"
 
 namespace tuningfork {
 
@@ -31,6 +33,7 @@ class JsonSerializer {
     JsonSerializer(const Session& session, IdProvider* id_provider)
         : session_(session), id_provider_(id_provider) {}
 
+    // These overwrite evt_json_ser, reusing its capacity.
     void SerializeEvent(const RequestInfo& device_info,
                         std::string& evt_json_ser);
 
@@ -47,37 +50,37 @@ class JsonSerializer {
     static std::string FixedAndTruncated(double d);
 
    private:
-    json11::Json::object TelemetryContextJson(const AnnotationId& annotation,
-                                              const RequestInfo& request_info,
-                                              const Duration& duration);
+    void WriteTelemetryContext(JsonWriter& w, const AnnotationId& annotation,
+                               const RequestInfo& request_info,
+                               Duration duration);
 
-    json11::Json::object TelemetryReportJson(const AnnotationId& annotation,
-                                             bool& empty, Duration& duration);
+    void WriteTelemetryReport(JsonWriter& w, const AnnotationId& annotation,
+                              bool& empty, Duration& duration);
 
-    json11::Json::object PartialLoadingTelemetryReportJson(
-        const AnnotationId& annotation, const LifecycleUploadEvent& event,
-        Duration& duration);
+    void WritePartialLoadingTelemetryReport(JsonWriter& w,
+                                            const AnnotationId& annotation,
+                                            const LifecycleUploadEvent& event,
+                                            Duration& duration);
 
-    json11::Json::object TelemetryJson(const AnnotationId& annotation,
-                                       const RequestInfo& request_info,
-                                       Duration& duration, bool& empty);
+    void WriteTelemetry(JsonWriter& w, const AnnotationId& annotation,
+                        const RequestInfo& request_info, Duration duration);
 
-    json11::Json::object PartialLoadingTelemetryJson(
-        const AnnotationId& annotation, const LifecycleUploadEvent& event,
-        const RequestInfo& request_info);
+    void WriteLoadingTimeMetadata(JsonWriter& w,
+                                  const LoadingTimeMetadataWithGroup& md);
+    void WriteCrashReports(JsonWriter& w, const RequestInfo& request_info);
 
-    json11::Json::object LoadingTimeMetadataJson(
-        const LoadingTimeMetadataWithGroup& md);
-    std::vector<json11::Json::object> CrashReportsJson(
-        const RequestInfo& request_info);
-
-    void SerializeTelemetryRequest(
-        const RequestInfo& request_info,
-        const std::vector<json11::Json::object>& telemetry,
-        std::string& evt_json_ser);
+    // Writes everything up to the start of the telemetry array.
+    void BeginTelemetryRequest(JsonWriter& w, const RequestInfo& request_info);
 
     const Session& session_;
     IdProvider* id_provider_;
+    // Scratch space, reused for each annotation in a session so that they
+    // don't each allocate. A serializer is made per upload, so nothing is
+    // kept between uploads.
+    std::string report_;
+    std::string b64_;
+    SerializedAnnotation annotation_;
+    std::set<AnnotationId> annotations_;
 };
 
 }  // namespace tuningfork
@@ -0,0 +1,285 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "json_writer.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+// TODO(b/140155101): Move the date library into aosp/external
+#include "date/date.h"
+
+namespace tuningfork {
+
+using namespace std::chrono;
+
+namespace {
+
+constexpr int64_t kNanosPerSecond = 1000000000;
+// Below this many seconds, a whole number of nanoseconds converted to seconds
+// as a double is within 2^-31s of its exact value, so rounding it to 9 decimal
+// places gives back the exact number of nanoseconds.
+constexpr int64_t kExactSeconds = int64_t(1) << 22;
+// Doubles up to 2^53 hold integers exactly and %.17g writes them in full.
+constexpr double kExactIntegers = 9007199254740992.0;
+
+// The number of digits after the decimal point in a system_clock time, or -1
+// if its period isn't a power of ten.
+constexpr int FractionDigits() {
+    int digits = 0;
+    auto den = system_clock::period::den;
+    if (system_clock::period::num != 1) return -1;
+    for (; den > 1; den /= 10) {
+        if (den % 10 != 0) return -1;
+        ++digits;
+    }
+    return digits;
+}
+
+// Write the digits of x, at least min_digits of them, so they end at end, and
+// return where they start.
+char* FormatUint(uint64_t x, char* end, int min_digits = 1) {
+    char* p = end;
+    do {
+        *--p = static_cast<char>('0' + x % 10);
+        x /= 10;
+    } while (x != 0 || end - p < min_digits);
+    return p;
+}
+
+void AppendInt(std::string& out, int64_t x) {
+    char buf[24];
+    char* end = buf + sizeof(buf);
+    uint64_t u = x < 0 ? 0 - static_cast<uint64_t>(x) : x;
+    char* p = FormatUint(u, end);
+    if (x < 0) *--p = '-';
+    out.append(p, end - p);
+}
+
+}  // anonymous namespace
+
+void JsonWriter::BeginValue() {
+    if (after_key_)
+        after_key_ = false;
+    else if (!first_)
+        out_ += ", ";
+    first_ = false;
+}
+
+void JsonWriter::BeginObject() {
+    BeginValue();
+    out_ += '{';
+    first_ = true;
+}
+
+void JsonWriter::EndObject() {
+    out_ += '}';
+    first_ = false;
+}
+
+void JsonWriter::BeginArray() {
+    BeginValue();
+    out_ += '[';
+    first_ = true;
+}
+
+void JsonWriter::EndArray() {
+    out_ += ']';
+    first_ = false;
+}
+
+void JsonWriter::Key(const char* key) {
+    String(key, strlen(key));
+    out_ += ": ";
+    after_key_ = true;
+}
+
+void JsonWriter::String(const char* s, size_t size) {
+    BeginValue();
+    out_ += '"';
+    // Escape the same characters as json11.
+    for (size_t i = 0; i < size; ++i) {
+        char ch = s[i];
+        auto u = static_cast<uint8_t>(ch);
+        if (ch == '\\') {
+            out_ += "\\\\";
+        } else if (ch == '"') {
+            out_ += "\\\"";
+        } else if (ch == '\b') {
+            out_ += "\\b";
+        } else if (ch == '\f') {
+            out_ += "\\f";
+        } else if (ch == '\n') {
+            out_ += "\\n";
+        } else if (ch == '\r') {
+            out_ += "\\r";
+        } else if (ch == '\t') {
+            out_ += "\\t";
+        } else if (u <= 0x1f) {
+            static const char kHex[] = "0123456789abcdef";
+            char esc[] = {'\\', 'u', '0', '0', kHex[u >> 4], kHex[u & 0xf]};
+            out_.append(esc, sizeof(esc));
+        } else if (u == 0xe2 && i + 2 < size &&
+                   static_cast<uint8_t>(s[i + 1]) == 0x80 &&
+                   (static_cast<uint8_t>(s[i + 2]) == 0xa8 ||
+                    static_cast<uint8_t>(s[i + 2]) == 0xa9)) {
+            // U+2028 and U+2029
+            out_ += static_cast<uint8_t>(s[i + 2]) == 0xa8 ? "\\u2028"
+                                                           : "\\u2029";
+            i += 2;
+        } else {
+            out_ += ch;
+        }
+    }
+    out_ += '"';
+}
+
+void JsonWriter::Int(int64_t x) {
+    BeginValue();
+    AppendInt(out_, x);
+}
+
+void JsonWriter::Double(double x) {
+    BeginValue();
+    if (!std::isfinite(x)) {
+        out_ += "null";
+    } else if (x == std::floor(x) && std::fabs(x) < kExactIntegers &&
+               !(x == 0 && std::signbit(x))) {
+        AppendInt(out_, static_cast<int64_t>(x));
+    } else {
+        char buf[32];
+        int n = snprintf(buf, sizeof(buf), "%.17g", x);
+        out_.append(buf, n);
+    }
+}
+
+void JsonWriter::Bool(bool x) {
+    BeginValue();
+    out_ += x ? "true" : "false";
+}
+
+void JsonWriter::Uint64(uint64_t x) {
+    BeginValue();
+    char buf[24];
+    char* end = buf + sizeof(buf);
+    *--end = '"';
+    char* p = FormatUint(x, end);
+    *--p = '"';
+    out_.append(p, buf + sizeof(buf) - p);
+}
+
+void JsonWriter::Seconds(int64_t ns) {
+    BeginValue();
+    out_ += '"';
+    uint64_t u = ns < 0 ? 0 - static_cast<uint64_t>(ns) : ns;
+    if (u < kExactSeconds * kNanosPerSecond) {
+        char buf[32];
+        char* end = buf + sizeof(buf);
+        char* p = end;
+        uint64_t fraction = u % kNanosPerSecond;
+        if (fraction != 0) {
+            int digits = 9;
+            while (fraction % 10 == 0) {
+                fraction /= 10;
+                --digits;
+            }
+            p = FormatUint(fraction, p, digits);
+            *--p = '.';
+        }
+        p = FormatUint(u / kNanosPerSecond, p);
+        if (ns < 0) *--p = '-';
+        out_.append(p, end - p);
+    } else {
+        AppendFixedAndTruncated(out_, ns / 1000000000.0);
+    }
+    out_ += "s\"";
+}
+
+void JsonWriter::Seconds(Duration d) {
+    Seconds(static_cast<int64_t>(duration_cast<nanoseconds>(d).count()));
+}
+
+void JsonWriter::Time(SystemTimePoint t) {
+    BeginValue();
+    out_ += '"';
+    auto day = date::floor<date::days>(t);
+    constexpr int kFractionDigits = FractionDigits();
+    if (kFractionDigits < 0) {
+        std::stringstream str;
+        str << date::year_month_day(day) << 'T' << date::make_time(t - day)
+            << 'Z';
+        out_ += str.str();
+    } else {
+        int64_t day_number = day.time_since_epoch().count();
+        if (day_number != cached_day_) {
+            std::stringstream str;
+            str << date::year_month_day(day) << 'T';
+            auto date = str.str();
+            cached_date_size_ = std::min(date.size(), sizeof(cached_date_));
+            memcpy(cached_date_, date.data(), cached_date_size_);
+            cached_day_ = day_number;
+        }
+        out_.append(cached_date_, cached_date_size_);
+        // hh:mm:ss.fff...Z
+        uint64_t ticks = (t - day).count();
+        uint64_t ticks_per_second = system_clock::period::den;
+        uint64_t seconds = ticks / ticks_per_second;
+        char buf[40];
+        char* end = buf + sizeof(buf);
+        *--end = 'Z';
+        if (kFractionDigits > 0) {
+            end = FormatUint(ticks % ticks_per_second, end, kFractionDigits);
+            *--end = '.';
+        }
+        end = FormatUint(seconds % 60, end, 2);
+        *--end = ':';
+        end = FormatUint(seconds / 60 % 60, end, 2);
+        *--end = ':';
+        end = FormatUint(seconds / 3600, end, 2);
+        out_.append(end, buf + sizeof(buf) - end);
+    }
+    out_ += '"';
+}
+
+void JsonWriter::Raw(const std::string& json) {
+    BeginValue();
+    out_ += json;
+}
+
+/*static*/ void JsonWriter::AppendFixedAndTruncated(std::string& out,
+                                                    double x) {
+    char buf[64];
+    int n = snprintf(buf, sizeof(buf), "%.9f", x);
+    if (n < 0) return;
+    std::string large;
+    const char* s = buf;
+    if (n >= static_cast<int>(sizeof(buf))) {
+        // Only for numbers around 1e54 and up.
+        large.resize(n + 1);
+        snprintf(&large[0], large.size(), "%.9f", x);
+        s = large.data();
+    }
+    if (memchr(s, '.', n) != nullptr) {
+        // Remove trailing zeroes, then the decimal point if it's last.
+        while (s[n - 1] == '0') --n;
+        if (s[n - 1] == '.') --n;
+    }
+    out.append(s, n);
+}
+
+}  // namespace tuningfork
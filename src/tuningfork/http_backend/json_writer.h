@@ -0,0 +1,78 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "core/common.h"
+
+namespace tuningfork {
+
+// Writes JSON directly to the end of a string, with the same formatting as
+// json11's dump: ", " between elements, ": " after keys, doubles with %.17g.
+//
+// json11 keeps objects in a std::map, so to match its output the keys of each
+// object must be written in sorted order.
+class JsonWriter {
+   public:
+    explicit JsonWriter(std::string& out) : out_(out) {}
+
+    void BeginObject();
+    void EndObject();
+    void BeginArray();
+    void EndArray();
+    void Key(const char* key);
+
+    void String(const char* s, size_t size);
+    void String(const std::string& s) { String(s.data(), s.size()); }
+    // A number that json11 would hold as an int.
+    void Int(int64_t x);
+    // A number that json11 would hold as a double.
+    void Double(double x);
+    void Bool(bool x);
+    // A 64-bit integer, as a string since JSON numbers are doubles.
+    // https://developers.google.com/protocol-buffers/docs/proto3#json
+    void Uint64(uint64_t x);
+    // A duration, as a string with the number of seconds.
+    // https://github.com/protocolbuffers/protobuf/blob/master/src/google/protobuf/duration.proto
+    void Seconds(int64_t ns);
+    void Seconds(Duration d);
+    // A time in RFC 3339 format, to the precision of the system clock.
+    void Time(SystemTimePoint t);
+    // A value that has already been serialized.
+    void Raw(const std::string& json);
+
+    // Write x with fixed-point notation to 9 decimal places, with trailing
+    // zeroes removed.
+    static void AppendFixedAndTruncated(std::string& out, double x);
+
+   private:
+    void BeginValue();
+
+    std::string& out_;
+    // Whether nothing has been written yet in the current object or array.
+    bool first_ = true;
+    // Whether a key has been written that is waiting for its value.
+    bool after_key_ = false;
+    // The date part of the last time written, which rarely changes.
+    int64_t cached_day_ = INT64_MIN;
+    char cached_date_[16];
+    size_t cached_date_size_ = 0;
+};
+
+}  // namespace tuningfork
@@ -17,55 +17,84 @@
 
 #include "ultimate_uploader.h"
 
+#include "binary_serializer.h"
+
 #define LOG_TAG "TuningFork.GE"
 #include "Log.h"
 
 namespace tuningfork {
 
 constexpr Duration kUploadCheckInterval = std::chrono::seconds(1);
+constexpr Duration kMaxRetryInterval = std::chrono::minutes(10);
+constexpr size_t kUploadBatchSize = 8;
 
 const char kUploadRpcName[] = ":uploadTelemetry";
 
-UltimateUploader::UltimateUploader(const TuningFork_Cache* persister,
+UltimateUploader::UltimateUploader(std::shared_ptr<UploadQueue> queue,
                                    const HttpRequest& request)
-    : Runnable(nullptr), persister_(persister), request_(request) {}
+    : Runnable(nullptr),
+      queue_(queue),
+      request_(request),
+      retry_interval_(kUploadCheckInterval) {}
+
 Duration UltimateUploader::DoWork() {
-    CheckUploadPending();
-    return kUploadCheckInterval;
+    if (CheckUploadPending()) {
+        retry_interval_ = kUploadCheckInterval;
+    } else {
+        // Back off exponentially while uploads are failing.
+        retry_interval_ = std::min(2 * retry_interval_, kMaxRetryInterval);
+        auto seconds = std::chrono::duration_cast<std::chrono::seconds>(
+                           retry_interval_)
+                           .count();
+        ALOGI("Retrying upload in %d s", static_cast<int>(seconds));
+    }
+    return retry_interval_;
 }
 
 void UltimateUploader::Run() { Runnable::Run(); }
 
+// Client errors other than timeouts and rate limiting won't go away by
+// retrying.
+static bool IsPermanentFailure(int response_code) {
+    return response_code >= 400 && response_code < 500 &&
+           response_code != 408 && response_code != 429;
+}
+
 bool UltimateUploader::CheckUploadPending() {
-    TuningFork_CProtobufSerialization uploading_hists_ser;
-    if (persister_->get(HISTOGRAMS_UPLOADING, &uploading_hists_ser,
-                        persister_->user_data) == TUNINGFORK_ERROR_OK) {
-        std::string request_json = ToString(uploading_hists_ser);
+    std::vector<UploadQueue::Entry> batch;
+    queue_->Front(kUploadBatchSize, batch);
+    if (batch.empty()) {
+        ALOGV("No upload pending");
+        return true;
+    }
+    for (const auto& entry : batch) {
+        const std::string& request_body = entry.evt_ser;
         int response_code = -1;
         std::string body;
-        ALOGV("Got UPLOADING histograms: %s", request_json.c_str());
+        bool binary = BinarySerializer::IsBinary(request_body);
+        ALOGV("Got UPLOADING histograms: %s",
+              binary ? "(binary)" : request_body.c_str());
         TuningFork_ErrorCode ret =
-            request_.Send(kUploadRpcName, request_json, response_code, body);
-        if (ret == TUNINGFORK_ERROR_OK) {
-            ALOGI("UPLOAD request returned %d %s", response_code, body.c_str());
-            if (response_code == 200) {
-                persister_->remove(HISTOGRAMS_UPLOADING, persister_->user_data);
-                TuningFork_CProtobufSerialization_free(&uploading_hists_ser);
-                return true;
-            }
-        } else {
+            binary ? request_.SendBytes(kUploadRpcName, request_body,
+                                        BinarySerializer::kContentType,
+                                        response_code, body)
+                   : request_.Send(kUploadRpcName, request_body, response_code,
+                                   body);
+        if (ret != TUNINGFORK_ERROR_OK) {
             ALOGW("Error %d when sending UPLOAD request\n%s", ret,
-                  request_json.c_str());
-            persister_->remove(HISTOGRAMS_UPLOADING, persister_->user_data);
-            persister_->set(HISTOGRAMS_PAUSED, &uploading_hists_ser,
-                            persister_->user_data);
+                  binary ? "(binary)" : request_body.c_str());
+            return false;
+        }
+        ALOGI("UPLOAD request returned %d %s", response_code, body.c_str());
+        if (response_code == 200) {
+            queue_->Pop(entry.seq);
+        } else if (IsPermanentFailure(response_code)) {
+            queue_->Pop(entry.seq, true /* dropped */);
+        } else {
+            return false;
         }
-        TuningFork_CProtobufSerialization_free(&uploading_hists_ser);
-    } else {
-        ALOGV("No upload pending");
-        return true;
     }
-    return false;
+    return true;
 }
 
 }  // namespace tuningfork
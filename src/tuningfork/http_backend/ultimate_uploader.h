@@ -17,26 +17,33 @@
 
 #pragma once
 
+#include <memory>
+
 #include "core/runnable.h"
 #include "core/tuningfork_utils.h"
+#include "core/upload_queue.h"
 #include "http_request.h"
 #include "proto/protobuf_util.h"
 
 namespace tuningfork {
 
-// This class periodically listens on a separate thread for upload packets from
-// the persister and performs the HTTP request to do the upload.
+// This class periodically checks on a separate thread for sessions in the
+// upload queue and performs the HTTP requests to upload them, oldest first.
+// While uploads fail, it retries with exponential backoff.
 class UltimateUploader : public Runnable {
-    const TuningFork_Cache* persister_ = nullptr;
+    std::shared_ptr<UploadQueue> queue_;
     HttpRequest request_;
+    Duration retry_interval_;
 
    public:
-    UltimateUploader(const TuningFork_Cache* persister,
+    UltimateUploader(std::shared_ptr<UploadQueue> queue,
                      const HttpRequest& request);
     virtual Duration DoWork() override;
     virtual void Run() override;
 
    private:
+    // Upload a batch of queued sessions. Returns false if an upload needs to
+    // be retried.
     bool CheckUploadPending();
 };
 
@@ -16,6 +16,7 @@
 
 #include "swappy/common/SwappyCommon.h"
 
+#include <cstring>
 #include <functional>
 #include <optional>
 #include <ostream>
@@ -24,6 +25,8 @@
 #include <vector>
 
 #include "gtest/gtest.h"
+#include "swappy/common/CPUTracer.h"
+#include "trace_recorder.h"
 
 #define LOG_TAG "SCTest"
 #include "Log.h"
@@ -740,3 +743,41 @@ TEST(SwappyCommonTest, AutoModeOnAutoPipeliningOffSwitchDownFrom60HzAndBack) {
                {Result{1ms, 1ms, 3, SwapEvents{{1ms, 100ms}}},
                 Result{1ms, 1ms, 3, SwapEvents{{1ms, 200ms}}}});
 }
+
+// Swappy's CPU frame time section is recorded without systrace attached.
+TEST(SwappyCommonTest, CPUTracerRecordsWithoutSystrace) {
+    using gamesdk::TraceRecorder;
+    const char* kSection = "Swappy: CPU frame time";
+    TraceRecorder::Start();
+    TraceRecorder::Drain();
+    int begins = 0, ends = 0;
+    int32_t tracer_tid = 0;
+    auto count = [&]() {
+        for (auto& thread : TraceRecorder::Drain())
+            for (auto& e : thread.events) {
+                if (e.type == TraceRecorder::EventType::BEGIN &&
+                    strcmp(e.name, kSection) == 0) {
+                    tracer_tid = thread.tid;
+                    ++begins;
+                }
+                // The tracer's thread records nothing else.
+                if (e.type == TraceRecorder::EventType::END &&
+                    thread.tid == tracer_tid)
+                    ++ends;
+            }
+    };
+    {
+        CPUTracer tracer;
+        tracer.startTrace();
+        // The section begins on the tracer's thread.
+        for (int i = 0; i < 100 && begins == 0; ++i) {
+            std::this_thread::sleep_for(10ms);
+            count();
+        }
+        tracer.endTrace();
+    }
+    count();
+    TraceRecorder::Stop();
+    EXPECT_EQ(begins, 1);
+    EXPECT_EQ(ends, 1);
+}
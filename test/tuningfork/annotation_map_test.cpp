@@ -0,0 +1,157 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "core/annotation_map.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace annotation_map_test {
+
+using namespace tuningfork;
+
+constexpr int kStressAnnotations = 1000000;
+
+// Something like a serialized annotation with two enum fields.
+ProtobufSerialization SyntheticAnnotation(uint32_t i) {
+    ProtobufSerialization ser = {0x08};
+    uint32_t x = i % 1000 + 1;
+    do {
+        ser.push_back((x & 0x7f) | (x > 0x7f ? 0x80 : 0));
+        x >>= 7;
+    } while (x);
+    ser.push_back(0x10);
+    x = i / 1000 + 1;
+    do {
+        ser.push_back((x & 0x7f) | (x > 0x7f ? 0x80 : 0));
+        x >>= 7;
+    } while (x);
+    return ser;
+}
+
+TEST(AnnotationMapTest, InsertAndGet) {
+    AnnotationMap map;
+    AnnotationId a, b, a_again;
+    EXPECT_EQ(map.GetOrInsert({1, 2, 3}, a), TUNINGFORK_ERROR_OK);
+    EXPECT_EQ(map.GetOrInsert({1, 2, 4}, b), TUNINGFORK_ERROR_OK);
+    EXPECT_EQ(map.GetOrInsert({1, 2, 3}, a_again), TUNINGFORK_ERROR_OK);
+    EXPECT_NE(a, b);
+    EXPECT_EQ(a, a_again);
+    EXPECT_EQ(map.Size(), 2);
+    ProtobufSerialization ser;
+    EXPECT_EQ(map.Get(b, ser), TUNINGFORK_ERROR_OK);
+    EXPECT_EQ(ser, (ProtobufSerialization{1, 2, 4}));
+    EXPECT_EQ(map.Get(0, ser), TUNINGFORK_ERROR_INVALID_ANNOTATION);
+    EXPECT_EQ(map.Get(b + 1, ser), TUNINGFORK_ERROR_INVALID_ANNOTATION);
+    const uint8_t* data;
+    size_t size;
+    ASSERT_TRUE(map.View(a, data, size));
+    EXPECT_EQ(ProtobufSerialization(data, data + size),
+              (ProtobufSerialization{1, 2, 3}));
+    EXPECT_TRUE(map.View(0, data, size));
+    EXPECT_EQ(size, 0);
+    EXPECT_FALSE(map.View(b + 1, data, size));
+}
+
+TEST(AnnotationMapTest, EmptyAndLargeAnnotations) {
+    AnnotationMap map;
+    ProtobufSerialization large(100000, 7);
+    AnnotationId empty_id, large_id, small_id;
+    EXPECT_EQ(map.GetOrInsert({}, empty_id), TUNINGFORK_ERROR_OK);
+    EXPECT_EQ(map.GetOrInsert(large, large_id), TUNINGFORK_ERROR_OK);
+    EXPECT_EQ(map.GetOrInsert({9}, small_id), TUNINGFORK_ERROR_OK);
+    ProtobufSerialization ser = {1};
+    EXPECT_EQ(map.Get(empty_id, ser), TUNINGFORK_ERROR_OK);
+    EXPECT_TRUE(ser.empty());
+    EXPECT_EQ(map.Get(large_id, ser), TUNINGFORK_ERROR_OK);
+    EXPECT_EQ(ser, large);
+    EXPECT_EQ(map.Get(small_id, ser), TUNINGFORK_ERROR_OK);
+    EXPECT_EQ(ser, ProtobufSerialization{9});
+}
+
+// With a million annotations there are bound to be 32-bit hash collisions:
+// they must still get different ids.
+TEST(AnnotationMapTest, MillionAnnotationsStress) {
+    AnnotationMap map;
+    std::vector<ProtobufSerialization> sers;
+    sers.reserve(kStressAnnotations);
+    for (int i = 0; i < kStressAnnotations; ++i)
+        sers.push_back(SyntheticAnnotation(i));
+    std::vector<bool> seen(kStressAnnotations + 1);
+    int collisions = 0;
+    for (auto& ser : sers) {
+        AnnotationId id;
+        ASSERT_EQ(map.GetOrInsert(ser, id), TUNINGFORK_ERROR_OK);
+        ASSERT_LE(id, kStressAnnotations);
+        if (seen[id]) ++collisions;
+        seen[id] = true;
+    }
+    EXPECT_EQ(collisions, 0);
+    EXPECT_EQ(map.Size(), kStressAnnotations);
+
+    // Existing annotations are found again.
+    int mismatches = 0;
+    for (int i = 0; i < kStressAnnotations; ++i) {
+        AnnotationId id;
+        ASSERT_EQ(map.GetOrInsert(sers[i], id), TUNINGFORK_ERROR_OK);
+        if (id != AnnotationId(i + 1)) ++mismatches;
+    }
+    EXPECT_EQ(mismatches, 0);
+    EXPECT_EQ(map.Size(), kStressAnnotations);
+    ProtobufSerialization ser;
+    for (int j = 0; j < kStressAnnotations; j += 997) {
+        ASSERT_EQ(map.Get(j + 1, ser), TUNINGFORK_ERROR_OK);
+        EXPECT_EQ(ser, sers[j]);
+    }
+}
+
+TEST(AnnotationMapTest, ConcurrentReadersAndWriter) {
+    constexpr int kAnnotations = 100000;
+    constexpr int kReaders = 4;
+    AnnotationMap map;
+    AnnotationId first;
+    map.GetOrInsert(SyntheticAnnotation(0), first);
+    std::atomic<bool> done(false);
+    std::atomic<int> errors(0);
+    std::vector<std::thread> readers;
+    for (int r = 0; r < kReaders; ++r) {
+        readers.emplace_back([&]() {
+            while (!done) {
+                AnnotationId id;
+                map.GetOrInsert(SyntheticAnnotation(0), id);
+                if (id != first) ++errors;
+                ProtobufSerialization ser;
+                AnnotationId last = map.Size();
+                if (map.Get(last, ser) != TUNINGFORK_ERROR_OK ||
+                    ser != SyntheticAnnotation(last - 1))
+                    ++errors;
+            }
+        });
+    }
+    for (int i = 1; i < kAnnotations; ++i) {
+        AnnotationId id;
+        map.GetOrInsert(SyntheticAnnotation(i), id);
+        EXPECT_EQ(id, AnnotationId(i + 1));
+    }
+    done = true;
+    for (auto& t : readers) t.join();
+    EXPECT_EQ(errors, 0);
+}
+
+}  // namespace annotation_map_test
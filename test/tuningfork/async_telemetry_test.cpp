@@ -0,0 +1,148 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "core/async_telemetry.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "core/timer_wheel.h"
+
+namespace async_telemetry_test {
+
+using namespace tuningfork;
+using namespace std::chrono;
+
+class FakeTimeProvider : public ITimeProvider {
+   public:
+    TimePoint t = TimePoint() + hours(1);
+    TimePoint Now() override { return t; }
+    SystemTimePoint SystemNow() override { return SystemTimePoint(); }
+    Duration TimeSinceProcessStart() override {
+        return t.time_since_epoch();
+    }
+};
+
+class CountingTask : public RepeatingTask {
+   public:
+    CountingTask(FakeTimeProvider* time_provider, Duration interval,
+                 Duration work = Duration::zero())
+        : RepeatingTask(interval), time_provider_(time_provider), work_(work) {}
+    void DoWork(Session*) override {
+        times_.push_back(time_provider_->t);
+        time_provider_->t += work_;
+    }
+    std::vector<TimePoint> times_;
+
+   private:
+    FakeTimeProvider* time_provider_;
+    Duration work_;
+};
+
+TEST(TimerWheel, ExpiresInDeadlineOrder) {
+    TimerWheel<int, 4> wheel(seconds(1));
+    TimePoint t0 = TimePoint() + seconds(100);
+    wheel.Add(3, t0 + milliseconds(900));
+    wheel.Add(1, t0 + milliseconds(100));
+    wheel.Add(2, t0 + milliseconds(500));
+    // Deadlines more than a revolution away share slots with nearer ones.
+    wheel.Add(4, t0 + seconds(8));
+    wheel.Add(5, t0 + seconds(1));
+    EXPECT_EQ(wheel.NextDeadline(), t0 + milliseconds(100));
+    std::vector<int> expired;
+    // Everything in the slot is coalesced, even if not quite due yet.
+    wheel.Expire(t0 + milliseconds(100),
+                 [&](int i, TimePoint) { expired.push_back(i); });
+    EXPECT_EQ(expired, (std::vector<int>{1, 2, 3}));
+    EXPECT_EQ(wheel.Size(), 2);
+    expired.clear();
+    wheel.Expire(t0 + seconds(7),
+                 [&](int i, TimePoint) { expired.push_back(i); });
+    EXPECT_EQ(expired, std::vector<int>{5});
+    expired.clear();
+    wheel.Expire(t0 + seconds(8),
+                 [&](int i, TimePoint) { expired.push_back(i); });
+    EXPECT_EQ(expired, std::vector<int>{4});
+    EXPECT_TRUE(wheel.Empty());
+    EXPECT_EQ(wheel.NextDeadline(), TimePoint::max());
+}
+
+TEST(AsyncTelemetry, CoalescesTasksDueTogether) {
+    FakeTimeProvider time;
+    AsyncTelemetry telemetry(&time);
+    auto start = time.t;
+    auto a = std::make_shared<CountingTask>(&time, seconds(60));
+    auto b = std::make_shared<CountingTask>(&time, milliseconds(60500));
+    telemetry.AddTask(a);
+    telemetry.AddTask(b);
+    auto wait = telemetry.DoWork();
+    EXPECT_EQ(a->times_.size(), 1);
+    EXPECT_EQ(b->times_.size(), 1);
+    EXPECT_EQ(wait, seconds(60));
+    time.t += wait;
+    // b isn't due for another 500ms but is run on the same wakeup.
+    telemetry.DoWork();
+    EXPECT_EQ(a->times_.size(), 2);
+    EXPECT_EQ(b->times_.size(), 2);
+    auto stats = telemetry.GetStats();
+    EXPECT_EQ(stats.wakeups, 2);
+    EXPECT_EQ(stats.tasks_run, 4);
+    EXPECT_EQ(stats.tasks_coalesced, 1);
+    EXPECT_EQ(stats.runs_skipped, 0);
+    EXPECT_EQ(stats.max_lateness, Duration::zero());
+    EXPECT_EQ(a->times_[1], start + seconds(60));
+}
+
+TEST(AsyncTelemetry, DeadlinesDontDrift) {
+    FakeTimeProvider time;
+    AsyncTelemetry telemetry(&time);
+    auto start = time.t;
+    auto task =
+        std::make_shared<CountingTask>(&time, seconds(10), milliseconds(300));
+    telemetry.AddTask(task);
+    for (int i = 0; i < 5; ++i) {
+        auto wait = telemetry.DoWork();
+        // Wake up late each time.
+        time.t += wait + milliseconds(200);
+    }
+    ASSERT_EQ(task->times_.size(), 5);
+    EXPECT_EQ(task->times_[4], start + seconds(40) + milliseconds(200));
+    auto stats = telemetry.GetStats();
+    EXPECT_EQ(stats.max_lateness, milliseconds(200));
+    EXPECT_EQ(stats.total_lateness, milliseconds(800));
+    EXPECT_EQ(stats.tasks_coalesced, 0);
+    EXPECT_EQ(stats.runs_skipped, 0);
+}
+
+TEST(AsyncTelemetry, SkipsMissedRuns) {
+    FakeTimeProvider time;
+    AsyncTelemetry telemetry(&time);
+    auto task = std::make_shared<CountingTask>(&time, seconds(10));
+    telemetry.AddTask(task);
+    telemetry.DoWork();
+    // Asleep for a long time.
+    time.t += minutes(5);
+    auto wait = telemetry.DoWork();
+    EXPECT_EQ(task->times_.size(), 2);
+    EXPECT_EQ(wait, seconds(10));
+    auto stats = telemetry.GetStats();
+    EXPECT_EQ(stats.max_lateness, seconds(290));
+    // The runs due from 20s to 300s are skipped.
+    EXPECT_EQ(stats.runs_skipped, 29);
+}
+
+}  // namespace async_telemetry_test
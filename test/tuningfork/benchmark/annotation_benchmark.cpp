@@ -0,0 +1,103 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vector>
+
+#include "../endtoend/tuningfork_test.h"
+#include "benchmark_utils.h"
+#include "core/annotation_map.h"
+
+using namespace tuningfork_test;
+
+namespace tuningfork_benchmark {
+
+constexpr int kSwitchIterations = 200000;
+constexpr int kMapAnnotations = 1000000;
+
+tf::ProtobufSerialization LevelAnnotation(com::google::tuningfork::Level l) {
+    Annotation ann;
+    ann.set_level(l);
+    return tf::Serialize(ann);
+}
+
+// Alternate between two annotations, as when profiling parts of a frame.
+TEST(AnnotationBenchmark, SwitchAnnotation) {
+    // {3} is the number of values in the Level enum in
+    // tuningfork_extensions.proto
+    TuningForkTest test(TestSettings(
+        tf::Settings::AggregationStrategy::Submission::TIME_BASED, 100000, 2,
+        {3}));
+    tf::ProtobufSerialization annotations[] = {
+        LevelAnnotation(com::google::tuningfork::LEVEL_1),
+        LevelAnnotation(com::google::tuningfork::LEVEL_2)};
+    auto ns = NanosPerOp(1, kSwitchIterations, [&](int) {
+        static int i = 0;
+        tf::SetCurrentAnnotation(annotations[i++ & 1]);
+    });
+    Report("SetCurrentAnnotation", 1, ns);
+
+    tf::AnnotationId ids[2];
+    ASSERT_EQ(tf::RegisterAnnotation(annotations[0], ids[0]),
+              TUNINGFORK_ERROR_OK);
+    ASSERT_EQ(tf::RegisterAnnotation(annotations[1], ids[1]),
+              TUNINGFORK_ERROR_OK);
+    ns = NanosPerOp(1, kSwitchIterations, [&](int) {
+        static int i = 0;
+        tf::SetCurrentAnnotationById(ids[i++ & 1]);
+    });
+    Report("SetCurrentAnnotationById", 1, ns);
+}
+
+// Something like a serialized annotation with two enum fields.
+tf::ProtobufSerialization SyntheticAnnotation(uint32_t i) {
+    tf::ProtobufSerialization ser = {0x08};
+    uint32_t x = i % 1000 + 1;
+    do {
+        ser.push_back((x & 0x7f) | (x > 0x7f ? 0x80 : 0));
+        x >>= 7;
+    } while (x);
+    ser.push_back(0x10);
+    x = i / 1000 + 1;
+    do {
+        ser.push_back((x & 0x7f) | (x > 0x7f ? 0x80 : 0));
+        x >>= 7;
+    } while (x);
+    return ser;
+}
+
+// Look up annotations already in a map of a million.
+TEST(AnnotationBenchmark, AnnotationMapGetOrInsertExisting) {
+    tf::AnnotationMap map;
+    std::vector<tf::ProtobufSerialization> sers;
+    sers.reserve(kMapAnnotations);
+    for (int i = 0; i < kMapAnnotations; ++i) {
+        sers.push_back(SyntheticAnnotation(i));
+        tf::AnnotationId id;
+        ASSERT_EQ(map.GetOrInsert(sers.back(), id), TUNINGFORK_ERROR_OK);
+    }
+    int i = 0;
+    int mismatches = 0;
+    auto ns = NanosPerOp(1, kMapAnnotations, [&](int) {
+        tf::AnnotationId id;
+        map.GetOrInsert(sers[i], id);
+        if (id != tf::AnnotationId(i + 1)) ++mismatches;
+        ++i;
+    });
+    EXPECT_EQ(mismatches, 0);
+    Report("AnnotationMap::GetOrInsert(existing)", 1, ns);
+}
+
+}  // namespace tuningfork_benchmark
@@ -0,0 +1,171 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../endtoend/tuningfork_test.h"
+#include "benchmark_utils.h"
+#include "tuningfork/tuningfork.h"
+
+using namespace tuningfork_test;
+
+namespace tuningfork_benchmark {
+
+// The cost of each call in the C API on the game's threads, with as many
+// instrument keys and annotations as a typical game.
+constexpr int kKeys = 4;
+constexpr int kIterations = 100000;
+constexpr int kFlushIterations = 1000;
+constexpr int kBatchSize = 64;
+constexpr TuningFork_Duration kFrameTimeNs = 16666666;
+
+using Submission = tf::Settings::AggregationStrategy::Submission;
+
+tf::Settings ApiSettings(Submission method, int interval) {
+    std::vector<tf::Settings::Histogram> hists;
+    for (int k = 0; k < kKeys; ++k) hists.push_back({k + 1, 0, 100, 200});
+    // {3, 3} is for the two Level fields of the Annotation in
+    // dev_tuningfork.proto.
+    return TestSettings(method, interval, kKeys, {3, 3}, hists, 0, 16);
+}
+
+// The test time provider doesn't advance on its own, so a time-based
+// strategy means no uploads during the benchmark.
+tf::Settings NoUploadSettings() {
+    return ApiSettings(Submission::TIME_BASED, 100000);
+}
+
+TuningFork_InstrumentKey Key(int i) { return 1 + i % kKeys; }
+
+// Every combination of the two annotation fields.
+std::vector<tf::ProtobufSerialization> AllAnnotations() {
+    std::vector<tf::ProtobufSerialization> annotations;
+    for (int a = 1; a <= 3; ++a) {
+        for (int b = 1; b <= 3; ++b) {
+            Annotation ann;
+            ann.set_level(static_cast<com::google::tuningfork::Level>(a));
+            ann.set_level2(static_cast<com::google::tuningfork::Level>(b));
+            annotations.push_back(tf::Serialize(ann));
+        }
+    }
+    return annotations;
+}
+
+TuningFork_CProtobufSerialization CSerialization(
+    tf::ProtobufSerialization& ser) {
+    return {ser.data(), static_cast<uint32_t>(ser.size()), nullptr};
+}
+
+TEST(ApiBenchmark, FrameTimes) {
+    TuningForkTest test(NoUploadSettings());
+    int i = 0;
+    auto cost = CostPerOp(1, kIterations,
+                          [&](int) { TuningFork_frameTick(Key(i++)); });
+    Report("TuningFork_frameTick", 1, cost);
+
+    cost = CostPerOp(1, kIterations, [&](int) {
+        TuningFork_frameDeltaTimeNanos(Key(i++), kFrameTimeNs);
+    });
+    Report("TuningFork_frameDeltaTimeNanos", 1, cost);
+
+    std::vector<TuningFork_Duration> dts(kBatchSize, kFrameTimeNs);
+    cost = CostPerOp(1, kIterations / kBatchSize, [&](int) {
+        TuningFork_frameDeltaTimeNanosBatch(Key(i++), dts.data(), kBatchSize);
+    });
+    Report("TuningFork_frameDeltaTimeNanosBatch (64 samples)", 1, cost);
+
+    // A run of samples for each key, as when a frame's timings are batched.
+    std::vector<TuningFork_InstrumentKey> keys;
+    for (int s = 0; s < kBatchSize; ++s)
+        keys.push_back(Key(s * kKeys / kBatchSize));
+    cost = CostPerOp(1, kIterations / kBatchSize, [&](int) {
+        TuningFork_frameDeltaTimeNanosMultiKeyBatch(keys.data(), dts.data(),
+                                                    kBatchSize);
+    });
+    Report("TuningFork_frameDeltaTimeNanosMultiKeyBatch (64 samples)", 1,
+           cost);
+}
+
+TEST(ApiBenchmark, Traces) {
+    TuningForkTest test(NoUploadSettings());
+    int i = 0;
+    auto cost = CostPerOp(1, kIterations, [&](int) {
+        TuningFork_TraceHandle handle;
+        TuningFork_startTrace(Key(i++), &handle);
+        TuningFork_endTrace(handle);
+    });
+    Report("TuningFork_startTrace + TuningFork_endTrace", 1, cost);
+}
+
+TEST(ApiBenchmark, Annotations) {
+    TuningForkTest test(NoUploadSettings());
+    auto annotations = AllAnnotations();
+    std::vector<TuningFork_CProtobufSerialization> c_annotations;
+    for (auto& a : annotations) c_annotations.push_back(CSerialization(a));
+    int i = 0;
+    auto cost = CostPerOp(1, kIterations, [&](int) {
+        TuningFork_setCurrentAnnotation(
+            &c_annotations[i++ % c_annotations.size()]);
+    });
+    Report("TuningFork_setCurrentAnnotation", 1, cost);
+
+    std::vector<uint32_t> ids(c_annotations.size());
+    for (size_t a = 0; a < ids.size(); ++a) {
+        ASSERT_EQ(TuningFork_registerAnnotation(&c_annotations[a], &ids[a]),
+                  TUNINGFORK_ERROR_OK);
+    }
+    cost = CostPerOp(1, kIterations, [&](int) {
+        TuningFork_setCurrentAnnotationById(ids[i++ % ids.size()]);
+    });
+    Report("TuningFork_setCurrentAnnotationById", 1, cost);
+}
+
+TEST(ApiBenchmark, LoadingTimes) {
+    TuningForkTest test(NoUploadSettings());
+    auto annotation = AllAnnotations()[0];
+    auto c_annotation = CSerialization(annotation);
+    TuningFork_LoadingTimeMetadata metadata = {};
+    metadata.state = TuningFork_LoadingTimeMetadata::INTER_LEVEL;
+    metadata.source = TuningFork_LoadingTimeMetadata::DEVICE_STORAGE;
+    auto cost = CostPerOp(1, kIterations, [&](int) {
+        TuningFork_LoadingEventHandle handle;
+        TuningFork_startRecordingLoadingTime(&metadata, sizeof(metadata),
+                                             &c_annotation, &handle);
+        TuningFork_stopRecordingLoadingTime(handle);
+    });
+    Report(
+        "TuningFork_startRecordingLoadingTime + "
+        "TuningFork_stopRecordingLoadingTime",
+        1, cost);
+
+    cost = CostPerOp(1, kIterations, [&](int) {
+        TuningFork_recordLoadingTime(1000000, &metadata, sizeof(metadata),
+                                     &c_annotation);
+    });
+    Report("TuningFork_recordLoadingTime", 1, cost);
+}
+
+// TuningFork_flush only flushes once a minute, so flushes are made by a
+// tick-based strategy instead, which does the same work. The upload itself
+// happens on the upload thread and isn't included.
+TEST(ApiBenchmark, Flush) {
+    TuningForkTest test(ApiSettings(Submission::TICK_BASED, 1));
+    int i = 0;
+    auto cost = CostPerOp(1, kFlushIterations, [&](int) {
+        TuningFork_frameDeltaTimeNanos(Key(i++), kFrameTimeNs);
+    });
+    Report("TuningFork_frameDeltaTimeNanos, flushing each time", 1, cost);
+}
+
+}  // namespace tuningfork_benchmark
@@ -0,0 +1,102 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "benchmark_utils.h"
+
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+thread_local uint64_t s_allocations = 0;
+FILE* s_report_file = nullptr;
+std::string s_file_dir = "/data/local/tmp";
+
+void* CountedAlloc(size_t size) {
+    ++s_allocations;
+    return malloc(size == 0 ? 1 : size);
+}
+
+std::string JsonString(const char* s) {
+    std::string out = "\"";
+    for (; *s != '\0'; ++s) {
+        if (*s == '"' || *s == '\\') out += '\\';
+        if (static_cast<unsigned char>(*s) >= 0x20) out += *s;
+    }
+    return out + '"';
+}
+
+void ReportToFile(const char* name, int n_threads, double ns_per_op,
+                  const double* allocs_per_op) {
+    if (s_report_file == nullptr) return;
+    std::string test;
+    if (auto info = ::testing::UnitTest::GetInstance()->current_test_info())
+        test = std::string(info->test_case_name()) + "." + info->name();
+    fprintf(s_report_file,
+            "{\"test\":%s,\"name\":%s,\"threads\":%d,\"ns_per_op\":%.1f",
+            JsonString(test.c_str()).c_str(), JsonString(name).c_str(),
+            n_threads, ns_per_op);
+    if (allocs_per_op != nullptr)
+        fprintf(s_report_file, ",\"allocs_per_op\":%.3f", *allocs_per_op);
+    fprintf(s_report_file, "}\n");
+    fflush(s_report_file);
+}
+
+}  // anonymous namespace
+
+// Counting allocations means replacing the global operator new, for the whole
+// benchmark binary.
+void* operator new(size_t size) {
+    void* p = CountedAlloc(size);
+    if (p == nullptr) abort();
+    return p;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return CountedAlloc(size);
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return CountedAlloc(size);
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+namespace tuningfork_benchmark {
+
+uint64_t ThreadAllocationCount() { return s_allocations; }
+
+void Report(const char* name, int n_threads, double ns_per_op) {
+    printf("%s threads=%d %.1f ns/op\n", name, n_threads, ns_per_op);
+    ReportToFile(name, n_threads, ns_per_op, nullptr);
+}
+
+void Report(const char* name, int n_threads, const OpCost& cost) {
+    printf("%s threads=%d %.1f ns/op %.3f allocs/op\n", name, n_threads,
+           cost.ns, cost.allocations);
+    ReportToFile(name, n_threads, cost.ns, &cost.allocations);
+}
+
+void SetReportFile(FILE* file) { s_report_file = file; }
+
+const std::string& FileDir() { return s_file_dir; }
+void SetFileDir(const std::string& dir) { s_file_dir = dir; }
+
+}  // namespace tuningfork_benchmark
@@ -0,0 +1,90 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace tuningfork_benchmark {
+
+// The mean cost of a call.
+struct OpCost {
+    double ns;
+    // Calls to operator new made by the calling thread. Allocations made on
+    // other threads as a result, such as by the upload thread, aren't counted.
+    double allocations;
+};
+
+// The number of calls to operator new so far on this thread.
+uint64_t ThreadAllocationCount();
+
+// Call fn(thread_index) iterations times on each of n_threads threads, all
+// starting at once. Returns the mean cost per call, as seen by each thread.
+template <typename Fn>
+OpCost CostPerOp(int n_threads, int iterations, Fn fn) {
+    std::atomic<int> waiting(n_threads);
+    std::vector<OpCost> costs(n_threads);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < n_threads; ++t) {
+        threads.emplace_back([&, t]() {
+            waiting--;
+            while (waiting > 0) std::this_thread::yield();
+            auto allocations = ThreadAllocationCount();
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < iterations; ++i) fn(t);
+            auto end = std::chrono::steady_clock::now();
+            costs[t].ns =
+                std::chrono::duration<double, std::nano>(end - start).count();
+            costs[t].allocations = ThreadAllocationCount() - allocations;
+        });
+    }
+    for (auto& th : threads) th.join();
+    OpCost total = {0, 0};
+    for (auto& c : costs) {
+        total.ns += c.ns;
+        total.allocations += c.allocations;
+    }
+    double n = double(n_threads) * iterations;
+    return {total.ns / n, total.allocations / n};
+}
+
+template <typename Fn>
+double NanosPerOp(int n_threads, int iterations, Fn fn) {
+    return CostPerOp(n_threads, iterations, fn).ns;
+}
+
+// Print a result and, if there is a report file, add it there too.
+void Report(const char* name, int n_threads, double ns_per_op);
+void Report(const char* name, int n_threads, const OpCost& cost);
+
+// Also write results to file as JSON, one object per line, with the name of
+// the test that reported each:
+// {"test":"FrameTickBenchmark.FrameTick","name":"FrameTick","threads":1,
+//  "ns_per_op":12.5,"allocs_per_op":0}
+// allocs_per_op is left out when only the time was reported.
+void SetReportFile(FILE* file);
+
+// The directory benchmarks write files under.
+const std::string& FileDir();
+void SetFileDir(const std::string& dir);
+
+}  // namespace tuningfork_benchmark
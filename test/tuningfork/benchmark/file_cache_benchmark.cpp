@@ -0,0 +1,73 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+
+#include "benchmark_utils.h"
+#include "core/file_cache.h"
+#include "core/mapped_file_cache.h"
+#include "core/tuningfork_utils.h"
+#include "gtest/gtest.h"
+#include "proto/protobuf_util.h"
+
+namespace tuningfork_benchmark {
+
+namespace tf = tuningfork;
+
+constexpr int kCacheIterations = 10000;
+constexpr int kCacheKeys = 16;
+
+template <typename Cache>
+void RunCacheBenchmark(const char* name, const std::string& dir) {
+    Cache cache(dir);
+    cache.Clear();
+    if (!cache.IsValid()) {
+        printf("%s: can't write to %s\n", name, dir.c_str());
+        return;
+    }
+    // About the size of a serialized session.
+    std::string value(2000, 'x');
+    TuningFork_CProtobufSerialization cvalue;
+    tf::ToCProtobufSerialization(value, cvalue);
+    int i = 0;
+    auto ns = NanosPerOp(1, kCacheIterations, [&](int) {
+        cache.Set(i++ % kCacheKeys, &cvalue);
+    });
+    printf("%s ", dir.c_str());
+    Report((std::string(name) + "::Set").c_str(), 1, ns);
+    i = 0;
+    ns = NanosPerOp(1, kCacheIterations, [&](int) {
+        TuningFork_CProtobufSerialization out;
+        if (cache.Get(i++ % kCacheKeys, &out) == TUNINGFORK_ERROR_OK)
+            TuningFork_CProtobufSerialization_free(&out);
+    });
+    printf("%s ", dir.c_str());
+    Report((std::string(name) + "::Get").c_str(), 1, ns);
+    TuningFork_CProtobufSerialization_free(&cvalue);
+    cache.Clear();
+}
+
+TEST(FileCacheBenchmark, GetSet) {
+    auto dir = FileDir() + "/tuningfork_cache_benchmark";
+    // Some devices don't allow writing to /data/local/tmp: use --benchmark_dir
+    // to choose somewhere else.
+    if (!tf::file_utils::CheckAndCreateDir(dir)) GTEST_SKIP();
+    RunCacheBenchmark<tf::FileCache>("FileCache", dir);
+    RunCacheBenchmark<tf::MappedFileCache>("MappedFileCache", dir);
+    tf::file_utils::DeleteDir(dir);
+}
+
+}  // namespace tuningfork_benchmark
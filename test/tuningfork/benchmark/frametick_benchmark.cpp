@@ -0,0 +1,73 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../endtoend/tuningfork_test.h"
+#include "benchmark_utils.h"
+
+using namespace tuningfork_test;
+
+namespace tuningfork_benchmark {
+
+constexpr int kMaxThreads = 4;
+constexpr int kIterations = 200000;
+
+// Each thread ticks its own instrument key.
+tf::Settings BenchmarkSettings() {
+    std::vector<tf::Settings::Histogram> hists;
+    for (int i = 0; i < kMaxThreads; ++i) {
+        hists.push_back({i + 1, 0, 100, 200});
+    }
+    // The test time provider doesn't advance on its own, so a time-based
+    // strategy means no uploads during the benchmark.
+    return TestSettings(
+        tf::Settings::AggregationStrategy::Submission::TIME_BASED, 100000,
+        kMaxThreads, {}, hists);
+}
+
+TEST(FrameTickBenchmark, FrameTick) {
+    TuningForkTest test(BenchmarkSettings());
+    for (int n_threads = 1; n_threads <= kMaxThreads; n_threads *= 2) {
+        auto ns = NanosPerOp(n_threads, kIterations, [](int t) {
+            tf::FrameTick(t + 1);
+        });
+        Report("FrameTick", n_threads, ns);
+    }
+}
+
+TEST(FrameTickBenchmark, FrameDeltaTimeNanos) {
+    TuningForkTest test(BenchmarkSettings());
+    for (int n_threads = 1; n_threads <= kMaxThreads; n_threads *= 2) {
+        auto ns = NanosPerOp(n_threads, kIterations, [](int t) {
+            tf::FrameDeltaTimeNanos(t + 1, milliseconds(16));
+        });
+        Report("FrameDeltaTimeNanos", n_threads, ns);
+    }
+}
+
+TEST(FrameTickBenchmark, FrameDeltaTimeNanosBatch) {
+    TuningForkTest test(BenchmarkSettings());
+    constexpr int kBatchSize = 64;
+    std::vector<uint64_t> dts(kBatchSize, 16000000);
+    for (int n_threads = 1; n_threads <= kMaxThreads; n_threads *= 2) {
+        auto ns = NanosPerOp(n_threads, kIterations / kBatchSize, [&](int t) {
+            tf::FrameDeltaTimeNanosBatch(t + 1, dts.data(), kBatchSize);
+        });
+        Report("FrameDeltaTimeNanosBatch (per sample)", n_threads,
+               ns / kBatchSize);
+    }
+}
+
+}  // namespace tuningfork_benchmark
@@ -0,0 +1,99 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <json11/json11.hpp>
+#include <string>
+
+#include "benchmark_utils.h"
+#include "core/session.h"
+#include "gtest/gtest.h"
+#include "http_backend/json_serializer.h"
+
+using namespace tuningfork;
+
+namespace tuningfork_benchmark {
+
+constexpr int kSerializeIkeys = 4;
+constexpr int kSerializeAnnotations = 250;
+constexpr int kSerializeIterations = 50;
+
+class BenchmarkIdProvider : public IdProvider {
+    TuningFork_ErrorCode SerializedAnnotationToAnnotationId(
+        const ProtobufSerialization& ser, AnnotationId& id) override {
+        id = 0;
+        return TUNINGFORK_ERROR_OK;
+    }
+    TuningFork_ErrorCode MakeCompoundId(InstrumentationKey k,
+                                        AnnotationId annotation_id,
+                                        MetricId& id) override {
+        id = MetricId::FrameTime(annotation_id, k);
+        return TUNINGFORK_ERROR_OK;
+    }
+    TuningFork_ErrorCode AnnotationIdToSerializedAnnotation(
+        AnnotationId id, SerializedAnnotation& ser) override {
+        ser = {8, static_cast<uint8_t>(id & 0x7f), 16,
+               static_cast<uint8_t>(id >> 7)};
+        return TUNINGFORK_ERROR_OK;
+    }
+    TuningFork_ErrorCode MetricIdToLoadingTimeMetadata(
+        MetricId id, LoadingTimeMetadataWithGroup& md) override {
+        md = {};
+        return TUNINGFORK_ERROR_OK;
+    }
+};
+
+TEST(JsonSerializerBenchmark, SerializeEvent) {
+    Session session;
+    for (int i = 0; i < kSerializeIkeys * kSerializeAnnotations; ++i) {
+        session.CreateFrameTimeHistogram(
+            MetricId::FrameTime(0, i % kSerializeIkeys),
+            Settings::DefaultHistogram(1));
+    }
+    for (int a = 0; a < kSerializeAnnotations; ++a) {
+        for (int k = 0; k < kSerializeIkeys; ++k) {
+            auto p = session.GetData<FrameTimeMetricData>(
+                MetricId::FrameTime(1 + a, k));
+            ASSERT_NE(p, nullptr);
+            for (int i = 0; i < 100; ++i)
+                p->Record(std::chrono::microseconds(15000 + (i * 997) % 4000));
+        }
+    }
+    RequestInfo request_info{};
+    request_info.experiment_id = "experiment";
+    request_info.session_id = "session";
+    BenchmarkIdProvider id_provider;
+    JsonSerializer serializer(session, &id_provider);
+    std::string evt_ser;
+    auto ns = NanosPerOp(1, kSerializeIterations, [&](int) {
+        serializer.SerializeEvent(request_info, evt_ser);
+    });
+    printf("%d histograms, %zu bytes: ",
+           kSerializeIkeys * kSerializeAnnotations, evt_ser.size());
+    Report("JsonSerializer::SerializeEvent", 1, ns);
+
+    // For comparison: json11 just dumping the same document, which the
+    // serializer used to do after building it as a tree.
+    std::string err;
+    auto json = json11::Json::parse(evt_ser, err);
+    ASSERT_TRUE(err.empty());
+    std::string dumped;
+    ns = NanosPerOp(1, kSerializeIterations,
+                    [&](int) { dumped = json.dump(); });
+    EXPECT_EQ(dumped, evt_ser);
+    Report("json11::Json::dump", 1, ns);
+}
+
+}  // namespace tuningfork_benchmark
@@ -0,0 +1,53 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstring>
+
+#include "benchmark_utils.h"
+#include "gtest/gtest.h"
+
+// Usage: tuningfork_benchmark [--benchmark_out=FILE] [--benchmark_dir=DIR]
+//                             [--gtest_filter=...]
+//
+// With --benchmark_out, each result is also appended to FILE as a line of
+// JSON, so that runs can be compared over time. Benchmarks that write files
+// do so under DIR, which defaults to /data/local/tmp, and are skipped if it
+// isn't writeable.
+int main(int argc, char* argv[]) {
+    ::testing::InitGoogleTest(&argc, argv);
+    const char kOutFlag[] = "--benchmark_out=";
+    const char kDirFlag[] = "--benchmark_dir=";
+    FILE* out = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], kOutFlag, sizeof(kOutFlag) - 1) == 0) {
+            const char* path = argv[i] + sizeof(kOutFlag) - 1;
+            out = fopen(path, "a");
+            if (out == nullptr) {
+                fprintf(stderr, "Can't open %s\n", path);
+                return 1;
+            }
+        } else if (strncmp(argv[i], kDirFlag, sizeof(kDirFlag) - 1) == 0) {
+            tuningfork_benchmark::SetFileDir(argv[i] + sizeof(kDirFlag) - 1);
+        } else {
+            fprintf(stderr, "Unknown argument: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    tuningfork_benchmark::SetReportFile(out);
+    int result = RUN_ALL_TESTS();
+    if (out != nullptr) fclose(out);
+    return result;
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "benchmark_utils.h"
+#include "gtest/gtest.h"
+#include "proc_file.h"
+
+namespace tuningfork_benchmark {
+
+constexpr int kProcIterations = 2000;
+
+// The parsers that ProcFile replaced, for comparison.
+
+// DefaultMemInfoProvider in tuningfork.
+size_t IfstreamParse(const std::string& path) {
+    std::unordered_map<std::string, size_t> data;
+    std::ifstream file_stream(path);
+    for (std::string line; std::getline(file_stream, line);) {
+        std::istringstream ss(line);
+        std::vector<std::string> split(std::istream_iterator<std::string>{ss},
+                                       std::istream_iterator<std::string>());
+        if (split.size() == 3 && split[2] == "kB") {
+            std::string& key = split[0];
+            key.pop_back();
+            data[key] = atoi(split[1].c_str()) * 1024;
+        }
+    }
+    return data.size();
+}
+
+// DefaultMetricsProvider in memory_advice.
+size_t RegexParse(const std::string& path) {
+    static const std::regex pattern("([^:]+)[^\\d]*(\\d+).*\n");
+    std::map<std::string, double> data;
+    std::ifstream file_stream(path);
+    std::string file((std::istreambuf_iterator<char>(file_stream)),
+                     std::istreambuf_iterator<char>());
+    std::smatch match;
+    while (std::regex_search(file, match, pattern)) {
+        data[match[1].str()] =
+            strtoll(match[2].str().c_str(), nullptr, 10) * 1024.0;
+        file = match.suffix().str();
+    }
+    return data.size();
+}
+
+void RunProcBenchmark(const char* path) {
+    gamesdk::ProcFile file(path);
+    if (!file.Read()) {
+        printf("%s: can't read\n", path);
+        return;
+    }
+    size_t n = 0;
+    auto ns = NanosPerOp(1, kProcIterations,
+                         [&](int) { n += IfstreamParse(path); });
+    printf("%s ", path);
+    Report("ifstream", 1, ns);
+    ns = NanosPerOp(1, kProcIterations, [&](int) { n += RegexParse(path); });
+    printf("%s ", path);
+    Report("regex", 1, ns);
+    ns = NanosPerOp(1, kProcIterations, [&](int) {
+        gamesdk::ProcField fields[] = {{"SwapTotal"}, {"MemAvailable"},
+                                       {"VmRSS"}, {"Rss"}};
+        if (file.Read()) n += file.GetFields(fields, 4);
+    });
+    printf("%s ", path);
+    Report("ProcFile::GetFields", 1, ns);
+    ns = NanosPerOp(1, kProcIterations, [&](int) {
+        if (file.Read())
+            file.ForEachField(
+                [&](const char*, size_t, uint64_t, bool) { ++n; });
+    });
+    printf("%s ", path);
+    Report("ProcFile::ForEachField", 1, ns);
+    EXPECT_GT(n, 0);
+}
+
+TEST(ProcFileBenchmark, Parse) {
+    RunProcBenchmark("/proc/meminfo");
+    RunProcBenchmark("/proc/self/status");
+    RunProcBenchmark("/proc/self/smaps_rollup");
+}
+
+}  // namespace tuningfork_benchmark
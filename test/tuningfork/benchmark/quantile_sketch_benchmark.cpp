@@ -0,0 +1,53 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "benchmark_utils.h"
+#include "core/histogram.h"
+#include "core/quantile_sketch.h"
+#include "gtest/gtest.h"
+
+namespace tuningfork_benchmark {
+
+namespace tf = tuningfork;
+
+constexpr int kSketchIterations = 1000000;
+
+// Frame times in ms, mostly 10-20ms with every 50th one up to 210ms.
+double FrameTimeMs(int i) {
+    return 10 + (i * 7919LL % 1000) * (i % 50 ? 0.01 : 0.2);
+}
+
+TEST(QuantileSketchBenchmark, Insert) {
+    tf::Histogram<double> h(0, 100, 200);
+    int i = 0;
+    auto ns = NanosPerOp(1, kSketchIterations,
+                         [&](int) { h.Add(FrameTimeMs(i++)); });
+    Report("Histogram200::Add", 1, ns);
+    printf("Histogram200 bytes=%zu\n",
+           sizeof(h) + h.BucketBytes());
+
+    tf::QuantileSketch q;
+    i = 0;
+    ns = NanosPerOp(1, kSketchIterations,
+                    [&](int) { q.Add(FrameTimeMs(i++)); });
+    Report("QuantileSketch::Add", 1, ns);
+    size_t bytes = sizeof(q);
+    for (auto& level : q.Levels())
+        bytes += sizeof(level) + level.capacity() * sizeof(float);
+    printf("QuantileSketch bytes=%zu retained=%zu\n", bytes, q.NumRetained());
+}
+
+}  // namespace tuningfork_benchmark
@@ -0,0 +1,108 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <unistd.h>
+
+#include <fstream>
+
+#include "benchmark_utils.h"
+#include "core/session.h"
+#include "gtest/gtest.h"
+
+using namespace tuningfork;
+
+namespace tuningfork_benchmark {
+
+constexpr int kIkeys = 4;
+constexpr int kAnnotations = 2500;
+constexpr int kMetrics = kIkeys * kAnnotations;
+constexpr int kIterations = 20;
+
+void CreateHistograms(Session& session, int n_metrics = kMetrics) {
+    for (int i = 0; i < n_metrics; ++i) {
+        session.CreateFrameTimeHistogram(MetricId::FrameTime(0, i % kIkeys),
+                                         Settings::DefaultHistogram(1));
+    }
+}
+
+// Record a frame time in every n'th annotation and instrument key
+// combination.
+void Fill(Session& session, int n) {
+    for (int i = 0; i < kMetrics; i += n) {
+        session
+            .GetData<FrameTimeMetricData>(
+                MetricId::FrameTime(1 + i / kIkeys, i % kIkeys))
+            ->Record(std::chrono::milliseconds(16));
+    }
+}
+
+TEST(SessionBenchmark, Iterate) {
+    for (int n : {1, 100}) {
+        Session session;
+        CreateHistograms(session);
+        Fill(session, n);
+        size_t found = 0;
+        auto ns = NanosPerOp(1, kIterations, [&](int) {
+            found +=
+                session.GetNonEmptyHistograms<FrameTimeMetricData>().size();
+        });
+        EXPECT_EQ(found, kIterations * ((kMetrics + n - 1) / n));
+        printf("%d of %d in use: ", (kMetrics + n - 1) / n, kMetrics);
+        Report("GetNonEmptyHistograms", 1, ns);
+    }
+}
+
+TEST(SessionBenchmark, MergeAndClear) {
+    Session from, to;
+    CreateHistograms(from);
+    CreateHistograms(to);
+    auto ns = NanosPerOp(1, kIterations, [&](int) {
+        Fill(from, 1);
+        to.Merge(from);
+        from.ClearData();
+        to.ClearData();
+    });
+    Report("Fill, Merge and ClearData of 10000 metrics", 1, ns);
+}
+
+size_t ResidentBytes() {
+    size_t total = 0, resident = 0;
+    std::ifstream("/proc/self/statm") >> total >> resident;
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+// Sessions are double-buffered, so there are two of each histogram.
+TEST(SessionBenchmark, ResidentMemory) {
+    size_t start = ResidentBytes();
+    // Increasing sizes, so that memory freed by one is reused by the next.
+    for (int n : {1000, 10000, 100000}) {
+        Session sessions[2];
+        for (auto& session : sessions) {
+            CreateHistograms(session, n);
+            // Use 1% of the combinations.
+            for (int i = 0; i < n; i += 100) {
+                session
+                    .GetData<FrameTimeMetricData>(
+                        MetricId::FrameTime(1 + i / kIkeys, i % kIkeys))
+                    ->Record(std::chrono::milliseconds(16));
+            }
+        }
+        printf("%d metrics: %zu KB resident\n", n,
+               (ResidentBytes() - start) / 1024);
+    }
+}
+
+}  // namespace tuningfork_benchmark
@@ -0,0 +1,200 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "core/crash_snapshot.h"
+
+#include <gtest/gtest.h>
+#include <signal.h>
+
+#include <fstream>
+#include <string>
+
+#include "core/tuningfork_utils.h"
+#include "jni/jni_helper.h"
+#include "test_utils.h"
+#include "tuningfork_test_c.h"
+
+namespace crash_snapshot_test {
+
+using namespace tuningfork;
+
+constexpr char kBasePath[] = "/data/local/tmp/tuningfork_crash_snapshot_test";
+
+std::string GetPath() {
+    // Use JNI if we can, for app cache usage rather than /data/local/tmp
+    init_jni_for_tests();
+    std::string dir = gamesdk::jni::IsValid()
+                          ? file_utils::GetAppCacheDir() +
+                                "/tuningfork_crash_snapshot_test"
+                          : kBasePath;
+    file_utils::CheckAndCreateDir(dir);
+    return dir + "/crash_snapshot.bin";
+}
+
+class IdMap : public IdProvider {
+    TuningFork_ErrorCode SerializedAnnotationToAnnotationId(
+        const ProtobufSerialization& ser, AnnotationId& id) override {
+        id = ser.size();
+        return TUNINGFORK_ERROR_OK;
+    }
+    TuningFork_ErrorCode MakeCompoundId(InstrumentationKey k,
+                                        AnnotationId annotation_id,
+                                        MetricId& id) override {
+        id = MetricId::FrameTime(annotation_id, k);
+        return TUNINGFORK_ERROR_OK;
+    }
+    TuningFork_ErrorCode AnnotationIdToSerializedAnnotation(
+        AnnotationId id, SerializedAnnotation& ann) override {
+        ann = SerializedAnnotation(id, 1);
+        return TUNINGFORK_ERROR_OK;
+    }
+    TuningFork_ErrorCode MetricIdToLoadingTimeMetadata(
+        MetricId id, LoadingTimeMetadataWithGroup& mg) override {
+        return TUNINGFORK_ERROR_BAD_PARAMETER;
+    }
+};
+
+const Settings::Histogram kHistogramSettings{0, 0, 100, 100};
+const Settings::Histogram kSketchSettings{
+    1,
+    0,
+    0,
+    16,
+    Settings::Histogram::Scale::LINEAR,
+    0,
+    Settings::Histogram::Storage::QUANTILE_SKETCH};
+
+// State used by the signal handler in the child process.
+CrashSnapshot* g_snapshot;
+const FrameTimeMetricData* g_data[2];
+
+void SnapshotOnCrash(int sig, siginfo_t*, void*) {
+    const uint8_t annotation[] = {1, 2};
+    g_snapshot->Begin();
+    g_snapshot->Add(annotation, sizeof(annotation), 0, *g_data[0]);
+    g_snapshot->Add(annotation, sizeof(annotation), 1, *g_data[1]);
+    g_snapshot->Commit();
+}
+
+void RecordFrames(FrameTimeMetricData& data) {
+    for (int i = 0; i < 1000; ++i)
+        data.Record(std::chrono::microseconds(10000 + (i * 7919) % 30000));
+}
+
+// Record some frames, then crash with SIGSEGV, writing the snapshot from
+// the signal handler.
+void RecordAndCrash(const std::string& path) {
+    CrashSnapshot snapshot;
+    if (!snapshot.Open(path)) _exit(1);
+    FrameTimeMetricData histogram(MetricId::FrameTime(2, 0),
+                                  kHistogramSettings);
+    FrameTimeMetricData sketch(MetricId::FrameTime(2, 1), kSketchSettings);
+    RecordFrames(histogram);
+    RecordFrames(sketch);
+    g_snapshot = &snapshot;
+    g_data[0] = &histogram;
+    g_data[1] = &sketch;
+    struct sigaction sa = {};
+    sa.sa_sigaction = SnapshotOnCrash;
+    sa.sa_flags = SA_SIGINFO | SA_RESETHAND;
+    sigaction(SIGSEGV, &sa, nullptr);
+    *static_cast<volatile int*>(nullptr) = 1;
+}
+
+class CrashSnapshotTest : public ::testing::Test {
+   protected:
+    void SetUp() override {
+        path_ = GetPath();
+        CrashSnapshot snapshot;
+        // Some devices don't allow writing to /data/local/tmp, however we
+        // don't want to give errors when they are run on the command-line.
+        if (!snapshot.Open(path_)) GTEST_SKIP();
+    }
+    void TearDown() override {
+        unlink(path_.c_str());
+        clear_jni_for_tests();
+    }
+    std::string path_;
+};
+
+TEST_F(CrashSnapshotTest, RecoversAfterSegfault) {
+    EXPECT_EXIT(RecordAndCrash(path_), ::testing::KilledBySignal(SIGSEGV),
+                "");
+    std::string snapshot;
+    ASSERT_TRUE(CrashSnapshot::Recover(path_, snapshot));
+    // It is only recovered once.
+    std::string again;
+    EXPECT_FALSE(CrashSnapshot::Recover(path_, again));
+
+    Session session;
+    session.CreateFrameTimeHistogram(MetricId::FrameTime(0, 0),
+                                     kHistogramSettings);
+    session.CreateFrameTimeHistogram(MetricId::FrameTime(0, 1),
+                                     kSketchSettings);
+    IdMap id_map;
+    ASSERT_EQ(CrashSnapshot::Merge(snapshot, id_map, session),
+              TUNINGFORK_ERROR_OK);
+
+    FrameTimeMetricData histogram(MetricId::FrameTime(2, 0),
+                                  kHistogramSettings);
+    FrameTimeMetricData sketch(MetricId::FrameTime(2, 1), kSketchSettings);
+    RecordFrames(histogram);
+    RecordFrames(sketch);
+    auto h = session.GetData<FrameTimeMetricData>(MetricId::FrameTime(2, 0));
+    ASSERT_NE(h, nullptr);
+    EXPECT_EQ(h->histogram_.buckets(), histogram.histogram_.buckets());
+    EXPECT_EQ(h->duration_, histogram.duration_);
+    auto q = session.GetData<FrameTimeMetricData>(MetricId::FrameTime(2, 1));
+    ASSERT_NE(q, nullptr);
+    EXPECT_EQ(q->quantiles_.Count(), sketch.quantiles_.Count());
+    EXPECT_EQ(q->quantiles_.Levels(), sketch.quantiles_.Levels());
+}
+
+TEST_F(CrashSnapshotTest, UncommittedSnapshotIsIgnored) {
+    {
+        CrashSnapshot snapshot;
+        ASSERT_TRUE(snapshot.Open(path_));
+        FrameTimeMetricData data(MetricId::FrameTime(0, 0),
+                                 kHistogramSettings);
+        RecordFrames(data);
+        snapshot.Begin();
+        snapshot.Add(nullptr, 0, 0, data);
+    }
+    std::string snapshot;
+    EXPECT_FALSE(CrashSnapshot::Recover(path_, snapshot));
+}
+
+TEST_F(CrashSnapshotTest, CorruptSnapshotIsIgnored) {
+    {
+        CrashSnapshot snapshot;
+        ASSERT_TRUE(snapshot.Open(path_, 4096));
+        FrameTimeMetricData data(MetricId::FrameTime(0, 0),
+                                 kHistogramSettings);
+        RecordFrames(data);
+        snapshot.Begin();
+        EXPECT_TRUE(snapshot.Add(nullptr, 0, 0, data));
+        snapshot.Commit();
+    }
+    {
+        std::fstream f(path_, std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(30);
+        f.put(0x7f);
+    }
+    std::string snapshot;
+    EXPECT_FALSE(CrashSnapshot::Recover(path_, snapshot));
+}
+
+}  // namespace crash_snapshot_test
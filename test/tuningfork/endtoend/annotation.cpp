@@ -14,7 +14,10 @@
  * limitations under the License.
  */
 
+#include <map>
+
 #include "common.h"
+#include "json11/json11.hpp"
 #include "test_utils.h"
 #include "tuningfork_test.h"
 
@@ -88,4 +91,95 @@ TEST(EndToEndTest, WithAnnotation) {
     CheckStrings("Annotation", result, ExpectedForAnnotationTest());
 }
 
+uint32_t RegisterLevel(com::google::tuningfork::Level level) {
+    Annotation ann;
+    ann.set_level(level);
+    TuningFork_CProtobufSerialization cann;
+    tf::ToCProtobufSerialization(tf::Serialize(ann), cann);
+    uint32_t id = 0;
+    EXPECT_EQ(TuningFork_registerAnnotation(&cann, &id), TUNINGFORK_ERROR_OK);
+    TuningFork_CProtobufSerialization_free(&cann);
+    return id;
+}
+
+// The report for each annotation in an upload.
+std::map<std::string, json11::Json> ReportsByAnnotation(
+    const TuningForkLogEvent& result) {
+    std::string err;
+    auto json = json11::Json::parse(result, err);
+    EXPECT_TRUE(err.empty()) << err;
+    std::map<std::string, json11::Json> reports;
+    for (auto& telemetry : json["telemetry"].array_items())
+        reports[telemetry["context"]["annotations"].string_value()] =
+            telemetry["report"];
+    return reports;
+}
+
+TEST(EndToEndTest, AnnotationsById) {
+    // {3} is the number of values in the Level enum in
+    // tuningfork_extensions.proto
+    auto settings = TestSettings(
+        tf::Settings::AggregationStrategy::Submission::TIME_BASED, 10000000, 2,
+        {3});
+    TuningForkTest test(settings, milliseconds(20),
+                        std::make_shared<TestDownloadBackend>(),
+                        /*enable_meminfo*/ true,
+                        /*enable_battery_reporting*/ true);
+    std::unique_lock<std::mutex> lock(*test.rmutex_);
+    // The battery, thermal and memory tasks first run straight away, with no
+    // annotation.
+    test.WaitForMemoryUpdates(1);
+    test.WaitForBatteryUpdates(1);
+    uint32_t level_1 = RegisterLevel(com::google::tuningfork::LEVEL_1);
+    uint32_t level_2 = RegisterLevel(com::google::tuningfork::LEVEL_2);
+    EXPECT_NE(level_1, level_2);
+    EXPECT_EQ(RegisterLevel(com::google::tuningfork::LEVEL_1), level_1);
+    EXPECT_EQ(TuningFork_setCurrentAnnotationById(level_1 + level_2 + 1),
+              TUNINGFORK_ERROR_INVALID_ANNOTATION);
+
+    ASSERT_EQ(TuningFork_setCurrentAnnotationById(level_1),
+              TUNINGFORK_ERROR_OK);
+    for (int i = 0; i < 11; ++i) {
+        test.IncrementTime();
+        tf::FrameTick(TFTICK_PACED_FRAME_TIME);
+    }
+    ASSERT_EQ(TuningFork_setCurrentAnnotationById(level_2),
+              TUNINGFORK_ERROR_OK);
+    for (int i = 0; i < 21; ++i) {
+        test.IncrementTime();
+        tf::FrameTick(TFTICK_PACED_FRAME_TIME);
+    }
+    // Move time on so that they run again, now under the second annotation.
+    test.IncrementTime((tf::kMemoryMetricInterval + seconds(1)) /
+                       milliseconds(20));
+    test.WaitForMemoryUpdates(2);
+    test.WaitForBatteryUpdates(2);
+    tf::Flush(true);
+    EXPECT_TRUE(test.cv_->wait_for(lock, s_test_wait_time) ==
+                std::cv_status::no_timeout)
+        << "Timeout";
+
+    auto reports = ReportsByAnnotation(test.Result());
+    // LEVEL_1 and LEVEL_2 serialized and base64 encoded.
+    auto report_1 = reports["CAE="];
+    auto report_2 = reports["CAI="];
+    // The first tick under each annotation only starts a frame.
+    auto frames = [](const json11::Json& report) {
+        int n = 0;
+        for (auto& h : report["rendering"]["render_time_histogram"]
+                           .array_items())
+            for (auto& c : h["counts"].array_items()) n += c.int_value();
+        return n;
+    };
+    EXPECT_EQ(frames(report_1), 10);
+    EXPECT_EQ(frames(report_2), 20);
+    for (auto metric : {"battery", "thermal", "memory"}) {
+        EXPECT_TRUE(report_1[metric].is_null()) << metric;
+        EXPECT_FALSE(report_2[metric].is_null()) << metric;
+    }
+    EXPECT_EQ(report_2["battery"]["battery_event"].array_items().size(), 1);
+    EXPECT_EQ(report_2["thermal"]["thermal_event"].array_items().size(), 1);
+    EXPECT_EQ(report_2["memory"]["memory_event"].array_items().size(), 1);
+}
+
 }  // namespace tuningfork_test
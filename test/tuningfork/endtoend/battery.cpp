@@ -43,6 +43,12 @@ TuningForkLogEvent TestEndToEndWithBattery() {
                 std::cv_status::no_timeout)
         << "Timeout";
 
+    // Battery reporting runs on the async telemetry thread.
+    tf::AsyncTelemetry::Stats stats;
+    EXPECT_EQ(tf::GetAsyncTelemetryStats(stats), TUNINGFORK_ERROR_OK);
+    EXPECT_GT(stats.wakeups, 0);
+    EXPECT_GE(stats.tasks_run, stats.wakeups);
+
     return test.Result();
 }
 
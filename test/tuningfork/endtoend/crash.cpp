@@ -0,0 +1,76 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <signal.h>
+#include <stdio.h>
+
+#include "common.h"
+#include "json11/json11.hpp"
+#include "test_utils.h"
+#include "tuningfork_test.h"
+
+using namespace gamesdk_test;
+
+namespace tuningfork_test {
+
+const int kCrashFrames = 10;
+
+tf::Settings CrashSettings() {
+    return TestSettings(
+        tf::Settings::AggregationStrategy::Submission::TIME_BASED, 10000000, 2,
+        {});
+}
+
+// Tick some frames, then crash before anything is flushed, so that the
+// frame times are only in the crash snapshot.
+void TickAndCrash() {
+    TuningForkTest test(CrashSettings());
+    for (int i = 0; i < kCrashFrames + 1; ++i) {
+        test.IncrementTime();
+        tf::FrameTick(TFTICK_PACED_FRAME_TIME);
+    }
+    raise(SIGSEGV);
+}
+
+TEST(EndToEndTest, CrashSnapshotKeepsInstrumentKeys) {
+    EXPECT_EXIT(TickAndCrash(), ::testing::KilledBySignal(SIGSEGV), "");
+
+    // The next run uploads the frame times from the snapshot.
+    TuningForkTest test(CrashSettings());
+    std::unique_lock<std::mutex> lock(*test.rmutex_);
+    tf::Flush(true);
+    // Wait for the upload thread to complete writing the string
+    EXPECT_TRUE(test.cv_->wait_for(lock, s_test_wait_time) ==
+                std::cv_status::no_timeout)
+        << "Timeout";
+    remove((tf::DefaultTuningForkSaveDirectory() + "/crash_info.bin").c_str());
+
+    std::string err;
+    auto json = json11::Json::parse(test.Result(), err);
+    ASSERT_TRUE(err.empty()) << err;
+    int frames = 0;
+    for (auto& telemetry : json["telemetry"].array_items()) {
+        for (auto& h :
+             telemetry["report"]["rendering"]["render_time_histogram"]
+                 .array_items()) {
+            EXPECT_EQ(h["instrument_id"].int_value(), TFTICK_PACED_FRAME_TIME);
+            for (auto& c : h["counts"].array_items()) frames += c.int_value();
+        }
+    }
+    EXPECT_EQ(frames, kCrashFrames);
+}
+
+}  // namespace tuningfork_test
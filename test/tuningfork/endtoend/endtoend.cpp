@@ -14,7 +14,10 @@
  * limitations under the License.
  */
 
+#include <thread>
+
 #include "common.h"
+#include "json11/json11.hpp"
 #include "test_utils.h"
 #include "tuningfork_test.h"
 
@@ -79,4 +82,314 @@ TEST(EndToEndTest, Base) {
     CheckStrings("Base", result, expected);
 }
 
+// With sampling, each recorded frame counts as sample_period frames towards a
+// tick-based submission.
+TEST(EndToEndTest, TickBasedWithSampling) {
+    const int kSamplePeriod = 4;
+    const int kFrames = 40;
+    tf::Settings::Histogram histogram{TFTICK_RAW_FRAME_TIME, 15, 45, 3};
+    histogram.sampling = tf::Settings::Histogram::Sampling::EVERY_NTH;
+    histogram.sample_period = kSamplePeriod;
+    auto settings =
+        TestSettings(tf::Settings::AggregationStrategy::Submission::TICK_BASED,
+                     kFrames, 1, {}, {histogram});
+    TuningForkTest test(settings);
+    std::unique_lock<std::mutex> lock(*test.rmutex_);
+    // Every 4th tick is stamped and the next one records a frame, so the
+    // 10th sample is recorded by tick 41.
+    for (int i = 0; i < kFrames + 1; ++i) {
+        test.IncrementTime();
+        tf::FrameTick(TFTICK_RAW_FRAME_TIME);
+    }
+    // Wait for the upload thread to complete writing the string
+    EXPECT_TRUE(test.cv_->wait_for(lock, s_test_wait_time) ==
+                std::cv_status::no_timeout)
+        << "Timeout";
+
+    TuningForkLogEvent expected = R"TF(
+{
+  "name": "applications//apks/0",
+  "session_context":
+{
+  "device": {
+    "brand": "",
+    "build_version": "",
+    "cpu_core_freqs_hz": [],
+    "device": "",
+    "fingerprint": "",
+    "gles_version": {
+      "major": 0,
+      "minor": 0
+    },
+    "model": "",
+    "product": "",
+    "soc_manufacturer": "",
+    "soc_model": "",
+    "swap_total_bytes": 123,
+    "total_memory_bytes": 0
+  },
+  "game_sdk_info": {
+    "session_id": "",
+    "version": "1.0.0"
+  },
+  "time_period": {
+    "end_time": "!REGEX(.*?Z)",
+    "start_time": "!REGEX(.*?Z)"
+  }
+},
+  "telemetry": [{
+    "context": {
+      "annotations": "",
+      "duration": "0.8s",
+      "tuning_parameters": {
+        "experiment_id": "",
+        "serialized_fidelity_parameters": ""
+      }
+    },
+    "report": {
+      "rendering": {
+        "render_time_histogram": [{
+         "counts": [0, 40, 0, 0, 0],
+         "instrument_id": 64000,
+         "sample_period": 4
+        }]
+      }
+    }
+  }]
+}
+)TF";
+    CheckStrings("TickBasedWithSampling", test.Result(), expected);
+}
+
+TuningForkLogEvent TestEndToEndMultipleThreads() {
+    const int NTHREADS = 2;
+    const int NFRAMES = 50;
+    auto settings =
+        TestSettings(tf::Settings::AggregationStrategy::Submission::TIME_BASED,
+                     10100, 1, {}, {{TFTICK_RAW_FRAME_TIME, 50, 150, 10}});
+    TuningForkTest test(settings, milliseconds(100));
+    std::unique_lock<std::mutex> lock(*test.rmutex_);
+    // Frame times from each thread are recorded separately and should all be
+    // merged into the same histogram when flushing.
+    std::vector<std::thread> threads;
+    for (int t = 0; t < NTHREADS; ++t) {
+        threads.emplace_back([]() {
+            for (int i = 0; i < NFRAMES; ++i) {
+                tf::FrameDeltaTimeNanos(TFTICK_RAW_FRAME_TIME,
+                                        milliseconds(100));
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+    tf::Flush(true);
+    // Wait for the upload thread to complete writing the string
+    EXPECT_TRUE(test.cv_->wait_for(lock, s_test_wait_time) ==
+                std::cv_status::no_timeout)
+        << "Timeout";
+
+    return test.Result();
+}
+
+TEST(EndToEndTest, MultipleThreads) {
+    auto result = TestEndToEndMultipleThreads();
+    TuningForkLogEvent expected = R"TF(
+{
+  "name": "applications//apks/0",
+  "session_context":
+{
+  "device": {
+    "brand": "",
+    "build_version": "",
+    "cpu_core_freqs_hz": [],
+    "device": "",
+    "fingerprint": "",
+    "gles_version": {
+      "major": 0,
+      "minor": 0
+    },
+    "model": "",
+    "product": "",
+    "soc_manufacturer": "",
+    "soc_model": "",
+    "swap_total_bytes": 123,
+    "total_memory_bytes": 0
+  },
+  "game_sdk_info": {
+    "session_id": "",
+    "version": "1.0.0"
+  },
+  "time_period": {
+    "end_time": "!REGEX(.*?Z)",
+    "start_time": "!REGEX(.*?Z)"
+  }
+},
+  "telemetry": [{
+    "context": {
+      "annotations": "",
+      "duration": "10s",
+      "tuning_parameters": {
+        "experiment_id": "",
+        "serialized_fidelity_parameters": ""
+      }
+    },
+    "report": {
+      "rendering": {
+        "render_time_histogram": [{
+         "counts": [
+           0, 0, 0, 0, 0, 0, 100, 0, 0, 0, 0, 0],
+         "instrument_id": 64000
+        }]
+      }
+    }
+  }]
+}
+)TF";
+    CheckStrings("MultipleThreads", result, expected);
+}
+
+TuningForkLogEvent TestEndToEndBatch() {
+    auto settings =
+        TestSettings(tf::Settings::AggregationStrategy::Submission::TIME_BASED,
+                     10100, 1, {}, {{TFTICK_RAW_FRAME_TIME, 50, 150, 10}});
+    TuningForkTest test(settings, milliseconds(100));
+    std::unique_lock<std::mutex> lock(*test.rmutex_);
+    std::vector<uint64_t> dts(30, 100000000);
+    tf::FrameDeltaTimeNanosBatch(TFTICK_RAW_FRAME_TIME, dts.data(), dts.size());
+    std::vector<tf::InstrumentationKey> keys(20, TFTICK_RAW_FRAME_TIME);
+    dts.assign(20, 60000000);
+    tf::FrameDeltaTimeNanosMultiKeyBatch(keys.data(), dts.data(), dts.size());
+    tf::Flush(true);
+    // Wait for the upload thread to complete writing the string
+    EXPECT_TRUE(test.cv_->wait_for(lock, s_test_wait_time) ==
+                std::cv_status::no_timeout)
+        << "Timeout";
+
+    return test.Result();
+}
+
+TEST(EndToEndTest, Batch) {
+    auto result = TestEndToEndBatch();
+    TuningForkLogEvent expected = R"TF(
+{
+  "name": "applications//apks/0",
+  "session_context":
+{
+  "device": {
+    "brand": "",
+    "build_version": "",
+    "cpu_core_freqs_hz": [],
+    "device": "",
+    "fingerprint": "",
+    "gles_version": {
+      "major": 0,
+      "minor": 0
+    },
+    "model": "",
+    "product": "",
+    "soc_manufacturer": "",
+    "soc_model": "",
+    "swap_total_bytes": 123,
+    "total_memory_bytes": 0
+  },
+  "game_sdk_info": {
+    "session_id": "",
+    "version": "1.0.0"
+  },
+  "time_period": {
+    "end_time": "!REGEX(.*?Z)",
+    "start_time": "!REGEX(.*?Z)"
+  }
+},
+  "telemetry": [{
+    "context": {
+      "annotations": "",
+      "duration": "4.2s",
+      "tuning_parameters": {
+        "experiment_id": "",
+        "serialized_fidelity_parameters": ""
+      }
+    },
+    "report": {
+      "rendering": {
+        "render_time_histogram": [{
+         "counts": [
+           0, 0, 20, 0, 0, 0, 30, 0, 0, 0, 0, 0],
+         "instrument_id": 64000
+        }]
+      }
+    }
+  }]
+}
+)TF";
+    CheckStrings("Batch", result, expected);
+}
+
+// Frame times given as deltas count towards jank like ticked ones.
+TEST(EndToEndTest, JankFromDeltaTimes) {
+    auto settings =
+        TestSettings(tf::Settings::AggregationStrategy::Submission::TIME_BASED,
+                     10100, 1, {});
+    TuningForkTest test(settings);
+    ASSERT_EQ(TuningFork_setSwapIntervalNanos(16666667), TUNINGFORK_ERROR_OK);
+    std::unique_lock<std::mutex> lock(*test.rmutex_);
+    // Two frames missing 2 vsyncs each, then one missing 5.
+    for (int ms : {16, 50, 50, 16, 100, 16}) {
+        auto dt = nanoseconds(milliseconds(ms)).count();
+        EXPECT_EQ(TuningFork_frameDeltaTimeNanos(TFTICK_RAW_FRAME_TIME, dt),
+                  TUNINGFORK_ERROR_OK);
+    }
+    tf::Flush(true);
+    // Wait for the upload thread to complete writing the string
+    EXPECT_TRUE(test.cv_->wait_for(lock, s_test_wait_time) ==
+                std::cv_status::no_timeout)
+        << "Timeout";
+
+    std::string err;
+    auto json = json11::Json::parse(test.Result(), err);
+    ASSERT_TRUE(err.empty()) << err;
+    auto jank = json["telemetry"][0]["report"]["rendering"]
+                    ["render_time_histogram"][0]["jank"];
+    EXPECT_EQ(jank["frames"].string_value(), "6");
+    EXPECT_EQ(jank["janky_frames"].string_value(), "3");
+    EXPECT_EQ(jank["missed_frames"].string_value(), "9");
+    EXPECT_EQ(jank["big_janks"].string_value(), "1");
+    EXPECT_EQ(jank["longest_run"].string_value(), "2");
+    EXPECT_EQ(jank["stutter_clusters"].string_value(), "1");
+    std::vector<std::string> runs;
+    for (auto& r : jank["runs"].array_items()) runs.push_back(r.string_value());
+    EXPECT_EQ(runs, std::vector<std::string>({"1", "1", "0", "0", "0"}));
+}
+
+// Ticks mustn't wait for an upload, however long it takes.
+TEST(EndToEndTest, FrameTickDuringSlowUpload) {
+    const int kTicksPerUpload = 100;
+    auto settings =
+        TestSettings(tf::Settings::AggregationStrategy::Submission::TICK_BASED,
+                     kTicksPerUpload, 1, {});
+    TuningForkTest test(settings);
+    test.test_backend_.upload_delay_ms = 500;
+    for (int i = 0; i <= kTicksPerUpload; ++i) {
+        test.IncrementTime();
+        tf::FrameTick(TFTICK_RAW_FRAME_TIME);
+    }
+    auto deadline = std::chrono::steady_clock::now() + s_test_wait_time;
+    while (!test.test_backend_.uploading &&
+           std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(milliseconds(1));
+    ASSERT_TRUE(test.test_backend_.uploading) << "Upload didn't start";
+
+    // Tick through another flush while the upload thread is in the backend.
+    tf::Duration max_tick = tf::Duration::zero();
+    for (int i = 0; i < kTicksPerUpload; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        test.IncrementTime();
+        EXPECT_EQ(tf::FrameTick(TFTICK_RAW_FRAME_TIME), TUNINGFORK_ERROR_OK);
+        max_tick = std::max<tf::Duration>(
+            max_tick, std::chrono::steady_clock::now() - start);
+    }
+    EXPECT_TRUE(test.test_backend_.uploading);
+    EXPECT_LT(max_tick, milliseconds(50));
+    test.test_backend_.upload_delay_ms = 0;
+}
+
 }  // namespace tuningfork_test
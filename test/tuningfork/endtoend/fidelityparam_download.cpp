@@ -15,6 +15,7 @@
  */
 
 #include "common.h"
+#include "core/tuningfork_utils.h"
 #include "test_utils.h"
 #include "tuningfork_test.h"
 
@@ -149,4 +150,209 @@ TEST(EndToEndTest, FidelityParamDownloadRequest) {
     backend.GenerateTuningParameters(request, nullptr, fps, experiment_id);
 }
 
+TEST(EndToEndTest, FidelityParamDownloadNotModified) {
+    tf::HttpBackend backend;
+    tf::HttpRequest inner_request("https://test.google.com", "dummy_api_key",
+                                  milliseconds(1000));
+    inner_request.IfNoneMatch("v1");
+    TestRequest request(inner_request,
+                        {{empty_tuning_parameters_request, 304, ""}});
+    tf::ProtobufSerialization fps;
+    std::string experiment_id;
+    EXPECT_EQ(
+        backend.GenerateTuningParameters(request, nullptr, fps, experiment_id),
+        TUNINGFORK_ERROR_FIDELITY_PARAMS_NOT_MODIFIED);
+}
+
+// Stands in for the server, taking latency to respond to each request. A
+// server without a version of the params can't be reached.
+class TestConditionalBackend : public TestDownloadBackend {
+   public:
+    TestConditionalBackend(milliseconds latency,
+                           const tf::ProtobufSerialization& params,
+                           const std::string& version)
+        : latency_(latency), params_(params), version_(version) {}
+
+    TuningFork_ErrorCode GenerateTuningParameters(
+        tf::HttpRequest& request,
+        const tf::ProtobufSerialization* training_mode_params,
+        tf::ProtobufSerialization& fidelity_params,
+        std::string& experiment_id) override {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if_none_match_ = request.IfNoneMatch();
+            ++n_requests_;
+        }
+        std::this_thread::sleep_for(latency_);
+        if (version_.empty())
+            return TUNINGFORK_ERROR_GENERATE_TUNING_PARAMETERS_ERROR;
+        request.SetResponseCaching(version_, kMaxAge);
+        if (request.IfNoneMatch() == version_)
+            return TUNINGFORK_ERROR_FIDELITY_PARAMS_NOT_MODIFIED;
+        fidelity_params = params_;
+        experiment_id = "server_experiment";
+        return TUNINGFORK_ERROR_OK;
+    }
+
+    int Requests() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return n_requests_;
+    }
+
+    std::string IfNoneMatch() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return if_none_match_;
+    }
+
+    static constexpr tf::Duration kMaxAge = std::chrono::hours(2);
+
+   private:
+    milliseconds latency_;
+    tf::ProtobufSerialization params_;
+    std::string version_;
+    std::mutex mutex_;
+    int n_requests_ = 0;
+    std::string if_none_match_;
+};
+
+constexpr tf::Duration TestConditionalBackend::kMaxAge;
+
+static std::vector<tf::ProtobufSerialization> cached_fp_callbacks;
+
+void CachedFidelityParamsCallback(const TuningFork_CProtobufSerialization* s) {
+    std::lock_guard<std::mutex> lock(fp_mutex);
+    cached_fp_callbacks.push_back(tf::ToProtobufSerialization(*s));
+    fp_cv.notify_all();
+}
+
+constexpr char kFidelityParamsCacheDir[] =
+    "/data/local/tmp/tuningfork_fp_cache_test";
+const tf::ProtobufSerialization cached_fps = {4, 5, 6};
+const tf::ProtobufSerialization server_fps = {7, 8, 9};
+
+struct CachedDownloadResult {
+    // The params passed to the callback, and when.
+    std::vector<tf::ProtobufSerialization> callbacks;
+    milliseconds first_callback_time;
+    std::string if_none_match;
+    std::string experiment_id;
+    tf::ProtobufSerialization current_params;
+    tf::CachedFidelityParams cache_after;
+};
+
+// Start the download thread with cached params expiring at expiry and a
+// server whose params are tagged server_version, or which can't be reached if
+// that is empty.
+void TestCachedDownload(tf::SystemTimePoint expiry,
+                        const std::string& server_version,
+                        size_t expected_callbacks,
+                        CachedDownloadResult& result) {
+    auto settings = TestSettings(
+        tf::Settings::AggregationStrategy::Submission::TICK_BASED, 100, 1, {});
+    settings.api_key = "dummy_api_key";
+    TuningForkTest test(settings);
+    auto backend = std::make_shared<TestConditionalBackend>(
+        milliseconds(300), server_fps, server_version);
+    test.test_backend_.SetDownloadBackend(backend);
+
+    auto cache = std::make_shared<tf::FidelityParamsCache>(
+        std::string(kFidelityParamsCacheDir) + "/saved_fp.bin");
+    // The test time provider's system clock starts at the epoch.
+    ASSERT_TRUE(cache->Save({cached_fps, "cached_experiment", "v1", expiry}));
+
+    std::unique_lock<std::mutex> lock(fp_mutex);
+    cached_fp_callbacks.clear();
+    auto start = steady_clock::now();
+    ASSERT_EQ(tf::StartFidelityParamDownloadThread(
+                  default_fps, CachedFidelityParamsCallback, 1000, 10000,
+                  cache),
+              TUNINGFORK_ERROR_OK);
+    EXPECT_TRUE(fp_cv.wait_for(lock, s_test_wait_time, [&]() {
+        return !cached_fp_callbacks.empty();
+    })) << "Timeout";
+    result.first_callback_time =
+        duration_cast<milliseconds>(steady_clock::now() - start);
+    EXPECT_TRUE(fp_cv.wait_for(lock, s_test_wait_time, [&]() {
+        return cached_fp_callbacks.size() >= expected_callbacks;
+    })) << "Timeout";
+    lock.unlock();
+    // Let the revalidation finish.
+    while (backend->Requests() == 0)
+        std::this_thread::sleep_for(milliseconds(10));
+    tf::KillDownloadThreads();
+
+    result.callbacks = cached_fp_callbacks;
+    result.if_none_match = backend->IfNoneMatch();
+    result.experiment_id = tf::RequestInfo::CachedValue().experiment_id;
+    result.current_params =
+        tf::RequestInfo::CachedValue().current_fidelity_parameters;
+    EXPECT_EQ(backend->Requests(), 1);
+    EXPECT_TRUE(cache->Load(result.cache_after));
+    cache->Remove();
+}
+
+bool CanCacheFidelityParams() {
+    return tf::file_utils::CheckAndCreateDir(kFidelityParamsCacheDir);
+}
+
+TEST(EndToEndTest, FidelityParamsCacheUsedWhileRevalidating) {
+    if (!CanCacheFidelityParams()) GTEST_SKIP();
+    CachedDownloadResult result;
+    TestCachedDownload(tf::SystemTimePoint() + std::chrono::hours(1), "v1", 1,
+                       result);
+    // The cached params didn't wait for the server's response.
+    EXPECT_LT(result.first_callback_time, milliseconds(300));
+    ASSERT_EQ(result.callbacks.size(), 1);
+    EXPECT_EQ(result.callbacks[0], cached_fps);
+    EXPECT_EQ(result.if_none_match, "v1");
+    EXPECT_EQ(result.experiment_id, "cached_experiment");
+    // The server said they are still current, for another 2 hours.
+    EXPECT_EQ(result.cache_after.params, cached_fps);
+    EXPECT_EQ(result.cache_after.version, "v1");
+    EXPECT_EQ(result.cache_after.expiry,
+              tf::SystemTimePoint() + TestConditionalBackend::kMaxAge);
+}
+
+TEST(EndToEndTest, FidelityParamsCacheUpdatedWhileRevalidating) {
+    if (!CanCacheFidelityParams()) GTEST_SKIP();
+    CachedDownloadResult result;
+    TestCachedDownload(tf::SystemTimePoint() + std::chrono::hours(1), "v2", 2,
+                       result);
+    EXPECT_LT(result.first_callback_time, milliseconds(300));
+    ASSERT_EQ(result.callbacks.size(), 2);
+    EXPECT_EQ(result.callbacks[0], cached_fps);
+    EXPECT_EQ(result.callbacks[1], server_fps);
+    EXPECT_EQ(result.cache_after.params, server_fps);
+    EXPECT_EQ(result.cache_after.version, "v2");
+    EXPECT_EQ(result.experiment_id, "server_experiment");
+    EXPECT_EQ(result.cache_after.experiment_id, "server_experiment");
+}
+
+TEST(EndToEndTest, FidelityParamsCacheKeptWhenRevalidationFails) {
+    if (!CanCacheFidelityParams()) GTEST_SKIP();
+    CachedDownloadResult result;
+    auto expiry = tf::SystemTimePoint() + std::chrono::hours(1);
+    TestCachedDownload(expiry, "", 1, result);
+    ASSERT_EQ(result.callbacks.size(), 1);
+    EXPECT_EQ(result.callbacks[0], cached_fps);
+    // The cached params are still the ones in use, not the training params.
+    EXPECT_EQ(result.current_params, cached_fps);
+    EXPECT_EQ(result.experiment_id, "cached_experiment");
+    EXPECT_EQ(result.cache_after.version, "v1");
+    EXPECT_EQ(result.cache_after.expiry, expiry);
+}
+
+TEST(EndToEndTest, ExpiredFidelityParamsCacheWaitsForServer) {
+    if (!CanCacheFidelityParams()) GTEST_SKIP();
+    CachedDownloadResult result;
+    TestCachedDownload(tf::SystemTimePoint(), "v1", 1, result);
+    EXPECT_GE(result.first_callback_time, milliseconds(300));
+    ASSERT_EQ(result.callbacks.size(), 1);
+    // The server confirmed the cached params.
+    EXPECT_EQ(result.callbacks[0], cached_fps);
+    EXPECT_EQ(result.if_none_match, "v1");
+    EXPECT_EQ(result.cache_after.expiry,
+              tf::SystemTimePoint() + TestConditionalBackend::kMaxAge);
+}
+
 }  // namespace tuningfork_test
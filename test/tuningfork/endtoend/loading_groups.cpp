@@ -14,7 +14,10 @@
  * limitations under the License.
  */
 
+#include <map>
+
 #include "common.h"
+#include "json11/json11.hpp"
 #include "test_utils.h"
 #include "tuningfork_test.h"
 
@@ -229,4 +232,69 @@ TEST(EndToEndTest, WithLoadingGroupsWithAnnotation) {
         ExpectedResultWithLoadingGroups(use_stop_call, with_annotation));
 }
 
+// Shaders load in parallel with assets and wait for some data from the
+// network part way through. The group waits for the shaders.
+TEST(EndToEndTest, LoadingSpansBreakdown) {
+    using Source = TuningFork_LoadingTimeMetadata::LoadingSource;
+    auto settings =
+        TestSettings(tf::Settings::AggregationStrategy::Submission::TICK_BASED,
+                     100, 1, {}, {}, 0 /* use default */, 4);
+    TuningForkTest test(settings, milliseconds(10));
+    TuningFork_LoadingTimeMetadata metadata{};
+    metadata.state = TuningFork_LoadingTimeMetadata::COLD_START;
+    TuningFork_LoadingGroupHandle group;
+    ASSERT_EQ(TuningFork_startLoadingGroup(&metadata, sizeof(metadata),
+                                           nullptr, &group),
+              TUNINGFORK_ERROR_OK);
+    TuningFork_LoadingSpanHandle assets, shaders, network;
+    ASSERT_EQ(TuningFork_startLoadingSpan(Source::DEVICE_STORAGE, 0, &assets),
+              TUNINGFORK_ERROR_OK);
+    test.IncrementTime();
+    ASSERT_EQ(
+        TuningFork_startLoadingSpan(Source::SHADER_COMPILATION, 0, &shaders),
+        TUNINGFORK_ERROR_OK);
+    test.IncrementTime();
+    ASSERT_EQ(TuningFork_startLoadingSpan(Source::NETWORK, shaders, &network),
+              TUNINGFORK_ERROR_OK);
+    test.IncrementTime(3);
+    EXPECT_EQ(TuningFork_stopLoadingSpan(network), TUNINGFORK_ERROR_OK);
+    test.IncrementTime();
+    EXPECT_EQ(TuningFork_stopLoadingSpan(assets), TUNINGFORK_ERROR_OK);
+    test.IncrementTime(3);
+    EXPECT_EQ(TuningFork_stopLoadingSpan(shaders), TUNINGFORK_ERROR_OK);
+    test.IncrementTime();
+    EXPECT_EQ(TuningFork_stopLoadingGroup(group), TUNINGFORK_ERROR_OK);
+
+    std::unique_lock<std::mutex> lock(*test.rmutex_);
+    tf::Flush(true);
+    // Wait for the upload thread to complete writing the string
+    EXPECT_TRUE(test.cv_->wait_for(lock, s_test_wait_time) ==
+                std::cv_status::no_timeout)
+        << "Timeout";
+
+    std::string err;
+    auto json = json11::Json::parse(test.Result(), err);
+    ASSERT_TRUE(err.empty()) << err;
+    json11::Json breakdown;
+    for (auto& telemetry : json["telemetry"].array_items())
+        for (auto& event :
+             telemetry["report"]["loading"]["loading_events"].array_items())
+            if (event["loading_breakdown"].is_object())
+                breakdown = event["loading_breakdown"];
+    ASSERT_TRUE(breakdown.is_object()) << test.Result();
+    EXPECT_DOUBLE_EQ(breakdown["parallelism"].number_value(), 1.4);
+    // Exclusive time and time on the critical path by source.
+    std::map<int, std::pair<std::string, std::string>> stages;
+    for (auto& stage : breakdown["stages"].array_items())
+        stages[stage["source"].int_value()] = {
+            stage["exclusive"].string_value(),
+            stage["critical_path"].string_value()};
+    std::map<int, std::pair<std::string, std::string>> expected = {
+        {Source::DEVICE_STORAGE, {"0.06s", "0s"}},
+        {Source::NETWORK, {"0.03s", "0.03s"}},
+        {Source::SHADER_COMPILATION, {"0.05s", "0.05s"}},
+        {Source::TOTAL_USER_WAIT_FOR_GROUP, {"0.01s", "0.02s"}}};
+    EXPECT_EQ(stages, expected);
+}
+
 }  // namespace tuningfork_test
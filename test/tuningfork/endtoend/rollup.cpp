@@ -0,0 +1,112 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vector>
+
+#include "common.h"
+#include "test_utils.h"
+#include "tuningfork_test.h"
+
+using namespace gamesdk_test;
+
+namespace tuningfork_test {
+
+// Each session is 50 frames of 20ms, i.e. one 1s rollup slot.
+const int kSessionFrames = 50;
+const int kSlotMs = 1000;
+
+std::vector<TuningFork_RollupWindow> GetWindows(uint32_t level,
+                                                TuningFork_InstrumentKey key) {
+    uint32_t n = 0;
+    EXPECT_EQ(TuningFork_getRollupWindows(level, key, nullptr, &n),
+              TUNINGFORK_ERROR_OK);
+    std::vector<TuningFork_RollupWindow> windows(n);
+    EXPECT_EQ(TuningFork_getRollupWindows(level, key, windows.data(), &n),
+              TUNINGFORK_ERROR_OK);
+    EXPECT_EQ(n, windows.size());
+    return windows;
+}
+
+TEST(EndToEndTest, RollupWindows) {
+    auto settings =
+        TestSettings(tf::Settings::AggregationStrategy::Submission::TICK_BASED,
+                     kSessionFrames, 1, {});
+    settings.rollup_slot_ms = kSlotMs;
+    TuningForkTest test(settings);
+    std::unique_lock<std::mutex> lock(*test.rmutex_);
+    // The first tick doesn't record a frame.
+    for (int i = 0; i < kSessionFrames + 1; ++i) {
+        test.IncrementTime();
+        tf::FrameTick(TFTICK_RAW_FRAME_TIME);
+    }
+    // Wait for the upload thread to roll up and upload the session
+    EXPECT_TRUE(test.cv_->wait_for(lock, s_test_wait_time) ==
+                std::cv_status::no_timeout)
+        << "Timeout";
+    // Any frame over goes in the next session, which isn't rolled up.
+    for (int i = 0; i < kSessionFrames + 1; ++i) {
+        test.IncrementTime();
+        tf::FrameTick(TFTICK_RAW_FRAME_TIME);
+    }
+    EXPECT_TRUE(test.cv_->wait_for(lock, s_test_wait_time) ==
+                std::cv_status::no_timeout)
+        << "Timeout";
+
+    // The sessions ended in consecutive slots.
+    auto slots = GetWindows(0, TFTICK_RAW_FRAME_TIME);
+    ASSERT_EQ(slots.size(), 2);
+    for (auto& slot : slots) {
+        EXPECT_EQ(slot.length_ms, kSlotMs);
+        EXPECT_EQ(slot.start_ms % kSlotMs, 0);
+        EXPECT_EQ(slot.frames, kSessionFrames);
+        EXPECT_EQ(slot.frame_time_ns,
+                  nanoseconds(milliseconds(20)).count() * kSessionFrames);
+        EXPECT_EQ(slot.janky_frames, 0);
+    }
+    EXPECT_EQ(slots[1].start_ms, slots[0].start_ms + kSlotMs);
+    // Both are in the first 10 slot window.
+    auto tens = GetWindows(1, TFTICK_RAW_FRAME_TIME);
+    ASSERT_EQ(tens.size(), 1);
+    EXPECT_EQ(tens[0].start_ms, 0);
+    EXPECT_EQ(tens[0].length_ms, 10 * kSlotMs);
+    EXPECT_EQ(tens[0].frames, 2 * kSessionFrames);
+
+    // Only the most recent windows that fit are written.
+    TuningFork_RollupWindow last;
+    uint32_t n = 1;
+    EXPECT_EQ(TuningFork_getRollupWindows(0, TFTICK_RAW_FRAME_TIME, &last, &n),
+              TUNINGFORK_ERROR_OK);
+    EXPECT_EQ(n, 2);
+    EXPECT_EQ(last.start_ms, slots[1].start_ms);
+    // Other instrument keys have no frames.
+    for (auto& slot : GetWindows(0, TFTICK_PACED_FRAME_TIME))
+        EXPECT_EQ(slot.frames, 0);
+    EXPECT_EQ(TuningFork_getRollupWindows(3, TFTICK_RAW_FRAME_TIME, &last, &n),
+              TUNINGFORK_ERROR_BAD_PARAMETER);
+    EXPECT_EQ(TuningFork_getRollupWindows(0, TFTICK_RAW_FRAME_TIME, &last,
+                                          nullptr),
+              TUNINGFORK_ERROR_BAD_PARAMETER);
+}
+
+TEST(EndToEndTest, NoRollupWindowsWhenDisabled) {
+    auto settings =
+        TestSettings(tf::Settings::AggregationStrategy::Submission::TICK_BASED,
+                     kSessionFrames, 1, {});
+    TuningForkTest test(settings);
+    EXPECT_TRUE(GetWindows(0, TFTICK_RAW_FRAME_TIME).empty());
+}
+
+}  // namespace tuningfork_test
@@ -16,6 +16,9 @@
 
 #pragma once
 
+#include <atomic>
+#include <thread>
+
 #include "common.h"
 
 namespace tuningfork_test {
@@ -31,6 +34,9 @@ class TestBackend : public tf::IBackend {
     TuningFork_ErrorCode UploadTelemetry(
         const TuningForkLogEvent& evt_ser) override {
         ALOGI("Process");
+        uploading = true;
+        std::this_thread::sleep_for(milliseconds(upload_delay_ms.load()));
+        uploading = false;
         {
             std::lock_guard<std::mutex> lock(*mutex);
             result = evt_ser;
@@ -65,6 +71,9 @@ class TestBackend : public tf::IBackend {
     }
 
     TuningForkLogEvent result;
+    // Each upload takes this long, like one over a slow network.
+    std::atomic<int> upload_delay_ms{0};
+    std::atomic<bool> uploading{false};
     std::shared_ptr<std::condition_variable> cv;
     std::shared_ptr<std::mutex> mutex;
     std::shared_ptr<IBackend> dl_backend;
@@ -16,6 +16,8 @@
 
 #pragma once
 
+#include <atomic>
+
 #include "common.h"
 #include "core/battery_provider.h"
 
@@ -27,11 +29,19 @@ class TestBatteryProvider : public tf::IBatteryProvider {
    public:
     TestBatteryProvider(bool enabled) : enabled_(enabled) {}
 
-    int32_t GetBatteryPercentage() override { return 70; }
+    // Calls from the battery and thermal reporting tasks.
+    std::atomic<int> num_battery_requests{0};
+    std::atomic<int> num_thermal_requests{0};
+
+    int32_t GetBatteryPercentage() override {
+        ++num_battery_requests;
+        return 70;
+    }
 
     int32_t GetBatteryCharge() override { return 1234; }
 
     tf::IBatteryProvider::ThermalState GetCurrentThermalStatus() override {
+        ++num_thermal_requests;
         return tf::IBatteryProvider::THERMAL_STATE_MODERATE;
     }
 
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "json11/json11.hpp"
+#include "test_utils.h"
+#include "tuningfork_test.h"
+
+using namespace gamesdk_test;
+
+namespace tuningfork_test {
+
+// Drain the recorded events, returning the number of begin and end events
+// with the given name.
+void CountSections(const char* name, int& begins, int& ends) {
+    TuningFork_CProtobufSerialization trace;
+    ASSERT_EQ(TuningFork_drainTraceRecording(
+                  TUNINGFORK_TRACE_FORMAT_CHROME_JSON, &trace),
+              TUNINGFORK_ERROR_OK);
+    std::string err;
+    auto json = json11::Json::parse(tf::ToString(trace), err);
+    TuningFork_CProtobufSerialization_free(&trace);
+    ASSERT_TRUE(err.empty()) << err;
+    begins = 0;
+    ends = 0;
+    // End events have no name, so match them to the open sections. Each
+    // thread's events start with its name.
+    std::vector<std::string> open;
+    for (auto& e : json["traceEvents"].array_items()) {
+        if (e["ph"] == "M") {
+            open.clear();
+        } else if (e["ph"] == "B") {
+            open.push_back(e["name"].string_value());
+            if (open.back() == name) ++begins;
+        } else if (e["ph"] == "E" && !open.empty()) {
+            if (open.back() == name) ++ends;
+            open.pop_back();
+        }
+    }
+}
+
+TEST(EndToEndTest, TraceRecording) {
+    const int kTicks = 5;
+    ASSERT_EQ(TuningFork_startTraceRecording(0), TUNINGFORK_ERROR_OK);
+    // Drain anything recorded before the test.
+    int begins, ends;
+    CountSections("TFTick", begins, ends);
+
+    auto settings = TestSettings(
+        tf::Settings::AggregationStrategy::Submission::TICK_BASED, 100, 1, {});
+    TuningForkTest test(settings);
+    for (int i = 0; i < kTicks; ++i) {
+        test.IncrementTime();
+        tf::FrameTick(TFTICK_RAW_FRAME_TIME);
+    }
+    CountSections("TFTick", begins, ends);
+    EXPECT_EQ(begins, kTicks);
+    EXPECT_EQ(ends, kTicks);
+
+    // Nothing is recorded once stopped.
+    ASSERT_EQ(TuningFork_stopTraceRecording(), TUNINGFORK_ERROR_OK);
+    tf::FrameTick(TFTICK_RAW_FRAME_TIME);
+    CountSections("TFTick", begins, ends);
+    EXPECT_EQ(begins, 0);
+
+    TuningFork_CProtobufSerialization trace;
+    EXPECT_EQ(TuningFork_drainTraceRecording(TUNINGFORK_TRACE_FORMAT_PERFETTO,
+                                             &trace),
+              TUNINGFORK_ERROR_OK);
+    TuningFork_CProtobufSerialization_free(&trace);
+    EXPECT_EQ(TuningFork_drainTraceRecording(
+                  static_cast<TuningFork_TraceFormat>(2), &trace),
+              TUNINGFORK_ERROR_BAD_PARAMETER);
+    EXPECT_EQ(TuningFork_drainTraceRecording(
+                  TUNINGFORK_TRACE_FORMAT_CHROME_JSON, nullptr),
+              TUNINGFORK_ERROR_BAD_PARAMETER);
+}
+
+}  // namespace tuningfork_test
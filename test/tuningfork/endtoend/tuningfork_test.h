@@ -15,6 +15,7 @@
  */
 
 #include "common.h"
+#include "core/jank_metric.h"
 #include "test_backend.h"
 #include "test_battery_provider.h"
 #include "test_download_backend.h"
@@ -43,6 +44,9 @@ class TuningForkTest {
           time_provider_(tick_size),
           meminfo_provider_(enable_meminfo),
           battery_provider_(enable_battery_reporting) {
+        // The expected reports predate jank reporting, so don't count any
+        // of their frames as janky. Tests of jank set their own interval.
+        tf::SetSwapIntervalNanos(nanoseconds(seconds(10)).count());
         tf::RequestInfo info = {};
         info.tuningfork_version = ANDROID_GAMESDK_PACKED_VERSION(1, 0, 0);
         init_return_value_ =
@@ -56,6 +60,8 @@ class TuningForkTest {
             tuningfork::Destroy();
             tuningfork::KillDownloadThreads();
         }
+        // The interval is global, so leave the default for other tests.
+        tf::SetSwapIntervalNanos(tf::JankMetricData::kDefaultSwapIntervalNs);
     }
 
     TuningForkLogEvent Result() const { return test_backend_.result; }
@@ -70,6 +76,17 @@ class TuningForkTest {
             std::this_thread::sleep_for(milliseconds(10));
         }
     }
+    void WaitForBatteryUpdates(int expected_num_requests) {
+        const int maxWaits = 10;
+        int waits = 0;
+        while (waits++ < maxWaits &&
+               (battery_provider_.num_battery_requests <
+                    expected_num_requests ||
+                battery_provider_.num_thermal_requests <
+                    expected_num_requests)) {
+            std::this_thread::sleep_for(milliseconds(10));
+        }
+    }
     void IncrementTime(int count = 1) {
         for (int i = 0; i < count; ++i) time_provider_.Increment();
     }
@@ -0,0 +1,89 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "core/fidelity_params_cache.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "core/tuningfork_utils.h"
+
+namespace fidelity_params_cache_test {
+
+using namespace tuningfork;
+
+constexpr char kBasePath[] = "/data/local/tmp/tuningfork_fp_cache_test";
+
+CachedFidelityParams TestEntry() {
+    return {{8, 0, 255, 1},
+            "experiment",
+            "\"etag-1\"",
+            SystemTimePoint() + std::chrono::hours(24 * 365 * 50)};
+}
+
+void ExpectEqual(const CachedFidelityParams& a, const CachedFidelityParams& b) {
+    EXPECT_EQ(a.params, b.params);
+    EXPECT_EQ(a.experiment_id, b.experiment_id);
+    EXPECT_EQ(a.version, b.version);
+    EXPECT_EQ(a.expiry, b.expiry);
+}
+
+TEST(FidelityParamsCacheTest, EncodeDecode) {
+    auto entry = TestEntry();
+    std::string bytes;
+    FidelityParamsCache::Encode(entry, bytes);
+    CachedFidelityParams decoded;
+    ASSERT_TRUE(FidelityParamsCache::Decode(bytes, decoded));
+    ExpectEqual(decoded, entry);
+    EXPECT_FALSE(decoded.Expired(SystemTimePoint()));
+    EXPECT_TRUE(decoded.Expired(entry.expiry));
+
+    // Nothing from a bad entry is kept.
+    for (size_t size = 5; size < bytes.size(); ++size) {
+        CachedFidelityParams truncated;
+        EXPECT_FALSE(
+            FidelityParamsCache::Decode(bytes.substr(0, size), truncated))
+            << size;
+        EXPECT_TRUE(truncated.version.empty()) << size;
+    }
+}
+
+TEST(FidelityParamsCacheTest, DecodesParamsOfUnknownAge) {
+    std::string bytes = {8, 2, 16, 3};
+    CachedFidelityParams entry;
+    ASSERT_TRUE(FidelityParamsCache::Decode(bytes, entry));
+    EXPECT_EQ(entry.params, ProtobufSerialization(bytes.begin(), bytes.end()));
+    EXPECT_TRUE(entry.version.empty());
+    EXPECT_TRUE(entry.Expired(SystemTimePoint()));
+}
+
+TEST(FidelityParamsCacheTest, SaveLoadRemove) {
+    // Some devices don't allow writing to /data/local/tmp.
+    if (!file_utils::CheckAndCreateDir(kBasePath)) GTEST_SKIP();
+    FidelityParamsCache cache(std::string(kBasePath) + "/saved_fp.bin");
+    auto entry = TestEntry();
+    ASSERT_TRUE(cache.Save(entry));
+    EXPECT_TRUE(cache.Exists());
+    CachedFidelityParams loaded;
+    ASSERT_TRUE(cache.Load(loaded));
+    ExpectEqual(loaded, entry);
+    EXPECT_TRUE(cache.Remove());
+    EXPECT_FALSE(cache.Exists());
+    EXPECT_FALSE(cache.Load(loaded));
+}
+
+}  // namespace fidelity_params_cache_test
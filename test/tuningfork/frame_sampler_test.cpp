@@ -0,0 +1,153 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "core/frame_sampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "core/frametime_metric.h"
+#include "gtest/gtest.h"
+
+namespace frame_sampler_test {
+
+using namespace tuningfork;
+
+using Action = FrameSampler::Action;
+
+Settings::Histogram HistogramSettings(Settings::Histogram::Sampling sampling,
+                                      uint32_t sample_period) {
+    Settings::Histogram h{-1, 0, 100, 200};
+    h.sampling = sampling;
+    h.sample_period = sample_period;
+    return h;
+}
+
+// Tick data with frame times drawn from a fixed distribution, as
+// TuningForkImpl::FrameTick does.
+void TickFrames(FrameSampler& sampler, FrameTimeMetricData& data,
+                size_t n_frames) {
+    std::mt19937 gen(1234);
+    std::normal_distribution<double> vsync(16.7, 1.0);
+    std::uniform_real_distribution<double> slow(20.0, 60.0);
+    std::bernoulli_distribution janky(0.1);
+    TimePoint t{};
+    for (size_t i = 0; i < n_frames; ++i) {
+        double ms = janky(gen) ? slow(gen) : vsync(gen);
+        t += std::chrono::microseconds(static_cast<int64_t>(ms * 1000));
+        auto action = sampler.Tick();
+        if (action != Action::SKIP) data.Tick(t, action == Action::RECORD);
+    }
+}
+
+TEST(FrameSamplerTest, EveryNthStampsBeforeRecording) {
+    FrameSampler sampler(
+        HistogramSettings(Settings::Histogram::Sampling::EVERY_NTH, 4), 1);
+    std::vector<Action> actions;
+    for (int i = 0; i < 9; ++i) actions.push_back(sampler.Tick());
+    EXPECT_EQ(actions, (std::vector<Action>{Action::SKIP, Action::SKIP,
+                                            Action::SKIP, Action::STAMP,
+                                            Action::RECORD, Action::SKIP,
+                                            Action::SKIP, Action::STAMP,
+                                            Action::RECORD}));
+}
+
+TEST(FrameSamplerTest, NoSamplingRecordsEverything) {
+    FrameSampler sampler(
+        HistogramSettings(Settings::Histogram::Sampling::RANDOM, 1), 1);
+    for (int i = 0; i < 10; ++i) EXPECT_EQ(sampler.Tick(), Action::RECORD);
+    FrameSampler all(HistogramSettings(Settings::Histogram::Sampling::ALL, 8),
+                     1);
+    EXPECT_EQ(all.Period(), 1);
+    EXPECT_TRUE(all.Record());
+}
+
+// The scaled histogram of sampled frames should match that of all frames.
+void CheckAgreesWithFull(Settings::Histogram::Sampling sampling) {
+    constexpr size_t kFrames = 400000;
+    constexpr uint32_t kPeriod = 8;
+    auto full_settings =
+        HistogramSettings(Settings::Histogram::Sampling::ALL, 0);
+    auto sampled_settings = HistogramSettings(sampling, kPeriod);
+    FrameTimeMetricData full(MetricId::FrameTime(0, 0), full_settings);
+    FrameTimeMetricData sampled(MetricId::FrameTime(0, 0), sampled_settings);
+    FrameSampler full_sampler(full_settings, 1);
+    FrameSampler sampler(sampled_settings, 5678);
+    TickFrames(full_sampler, full, kFrames);
+    TickFrames(sampler, sampled, kFrames);
+
+    auto a = full.ScaledCounts();
+    auto b = sampled.ScaledCounts();
+    ASSERT_EQ(a.size(), b.size());
+    double total_a = 0, total_b = 0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        total_a += a[i];
+        total_b += b[i];
+    }
+    EXPECT_NEAR(total_b / total_a, 1.0, 0.02);
+    // Compare the cumulative distributions.
+    double cum_a = 0, cum_b = 0, max_diff = 0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        cum_a += a[i] / total_a;
+        cum_b += b[i] / total_b;
+        max_diff = std::max(max_diff, std::abs(cum_a - cum_b));
+    }
+    EXPECT_LT(max_diff, 0.01);
+    double duration_ratio = std::chrono::duration<double>(sampled.duration_) /
+                            std::chrono::duration<double>(full.duration_);
+    EXPECT_NEAR(duration_ratio, 1.0, 0.02);
+}
+
+TEST(FrameSamplerTest, EveryNthAgreesWithFull) {
+    CheckAgreesWithFull(Settings::Histogram::Sampling::EVERY_NTH);
+}
+
+TEST(FrameSamplerTest, RandomAgreesWithFull) {
+    CheckAgreesWithFull(Settings::Histogram::Sampling::RANDOM);
+}
+
+TEST(FrameSamplerTest, ScaledCountsRoundTrip) {
+    FrameTimeMetricData data(
+        MetricId::FrameTime(0, 0),
+        HistogramSettings(Settings::Histogram::Sampling::EVERY_NTH, 4));
+    data.Record(std::chrono::milliseconds(10));
+    auto counts = data.ScaledCounts();
+    auto bucket = std::find(counts.begin(), counts.end(), 4) - counts.begin();
+    ASSERT_LT(bucket, counts.size());
+    data.AddScaledCounts(counts);
+    EXPECT_EQ(data.histogram_.buckets()[bucket], 2);
+    EXPECT_EQ(data.ScaledCounts()[bucket], 8);
+}
+
+TEST(FrameSamplerTest, ScaledQuantilesRoundTrip) {
+    auto settings =
+        HistogramSettings(Settings::Histogram::Sampling::EVERY_NTH, 4);
+    settings.storage = Settings::Histogram::Storage::QUANTILE_SKETCH;
+    FrameTimeMetricData data(MetricId::FrameTime(0, 0), settings);
+    for (int i = 0; i < 3; ++i) data.Record(std::chrono::milliseconds(10));
+    EXPECT_EQ(data.FrameCount(), 12);
+    auto count = data.ScaledQuantileCount();
+    EXPECT_EQ(count, 12);
+    auto levels = data.quantiles_.Levels();
+    EXPECT_EQ(data.MergeScaledQuantiles(levels, count), TUNINGFORK_ERROR_OK);
+    EXPECT_EQ(data.quantiles_.Count(), 6);
+    EXPECT_EQ(data.MergeScaledQuantiles(levels, count + 1),
+              TUNINGFORK_ERROR_BAD_PARAMETER);
+}
+
+}  // namespace frame_sampler_test
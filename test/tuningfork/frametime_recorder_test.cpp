@@ -0,0 +1,220 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "core/frametime_recorder.h"
+
+#include <gtest/gtest.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace frametime_recorder_test {
+
+using namespace tuningfork;
+
+class IdMap : public IdProvider {
+    TuningFork_ErrorCode SerializedAnnotationToAnnotationId(
+        const ProtobufSerialization& ser, AnnotationId& id) override {
+        id = ser.size();
+        return TUNINGFORK_ERROR_OK;
+    }
+    TuningFork_ErrorCode MakeCompoundId(InstrumentationKey k,
+                                        AnnotationId annotation_id,
+                                        MetricId& id) override {
+        id = MetricId::FrameTime(annotation_id, k);
+        return TUNINGFORK_ERROR_OK;
+    }
+    TuningFork_ErrorCode AnnotationIdToSerializedAnnotation(
+        AnnotationId id, SerializedAnnotation& ann) override {
+        ann = SerializedAnnotation(id, 1);
+        return TUNINGFORK_ERROR_OK;
+    }
+    TuningFork_ErrorCode MetricIdToLoadingTimeMetadata(
+        MetricId id, LoadingTimeMetadataWithGroup& mg) override {
+        return TUNINGFORK_ERROR_BAD_PARAMETER;
+    }
+};
+
+const Settings::Histogram kHistogramSettings{0, 0, 100, 100};
+
+TimePoint Ms(int64_t ms) { return TimePoint(std::chrono::milliseconds(ms)); }
+
+// Tick at each of the times and return the last frame count.
+size_t TickAt(FrameTimeRecorder& recorder, std::initializer_list<int> times) {
+    size_t count = 0;
+    for (auto t : times)
+        EXPECT_EQ(recorder.Tick(0, 0, Ms(t), true, &count),
+                  TUNINGFORK_ERROR_OK);
+    return count;
+}
+
+TEST(FrameTimeRecorderTest, ThreadSlotsAreRecycled) {
+    IdMap ids;
+    FrameTimeRecorder recorder(&ids, {kHistogramSettings}, 1, 1, 4);
+    size_t count = 0;
+    std::thread([&]() { count = TickAt(recorder, {0, 10, 20}); }).join();
+    EXPECT_EQ(count, 2);
+    EXPECT_EQ(recorder.NumThreadSlots(), 1);
+
+    // The next thread gets the same slots, with the unmerged frames but no
+    // frame from the last thread's last tick.
+    std::thread([&]() { count = TickAt(recorder, {100, 110}); }).join();
+    EXPECT_EQ(count, 3);
+    EXPECT_EQ(recorder.NumThreadSlots(), 1);
+
+    // Threads that are still running need their own.
+    TickAt(recorder, {200});
+    std::thread([&]() { TickAt(recorder, {300}); }).join();
+    EXPECT_EQ(recorder.NumThreadSlots(), 2);
+}
+
+TEST(FrameTimeRecorderTest, SlotsOutliveRecorder) {
+    IdMap ids;
+    std::unique_ptr<FrameTimeRecorder> recorder(
+        new FrameTimeRecorder(&ids, {kHistogramSettings}, 1, 1, 4));
+    TickAt(*recorder, {0, 10});
+    recorder.reset();
+    // Using a new recorder releases the slots of the destroyed one.
+    FrameTimeRecorder other(&ids, {kHistogramSettings}, 1, 1, 4);
+    EXPECT_EQ(TickAt(other, {0, 10}), 1);
+}
+
+TEST(FrameTimeRecorderTest, LiveDataOfEachThreadIsVisited) {
+    IdMap ids;
+    FrameTimeRecorder recorder(&ids, {kHistogramSettings}, 1, 1, 4);
+    TickAt(recorder, {0, 10, 20});
+    std::thread([&]() { TickAt(recorder, {0, 10}); }).join();
+    std::vector<size_t> counts;
+    recorder.ForEachLiveData(
+        [&](const FrameTimeMetricData* d) { counts.push_back(d->Count()); });
+    EXPECT_EQ(counts, std::vector<size_t>({2, 1}));
+}
+
+TEST(FrameTimeRecorderTest, LimitsThreadsRecordingAtOnce) {
+    IdMap ids;
+    FrameTimeRecorder recorder(&ids, {kHistogramSettings}, 1, 1, 4);
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t n_ticked = 0;
+    bool done = false;
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < FrameTimeRecorder::kMaxThreads; ++i) {
+        threads.emplace_back([&]() {
+            TickAt(recorder, {0});
+            std::unique_lock<std::mutex> lock(mutex);
+            ++n_ticked;
+            cv.notify_all();
+            cv.wait(lock, [&]() { return done; });
+        });
+    }
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock,
+                [&]() { return n_ticked == FrameTimeRecorder::kMaxThreads; });
+    }
+    std::thread([&]() {
+        EXPECT_EQ(recorder.Tick(0, 0, Ms(0), true, nullptr),
+                  TUNINGFORK_ERROR_NO_MORE_SPACE_FOR_FRAME_TIME_DATA);
+    }).join();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+    }
+    cv.notify_all();
+    for (auto& t : threads) t.join();
+    // Once they have exited, their slots can be used again.
+    std::thread([&]() { EXPECT_EQ(TickAt(recorder, {0, 10}), 1); }).join();
+    EXPECT_EQ(recorder.NumThreadSlots(), FrameTimeRecorder::kMaxThreads);
+}
+
+TEST(FrameTimeRecorderTest, CountsEachMetricOnce) {
+    IdMap ids;
+    FrameTimeRecorder recorder(&ids, {kHistogramSettings}, 1, 2, 1);
+    TickAt(recorder, {0});
+    // Another thread recording the same metric doesn't take up another one.
+    std::thread([&]() {
+        EXPECT_EQ(recorder.Tick(0, 0, Ms(0), true, nullptr),
+                  TUNINGFORK_ERROR_OK);
+        EXPECT_EQ(recorder.Tick(0, 1, Ms(0), true, nullptr),
+                  TUNINGFORK_ERROR_NO_MORE_SPACE_FOR_FRAME_TIME_DATA);
+    }).join();
+    // After a merge, the metric can go to another annotation.
+    Session session;
+    recorder.MergeInto(session);
+    EXPECT_EQ(recorder.Tick(0, 1, Ms(10), true, nullptr),
+              TUNINGFORK_ERROR_OK);
+    EXPECT_EQ(recorder.Tick(0, 0, Ms(10), true, nullptr),
+              TUNINGFORK_ERROR_NO_MORE_SPACE_FOR_FRAME_TIME_DATA);
+}
+
+TEST(FrameTimeRecorderTest, SlotsAreReusedAfterMerge) {
+    IdMap ids;
+    FrameTimeRecorder recorder(&ids, {kHistogramSettings}, 1, 2, 4);
+    Session session;
+    // Use both buffers for annotation 0, then annotation 1.
+    for (AnnotationId a = 0; a < 2; ++a) {
+        for (int i = 0; i < 2; ++i) {
+            EXPECT_EQ(recorder.Tick(0, a, Ms(0), true, nullptr),
+                      TUNINGFORK_ERROR_OK);
+            EXPECT_EQ(recorder.Tick(0, a, Ms(10), true, nullptr),
+                      TUNINGFORK_ERROR_OK);
+            std::vector<MetricId> live;
+            recorder.ForEachLiveData([&](const FrameTimeMetricData* d) {
+                live.push_back(d->metric_id_);
+            });
+            ASSERT_EQ(live.size(), 1);
+            EXPECT_EQ(live[0].detail.annotation, a);
+            recorder.MergeInto(session);
+        }
+    }
+}
+
+TEST(FrameTimeRecorderTest, TryLockMergesDoesntBlock) {
+    IdMap ids;
+    FrameTimeRecorder recorder(&ids, {kHistogramSettings}, 1, 1, 4);
+    auto lock = recorder.TryLockMerges();
+    EXPECT_TRUE(lock.owns_lock());
+    std::thread([&]() { EXPECT_FALSE(recorder.TryLockMerges().owns_lock()); })
+        .join();
+    lock.unlock();
+    EXPECT_TRUE(recorder.TryLockMerges().owns_lock());
+}
+
+TEST(FrameTimeRecorderTest, SamplesOnlySampledKeys) {
+    IdMap ids;
+    auto sampled = kHistogramSettings;
+    sampled.sampling = Settings::Histogram::Sampling::EVERY_NTH;
+    sampled.sample_period = 2;
+    FrameTimeRecorder recorder(&ids, {kHistogramSettings, sampled}, 2, 1, 4);
+    using Action = FrameSampler::Action;
+    for (int i = 0; i < 4; ++i)
+        EXPECT_EQ(recorder.SampleTick(0, 0), Action::RECORD);
+    // Every other frame of key 1 is recorded, stamping the tick before each.
+    EXPECT_EQ(recorder.SampleTick(1, 0), Action::SKIP);
+    EXPECT_EQ(recorder.SampleTick(1, 0), Action::STAMP);
+    EXPECT_EQ(recorder.SampleTick(1, 0), Action::RECORD);
+    EXPECT_EQ(recorder.SampleTick(1, 0), Action::STAMP);
+    EXPECT_EQ(recorder.SampleTick(1, 0), Action::RECORD);
+
+    // Without any sampling, every tick is recorded.
+    FrameTimeRecorder unsampled(&ids, {kHistogramSettings}, 2, 1, 4);
+    for (int i = 0; i < 4; ++i)
+        EXPECT_EQ(unsampled.SampleTick(1, 0), Action::RECORD);
+}
+
+}  // namespace frametime_recorder_test
@@ -16,6 +16,8 @@
 
 #include "core/histogram.h"
 
+#include <algorithm>
+
 #include "gtest/gtest.h"
 
 namespace histogram_test {
@@ -37,6 +39,15 @@ const char kAddOneTo0To10EventsOnlyJson[] =
     "{\"events\":[1.00,0.00,0.00,0.00,0.00,0.00,0.00,0.00,0.00,0.00]}";
 const char kAddElevenTo0To10EventsOnlyJson[] =
     "{\"events\":[10.00,1.00,2.00,3.00,4.00,5.00,6.00,7.00,8.00,9.00]}";
+const char kLogLinear1To8Json[] =
+    "{\"pmax\":[1.00,1.25,1.50,1.75,2.00,2.50,3.00,3.50,4.00,5.00,6.00,7.00,"
+    "8.00,10.00,99999],\"cnts\":[1,1,1,0,0,0,0,1,0,0,0,0,0,1,1]}";
+
+tuningfork::Settings::Histogram LogLinearSettings(float min, float max,
+                                                  int sub_bucket_bits) {
+    return {0, min, max, 0, tuningfork::Settings::Histogram::Scale::LOG_LINEAR,
+            sub_bucket_bits};
+}
 
 TEST(HistogramTest, DefaultEmpty) {
     Histogram h{};
@@ -89,4 +100,103 @@ TEST(HistogramTest, AddElevenTo0To10EventsOnly) {
         << "Add 11 0-10 histogram bad";
 }
 
+TEST(HistogramTest, LogLinear) {
+    Histogram h(LogLinearSettings(1, 8, 2));
+    EXPECT_EQ(h.GetMode(), tuningfork::HistogramBase::Mode::LOG_LINEAR);
+    for (double x : {0.5, 1.0, 1.3, 3.0, 8.5, 100.0}) h.Add(x);
+    EXPECT_EQ(h.Count(), 6) << "6 were not counted";
+    EXPECT_EQ(h.ToDebugJSON(), kLogLinear1To8Json) << "Log-linear bad";
+    h.Clear();
+    EXPECT_EQ(h.Count(), 0) << "Clear log-linear histogram bad";
+    EXPECT_EQ(h.GetMode(), tuningfork::HistogramBase::Mode::LOG_LINEAR);
+}
+
+TEST(HistogramTest, LogLinearRelativeError) {
+    const int kSubBucketBits = 4;
+    Histogram h(LogLinearSettings(0.5, 1000, kSubBucketBits));
+    for (double x = h.BucketStart(); x < h.BucketEnd(); x *= 1.01) {
+        h.Clear();
+        h.Add(x);
+        auto b = h.buckets();
+        uint32_t i = std::find(b.begin(), b.end(), 1) - b.begin();
+        ASSERT_GT(i, 0) << x << " in underflow bucket";
+        ASSERT_LT(i, b.size() - 1) << x << " in overflow bucket";
+        double lower = h.BucketLowerBound(i);
+        double upper = h.BucketLowerBound(i + 1);
+        EXPECT_LE(lower, x);
+        EXPECT_LT(x, upper);
+        EXPECT_LE((upper - lower) / lower, 1.0 / (1 << kSubBucketBits));
+    }
+}
+
+TEST(HistogramTest, LogLinearMerge) {
+    auto settings = LogLinearSettings(1, 500, 3);
+    Histogram a(settings), b(settings), all(settings);
+    for (int i = 0; i < 100; ++i) {
+        double x = 0.9 + i * 5.7;
+        (i % 2 ? a : b).Add(x);
+        all.Add(x);
+    }
+    EXPECT_EQ(a.AddCounts(b.buckets()), TUNINGFORK_ERROR_OK);
+    EXPECT_EQ(a.buckets(), all.buckets()) << "AddCounts bad";
+    Histogram linear(1, 500, a.buckets().size() - 2);
+    EXPECT_EQ(linear.Merge(b), TUNINGFORK_ERROR_BAD_PARAMETER)
+        << "Merged log-linear into linear buckets";
+}
+
+TEST(HistogramTest, AddBatch) {
+    std::vector<double> xs;
+    for (int i = 0; i < 1000; ++i) xs.push_back(-2 + i * 0.0137);
+    for (auto& h : {Histogram(0, 10, 10), Histogram(LogLinearSettings(1, 8, 2)),
+                    Histogram(0, 10, 10, true)}) {
+        Histogram one_by_one(h), batched(h);
+        for (double x : xs) one_by_one.Add(x);
+        batched.AddBatch(xs.data(), xs.size());
+        EXPECT_EQ(batched.Count(), one_by_one.Count());
+        EXPECT_EQ(batched.ToDebugJSON(), one_by_one.ToDebugJSON())
+            << "AddBatch differs from Add";
+    }
+}
+
+TEST(HistogramTest, SparseBuckets) {
+    Histogram h(0, 98, 98);
+    // Few enough distinct values to stay sparse.
+    for (int i = 0; i < 1000; ++i) h.Add(16.5 + (i % 3) * 17);
+    EXPECT_LT(h.BucketBytes(), 100 * sizeof(uint32_t));
+    auto b = h.buckets();
+    ASSERT_EQ(b.size(), 100);
+    EXPECT_EQ(b[17], 334);
+    EXPECT_EQ(b[34], 333);
+    EXPECT_EQ(b[51], 333);
+    EXPECT_EQ(std::count(b.begin(), b.end(), 0), 97);
+    // Filling more buckets switches to dense storage with the same counts.
+    Histogram dense(h);
+    for (int i = 0; i < 100; ++i) dense.Add(i + 0.5);
+    EXPECT_GE(dense.BucketBytes(), 100 * sizeof(uint32_t));
+    auto d = dense.buckets();
+    for (int i = 1; i < 99; ++i) EXPECT_EQ(d[i], b[i] + 1);
+    h.Clear();
+    EXPECT_EQ(h.buckets(), std::vector<uint32_t>(100));
+}
+
+TEST(HistogramTest, SparseAndDenseMerge) {
+    Histogram sparse(0, 100, 98), dense(0, 100, 98), all(0, 100, 98);
+    sparse.Add(10.5);
+    for (int i = 0; i < 100; ++i) {
+        dense.Add(i);
+        all.Add(i);
+    }
+    all.Add(10.5);
+    Histogram a(sparse), b(dense);
+    EXPECT_EQ(a.Merge(dense), TUNINGFORK_ERROR_OK);
+    EXPECT_EQ(b.Merge(sparse), TUNINGFORK_ERROR_OK);
+    EXPECT_EQ(a, all);
+    EXPECT_EQ(b, all);
+    EXPECT_EQ(a.Count(), all.Count());
+    Histogram c(sparse);
+    EXPECT_EQ(c.AddCounts(dense.buckets()), TUNINGFORK_ERROR_OK);
+    EXPECT_EQ(c.buckets(), all.buckets());
+    EXPECT_EQ(c.AddCounts({1, 2}), TUNINGFORK_ERROR_BAD_PARAMETER);
+}
+
 }  // namespace histogram_test
@@ -0,0 +1,160 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <zlib.h>
+
+#include <sstream>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "http_backend/compression.h"
+#include "http_backend/http_request.h"
+
+namespace http_compression_test {
+
+namespace tf = tuningfork;
+
+// Inflate a gzip body, independently of the code under test.
+bool Gunzip(const std::string& in, std::string& out) {
+    z_stream stream = {};
+    if (inflateInit2(&stream, 15 + 16) != Z_OK) return false;
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+    stream.avail_in = in.size();
+    out.clear();
+    int ret = Z_OK;
+    char buffer[4096];
+    while (ret == Z_OK) {
+        stream.next_out = reinterpret_cast<Bytef*>(buffer);
+        stream.avail_out = sizeof(buffer);
+        ret = inflate(&stream, Z_NO_FLUSH);
+        out.append(buffer, sizeof(buffer) - stream.avail_out);
+    }
+    inflateEnd(&stream);
+    return ret == Z_STREAM_END;
+}
+
+// Stands in for the server: it decodes what would go over the wire and
+// responds with 200.
+class LoopbackServer : public tf::HttpRequest {
+   public:
+    std::string received_encoding;
+    std::string received_content_type;
+    size_t received_bytes = 0;
+    std::string payload;
+
+    LoopbackServer()
+        : HttpRequest("https://loopback/", "key", std::chrono::seconds(1)) {}
+
+   protected:
+    TuningFork_ErrorCode Post(const std::string& rpc_name,
+                              const std::string& body,
+                              const std::string& content_type,
+                              const std::string& content_encoding,
+                              int& response_code,
+                              std::string& response_body) override {
+        received_encoding = content_encoding;
+        received_content_type = content_type;
+        received_bytes = body.size();
+        if (content_encoding == "gzip") {
+            if (!Gunzip(body, payload)) {
+                response_code = 400;
+                return TUNINGFORK_ERROR_OK;
+            }
+        } else {
+            EXPECT_EQ(content_encoding, "");
+            payload = body;
+        }
+        response_code = 200;
+        response_body = "{}";
+        return TUNINGFORK_ERROR_OK;
+    }
+};
+
+std::string TelemetryLikeJson(int n) {
+    std::stringstream s;
+    s << "{\"render_time_histogram\": [";
+    for (int i = 0; i < n; ++i) {
+        if (i > 0) s << ",";
+        s << "{\"counts\": [0, 0, 0, 0, " << i % 7
+          << ", 0, 0, 0, 0], \"instrument_id\": " << i % 3 << "}";
+    }
+    s << "]}";
+    return s.str();
+}
+
+TEST(HttpCompressionTest, LargeBodyIsCompressed) {
+    LoopbackServer server;
+    server.CompressAbove(1024);
+    auto request = TelemetryLikeJson(200);
+    int response_code = -1;
+    std::string response_body;
+    EXPECT_EQ(server.Send(":uploadTelemetry", request, response_code,
+                          response_body),
+              TUNINGFORK_ERROR_OK);
+    EXPECT_EQ(response_code, 200);
+    EXPECT_EQ(server.received_encoding, "gzip");
+    EXPECT_EQ(server.received_content_type, "application/json");
+    EXPECT_EQ(server.payload, request);
+    EXPECT_LT(server.received_bytes * 10, request.size());
+}
+
+TEST(HttpCompressionTest, SmallBodyIsNotCompressed) {
+    LoopbackServer server;
+    server.CompressAbove(1024);
+    auto request = TelemetryLikeJson(2);
+    int response_code = -1;
+    std::string response_body;
+    server.Send(":uploadTelemetry", request, response_code, response_body);
+    EXPECT_EQ(server.received_encoding, "");
+    EXPECT_EQ(server.payload, request);
+}
+
+TEST(HttpCompressionTest, CompressionDisabled) {
+    LoopbackServer server;
+    auto request = TelemetryLikeJson(200);
+    int response_code = -1;
+    std::string response_body;
+    server.Send(":uploadTelemetry", request, response_code, response_body);
+    EXPECT_EQ(server.received_encoding, "");
+    EXPECT_EQ(server.payload, request);
+}
+
+TEST(HttpCompressionTest, BinaryBody) {
+    LoopbackServer server;
+    server.CompressAbove(0);
+    std::string request;
+    for (int i = 0; i < 4096; ++i) request.push_back(static_cast<char>(i % 5));
+    int response_code = -1;
+    std::string response_body;
+    server.SendBytes(":uploadTelemetry", request, "application/octet-stream",
+                     response_code, response_body);
+    EXPECT_EQ(server.received_encoding, "gzip");
+    EXPECT_EQ(server.received_content_type, "application/octet-stream");
+    EXPECT_EQ(server.payload, request);
+}
+
+TEST(HttpCompressionTest, IncompressibleBodyIsSentAsIs) {
+    LoopbackServer server;
+    server.CompressAbove(0);
+    std::string request = "x";
+    int response_code = -1;
+    std::string response_body;
+    server.Send(":uploadTelemetry", request, response_code, response_body);
+    EXPECT_EQ(server.received_encoding, "");
+    EXPECT_EQ(server.payload, request);
+}
+
+}  // namespace http_compression_test
@@ -0,0 +1,86 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "core/jank_metric.h"
+
+#include <vector>
+
+#include "core/frametime_metric.h"
+#include "gtest/gtest.h"
+
+namespace jank_metric_test {
+
+using namespace tuningfork;
+
+constexpr uint64_t kMs = 1000000;
+constexpr uint64_t kSwapInterval = 16 * kMs;
+
+JankMetricData Record(const std::vector<uint64_t>& dts_ms) {
+    JankMetricData::SetSwapIntervalNs(kSwapInterval);
+    JankMetricData jank;
+    for (auto dt : dts_ms) jank.Record(dt * kMs);
+    return jank.Finished();
+}
+
+TEST(JankMetricTest, RunsAndBigJanks) {
+    auto jank = Record({16, 17, 33, 31, 15, 66, 16, 33});
+    EXPECT_EQ(jank.frames_, 8);
+    EXPECT_EQ(jank.janky_frames_, 4);
+    EXPECT_EQ(jank.missed_frames_, 6);
+    EXPECT_EQ(jank.big_janks_, 1);
+    EXPECT_EQ(jank.longest_run_, 2);
+    EXPECT_EQ(jank.runs_[0], 2);
+    EXPECT_EQ(jank.runs_[1], 1);
+    EXPECT_EQ(jank.runs_[2], 0);
+}
+
+TEST(JankMetricTest, LongRunsAreCountedTogether) {
+    auto jank = Record({33, 33, 33, 33, 33, 33, 33, 16, 33, 33, 33, 33, 33});
+    EXPECT_EQ(jank.longest_run_, 7);
+    EXPECT_EQ(jank.runs_[JankMetricData::kMaxRunLength - 1], 2);
+}
+
+TEST(JankMetricTest, StutterClusters) {
+    std::vector<uint64_t> dts;
+    // Three janky frames close together, then three spread out.
+    for (int i = 0; i < 10; ++i) dts.push_back(i % 3 == 0 ? 33 : 16);
+    for (int i = 0; i < 100; ++i) dts.push_back(i % 40 == 0 ? 33 : 16);
+    auto jank = Record(dts);
+    EXPECT_EQ(jank.janky_frames_, 7);
+    EXPECT_EQ(jank.stutter_clusters_, 1);
+}
+
+TEST(JankMetricTest, TickAndMerge) {
+    JankMetricData::SetSwapIntervalNs(kSwapInterval);
+    Settings::Histogram settings{-1, 0, 100, 100};
+    FrameTimeMetricData a(MetricId::FrameTime(0, 0), settings);
+    FrameTimeMetricData b(MetricId::FrameTime(0, 0), settings);
+    TimePoint t{};
+    for (auto dt : {16, 33, 33}) {
+        a.Tick(t);
+        t += std::chrono::milliseconds(dt);
+    }
+    a.Tick(t);
+    EXPECT_EQ(a.jank_.janky_frames_, 2);
+    // The run in progress in a is finished by the merge.
+    EXPECT_EQ(b.Merge(a), TUNINGFORK_ERROR_OK);
+    EXPECT_EQ(b.jank_.runs_[1], 1);
+    a.Clear();
+    EXPECT_TRUE(a.jank_.Empty());
+    JankMetricData::SetSwapIntervalNs(JankMetricData::kDefaultSwapIntervalNs);
+}
+
+}  // namespace jank_metric_test
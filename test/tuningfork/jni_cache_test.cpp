@@ -0,0 +1,211 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "jni/jni_cache.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+namespace jni_cache_test {
+
+using gamesdk::jni::IdCache;
+
+// A JNIEnv that counts the lookups made through it. Classes are just distinct
+// addresses, references to them are the same address and ids are handed out
+// in order for each new class, name and signature. Names starting with
+// "missing" aren't found. Only one may exist at a time.
+struct FakeEnv {
+    static FakeEnv* current;
+
+    JNIEnv env;
+    JNINativeInterface functions;
+
+    std::mutex mutex;
+    std::map<std::tuple<int, jclass, std::string, std::string>, uintptr_t> ids;
+    std::atomic<int> lookups{0};
+    std::atomic<int> global_refs{0};
+    std::atomic<int> classes_found{0};
+    bool exception = false;
+
+    FakeEnv() : env(), functions() {
+        current = this;
+        functions.NewGlobalRef = [](JNIEnv* env, jobject o) {
+            ++Get(env)->global_refs;
+            return o;
+        };
+        functions.DeleteGlobalRef = [](JNIEnv* env, jobject) {
+            --Get(env)->global_refs;
+        };
+        functions.NewLocalRef = [](JNIEnv*, jobject o) { return o; };
+        functions.DeleteLocalRef = [](JNIEnv*, jobject) {};
+        functions.IsSameObject = [](JNIEnv*, jobject a, jobject b) {
+            return static_cast<jboolean>(a == b);
+        };
+        functions.ExceptionCheck = [](JNIEnv* env) {
+            return static_cast<jboolean>(Get(env)->exception);
+        };
+        functions.ExceptionClear = [](JNIEnv* env) {
+            Get(env)->exception = false;
+        };
+        functions.GetMethodID = [](JNIEnv* env, jclass c, const char* n,
+                                   const char* s) {
+            return reinterpret_cast<jmethodID>(Get(env)->Lookup(0, c, n, s));
+        };
+        functions.GetStaticMethodID = [](JNIEnv* env, jclass c, const char* n,
+                                         const char* s) {
+            return reinterpret_cast<jmethodID>(Get(env)->Lookup(1, c, n, s));
+        };
+        functions.GetFieldID = [](JNIEnv* env, jclass c, const char* n,
+                                  const char* s) {
+            return reinterpret_cast<jfieldID>(Get(env)->Lookup(2, c, n, s));
+        };
+        functions.GetStaticFieldID = [](JNIEnv* env, jclass c, const char* n,
+                                        const char* s) {
+            return reinterpret_cast<jfieldID>(Get(env)->Lookup(3, c, n, s));
+        };
+        env.functions = &functions;
+    }
+
+    ~FakeEnv() { current = nullptr; }
+
+    static FakeEnv* Get(JNIEnv*) { return current; }
+
+    uintptr_t Lookup(int kind, jclass c, const char* name, const char* sig) {
+        ++lookups;
+        std::lock_guard<std::mutex> lock(mutex);
+        if (std::string(name).compare(0, 7, "missing") == 0) {
+            exception = true;
+            return 0;
+        }
+        auto& id = ids[std::make_tuple(kind, c, name, sig)];
+        if (id == 0) id = ids.size();
+        return id;
+    }
+};
+
+FakeEnv* FakeEnv::current = nullptr;
+
+char class_storage[2];
+jclass kClassA = reinterpret_cast<jclass>(&class_storage[0]);
+jclass kClassB = reinterpret_cast<jclass>(&class_storage[1]);
+
+jclass FindFakeClass(const char* name) {
+    ++FakeEnv::current->classes_found;
+    return std::string(name) == "a/A" ? kClassA : nullptr;
+}
+
+TEST(JniCacheTest, LooksUpEachIdOnce) {
+    FakeEnv fake;
+    JNIEnv* env = &fake.env;
+    IdCache cache;
+    auto read = cache.GetMethodID(env, kClassA, "read", "([B)I");
+    EXPECT_NE(read, nullptr);
+    EXPECT_EQ(fake.lookups, 1);
+    for (int i = 0; i < 10; ++i)
+        EXPECT_EQ(cache.GetMethodID(env, kClassA, "read", "([B)I"), read);
+    EXPECT_EQ(fake.lookups, 1);
+    // A different signature, class or kind of id is another lookup.
+    EXPECT_NE(cache.GetMethodID(env, kClassA, "read", "()I"), read);
+    EXPECT_NE(cache.GetMethodID(env, kClassB, "read", "([B)I"), read);
+    EXPECT_NE(cache.GetStaticMethodID(env, kClassA, "read", "([B)I"), read);
+    auto field = cache.GetFieldID(env, kClassA, "read", "I");
+    auto static_field = cache.GetStaticFieldID(env, kClassA, "read", "I");
+    EXPECT_NE(reinterpret_cast<void*>(field),
+              reinterpret_cast<void*>(static_field));
+    EXPECT_EQ(fake.lookups, 6);
+    EXPECT_EQ(cache.GetFieldID(env, kClassA, "read", "I"), field);
+    EXPECT_EQ(cache.GetStaticFieldID(env, kClassA, "read", "I"), static_field);
+    EXPECT_EQ(cache.GetMethodID(env, kClassB, "read", "([B)I"),
+              cache.GetMethodID(env, kClassB, "read", "([B)I"));
+    EXPECT_EQ(fake.lookups, 6);
+    EXPECT_EQ(cache.Size(), 6);
+    // Each entry holds its class.
+    EXPECT_EQ(fake.global_refs, 6);
+    cache.Clear(env);
+    EXPECT_EQ(fake.global_refs, 0);
+    EXPECT_EQ(cache.Size(), 0);
+    cache.GetMethodID(env, kClassA, "read", "([B)I");
+    EXPECT_EQ(fake.lookups, 7);
+    cache.Clear(env);
+}
+
+TEST(JniCacheTest, FailuresArentCached) {
+    FakeEnv fake;
+    JNIEnv* env = &fake.env;
+    IdCache cache;
+    EXPECT_EQ(cache.GetMethodID(env, kClassA, "missingMethod", "()V"),
+              nullptr);
+    EXPECT_TRUE(fake.exception);
+    fake.exception = false;
+    EXPECT_EQ(cache.GetMethodID(env, kClassA, "missingMethod", "()V"),
+              nullptr);
+    EXPECT_EQ(fake.lookups, 2);
+    EXPECT_EQ(cache.Size(), 0);
+    EXPECT_EQ(fake.global_refs, 0);
+}
+
+TEST(JniCacheTest, FindsClassesOnce) {
+    FakeEnv fake;
+    JNIEnv* env = &fake.env;
+    IdCache cache;
+    for (int i = 0; i < 5; ++i)
+        EXPECT_EQ(cache.FindClass(env, "a/A", FindFakeClass), kClassA);
+    EXPECT_EQ(fake.classes_found, 1);
+    EXPECT_EQ(cache.FindClass(env, "b/Missing", FindFakeClass), nullptr);
+    EXPECT_EQ(cache.FindClass(env, "b/Missing", FindFakeClass), nullptr);
+    EXPECT_EQ(fake.classes_found, 3);
+    EXPECT_EQ(cache.Size(), 1);
+    cache.Clear(env);
+    EXPECT_EQ(fake.global_refs, 0);
+}
+
+TEST(JniCacheTest, ConcurrentLookups) {
+    constexpr int kThreads = 8;
+    constexpr int kMethods = 50;
+    FakeEnv fake;
+    JNIEnv* env = &fake.env;
+    IdCache cache;
+    std::vector<std::string> names;
+    for (int i = 0; i < kMethods; ++i)
+        names.push_back("method" + std::to_string(i));
+    std::vector<std::vector<jmethodID>> found(kThreads);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&, t]() {
+            for (int i = 0; i < 100; ++i)
+                for (auto& name : names)
+                    found[t].push_back(
+                        cache.GetMethodID(env, kClassA, name.c_str(), "()V"));
+        });
+    }
+    for (auto& th : threads) th.join();
+    for (int t = 1; t < kThreads; ++t) EXPECT_EQ(found[t], found[0]);
+    EXPECT_EQ(cache.Size(), kMethods);
+    // Threads that miss at the same time may each look the id up, but only
+    // while the cache is cold.
+    EXPECT_LE(fake.lookups, kThreads * kMethods);
+    cache.Clear(env);
+    EXPECT_EQ(fake.global_refs, 0);
+}
+
+}  // namespace jni_cache_test
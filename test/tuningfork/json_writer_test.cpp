@@ -0,0 +1,173 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "http_backend/json_writer.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <json11/json11.hpp>
+#include <limits>
+#include <random>
+#include <sstream>
+
+#include "date/date.h"
+#include "http_backend/json_serializer.h"
+
+namespace json_writer_test {
+
+using namespace tuningfork;
+using namespace std::chrono;
+using json11::Json;
+
+std::string Written(double x) {
+    std::string s;
+    JsonWriter(s).Double(x);
+    return s;
+}
+
+std::string Written(const std::string& x) {
+    std::string s;
+    JsonWriter(s).String(x);
+    return s;
+}
+
+std::string WrittenSeconds(int64_t ns) {
+    std::string s;
+    JsonWriter(s).Seconds(ns);
+    return s;
+}
+
+TEST(JsonWriterTest, StringsMatchJson11) {
+    std::string all;
+    for (int c = 1; c < 0x100; ++c) all += static_cast<char>(c);
+    for (auto s :
+         {std::string(), std::string("plain"), all, std::string("a\0b", 3),
+          std::string("\xe2\x80\xa8 \xe2\x80\xa9"),
+          std::string("\xe2\x80\xaa \xe2\x80"), std::string("\xe2\x80")}) {
+        EXPECT_EQ(Written(s), Json(s).dump());
+    }
+}
+
+TEST(JsonWriterTest, DoublesMatchJson11) {
+    std::mt19937_64 gen(1234);
+    std::vector<double> xs = {0.0,
+                              -0.0,
+                              1.0,
+                              -1.0,
+                              0.1,
+                              16.666666,
+                              9007199254740991.0,
+                              9007199254740992.0,
+                              -9007199254740993.0,
+                              1e300,
+                              5e-324,
+                              std::numeric_limits<double>::infinity(),
+                              std::numeric_limits<double>::quiet_NaN()};
+    std::uniform_real_distribution<double> reals(-1e6, 1e6);
+    std::uniform_int_distribution<int64_t> ints(-(int64_t(1) << 54),
+                                                int64_t(1) << 54);
+    for (int i = 0; i < 1000; ++i) {
+        xs.push_back(reals(gen));
+        xs.push_back(static_cast<double>(ints(gen)));
+        xs.push_back(static_cast<float>(reals(gen)));
+    }
+    for (auto x : xs) EXPECT_EQ(Written(x), Json(x).dump()) << x;
+}
+
+TEST(JsonWriterTest, SecondsMatchFixedAndTruncated) {
+    std::mt19937_64 gen(5678);
+    std::vector<int64_t> ns = {0,
+                               1,
+                               -1,
+                               10,
+                               999999999,
+                               1000000000,
+                               -1500000000,
+                               (int64_t(1) << 22) * 1000000000 - 1,
+                               (int64_t(1) << 22) * 1000000000,
+                               std::numeric_limits<int64_t>::max(),
+                               std::numeric_limits<int64_t>::min()};
+    // Times up to a day, at ns and ms resolution, and up to 100 days.
+    std::uniform_int_distribution<int64_t> day(0, 86400000000000);
+    std::uniform_int_distribution<int64_t> days(0, 8640000000000000);
+    for (int i = 0; i < 10000; ++i) {
+        ns.push_back(day(gen));
+        ns.push_back(day(gen) / 1000000 * 1000000);
+        ns.push_back(-days(gen));
+    }
+    for (auto n : ns) {
+        EXPECT_EQ(WrittenSeconds(n),
+                  "\"" + JsonSerializer::FixedAndTruncated(n / 1000000000.0) +
+                      "s\"")
+            << n;
+    }
+}
+
+TEST(JsonWriterTest, TimesMatchDate) {
+    std::string s;
+    JsonWriter w(s);
+    std::string expected;
+    std::mt19937_64 gen(42);
+    // Around 2022, with consecutive times often on the same day.
+    std::uniform_int_distribution<int64_t> offsets(0, 3 * 86400);
+    SystemTimePoint t = SystemTimePoint() + seconds(1640995200);
+    for (int i = 0; i < 1000; ++i) {
+        t += duration_cast<system_clock::duration>(seconds(offsets(gen)) +
+                                                   nanoseconds(offsets(gen)));
+        w.Time(t);
+        auto day = date::floor<date::days>(t);
+        std::stringstream str;
+        if (i > 0) str << ", ";
+        str << '"' << date::year_month_day(day) << 'T'
+            << date::make_time(t - day) << "Z\"";
+        expected += str.str();
+    }
+    EXPECT_EQ(s, expected);
+}
+
+TEST(JsonWriterTest, NestingMatchesJson11) {
+    std::string s;
+    JsonWriter w(s);
+    w.BeginObject();
+    w.Key("a");
+    w.BeginArray();
+    w.Int(1);
+    w.BeginObject();
+    w.EndObject();
+    w.BeginArray();
+    w.EndArray();
+    w.Bool(false);
+    w.EndArray();
+    w.Key("b");
+    w.BeginObject();
+    w.Key("c");
+    w.Uint64(18446744073709551615ull);
+    w.Key("d");
+    w.Raw("[1, 2]");
+    w.EndObject();
+    w.Key("e");
+    w.Int(-123456);
+    w.EndObject();
+    Json expected = Json::object{
+        {"a", Json::array{1, Json::object{}, Json::array{}, false}},
+        {"b", Json::object{{"c", "18446744073709551615"},
+                           {"d", Json::array{1, 2}}}},
+        {"e", -123456}};
+    EXPECT_EQ(s, expected.dump());
+}
+
+}  // namespace json_writer_test
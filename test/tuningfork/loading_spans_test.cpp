@@ -0,0 +1,158 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "core/loading_spans.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace loading_spans_test {
+
+using namespace tuningfork;
+using Source = TuningFork_LoadingTimeMetadata::LoadingSource;
+
+ProcessTime Ms(int64_t ms) { return std::chrono::milliseconds(ms); }
+
+Duration Critical(const LoadingBreakdown& b, Source s) {
+    return b.stages[s].critical_path;
+}
+
+Duration Exclusive(const LoadingBreakdown& b, Source s) {
+    return b.stages[s].exclusive;
+}
+
+TEST(LoadingSpansTest, CriticalPath) {
+    auto spans = std::make_unique<LoadingSpans>();
+    spans->BeginGroup(Ms(1000));
+    // Assets load in parallel with shaders, which wait for some data from the
+    // network part way through.
+    LoadingSpanHandle assets, shaders, network;
+    ASSERT_EQ(spans->Start(Source::DEVICE_STORAGE, 0, Ms(1000), assets),
+              TUNINGFORK_ERROR_OK);
+    ASSERT_EQ(spans->Start(Source::SHADER_COMPILATION, 0, Ms(1010), shaders),
+              TUNINGFORK_ERROR_OK);
+    ASSERT_EQ(spans->Start(Source::NETWORK, shaders, Ms(1020), network),
+              TUNINGFORK_ERROR_OK);
+    EXPECT_EQ(spans->Stop(network, Ms(1050)), TUNINGFORK_ERROR_OK);
+    EXPECT_EQ(spans->Stop(assets, Ms(1060)), TUNINGFORK_ERROR_OK);
+    EXPECT_EQ(spans->Stop(shaders, Ms(1090)), TUNINGFORK_ERROR_OK);
+    auto b = spans->EndGroup(Ms(1100));
+
+    EXPECT_EQ(b.wall, Ms(100));
+    EXPECT_EQ(Exclusive(b, Source::DEVICE_STORAGE), Ms(60));
+    EXPECT_EQ(Exclusive(b, Source::SHADER_COMPILATION), Ms(50));
+    EXPECT_EQ(Exclusive(b, Source::NETWORK), Ms(30));
+    EXPECT_EQ(Exclusive(b, Source::TOTAL_USER_WAIT_FOR_GROUP), Ms(10));
+    EXPECT_EQ(b.work, Ms(140));
+    EXPECT_DOUBLE_EQ(b.Parallelism(), 1.4);
+    // The group waited for the shaders, which waited for the network.
+    EXPECT_EQ(Critical(b, Source::DEVICE_STORAGE), Ms(0));
+    EXPECT_EQ(Critical(b, Source::SHADER_COMPILATION), Ms(50));
+    EXPECT_EQ(Critical(b, Source::NETWORK), Ms(30));
+    EXPECT_EQ(Critical(b, Source::TOTAL_USER_WAIT_FOR_GROUP), Ms(20));
+}
+
+TEST(LoadingSpansTest, SpansAreClipped) {
+    auto spans = std::make_unique<LoadingSpans>();
+    spans->BeginGroup(Ms(0));
+    LoadingSpanHandle parent, child, running;
+    ASSERT_EQ(spans->Start(Source::APK, 0, Ms(0), parent),
+              TUNINGFORK_ERROR_OK);
+    ASSERT_EQ(spans->Start(Source::MEMORY, parent, Ms(10), child),
+              TUNINGFORK_ERROR_OK);
+    ASSERT_EQ(spans->Start(Source::NETWORK, 0, Ms(50), running),
+              TUNINGFORK_ERROR_OK);
+    EXPECT_EQ(spans->Stop(parent, Ms(20)), TUNINGFORK_ERROR_OK);
+    // The child outlives its parent and the other span outlives the group.
+    EXPECT_EQ(spans->Stop(child, Ms(90)), TUNINGFORK_ERROR_OK);
+    auto b = spans->EndGroup(Ms(80));
+    EXPECT_EQ(Exclusive(b, Source::APK), Ms(10));
+    EXPECT_EQ(Exclusive(b, Source::MEMORY), Ms(10));
+    EXPECT_EQ(Exclusive(b, Source::NETWORK), Ms(30));
+    EXPECT_EQ(Critical(b, Source::NETWORK), Ms(30));
+    EXPECT_EQ(Critical(b, Source::TOTAL_USER_WAIT_FOR_GROUP), Ms(30));
+    EXPECT_EQ(Critical(b, Source::MEMORY), Ms(10));
+    EXPECT_EQ(Critical(b, Source::APK), Ms(10));
+}
+
+TEST(LoadingSpansTest, BadHandles) {
+    auto spans = std::make_unique<LoadingSpans>();
+    LoadingSpanHandle h;
+    EXPECT_EQ(spans->Start(Source::APK, 0, Ms(0), h),
+              TUNINGFORK_ERROR_NO_ACTIVE_LOADING_GROUP);
+    spans->BeginGroup(Ms(0));
+    EXPECT_EQ(spans->Start(Source::APK, 12345, Ms(0), h),
+              TUNINGFORK_ERROR_INVALID_LOADING_HANDLE);
+    EXPECT_EQ(spans->Start(LoadingBreakdown::kNumStages, 0, Ms(0), h),
+              TUNINGFORK_ERROR_BAD_PARAMETER);
+    ASSERT_EQ(spans->Start(Source::APK, 0, Ms(0), h), TUNINGFORK_ERROR_OK);
+    EXPECT_EQ(spans->Stop(h, Ms(1)), TUNINGFORK_ERROR_OK);
+    EXPECT_EQ(spans->Stop(h, Ms(2)), TUNINGFORK_ERROR_INVALID_LOADING_HANDLE);
+    EXPECT_FALSE(spans->EndGroup(Ms(3)).Empty());
+
+    // Handles from the previous group aren't valid in the next.
+    spans->BeginGroup(Ms(10));
+    LoadingSpanHandle child;
+    EXPECT_EQ(spans->Start(Source::APK, h, Ms(10), child),
+              TUNINGFORK_ERROR_INVALID_LOADING_HANDLE);
+    // A group without spans has no breakdown.
+    EXPECT_TRUE(spans->EndGroup(Ms(20)).Empty());
+}
+
+TEST(LoadingSpansTest, TooManySpans) {
+    auto spans = std::make_unique<LoadingSpans>();
+    spans->BeginGroup(Ms(0));
+    LoadingSpanHandle h;
+    for (size_t i = 0; i < LoadingSpans::kMaxSpans; ++i)
+        ASSERT_EQ(spans->Start(Source::APK, 0, Ms(0), h), TUNINGFORK_ERROR_OK);
+    EXPECT_EQ(spans->Start(Source::APK, 0, Ms(0), h),
+              TUNINGFORK_ERROR_NO_MORE_SPACE_FOR_LOADING_TIME_DATA);
+    EXPECT_EQ(spans->EndGroup(Ms(10)).work,
+              Duration(Ms(10)) * int(LoadingSpans::kMaxSpans));
+}
+
+TEST(LoadingSpansTest, ConcurrentSpans) {
+    constexpr int kThreads = 4;
+    constexpr int kSpansPerThread = 30;
+    auto spans = std::make_unique<LoadingSpans>();
+    spans->BeginGroup(Ms(0));
+    LoadingSpanHandle root;
+    ASSERT_EQ(spans->Start(Source::DEVICE_STORAGE, 0, Ms(0), root),
+              TUNINGFORK_ERROR_OK);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&, t]() {
+            for (int i = 0; i < kSpansPerThread; ++i) {
+                LoadingSpanHandle h;
+                ASSERT_EQ(spans->Start(Source::NETWORK, root, Ms(i), h),
+                          TUNINGFORK_ERROR_OK);
+                ASSERT_EQ(spans->Stop(h, Ms(i + 1)), TUNINGFORK_ERROR_OK);
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+    EXPECT_EQ(spans->Stop(root, Ms(kSpansPerThread)), TUNINGFORK_ERROR_OK);
+    auto b = spans->EndGroup(Ms(kSpansPerThread));
+    EXPECT_EQ(Exclusive(b, Source::NETWORK), Ms(kThreads * kSpansPerThread));
+    EXPECT_EQ(Exclusive(b, Source::DEVICE_STORAGE), Ms(0));
+    EXPECT_EQ(Critical(b, Source::NETWORK), Ms(kSpansPerThread));
+    EXPECT_DOUBLE_EQ(b.Parallelism(), kThreads);
+}
+
+}  // namespace loading_spans_test
@@ -0,0 +1,160 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "core/mapped_file_cache.h"
+
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "core/tuningfork_utils.h"
+#include "jni/jni_helper.h"
+#include "proto/protobuf_util.h"
+#include "test_utils.h"
+#include "tuningfork_test_c.h"
+
+namespace mapped_file_cache_test {
+
+using namespace tuningfork;
+
+constexpr char kBasePath[] = "/data/local/tmp/tuningfork_mapped_file_test";
+
+std::string GetPath() {
+    // Use JNI if we can, for app cache usage rather than /data/local/tmp
+    init_jni_for_tests();
+    if (gamesdk::jni::IsValid()) {
+        return file_utils::GetAppCacheDir() + "/tuningfork_mapped_file_test";
+    } else {
+        return kBasePath;
+    }
+}
+
+std::string LogFileName() { return GetPath() + "/local_cache.log"; }
+
+size_t LogFileSize() {
+    struct stat st;
+    if (stat(LogFileName().c_str(), &st) != 0) return 0;
+    return st.st_size;
+}
+
+void Save(MappedFileCache& cache, uint64_t key,
+          const ProtobufSerialization& value) {
+    TuningFork_CProtobufSerialization cvalue;
+    ToCProtobufSerialization(value, cvalue);
+    EXPECT_EQ(cache.Set(key, &cvalue), TUNINGFORK_ERROR_OK);
+    TuningFork_CProtobufSerialization_free(&cvalue);
+}
+
+ProtobufSerialization Load(MappedFileCache& cache, uint64_t key) {
+    TuningFork_CProtobufSerialization cvalue;
+    if (cache.Get(key, &cvalue) == TUNINGFORK_ERROR_OK) {
+        auto value = ToProtobufSerialization(cvalue);
+        TuningFork_CProtobufSerialization_free(&cvalue);
+        return value;
+    } else
+        return {};
+}
+
+class MappedFileCacheTest : public ::testing::Test {
+   protected:
+    void SetUp() override {
+        cache_.SetDir(GetPath());
+        EXPECT_EQ(cache_.Clear(), TUNINGFORK_ERROR_OK);
+        // Some devices don't allow writing to /data/local/tmp, however we
+        // don't want to give errors when they are run on the command-line.
+        if (!cache_.IsValid()) GTEST_SKIP();
+    }
+    void TearDown() override {
+        cache_.Clear();
+        clear_jni_for_tests();
+    }
+    MappedFileCache cache_;
+};
+
+static std::vector<uint64_t> keys = {0, 1, 24523, 0xffffff};
+
+TEST_F(MappedFileCacheTest, SaveLoadOp) {
+    ProtobufSerialization saved = {1, 2, 3};
+    for (auto k : keys) {
+        EXPECT_EQ(Load(cache_, k), ProtobufSerialization{});
+        Save(cache_, k, saved);
+        EXPECT_EQ(Load(cache_, k), saved) << "Save+Load";
+    }
+    const uint8_t* data;
+    size_t size;
+    ASSERT_EQ(cache_.GetView(keys[0], &data, &size), TUNINGFORK_ERROR_OK);
+    EXPECT_EQ(ProtobufSerialization(data, data + size), saved);
+    // Everything is in the one file.
+    EXPECT_FALSE(file_utils::FileExists(GetPath() + "/local_cache_0"));
+    EXPECT_TRUE(file_utils::FileExists(LogFileName()));
+}
+
+TEST_F(MappedFileCacheTest, RemoveOp) {
+    ProtobufSerialization saved = {1, 2, 3};
+    for (auto k : keys) {
+        Save(cache_, k, saved);
+        EXPECT_EQ(Load(cache_, k), saved) << "Save+Load";
+        EXPECT_EQ(cache_.Remove(k), TUNINGFORK_ERROR_OK);
+        EXPECT_EQ(Load(cache_, k), ProtobufSerialization{}) << "Remove";
+        EXPECT_EQ(cache_.Remove(k), TUNINGFORK_ERROR_NO_SUCH_KEY);
+    }
+}
+
+TEST_F(MappedFileCacheTest, Reopen) {
+    Save(cache_, 1, {1});
+    Save(cache_, 2, {2});
+    Save(cache_, 1, {1, 1});
+    cache_.Remove(2);
+    MappedFileCache reopened(GetPath());
+    EXPECT_EQ(Load(reopened, 1), (ProtobufSerialization{1, 1}));
+    EXPECT_EQ(Load(reopened, 2), ProtobufSerialization{});
+}
+
+TEST_F(MappedFileCacheTest, Compacts) {
+    ProtobufSerialization value(1000, 7);
+    for (int i = 0; i < 1000; ++i) {
+        value[0] = i;
+        Save(cache_, i % 4, value);
+    }
+    EXPECT_LT(cache_.DeadBytes(), MappedFileCache::kMinCompactionBytes);
+    EXPECT_LT(LogFileSize(), 4 * MappedFileCache::kMinCompactionBytes);
+    EXPECT_FALSE(file_utils::FileExists(LogFileName() + ".tmp"));
+    MappedFileCache reopened(GetPath());
+    for (int i = 996; i < 1000; ++i) {
+        value[0] = i;
+        EXPECT_EQ(Load(reopened, i % 4), value);
+    }
+}
+
+TEST_F(MappedFileCacheTest, IgnoresTornWrite) {
+    Save(cache_, 1, {1, 2, 3});
+    Save(cache_, 2, {4, 5, 6});
+    const uint8_t* data;
+    size_t size;
+    ASSERT_EQ(cache_.GetView(2, &data, &size), TUNINGFORK_ERROR_OK);
+    // Simulate the last value only being partly written.
+    const_cast<uint8_t*>(data)[1] = 0;
+    MappedFileCache reopened(GetPath());
+    EXPECT_EQ(Load(reopened, 1), (ProtobufSerialization{1, 2, 3}));
+    EXPECT_EQ(Load(reopened, 2), ProtobufSerialization{});
+    Save(reopened, 3, {7});
+    MappedFileCache reopened_again(GetPath());
+    EXPECT_EQ(Load(reopened_again, 3), ProtobufSerialization{7});
+}
+
+}  // namespace mapped_file_cache_test
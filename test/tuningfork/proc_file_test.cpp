@@ -0,0 +1,148 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "proc_file.h"
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <string>
+
+namespace proc_file_test {
+
+using gamesdk::ProcField;
+using gamesdk::ProcFile;
+
+constexpr char kPath[] = "/data/local/tmp/tuningfork_proc_file_test";
+
+class ProcFileTest : public ::testing::Test {
+   protected:
+    // Returns false if the file can't be written.
+    bool Write(const std::string& contents) {
+        std::ofstream f(kPath, std::ios::binary | std::ios::trunc);
+        f << contents;
+        return f.good();
+    }
+    void TearDown() override { unlink(kPath); }
+};
+
+TEST_F(ProcFileTest, MeminfoFields) {
+    if (!Write("MemTotal:       16318200 kB\n"
+               "MemFree:          512000 kB\n"
+               "Active(anon):       2048 kB\n"
+               "HugePages_Total:       0\n"
+               "SwapTotal:       2097148 kB\n"))
+        GTEST_SKIP();
+    ProcFile file(kPath);
+    ASSERT_TRUE(file.Read());
+    ProcField fields[] = {{"SwapTotal"}, {"Active(anon)"},
+                          {"HugePages_Total"}, {"MemFre"}};
+    EXPECT_EQ(file.GetFields(fields, 4), 3);
+    EXPECT_TRUE(fields[0].found);
+    EXPECT_EQ(fields[0].value, 2097148);
+    EXPECT_TRUE(fields[0].kb);
+    EXPECT_EQ(fields[1].value, 2048);
+    EXPECT_TRUE(fields[2].found);
+    EXPECT_EQ(fields[2].value, 0);
+    EXPECT_FALSE(fields[2].kb);
+    EXPECT_FALSE(fields[3].found);
+}
+
+TEST_F(ProcFileTest, StatusFields) {
+    if (!Write("Name:\tgame\n"
+               "State:\tS (sleeping)\n"
+               "Pid:\t1234\n"
+               "VmRSS:\t  123456 kB\n"
+               "Cpus_allowed_list:\t0-7\n"))
+        GTEST_SKIP();
+    ProcFile file(kPath);
+    ASSERT_TRUE(file.Read());
+    std::string keys;
+    file.ForEachField(
+        [&](const char* key, size_t key_size, uint64_t value, bool kb) {
+            keys += std::string(key, key_size) + "=" +
+                    std::to_string(value) + (kb ? "kB " : " ");
+        });
+    EXPECT_EQ(keys, "Pid=1234 VmRSS=123456kB Cpus_allowed_list=0 ");
+}
+
+TEST_F(ProcFileTest, RereadsChangedFile) {
+    if (!Write("Rss: 1 kB\n")) GTEST_SKIP();
+    ProcFile file(kPath);
+    ProcField rss("Rss");
+    ASSERT_TRUE(file.Read());
+    file.GetFields(&rss, 1);
+    EXPECT_EQ(rss.value, 1);
+    // Overwrite the file in place, as the kernel does for /proc files.
+    ASSERT_TRUE(Write("Rss: 22 kB\n"));
+    ASSERT_TRUE(file.Read());
+    file.GetFields(&rss, 1);
+    EXPECT_EQ(rss.value, 22);
+}
+
+TEST_F(ProcFileTest, LongFileIsCutAtLine) {
+    std::string contents;
+    int n_lines = 0;
+    while (contents.size() < 2 * ProcFile::kBufferSize) {
+        contents += "Key" + std::to_string(n_lines++) + ": 1 kB\n";
+    }
+    if (!Write(contents)) GTEST_SKIP();
+    ProcFile file(kPath);
+    ASSERT_TRUE(file.Read());
+    EXPECT_LE(file.Size(), ProcFile::kBufferSize);
+    EXPECT_EQ(file.Data()[file.Size() - 1], '\n');
+    int n = 0;
+    file.ForEachField([&](const char*, size_t, uint64_t, bool kb) {
+        EXPECT_TRUE(kb);
+        ++n;
+    });
+    EXPECT_GT(n, 0);
+    EXPECT_LT(n, n_lines);
+}
+
+TEST_F(ProcFileTest, Numbers) {
+    if (!Write("1024 300 200 10 0 500 0\n")) GTEST_SKIP();
+    ProcFile file(kPath);
+    ASSERT_TRUE(file.Read());
+    int64_t statm[7];
+    EXPECT_EQ(file.GetNumbers(statm, 7), 7);
+    EXPECT_EQ(statm[0], 1024);
+    EXPECT_EQ(statm[1], 300);
+    EXPECT_EQ(statm[5], 500);
+    ASSERT_TRUE(Write("-17\n"));
+    ASSERT_TRUE(file.Read());
+    EXPECT_EQ(file.GetNumbers(statm, 7), 1);
+    EXPECT_EQ(statm[0], -17);
+}
+
+TEST(ProcFile, ReadsProc) {
+    ProcFile statm("/proc/self/statm");
+    ASSERT_TRUE(statm.Read());
+    int64_t pages[2];
+    EXPECT_EQ(statm.GetNumbers(pages, 2), 2);
+    EXPECT_GT(pages[1], 0);
+
+    ProcFile status("/proc/self/status");
+    ASSERT_TRUE(status.Read());
+    ProcField vm_rss("VmRSS");
+    EXPECT_EQ(status.GetFields(&vm_rss, 1), 1);
+    EXPECT_TRUE(vm_rss.kb);
+
+    EXPECT_FALSE(ProcFile("/proc/self/no_such_file").Read());
+}
+
+}  // namespace proc_file_test
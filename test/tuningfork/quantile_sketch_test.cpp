@@ -0,0 +1,96 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "core/quantile_sketch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace quantile_sketch_test {
+
+using tuningfork::QuantileSketch;
+
+// A permutation of 0..n-1, so that the sample at rank r is r.
+std::vector<float> Shuffled(int n) {
+    std::vector<float> xs;
+    for (int64_t i = 0; i < n; ++i) xs.push_back((i * 7919) % n);
+    return xs;
+}
+
+void CheckRankError(const QuantileSketch& q, int n, double max_error) {
+    for (double p : {0.01, 0.1, 0.5, 0.9, 0.95, 0.99, 0.999}) {
+        double rank = q.Quantile(p);
+        EXPECT_LE(std::abs(rank / n - p), max_error) << "Quantile " << p;
+    }
+}
+
+TEST(QuantileSketchTest, Empty) {
+    QuantileSketch q;
+    EXPECT_EQ(q.Count(), 0);
+    EXPECT_EQ(q.Quantile(0.5), 0);
+}
+
+TEST(QuantileSketchTest, ExactWhenSmall) {
+    QuantileSketch q;
+    for (float x : {5.0f, 1.0f, 4.0f, 2.0f, 3.0f}) q.Add(x);
+    EXPECT_EQ(q.Count(), 5);
+    EXPECT_EQ(q.NumRetained(), 5);
+    EXPECT_EQ(q.Quantile(0), 1);
+    EXPECT_EQ(q.Quantile(0.5), 3);
+    EXPECT_EQ(q.Quantile(1), 5);
+    q.Clear();
+    EXPECT_EQ(q.Count(), 0) << "Clear bad";
+}
+
+TEST(QuantileSketchTest, BoundedMemory) {
+    QuantileSketch q;
+    const int n = 1000000;
+    for (float x : Shuffled(n)) q.Add(x);
+    EXPECT_EQ(q.Count(), n);
+    EXPECT_LT(q.NumRetained(), 4 * QuantileSketch::kDefaultK);
+    CheckRankError(q, n, 0.017);
+}
+
+TEST(QuantileSketchTest, Merge) {
+    const int n = 200000;
+    QuantileSketch a, b;
+    auto xs = Shuffled(n);
+    for (int i = 0; i < n; ++i) (i % 3 ? a : b).Add(xs[i]);
+    EXPECT_EQ(a.Merge(b), TUNINGFORK_ERROR_OK);
+    EXPECT_EQ(a.Count(), n);
+    EXPECT_LT(a.NumRetained(), 4 * QuantileSketch::kDefaultK);
+    CheckRankError(a, n, 0.017);
+    QuantileSketch c(100);
+    EXPECT_EQ(c.Merge(b), TUNINGFORK_ERROR_BAD_PARAMETER)
+        << "Merged sketches of different sizes";
+}
+
+TEST(QuantileSketchTest, MergeLevels) {
+    QuantileSketch a, b;
+    for (float x : Shuffled(10000)) a.Add(x);
+    EXPECT_EQ(b.MergeLevels(a.Levels(), a.Count()), TUNINGFORK_ERROR_OK);
+    EXPECT_EQ(b.Count(), a.Count());
+    EXPECT_EQ(b.Quantile(0.5), a.Quantile(0.5));
+    EXPECT_EQ(b.MergeLevels(a.Levels(), a.Count() + 1),
+              TUNINGFORK_ERROR_BAD_PARAMETER)
+        << "Merged levels with the wrong count";
+}
+
+}  // namespace quantile_sketch_test
@@ -0,0 +1,107 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "core/rollup_engine.h"
+
+#include "gtest/gtest.h"
+
+namespace rollup_engine_test {
+
+using namespace tuningfork;
+
+MetricId FrameTimeId(AnnotationId annotation) {
+    return MetricId::FrameTime(annotation, 0);
+}
+
+// Times are minutes from an arbitrary midnight.
+SystemTimePoint Minute(int minute) {
+    return SystemTimePoint(std::chrono::hours(24 * 1000) +
+                           std::chrono::minutes(minute));
+}
+
+// A session ending at the given minute, with n frames recorded in
+// annotation.
+void Fill(Session& session, int minute, AnnotationId annotation, int n) {
+    session.ClearData();
+    session.Ping(Minute(minute));
+    auto d = session.GetData<FrameTimeMetricData>(FrameTimeId(annotation));
+    for (int i = 0; i < n; ++i) d->Record(std::chrono::milliseconds(16));
+}
+
+size_t Count(const RollupWindow& window, AnnotationId annotation) {
+    auto it = window.frame_times.find(FrameTimeId(annotation));
+    return it == window.frame_times.end() ? 0 : it->second.Count();
+}
+
+class RollupEngineTest : public ::testing::Test {
+   protected:
+    void SetUp() override {
+        for (int i = 0; i < 4; ++i)
+            session.CreateFrameTimeHistogram(FrameTimeId(0),
+                                             Settings::DefaultHistogram(1));
+    }
+    Session session;
+    RollupEngine rollup{std::chrono::minutes(1)};
+};
+
+TEST_F(RollupEngineTest, KeepsEachLevel) {
+    for (int minute = 0; minute < 25; ++minute) {
+        Fill(session, minute, 1 + minute / 20, 10);
+        rollup.Add(session);
+    }
+    auto minutes = rollup.Windows(0);
+    ASSERT_EQ(minutes.size(), 25);
+    EXPECT_EQ(minutes[3].start, Minute(3));
+    EXPECT_EQ(Count(minutes[3], 1), 10);
+    auto tens = rollup.Windows(1);
+    ASSERT_EQ(tens.size(), 3);
+    EXPECT_EQ(tens[1].start, Minute(10));
+    EXPECT_EQ(tens[1].length, std::chrono::minutes(10));
+    EXPECT_EQ(Count(tens[1], 1), 100);
+    EXPECT_EQ(Count(tens[2], 1), 0);
+    EXPECT_EQ(Count(tens[2], 2), 50);
+    auto hours = rollup.Windows(2);
+    ASSERT_EQ(hours.size(), 1);
+    EXPECT_EQ(Count(hours[0], 1), 200);
+    EXPECT_EQ(Count(hours[0], 2), 50);
+}
+
+TEST_F(RollupEngineTest, ReportsCompletedWindows) {
+    Fill(session, 5, 1, 1);
+    EXPECT_EQ(rollup.Add(session), 0);
+    Fill(session, 5, 1, 1);
+    EXPECT_EQ(rollup.Add(session), 0);
+    Fill(session, 6, 1, 1);
+    EXPECT_EQ(rollup.Add(session), 1);
+    Fill(session, 10, 1, 1);
+    EXPECT_EQ(rollup.Add(session), 3);
+    Fill(session, 61, 1, 1);
+    EXPECT_EQ(rollup.Add(session), 7);
+}
+
+TEST_F(RollupEngineTest, DropsOldWindows) {
+    int n = RollupEngine::kWindowsKept[0] + 5;
+    for (int minute = 0; minute < n; ++minute) {
+        Fill(session, minute, 1, 1);
+        rollup.Add(session);
+    }
+    auto minutes = rollup.Windows(0);
+    ASSERT_EQ(minutes.size(), RollupEngine::kWindowsKept[0]);
+    EXPECT_EQ(minutes.front().start, Minute(5));
+    EXPECT_EQ(Count(rollup.Windows(2)[0], 1), 60);
+}
+
+}  // namespace rollup_engine_test
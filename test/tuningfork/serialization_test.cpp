@@ -20,6 +20,7 @@
 
 #include "common/gamesdk_common.h"
 #include "core/tuningfork_utils.h"
+#include "http_backend/binary_serializer.h"
 #include "http_backend/json_serializer.h"
 #include "test_utils.h"
 
@@ -244,7 +245,10 @@ std::string single_tick = R"TF({
       "render_time_histogram": [{
         "counts": [0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
                    0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0],
-        "instrument_id": 0
+        "instrument_id": 0,
+        "jank": {"big_janks": "0", "frames": "1", "janky_frames": "1",
+                 "longest_run": "1", "missed_frames": "1",
+                 "runs": ["1", "0", "0", "0", "0"], "stutter_clusters": "0"}
       }]
     }
   }
@@ -259,6 +263,21 @@ void CheckSessions(Session& pc0, Session& pc1) {
 
 Settings::Histogram DefaultHistogram() { return {-1, 10, 40, 30}; }
 
+void CheckJank(Session& pc0, Session& pc1) {
+    auto j0 = pc0.GetData<FrameTimeMetricData>(MetricId::FrameTime(0, 0))
+                  ->jank_.Finished();
+    auto j1 = pc1.GetData<FrameTimeMetricData>(MetricId::FrameTime(0, 0))
+                  ->jank_.Finished();
+    EXPECT_EQ(j0.frames_, j1.frames_);
+    EXPECT_EQ(j0.janky_frames_, j1.janky_frames_);
+    EXPECT_EQ(j0.missed_frames_, j1.missed_frames_);
+    EXPECT_EQ(j0.big_janks_, j1.big_janks_);
+    EXPECT_EQ(j0.stutter_clusters_, j1.stutter_clusters_);
+    EXPECT_EQ(j0.longest_run_, j1.longest_run_);
+    for (int i = 0; i < JankMetricData::kMaxRunLength; ++i)
+        EXPECT_EQ(j0.runs_[i], j1.runs_[i]);
+}
+
 TEST(SerializationTest, GEDeserialization) {
     Session session{};
     FrameTimeMetric metric(0);
@@ -289,6 +308,278 @@ TEST(SerializationTest, GEDeserialization) {
     CheckSessions(session1, session);
 }
 
+std::string single_tick_log_linear = R"TF({
+  "context": {
+    "annotations": "AQID",
+    "duration": "0.03s",
+    "tuning_parameters": {
+      "experiment_id": "expt",
+      "serialized_fidelity_parameters": ""
+    }
+  },
+  "report": {
+    "rendering": {
+      "render_time_histogram": [{
+        "counts": [0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0],
+        "instrument_id": 0,
+        "jank": {"big_janks": "0", "frames": "1", "janky_frames": "1",
+                 "longest_run": "1", "missed_frames": "1",
+                 "runs": ["1", "0", "0", "0", "0"], "stutter_clusters": "0"},
+        "log_linear_buckets": {
+          "start": 10,
+          "sub_bucket_bits": 2
+        }
+      }]
+    }
+  }
+})TF";
+
+TEST(SerializationTest, LogLinearDeserialization) {
+    Session session{};
+    MetricId metric_id{0};
+    Settings::Histogram log_linear_histogram{
+        -1, 10, 40, 0, Settings::Histogram::Scale::LOG_LINEAR, 2};
+    session.CreateFrameTimeHistogram(metric_id, log_linear_histogram);
+    auto p = session.GetData<FrameTimeMetricData>(metric_id);
+    p->Record(milliseconds(30));
+    std::string evt_ser;
+    IdMap metric_map;
+    JsonSerializer serializer(session, &metric_map);
+    serializer.SerializeEvent(test_device_info, evt_ser);
+    auto report = report_start + single_tick_log_linear + report_end;
+    EXPECT_TRUE(CompareIgnoringWhitespace(evt_ser, report))
+        << evt_ser << "\n!=\n"
+        << report;
+    Session session1{};
+    session1.CreateFrameTimeHistogram(metric_id, log_linear_histogram);
+    EXPECT_EQ(
+        JsonSerializer::DeserializeAndMerge(evt_ser, metric_map, session1),
+        TUNINGFORK_ERROR_OK)
+        << "Deserialize log-linear";
+    CheckSessions(session1, session);
+    // The counts don't make sense for linear buckets.
+    Session session2{};
+    session2.CreateFrameTimeHistogram(metric_id, {-1, 10, 40, 9});
+    EXPECT_EQ(
+        JsonSerializer::DeserializeAndMerge(evt_ser, metric_map, session2),
+        TUNINGFORK_ERROR_BAD_PARAMETER)
+        << "Deserialize log-linear into linear";
+}
+
+std::string single_tick_quantile_sketch = R"TF({
+  "context": {
+    "annotations": "AQID",
+    "duration": "0.03s",
+    "tuning_parameters": {
+      "experiment_id": "expt",
+      "serialized_fidelity_parameters": ""
+    }
+  },
+  "report": {
+    "rendering": {
+      "render_time_histogram": [{
+        "instrument_id": 0,
+        "jank": {"big_janks": "0", "frames": "1", "janky_frames": "1",
+                 "longest_run": "1", "missed_frames": "1",
+                 "runs": ["1", "0", "0", "0", "0"], "stutter_clusters": "0"},
+        "quantile_sketch": {
+          "count": "1",
+          "k": 100,
+          "levels": [[30]]
+        }
+      }]
+    }
+  }
+})TF";
+
+TEST(SerializationTest, QuantileSketchDeserialization) {
+    Session session{};
+    MetricId metric_id{0};
+    Settings::Histogram sketch_histogram{
+        -1, 0, 0, 100, Settings::Histogram::Scale::LINEAR, 0,
+        Settings::Histogram::Storage::QUANTILE_SKETCH};
+    session.CreateFrameTimeHistogram(metric_id, sketch_histogram);
+    auto p = session.GetData<FrameTimeMetricData>(metric_id);
+    p->Record(milliseconds(30));
+    std::string evt_ser;
+    IdMap metric_map;
+    JsonSerializer serializer(session, &metric_map);
+    serializer.SerializeEvent(test_device_info, evt_ser);
+    auto report = report_start + single_tick_quantile_sketch + report_end;
+    EXPECT_TRUE(CompareIgnoringWhitespace(evt_ser, report))
+        << evt_ser << "\n!=\n"
+        << report;
+    Session session1{};
+    session1.CreateFrameTimeHistogram(metric_id, sketch_histogram);
+    auto p1 = session1.GetData<FrameTimeMetricData>(metric_id);
+    p1->Record(milliseconds(10));
+    EXPECT_EQ(
+        JsonSerializer::DeserializeAndMerge(evt_ser, metric_map, session1),
+        TUNINGFORK_ERROR_OK)
+        << "Deserialize quantile sketch";
+    EXPECT_EQ(p1->quantiles_.Count(), 2);
+    EXPECT_EQ(p1->quantiles_.Quantile(0), 10);
+    EXPECT_EQ(p1->quantiles_.Quantile(1), 30);
+    // A sketch can't be merged into histogram buckets.
+    Session session2{};
+    session2.CreateFrameTimeHistogram(metric_id, DefaultHistogram());
+    EXPECT_EQ(
+        JsonSerializer::DeserializeAndMerge(evt_ser, metric_map, session2),
+        TUNINGFORK_ERROR_BAD_PARAMETER)
+        << "Deserialize quantile sketch into histogram";
+}
+
+TEST(SerializationTest, BinaryRoundTrip) {
+    Session session{};
+    MetricId metric_id{0};
+    MetricId loading_time_metric = MetricId::LoadingTime(0, 0);
+    session.CreateFrameTimeHistogram(metric_id, DefaultHistogram());
+    session.CreateLoadingTimeSeries(loading_time_metric);
+    auto p = session.GetData<FrameTimeMetricData>(metric_id);
+    for (int i = 0; i < 100; ++i) p->Record(milliseconds(16 + i % 3));
+    p->Record(milliseconds(33));
+    p->Record(milliseconds(100));
+    auto l = session.GetData<LoadingTimeMetricData>(loading_time_metric);
+    l->Record(milliseconds(1500));
+    l->breakdown_.work = milliseconds(2000);
+    l->breakdown_.wall = milliseconds(1500);
+    l->breakdown_.stages[LoadingTimeMetadata::NETWORK].exclusive =
+        milliseconds(1200);
+    l->breakdown_.stages[LoadingTimeMetadata::NETWORK].critical_path =
+        milliseconds(900);
+    IdMap metric_map;
+    std::string json_ser, binary_ser;
+    JsonSerializer(session, &metric_map)
+        .SerializeEvent(test_device_info, json_ser);
+    BinarySerializer(session, &metric_map)
+        .SerializeEvent(test_device_info, binary_ser);
+    EXPECT_TRUE(BinarySerializer::IsBinary(binary_ser));
+    EXPECT_FALSE(BinarySerializer::IsBinary(json_ser));
+    EXPECT_LT(binary_ser.size(), json_ser.size() / 4);
+
+    Session from_json{};
+    from_json.CreateFrameTimeHistogram(metric_id, DefaultHistogram());
+    EXPECT_EQ(
+        JsonSerializer::DeserializeAndMerge(json_ser, metric_map, from_json),
+        TUNINGFORK_ERROR_OK);
+    Session from_binary{};
+    from_binary.CreateFrameTimeHistogram(metric_id, DefaultHistogram());
+    EXPECT_EQ(BinarySerializer::DeserializeAndMerge(binary_ser, metric_map,
+                                                    from_binary),
+              TUNINGFORK_ERROR_OK);
+    CheckSessions(from_binary, from_json);
+    CheckSessions(from_binary, session);
+    // The 33ms and 100ms frames are janky.
+    EXPECT_EQ(p->jank_.janky_frames_, 2);
+    CheckJank(from_binary, from_json);
+    CheckJank(from_binary, session);
+
+    // Truncated or garbled data is rejected, as are later versions.
+    Session session1{};
+    session1.CreateFrameTimeHistogram(metric_id, DefaultHistogram());
+    EXPECT_EQ(BinarySerializer::DeserializeAndMerge(
+                  binary_ser.substr(0, binary_ser.size() - 1), metric_map,
+                  session1),
+              TUNINGFORK_ERROR_BAD_PARAMETER);
+    EXPECT_EQ(BinarySerializer::DeserializeAndMerge(json_ser, metric_map,
+                                                    session1),
+              TUNINGFORK_ERROR_BAD_PARAMETER);
+    // The loading breakdown is written and read back: a version 2 reader
+    // doesn't expect it and is left with unread data.
+    std::string v2_ser = binary_ser;
+    v2_ser[BinarySerializer::kMagicSize - 1] = 2;
+    EXPECT_EQ(
+        BinarySerializer::DeserializeAndMerge(v2_ser, metric_map, session1),
+        TUNINGFORK_ERROR_BAD_PARAMETER);
+    std::string other_ser;
+    l->breakdown_.stages[LoadingTimeMetadata::NETWORK].critical_path =
+        milliseconds(1000);
+    BinarySerializer(session, &metric_map)
+        .SerializeEvent(test_device_info, other_ser);
+    EXPECT_EQ(other_ser.size(), binary_ser.size());
+    EXPECT_NE(other_ser, binary_ser);
+    l->breakdown_.Clear();
+    BinarySerializer(session, &metric_map)
+        .SerializeEvent(test_device_info, other_ser);
+    EXPECT_EQ(BinarySerializer::DeserializeAndMerge(other_ser, metric_map,
+                                                    session1),
+              TUNINGFORK_ERROR_OK);
+    EXPECT_LT(other_ser.size(), binary_ser.size());
+    binary_ser[BinarySerializer::kMagicSize - 1]++;
+    EXPECT_FALSE(BinarySerializer::IsBinary(binary_ser));
+}
+
+TEST(SerializationTest, BinaryLogLinearRoundTrip) {
+    Session session{};
+    MetricId metric_id{0};
+    Settings::Histogram log_linear_histogram{
+        -1, 10, 40, 0, Settings::Histogram::Scale::LOG_LINEAR, 2};
+    session.CreateFrameTimeHistogram(metric_id, log_linear_histogram);
+    auto p = session.GetData<FrameTimeMetricData>(metric_id);
+    p->Record(milliseconds(12));
+    p->Record(milliseconds(30));
+    IdMap metric_map;
+    std::string json_ser, binary_ser;
+    JsonSerializer(session, &metric_map)
+        .SerializeEvent(test_device_info, json_ser);
+    BinarySerializer(session, &metric_map)
+        .SerializeEvent(test_device_info, binary_ser);
+    Session from_json{};
+    from_json.CreateFrameTimeHistogram(metric_id, log_linear_histogram);
+    EXPECT_EQ(
+        JsonSerializer::DeserializeAndMerge(json_ser, metric_map, from_json),
+        TUNINGFORK_ERROR_OK);
+    Session from_binary{};
+    from_binary.CreateFrameTimeHistogram(metric_id, log_linear_histogram);
+    EXPECT_EQ(BinarySerializer::DeserializeAndMerge(binary_ser, metric_map,
+                                                    from_binary),
+              TUNINGFORK_ERROR_OK);
+    CheckSessions(from_binary, from_json);
+    // The counts don't make sense for linear buckets.
+    Session session2{};
+    session2.CreateFrameTimeHistogram(metric_id, {-1, 10, 40, 9});
+    EXPECT_EQ(BinarySerializer::DeserializeAndMerge(binary_ser, metric_map,
+                                                    session2),
+              TUNINGFORK_ERROR_BAD_PARAMETER);
+}
+
+TEST(SerializationTest, BinaryQuantileSketchRoundTrip) {
+    Session session{};
+    MetricId metric_id{0};
+    Settings::Histogram sketch_histogram{
+        -1, 0, 0, 100, Settings::Histogram::Scale::LINEAR, 0,
+        Settings::Histogram::Storage::QUANTILE_SKETCH};
+    session.CreateFrameTimeHistogram(metric_id, sketch_histogram);
+    auto p = session.GetData<FrameTimeMetricData>(metric_id);
+    for (int i = 0; i < 1000; ++i) p->Record(microseconds(16000 + i));
+    IdMap metric_map;
+    std::string json_ser, binary_ser;
+    JsonSerializer(session, &metric_map)
+        .SerializeEvent(test_device_info, json_ser);
+    BinarySerializer(session, &metric_map)
+        .SerializeEvent(test_device_info, binary_ser);
+    Session from_json{};
+    from_json.CreateFrameTimeHistogram(metric_id, sketch_histogram);
+    EXPECT_EQ(
+        JsonSerializer::DeserializeAndMerge(json_ser, metric_map, from_json),
+        TUNINGFORK_ERROR_OK);
+    Session from_binary{};
+    from_binary.CreateFrameTimeHistogram(metric_id, sketch_histogram);
+    EXPECT_EQ(BinarySerializer::DeserializeAndMerge(binary_ser, metric_map,
+                                                    from_binary),
+              TUNINGFORK_ERROR_OK);
+    auto pj = from_json.GetData<FrameTimeMetricData>(metric_id);
+    auto pb = from_binary.GetData<FrameTimeMetricData>(metric_id);
+    EXPECT_EQ(pb->quantiles_.Count(), pj->quantiles_.Count());
+    EXPECT_EQ(pb->quantiles_.Levels(), pj->quantiles_.Levels());
+    // A sketch can't be merged into histogram buckets.
+    Session session2{};
+    session2.CreateFrameTimeHistogram(metric_id, DefaultHistogram());
+    EXPECT_EQ(BinarySerializer::DeserializeAndMerge(binary_ser, metric_map,
+                                                    session2),
+              TUNINGFORK_ERROR_BAD_PARAMETER);
+}
+
 TEST(SerializationTest, DurationSerialization) {
     std::vector<double> ds = {1e19, 1e15, 1e10, 1e5,  1e0,   1e-1,
                               1e-3, 1e-5, 1e-8, 1e-9, 1e-10, 1e-15};
@@ -313,4 +604,274 @@ TEST(SerializationTest, DurationSerialization) {
     }
 }
 
+class RichIdMap : public IdMap {
+    TuningFork_ErrorCode AnnotationIdToSerializedAnnotation(
+        AnnotationId id, SerializedAnnotation& ann) override {
+        ann = SerializedAnnotation(id + 1, static_cast<uint8_t>(id + 0xf0));
+        return TUNINGFORK_ERROR_OK;
+    }
+    TuningFork_ErrorCode MetricIdToLoadingTimeMetadata(
+        MetricId id, LoadingTimeMetadataWithGroup& mg) override {
+        LoadingTimeMetadata& m = mg.metadata;
+        m = {};
+        if (id.detail.loading_time.metadata == 0) {
+            m.state = LoadingTimeMetadata::INTER_LEVEL;
+            m.source = LoadingTimeMetadata::MEMORY;
+            m.compression_level = 3;
+        } else {
+            m.source = LoadingTimeMetadata::NETWORK;
+            m.network_latency_ns = 1234567;
+            m.network_connectivity =
+                LoadingTimeMetadata::NetworkConnectivity::CELLULAR_NETWORK;
+            m.network_transfer_speed_bps = 12345678901234;
+            mg.group_id = "group\t\"1\"";
+        }
+        return TUNINGFORK_ERROR_OK;
+    }
+};
+
+// Only knows annotation 0.
+class PartialIdMap : public IdMap {
+    TuningFork_ErrorCode AnnotationIdToSerializedAnnotation(
+        AnnotationId id, SerializedAnnotation& ann) override {
+        if (id != 0) return TUNINGFORK_ERROR_INVALID_ANNOTATION;
+        ann = {1, 2, 3};
+        return TUNINGFORK_ERROR_OK;
+    }
+};
+
+TEST(SerializationTest, UnknownAnnotationIsWrittenEmpty) {
+    Session session{};
+    session.SetInstrumentationKeys({1234});
+    for (AnnotationId a = 0; a < 2; ++a) {
+        MetricId id = MetricId::FrameTime(a, 0);
+        session.CreateFrameTimeHistogram(id, Settings::DefaultHistogram(1));
+        session.GetData<FrameTimeMetricData>(id)->Record(milliseconds(10));
+    }
+    PartialIdMap id_map;
+    JsonSerializer serializer(session, &id_map);
+    std::string evt_ser;
+    serializer.SerializeEvent(test_device_info, evt_ser);
+    std::string err;
+    auto telemetry = Json::parse(evt_ser, err)["telemetry"];
+    ASSERT_TRUE(err.empty()) << err;
+    ASSERT_EQ(telemetry.array_items().size(), 2);
+    EXPECT_EQ(telemetry[0]["context"]["annotations"].string_value(), "AQID");
+    // Not the annotation written before it.
+    EXPECT_EQ(telemetry[1]["context"]["annotations"].string_value(), "");
+}
+
+// A session with one of everything the JSON serializer writes.
+void FillRichSession(Session& session) {
+    session.SetInstrumentationKeys({64000, 7, 1, 5});
+    session.Ping(SystemTimePoint(seconds(1646370367) + microseconds(123456)));
+    session.Ping(SystemTimePoint(seconds(1646370387) + microseconds(623456)));
+    Settings::Histogram linear{-1, 6.54f, 60, 20};
+    Settings::Histogram log_linear{
+        -1, 0.5f, 100, 0, Settings::Histogram::Scale::LOG_LINEAR, 1};
+    Settings::Histogram sketch{
+        -1, 0, 0, 8, Settings::Histogram::Scale::LINEAR, 0,
+        Settings::Histogram::Storage::QUANTILE_SKETCH};
+    Settings::Histogram sampled = linear;
+    sampled.sampling = Settings::Histogram::Sampling::EVERY_NTH;
+    sampled.sample_period = 3;
+    MetricId ft0 = MetricId::FrameTime(0, 0);
+    MetricId ft1 = MetricId::FrameTime(0, 1);
+    MetricId ft2 = MetricId::FrameTime(2, 2);
+    MetricId ft3 = MetricId::FrameTime(2, 3);
+    session.CreateFrameTimeHistogram(ft0, linear);
+    session.CreateFrameTimeHistogram(ft1, log_linear);
+    session.CreateFrameTimeHistogram(ft2, sketch);
+    session.CreateFrameTimeHistogram(ft3, sampled);
+    auto p0 = session.GetData<FrameTimeMetricData>(ft0);
+    TimePoint t{};
+    for (int i = 0; i < 200; ++i) {
+        t += microseconds(i % 17 == 0 ? 70000 : 16000 + 137 * (i % 5));
+        p0->Tick(t);
+    }
+    auto p1 = session.GetData<FrameTimeMetricData>(ft1);
+    for (int i = 0; i < 50; ++i) p1->Record(microseconds(900 + i * 1733));
+    auto p2 = session.GetData<FrameTimeMetricData>(ft2);
+    for (int i = 0; i < 40; ++i)
+        p2->Record(nanoseconds(16666667 + i * 1234567 % 9000001));
+    auto p3 = session.GetData<FrameTimeMetricData>(ft3);
+    for (int i = 0; i < 10; ++i) p3->Record(milliseconds(20 + i));
+
+    MetricId lt0 = MetricId::LoadingTime(0, 0);
+    MetricId lt1 = MetricId::LoadingTime(0, 1);
+    MetricId lt2 = MetricId::LoadingTime(2, 0);
+    session.CreateLoadingTimeSeries(lt0);
+    session.CreateLoadingTimeSeries(lt1);
+    session.CreateLoadingTimeSeries(lt2);
+    auto l0 = session.GetData<LoadingTimeMetricData>(lt0);
+    l0->Record(milliseconds(1500));
+    l0->Record(ProcessTimeInterval(milliseconds(100), nanoseconds(2100000001)));
+    auto l1 = session.GetData<LoadingTimeMetricData>(lt1);
+    l1->Record(nanoseconds(999999999999));
+    auto l2 = session.GetData<LoadingTimeMetricData>(lt2);
+    l2->Record(ProcessTimeInterval(seconds(3), seconds(3) + nanoseconds(7)));
+
+    MetricId b0 = MetricId::Battery(0);
+    MetricId th0 = MetricId::Thermal(2);
+    MetricId m0 = MetricId::Memory(0);
+    session.CreateBatteryTimeSeries(b0);
+    session.CreateThermalTimeSeries(th0);
+    session.CreateMemoryTimeSeries(m0);
+    auto& battery = session.GetData<BatteryMetricData>(b0)->data_;
+    battery.emplace_back(71, -4321, milliseconds(60010), true, false, true);
+    battery.emplace_back(70, 0, seconds(120), false, true, false);
+    session.GetData<ThermalMetricData>(th0)->data_.emplace_back(
+        IBatteryProvider::THERMAL_STATE_SEVERE, milliseconds(61234));
+    session.GetData<MemoryMetricData>(m0)->data_.emplace_back(
+        3000000001, 950, 123456789012, microseconds(5000001));
+    session.RecordCrash(SEGMENTATION_FAULT);
+    session.RecordCrash(LOW_MEMORY);
+}
+
+// Written by the JSON serializer before it streamed its output, split where
+// the fractions of seconds in the time period go.
+const char* kRichSession[] = {
+    R"TF({"name": "applications/packname/apks/0", )TF"
+    R"TF("session_context": {"crash_reports": [{"crash_reason": 2, )TF"
+    R"TF("session_id": "prev_sess"}, {"crash_reason": 1, )TF"
+    R"TF("session_id": "prev_sess"}], "device": {"brand": "BRAND", )TF"
+    R"TF("build_version": "6.3", "cpu_core_freqs_hz": [1, 2, 3], )TF"
+    R"TF("device": "DEVICE", "fingerprint": "fing", )TF"
+    R"TF("gles_version": {"major": 5, "minor": 21907}, "model": "MODEL", )TF"
+    R"TF("product": "PRODUCT", "soc_manufacturer": "SOC_MANUFACTURER", )TF"
+    R"TF("soc_model": "SOC_MODEL", "swap_total_bytes": 234, )TF"
+    R"TF("total_memory_bytes": 2387}, )TF"
+    R"TF("game_sdk_info": {"session_id": "sess", )TF"
+    R"TF("swappy_version": "2.7.0", "version": "0.10.0"}, )TF"
+    R"TF("time_period": {"end_time": "2022-03-04T05:06:27.)TF",
+    R"TF(Z", "start_time": "2022-03-04T05:06:07.)TF",
+    R"TF(Z"}}, "telemetry": [{"context": {"annotations": "8A==", )TF"
+    R"TF("duration": "999.999999999s", )TF"
+    R"TF("tuning_parameters": {"experiment_id": "ex\"p\\t\n\u0001\u2028",)TF"
+    R"TF( "serialized_fidelity_parameters": "/wB/"}}, )TF"
+    R"TF("report": {"battery": {"battery_event": [{"app_on_foreground": t)TF"
+    R"TF(rue, "charging": false, )TF"
+    R"TF("current_charge_microampere_hours": -4321, )TF"
+    R"TF("event_time": "60.01s", "percentage": 71, )TF"
+    R"TF("power_save_mode": true}, {"app_on_foreground": false, )TF"
+    R"TF("charging": true, "current_charge_microampere_hours": 0, )TF"
+    R"TF("event_time": "120s", "percentage": 70, )TF"
+    R"TF("power_save_mode": false}]}, )TF"
+    R"TF("loading": {"loading_events": [{"loading_metadata": {"group_id":)TF"
+    R"TF( "group\t\"1\"", )TF"
+    R"TF("network_info": {"bandwidth_bps": "12345678901234", )TF"
+    R"TF("connectivity": 2, "latency": "0.001234567s"}, "source": 5}, )TF"
+    R"TF("times_ms": [999999]}, {"intervals": [{"end": "2.100000001s", )TF"
+    R"TF("start": "0.1s"}], "loading_metadata": {"compression_level": 3, )TF"
+    R"TF("source": 1, "state": 5}, "times_ms": [1500]}]}, )TF"
+    R"TF("memory": {"memory_event": [{"avail_mem": 3000000001, )TF"
+    R"TF("event_time": "5.000001s", "oom_score": 950, )TF"
+    R"TF("proportional_set_size": 123456789012}]}, )TF"
+    R"TF("rendering": {"render_time_histogram": [{"counts": [0, 0, 0, 0, )TF"
+    R"TF(188, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 11], )TF"
+    R"TF("instrument_id": 64000, "jank": {"big_janks": "11", )TF"
+    R"TF("frames": "199", "janky_frames": "11", "longest_run": "1", )TF"
+    R"TF("missed_frames": "33", "runs": ["11", "0", "0", "0", "0"], )TF"
+    R"TF("stutter_clusters": "0"}}, {"counts": [0, 0, 1, 0, 0, 1, 0, 1, )TF"
+    R"TF(2, 2, 2, 5, 4, 10, 9, 13, 0, 0], "instrument_id": 7, )TF"
+    R"TF("jank": {"big_janks": "16", "frames": "50", )TF"
+    R"TF("janky_frames": "36", "longest_run": "36", )TF"
+    R"TF("missed_frames": "85", "runs": ["0", "0", "0", "0", "1"], )TF"
+    R"TF("stutter_clusters": "12"}, )TF"
+    R"TF("log_linear_buckets": {"start": 0.5, )TF"
+    R"TF("sub_bucket_bits": 1}}]}}}, {"context": {"annotations": "8vLy", )TF"
+    R"TF("duration": "0.837628852s", )TF"
+    R"TF("tuning_parameters": {"experiment_id": "ex\"p\\t\n\u0001\u2028",)TF"
+    R"TF( "serialized_fidelity_parameters": "/wB/"}}, )TF"
+    R"TF("report": {"loading": {"loading_events": [{"intervals": [{"end":)TF"
+    R"TF( "3.000000007s", "start": "3s"}], )TF"
+    R"TF("loading_metadata": {"compression_level": 3, "source": 1, )TF"
+    R"TF("state": 5}}]}, )TF"
+    R"TF("rendering": {"render_time_histogram": [{"instrument_id": 1, )TF"
+    R"TF("jank": {"big_janks": "0", "frames": "40", "janky_frames": "3", )TF"
+    R"TF("longest_run": "1", "missed_frames": "3", )TF"
+    R"TF("runs": ["3", "0", "0", "0", "0"], "stutter_clusters": "1"}, )TF"
+    R"TF("quantile_sketch": {"count": "40", "k": 8, )TF"
+    R"TF("levels": [[25.469106674194336, 19.814775466918945], )TF"
+    R"TF([16.827138900756836, 17.703672409057617, 18.580207824707031, )TF"
+    R"TF(19.296272277832031, 20.530839920043945, 21.765405654907227, )TF"
+    R"TF(22.999973297119141, 23.876508712768555, 24.592571258544922], )TF"
+    R"TF([17.185169219970703, 18.419736862182617, 20.370367050170898, )TF"
+    R"TF(22.123437881469727, 23.716037750244141]]}}, {"counts": [0, 0, )TF"
+    R"TF(0, 0, 0, 0, 9, 9, 6, 6, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0], )TF"
+    R"TF("instrument_id": 5, "sample_period": 3}]}, )TF"
+    R"TF("thermal": {"thermal_event": [{"event_time": "61.234s", )TF"
+    R"TF("thermal_state": 4}]}}}]})TF"};
+
+const char* kRichLifecycle[] = {
+    R"TF({"name": "applications/packname/apks/0", )TF"
+    R"TF("session_context": {"crash_reports": [{"crash_reason": 2, )TF"
+    R"TF("session_id": "prev_sess"}, {"crash_reason": 1, )TF"
+    R"TF("session_id": "prev_sess"}], "device": {"brand": "BRAND", )TF"
+    R"TF("build_version": "6.3", "cpu_core_freqs_hz": [1, 2, 3], )TF"
+    R"TF("device": "DEVICE", "fingerprint": "fing", )TF"
+    R"TF("gles_version": {"major": 5, "minor": 21907}, "model": "MODEL", )TF"
+    R"TF("product": "PRODUCT", "soc_manufacturer": "SOC_MANUFACTURER", )TF"
+    R"TF("soc_model": "SOC_MODEL", "swap_total_bytes": 234, )TF"
+    R"TF("total_memory_bytes": 2387}, )TF"
+    R"TF("game_sdk_info": {"session_id": "sess", )TF"
+    R"TF("swappy_version": "2.7.0", "version": "0.10.0"}, )TF"
+    R"TF("time_period": {"end_time": "2022-03-04T05:06:27.)TF",
+    R"TF(Z", "start_time": "2022-03-04T05:06:07.)TF",
+    R"TF(Z"}}, "telemetry": [{"context": {"annotations": "8A==", )TF"
+    R"TF("duration": "1s", )TF"
+    R"TF("tuning_parameters": {"experiment_id": "ex\"p\\t\n\u0001\u2028",)TF"
+    R"TF( "serialized_fidelity_parameters": "/wB/"}}, )TF"
+    R"TF("report": {"partial_loading": {"event_type": 2, )TF"
+    R"TF("report": {"loading_events": [{"intervals": [{"end": "1.25s", )TF"
+    R"TF("start": "0.25s"}], )TF"
+    R"TF("loading_metadata": {"group_id": "group\t\"1\"", )TF"
+    R"TF("network_info": {"bandwidth_bps": "12345678901234", )TF"
+    R"TF("connectivity": 2, "latency": "0.001234567s"}, )TF"
+    R"TF("source": 5}}]}}}}, {"context": {"annotations": "8vLy", )TF"
+    R"TF("duration": "1.000000001s", )TF"
+    R"TF("tuning_parameters": {"experiment_id": "ex\"p\\t\n\u0001\u2028",)TF"
+    R"TF( "serialized_fidelity_parameters": "/wB/"}}, )TF"
+    R"TF("report": {"partial_loading": {"event_type": 2, )TF"
+    R"TF("report": {"loading_events": [{"intervals": [{"end": "2.00000000)TF"
+    R"TF(1s", "start": "1s"}], )TF"
+    R"TF("loading_metadata": {"compression_level": 3, "source": 1, )TF"
+    R"TF("state": 5}}]}}}}]})TF"};
+
+// Fractions of a second are written to the precision of system_clock.
+std::string Fraction(const std::string& micros) {
+    size_t digits = 0;
+    for (auto den = system_clock::period::den; den > 1; den /= 10) ++digits;
+    return (micros + "000").substr(0, digits);
+}
+
+std::string Golden(const char* const parts[3]) {
+    return parts[0] + Fraction("623456") + parts[1] + Fraction("123456") +
+           parts[2];
+}
+
+TEST(SerializationTest, RichSessionGolden) {
+    Session session{};
+    FillRichSession(session);
+    RichIdMap id_map;
+    RequestInfo info = test_device_info;
+    info.experiment_id = "ex\"p\\t\n\x01\xe2\x80\xa8";
+    info.current_fidelity_parameters = {0xff, 0x00, 0x7f};
+    JsonSerializer serializer(session, &id_map);
+    std::string evt_ser;
+    serializer.SerializeEvent(info, evt_ser);
+    EXPECT_EQ(evt_ser, Golden(kRichSession));
+    std::string err;
+    EXPECT_EQ(Json::parse(evt_ser, err).dump(), evt_ser) << err;
+    LifecycleUploadEvent event{TUNINGFORK_STATE_ONSTOP, {}};
+    event.loading_events.push_back(
+        {MetricId::LoadingTime(0, 1),
+         ProcessTimeInterval(milliseconds(250), milliseconds(1250))});
+    event.loading_events.push_back(
+        {MetricId::LoadingTime(2, 0),
+         ProcessTimeInterval(seconds(1), seconds(2) + nanoseconds(1))});
+    serializer.SerializeLifecycleEvent(event, info, evt_ser);
+    EXPECT_EQ(evt_ser, Golden(kRichLifecycle));
+}
+
 }  // namespace serialization_test
@@ -0,0 +1,200 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "core/session_ring.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include "core/backend.h"
+#include "gtest/gtest.h"
+
+namespace session_ring_test {
+
+using namespace tuningfork;
+
+constexpr int kFlushes = 1000;
+constexpr int kFramesPerFlush = 10;
+
+// A backend that takes a while to upload each session, which is just the
+// number of frame times in it.
+class SlowBackend : public IBackend {
+   public:
+    std::atomic<uint64_t> frames{0};
+    std::atomic<int> uploads{0};
+
+    TuningFork_ErrorCode UploadTelemetry(const std::string& s) override {
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+        frames += std::stoull(s);
+        ++uploads;
+        return TUNINGFORK_ERROR_OK;
+    }
+    TuningFork_ErrorCode GenerateTuningParameters(
+        HttpRequest& request, const ProtobufSerialization* training_mode_fps,
+        ProtobufSerialization& fidelity_params,
+        std::string& experiment_id) override {
+        return TUNINGFORK_ERROR_OK;
+    }
+    TuningFork_ErrorCode UploadDebugInfo(HttpRequest& request) override {
+        return TUNINGFORK_ERROR_OK;
+    }
+    void Stop() override {}
+};
+
+MetricId FrameTimeId() { return MetricId::FrameTime(0, 0); }
+
+uint64_t FrameCount(const Session& session) {
+    uint64_t n = 0;
+    for (auto h : session.GetNonEmptyHistograms<FrameTimeMetricData>())
+        n += h->Count();
+    return n;
+}
+
+std::unique_ptr<SessionRing> MakeRing(size_t n_slots,
+                                      Settings::SessionBackpressure policy) {
+    Settings::Histogram settings{0, 0, 100, 50};
+    std::vector<std::unique_ptr<Session>> sessions;
+    for (size_t i = 0; i < n_slots; ++i) {
+        sessions.push_back(std::make_unique<Session>());
+        sessions.back()->CreateFrameTimeHistogram(FrameTimeId(), settings);
+    }
+    return std::make_unique<SessionRing>(std::move(sessions), policy,
+                                         std::chrono::seconds(10));
+}
+
+struct FlushResult {
+    uint64_t uploaded;
+    uint64_t dropped_sessions;
+    int failed_submits;
+};
+
+// Record frames and flush kFlushes times while another thread, standing in
+// for the upload thread, serializes sessions and sends them to a slow backend.
+FlushResult RunFlushes(Settings::SessionBackpressure policy) {
+    auto ring = MakeRing(4, policy);
+    SlowBackend backend;
+    std::atomic<bool> done(false);
+    std::thread uploader([&]() {
+        bool upload;
+        while (true) {
+            auto session = ring->Front(upload);
+            if (session == nullptr) {
+                if (done) break;
+                std::this_thread::yield();
+                continue;
+            }
+            auto ser = std::to_string(FrameCount(*session));
+            ring->Release();
+            backend.UploadTelemetry(ser);
+        }
+    });
+    int failed_submits = 0;
+    for (int i = 0; i < kFlushes; ++i) {
+        auto data =
+            ring->Current()->GetData<FrameTimeMetricData>(FrameTimeId());
+        for (int j = 0; j < kFramesPerFlush; ++j)
+            data->Record(std::chrono::milliseconds(16));
+        if (ring->Submit(true) != TUNINGFORK_ERROR_OK) ++failed_submits;
+    }
+    // Data left in the current session goes with one last flush.
+    while (FrameCount(*ring->Current()) > 0 &&
+           ring->Submit(true) != TUNINGFORK_ERROR_OK)
+        std::this_thread::yield();
+    while (ring->NumQueued() > 0) std::this_thread::yield();
+    done = true;
+    uploader.join();
+    return {backend.frames, ring->DroppedSessions(), failed_submits};
+}
+
+TEST(SessionRingTest, MergeIntoPendingKeepsAllFrames) {
+    auto result =
+        RunFlushes(Settings::SessionBackpressure::MERGE_INTO_PENDING);
+    EXPECT_EQ(result.uploaded, kFlushes * kFramesPerFlush);
+    EXPECT_EQ(result.dropped_sessions, 0);
+}
+
+TEST(SessionRingTest, BlockKeepsAllFrames) {
+    auto result = RunFlushes(Settings::SessionBackpressure::BLOCK);
+    EXPECT_EQ(result.uploaded, kFlushes * kFramesPerFlush);
+    EXPECT_EQ(result.dropped_sessions, 0);
+    EXPECT_EQ(result.failed_submits, 0);
+}
+
+TEST(SessionRingTest, DropOldestDropsSessions) {
+    auto result = RunFlushes(Settings::SessionBackpressure::DROP_OLDEST);
+    EXPECT_GT(result.dropped_sessions, 0);
+    EXPECT_LT(result.uploaded, kFlushes * kFramesPerFlush);
+    EXPECT_EQ(result.uploaded % kFramesPerFlush, 0);
+}
+
+TEST(SessionRingTest, RecyclesSessions) {
+    auto ring = MakeRing(3, Settings::SessionBackpressure::BLOCK);
+    Session* first = ring->Current();
+    first->GetData<FrameTimeMetricData>(FrameTimeId())
+        ->Record(std::chrono::milliseconds(16));
+    EXPECT_EQ(ring->Submit(false), TUNINGFORK_ERROR_OK);
+    EXPECT_NE(ring->Current(), first);
+    EXPECT_EQ(ring->NumQueued(), 1);
+    bool upload = true;
+    EXPECT_EQ(ring->Front(upload), first);
+    EXPECT_FALSE(upload);
+    EXPECT_EQ(FrameCount(*first), 1);
+    ring->Release();
+    EXPECT_EQ(FrameCount(*first), 0);
+    EXPECT_EQ(ring->Front(upload), nullptr);
+    // The most recently released session is reused first.
+    EXPECT_EQ(ring->Submit(true), TUNINGFORK_ERROR_OK);
+    EXPECT_EQ(ring->Current(), first);
+}
+
+TEST(SessionRingTest, KeepsDataWhenOnlySessionIsUploading) {
+    auto ring = MakeRing(2, Settings::SessionBackpressure::MERGE_INTO_PENDING);
+    EXPECT_EQ(ring->Submit(true), TUNINGFORK_ERROR_OK);
+    bool upload;
+    ASSERT_NE(ring->Front(upload), nullptr);
+    ring->Current()
+        ->GetData<FrameTimeMetricData>(FrameTimeId())
+        ->Record(std::chrono::milliseconds(16));
+    EXPECT_EQ(ring->Submit(true), TUNINGFORK_ERROR_PREVIOUS_UPLOAD_PENDING);
+    EXPECT_EQ(FrameCount(*ring->Current()), 1);
+    ring->Release();
+    EXPECT_EQ(ring->Submit(true), TUNINGFORK_ERROR_OK);
+}
+
+TEST(SessionRingTest, MergeKeepsUploads) {
+    auto ring = MakeRing(2, Settings::SessionBackpressure::MERGE_INTO_PENDING);
+    auto record = [&]() {
+        ring->Current()
+            ->GetData<FrameTimeMetricData>(FrameTimeId())
+            ->Record(std::chrono::milliseconds(16));
+    };
+    record();
+    EXPECT_EQ(ring->Submit(true), TUNINGFORK_ERROR_OK);
+    // Saving data merged into a session waiting to be uploaded mustn't stop
+    // the upload.
+    record();
+    EXPECT_EQ(ring->Submit(false), TUNINGFORK_ERROR_OK);
+    EXPECT_EQ(ring->NumQueued(), 1);
+    bool upload = false;
+    auto session = ring->Front(upload);
+    ASSERT_NE(session, nullptr);
+    EXPECT_TRUE(upload);
+    EXPECT_EQ(FrameCount(*session), 2);
+    EXPECT_EQ(FrameCount(*ring->Current()), 0);
+}
+
+}  // namespace session_ring_test
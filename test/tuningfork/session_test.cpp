@@ -0,0 +1,112 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "core/session.h"
+
+#include <set>
+
+#include "gtest/gtest.h"
+
+namespace session_test {
+
+using namespace tuningfork;
+
+constexpr int kIkeys = 4;
+
+void CreateHistograms(Session& session, int n) {
+    for (int i = 0; i < n; ++i) {
+        session.CreateFrameTimeHistogram(MetricId::FrameTime(0, i % kIkeys),
+                                         Settings::DefaultHistogram(1));
+    }
+}
+
+TEST(SessionTest, SameIdGivesSameData) {
+    Session session;
+    CreateHistograms(session, 3 * kIkeys);
+    auto a = session.GetData<FrameTimeMetricData>(MetricId::FrameTime(1, 2));
+    auto b = session.GetData<FrameTimeMetricData>(MetricId::FrameTime(2, 1));
+    ASSERT_NE(a, nullptr);
+    ASSERT_NE(b, nullptr);
+    EXPECT_NE(a, b);
+    EXPECT_EQ(a, session.GetData<FrameTimeMetricData>(
+                     MetricId::FrameTime(1, 2)));
+    EXPECT_EQ(a->metric_id_, MetricId::FrameTime(1, 2));
+    // There is no data for an instrument key that wasn't created.
+    EXPECT_EQ(session.GetData<FrameTimeMetricData>(
+                  MetricId::FrameTime(1, kIkeys)),
+              nullptr);
+}
+
+TEST(SessionTest, RunsOutOfDataPerInstrumentKey) {
+    Session session;
+    CreateHistograms(session, 2 * kIkeys);
+    EXPECT_NE(session.GetData<FrameTimeMetricData>(MetricId::FrameTime(1, 0)),
+              nullptr);
+    EXPECT_NE(session.GetData<FrameTimeMetricData>(MetricId::FrameTime(2, 0)),
+              nullptr);
+    EXPECT_EQ(session.GetData<FrameTimeMetricData>(MetricId::FrameTime(3, 0)),
+              nullptr);
+    EXPECT_NE(session.GetData<FrameTimeMetricData>(MetricId::FrameTime(3, 1)),
+              nullptr);
+}
+
+TEST(SessionTest, IteratesNonEmptyData) {
+    Session session;
+    CreateHistograms(session, 100 * kIkeys);
+    std::set<uint64_t> recorded;
+    // Include an annotation too large for the dense layout.
+    for (AnnotationId a : {1u, 7u, 64u, 65u, 99u, 1u << 23}) {
+        auto id = MetricId::FrameTime(a, a % kIkeys);
+        session.GetData<FrameTimeMetricData>(id)->Record(
+            std::chrono::milliseconds(10));
+        recorded.insert(id.base);
+    }
+    // Taken but empty.
+    session.GetData<FrameTimeMetricData>(MetricId::FrameTime(5, 0));
+    std::set<uint64_t> found;
+    for (auto d : session.GetNonEmptyHistograms<FrameTimeMetricData>())
+        found.insert(d->metric_id_.base);
+    EXPECT_EQ(found, recorded);
+
+    session.ClearData();
+    EXPECT_TRUE(session.GetNonEmptyHistograms<FrameTimeMetricData>().empty());
+    // All the data is available again.
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_NE(session.GetData<FrameTimeMetricData>(
+                      MetricId::FrameTime(i, 0)),
+                  nullptr);
+    }
+}
+
+TEST(SessionTest, MergesDenseData) {
+    Session a, b;
+    CreateHistograms(a, 10 * kIkeys);
+    CreateHistograms(b, 10 * kIkeys);
+    for (int i = 0; i < 10; ++i) {
+        b.GetData<FrameTimeMetricData>(MetricId::FrameTime(i, 3))
+            ->Record(std::chrono::milliseconds(10));
+    }
+    a.GetData<FrameTimeMetricData>(MetricId::FrameTime(0, 3))
+        ->Record(std::chrono::milliseconds(10));
+    EXPECT_EQ(a.Merge(b), TUNINGFORK_ERROR_OK);
+    auto merged = a.GetNonEmptyHistograms<FrameTimeMetricData>();
+    EXPECT_EQ(merged.size(), 10);
+    EXPECT_EQ(a.GetData<FrameTimeMetricData>(MetricId::FrameTime(0, 3))
+                  ->Count(),
+              2);
+}
+
+}  // namespace session_test
@@ -26,10 +26,28 @@ namespace tf = tuningfork;
 
 /*
 message Histogram {
+        enum Scale {
+            LINEAR = 0;
+            LOG_LINEAR = 1;
+        }
         optional int32 instrument_key = 1;
         optional float bucket_min = 2;
         optional float bucket_max = 3;
         optional int32 n_buckets = 4;
+        enum Storage {
+            HISTOGRAM = 0;
+            QUANTILE_SKETCH = 1;
+        }
+        optional Scale scale = 5;
+        optional int32 sub_bucket_bits = 6;
+        optional Storage storage = 7;
+        enum Sampling {
+            ALL = 0;
+            EVERY_NTH = 1;
+            RANDOM = 2;
+        }
+        optional Sampling sampling = 8;
+        optional int32 sample_period = 9;
 }
 message AggregationStrategy {
         enum Submission {
@@ -47,7 +65,10 @@ message AggregationStrategy {
 bool operator==(const tf::Settings::Histogram& a,
                 const tf::Settings::Histogram& b) {
     return a.bucket_max == b.bucket_max && a.bucket_min == b.bucket_min &&
-           a.n_buckets == b.n_buckets && a.instrument_key == b.instrument_key;
+           a.n_buckets == b.n_buckets && a.instrument_key == b.instrument_key &&
+           a.scale == b.scale && a.sub_bucket_bits == b.sub_bucket_bits &&
+           a.storage == b.storage && a.sampling == b.sampling &&
+           a.sample_period == b.sample_period;
 }
 
 TEST(SettingsTest, Deserialize) {
@@ -75,8 +96,29 @@ TEST(SettingsTest, Deserialize) {
     h->set_bucket_max(35);
     h->set_n_buckets(1);
     h->set_instrument_key(64000);
+    h = histograms->Add();
+    h->set_bucket_min(1);
+    h->set_bucket_max(500);
+    h->set_instrument_key(64001);
+    h->set_scale(Settings_Histogram_Scale_LOG_LINEAR);
+    h->set_sub_bucket_bits(3);
+    h = histograms->Add();
+    h->set_n_buckets(100);
+    h->set_instrument_key(64002);
+    h->set_storage(Settings_Histogram_Storage_QUANTILE_SKETCH);
+    h->set_sampling(Settings_Histogram_Sampling_RANDOM);
+    h->set_sample_period(8);
     settings_proto.set_base_uri(base_uri);
     settings_proto.set_api_key(api_key);
+    settings_proto.set_telemetry_encoding(Settings_TelemetryEncoding_BINARY);
+    settings_proto.set_upload_compression_threshold_bytes(-1);
+    settings_proto.set_max_upload_queue_bytes(4096);
+    settings_proto.set_local_cache(Settings_LocalCache_MAPPED_LOG);
+    settings_proto.set_session_slots(4);
+    settings_proto.set_session_backpressure(Settings_SessionBackpressure_BLOCK);
+    settings_proto.set_rollup_slot_ms(60000);
+    settings_proto.set_rollup_upload_level(
+        Settings_RollupUploadLevel_TEN_SLOTS);
     settings_ser.resize(settings_proto.ByteSize());
     settings_proto.SerializeWithCachedSizesToArray(settings_ser.data());
     tf::Settings settings{};
@@ -84,6 +126,17 @@ TEST(SettingsTest, Deserialize) {
     EXPECT_EQ(result, TUNINGFORK_ERROR_OK);
     EXPECT_EQ(settings.api_key, api_key);
     EXPECT_EQ(settings.base_uri, base_uri);
+    EXPECT_EQ(settings.telemetry_encoding,
+              tf::Settings::TelemetryEncoding::BINARY);
+    EXPECT_EQ(settings.upload_compression_threshold_bytes, -1);
+    EXPECT_EQ(settings.max_upload_queue_bytes, 4096);
+    EXPECT_EQ(settings.local_cache, tf::Settings::LocalCache::MAPPED_LOG);
+    EXPECT_EQ(settings.session_slots, 4);
+    EXPECT_EQ(settings.session_backpressure,
+              tf::Settings::SessionBackpressure::BLOCK);
+    EXPECT_EQ(settings.rollup_slot_ms, 60000);
+    EXPECT_EQ(settings.rollup_upload_level,
+              tf::Settings::RollupUploadLevel::TEN_SLOTS);
     EXPECT_EQ(settings.aggregation_strategy.method,
               tf::Settings::AggregationStrategy::Submission::TICK_BASED);
     EXPECT_EQ(settings.aggregation_strategy.intervalms_or_count,
@@ -96,7 +149,7 @@ TEST(SettingsTest, Deserialize) {
         EXPECT_TRUE(settings.aggregation_strategy.annotation_enum_size[ix++] ==
                     i);
     }
-    ASSERT_EQ(settings.histograms.size(), 1);
+    ASSERT_EQ(settings.histograms.size(), 3);
     // For some reason, the operator== doesn't work in EXPECT_EQ, so use
     // EXPECT_TRUE
     EXPECT_TRUE(settings.histograms[0] == (tf::Settings::Histogram{
@@ -105,6 +158,27 @@ TEST(SettingsTest, Deserialize) {
                                               35,     // bucket_max;
                                               1       // n_buckets;
                                           }));
+    EXPECT_TRUE(settings.histograms[1] ==
+                (tf::Settings::Histogram{
+                    64001,  // instrument_key
+                    1,      // bucket_min
+                    500,    // bucket_max;
+                    0,      // n_buckets;
+                    tf::Settings::Histogram::Scale::LOG_LINEAR,  // scale
+                    3  // sub_bucket_bits
+                }));
+    EXPECT_TRUE(settings.histograms[2] ==
+                (tf::Settings::Histogram{
+                    64002,  // instrument_key
+                    0,      // bucket_min
+                    0,      // bucket_max;
+                    100,    // n_buckets;
+                    tf::Settings::Histogram::Scale::LINEAR,  // scale
+                    0,  // sub_bucket_bits
+                    tf::Settings::Histogram::Storage::QUANTILE_SKETCH,  // storage
+                    tf::Settings::Histogram::Sampling::RANDOM,  // sampling
+                    8  // sample_period
+                }));
     // Check overriding the api key
     settings.c_settings.api_key = overridden_api_key.c_str();
     result = tf::Settings::DeserializeSettings(settings_ser, &settings);
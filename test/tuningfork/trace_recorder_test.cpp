@@ -0,0 +1,246 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "trace_recorder.h"
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <json11/json11.hpp>
+#include <map>
+#include <string>
+#include <thread>
+
+namespace trace_recorder_test {
+
+using gamesdk::TraceRecorder;
+using json11::Json;
+using EventType = TraceRecorder::EventType;
+
+// Start recording with nothing left over from other tests.
+void StartClean(size_t events_per_thread) {
+    TraceRecorder::Start(events_per_thread);
+    TraceRecorder::Drain();
+}
+
+const TraceRecorder::ThreadEvents* FindThread(
+    const std::vector<TraceRecorder::ThreadEvents>& threads, int32_t tid) {
+    for (auto& thread : threads)
+        if (thread.tid == tid) return &thread;
+    return nullptr;
+}
+
+// A slice of the work done in the tests, on the calling thread.
+void Work(int n) {
+    TraceRecorder::Begin("outer");
+    for (int i = 0; i < n; ++i) {
+        TraceRecorder::Begin("inner");
+        TraceRecorder::Counter("count", i);
+        TraceRecorder::End();
+    }
+    TraceRecorder::End();
+}
+
+int32_t RecordOnThread(int n) {
+    int32_t tid = 0;
+    std::thread t([&]() {
+        tid = gettid();
+        Work(n);
+    });
+    t.join();
+    return tid;
+}
+
+TEST(TraceRecorderTest, RecordsEachThread) {
+    StartClean(64);
+    Work(2);
+    int32_t other = RecordOnThread(3);
+    TraceRecorder::Stop();
+    Work(1);
+    auto threads = TraceRecorder::Drain();
+
+    auto main_thread = FindThread(threads, gettid());
+    ASSERT_NE(main_thread, nullptr);
+    std::vector<EventType> expected = {
+        EventType::BEGIN,   EventType::BEGIN, EventType::COUNTER,
+        EventType::END,     EventType::BEGIN, EventType::COUNTER,
+        EventType::END,     EventType::END};
+    ASSERT_EQ(main_thread->events.size(), expected.size());
+    for (size_t i = 0; i < expected.size(); ++i)
+        EXPECT_EQ(main_thread->events[i].type, expected[i]) << i;
+    EXPECT_STREQ(main_thread->events[0].name, "outer");
+    EXPECT_STREQ(main_thread->events[1].name, "inner");
+    EXPECT_EQ(main_thread->events[5].value, 1);
+    for (size_t i = 1; i < expected.size(); ++i)
+        EXPECT_LE(main_thread->events[i - 1].time_ns,
+                  main_thread->events[i].time_ns);
+    EXPECT_EQ(main_thread->dropped, 0);
+
+    auto other_thread = FindThread(threads, other);
+    ASSERT_NE(other_thread, nullptr);
+    EXPECT_EQ(other_thread->events.size(), 2 + 3 * 3);
+
+    // Everything was drained, and the exited thread's buffer freed.
+    EXPECT_TRUE(TraceRecorder::Drain().empty());
+}
+
+TEST(TraceRecorderTest, DropsEventsWhenFull) {
+    StartClean(8);
+    // The buffer for this thread may have been made by an earlier test.
+    int32_t tid = RecordOnThread(10);
+    TraceRecorder::Stop();
+    auto threads = TraceRecorder::Drain();
+    auto thread = FindThread(threads, tid);
+    ASSERT_NE(thread, nullptr);
+    ASSERT_EQ(thread->events.size(), 8);
+    // Of the 32 events, the Ends of the 7 sections whose Begin was dropped
+    // aren't recorded or counted.
+    EXPECT_EQ(thread->dropped, 32 - 8 - 7);
+    EXPECT_EQ(thread->events.back().type, EventType::BEGIN);
+}
+
+TEST(TraceRecorderTest, IgnoresUnmatchedEnds) {
+    TraceRecorder::Begin("before");
+    StartClean(64);
+    TraceRecorder::End();
+    TraceRecorder::Begin("a");
+    TraceRecorder::End();
+    TraceRecorder::End();
+    TraceRecorder::Stop();
+    auto threads = TraceRecorder::Drain();
+    auto thread = FindThread(threads, gettid());
+    ASSERT_NE(thread, nullptr);
+    ASSERT_EQ(thread->events.size(), 2);
+    EXPECT_EQ(thread->events[0].type, EventType::BEGIN);
+    EXPECT_EQ(thread->events[1].type, EventType::END);
+}
+
+TEST(TraceRecorderTest, WritesChromeJson) {
+    StartClean(64);
+    TraceRecorder::Begin("say \"hi\"\n");
+    TraceRecorder::Counter("count", -5);
+    TraceRecorder::End();
+    TraceRecorder::Stop();
+    auto threads = TraceRecorder::Drain();
+    std::string s;
+    TraceRecorder::WriteChromeJson(threads, s);
+    std::string err;
+    Json json = Json::parse(s, err);
+    ASSERT_TRUE(err.empty()) << err << ": " << s;
+    auto& events = json["traceEvents"].array_items();
+    ASSERT_EQ(events.size(), 4);
+    EXPECT_EQ(events[0]["ph"].string_value(), "M");
+    EXPECT_EQ(events[1]["ph"].string_value(), "B");
+    EXPECT_EQ(events[1]["name"].string_value(), "say \"hi\"\n");
+    EXPECT_EQ(events[1]["tid"].int_value(), gettid());
+    EXPECT_EQ(events[2]["ph"].string_value(), "C");
+    EXPECT_EQ(events[2]["args"]["value"].int_value(), -5);
+    EXPECT_EQ(events[3]["ph"].string_value(), "E");
+    EXPECT_NEAR(events[1]["ts"].number_value(),
+                threads[0].events[0].time_ns / 1000.0, 0.001);
+}
+
+// Just enough of the protobuf wire format to check the trace's structure.
+struct Field {
+    uint32_t number;
+    uint64_t value;
+    std::string bytes;
+};
+
+bool ReadVarint(const std::string& s, size_t& pos, uint64_t& x) {
+    x = 0;
+    for (int shift = 0; pos < s.size() && shift < 64; shift += 7) {
+        uint8_t b = s[pos++];
+        x |= uint64_t(b & 0x7f) << shift;
+        if ((b & 0x80) == 0) return true;
+    }
+    return false;
+}
+
+std::vector<Field> Parse(const std::string& s) {
+    std::vector<Field> fields;
+    size_t pos = 0;
+    while (pos < s.size()) {
+        uint64_t tag, x;
+        EXPECT_TRUE(ReadVarint(s, pos, tag));
+        EXPECT_TRUE(ReadVarint(s, pos, x));
+        if ((tag & 7) == 2) {
+            EXPECT_LE(pos + x, s.size());
+            fields.push_back({uint32_t(tag >> 3), 0, s.substr(pos, x)});
+            pos += x;
+        } else {
+            EXPECT_EQ(tag & 7, 0);
+            fields.push_back({uint32_t(tag >> 3), x, ""});
+        }
+    }
+    return fields;
+}
+
+const Field* Get(const std::vector<Field>& fields, uint32_t number) {
+    for (auto& f : fields)
+        if (f.number == number) return &f;
+    return nullptr;
+}
+
+TEST(TraceRecorderTest, WritesPerfettoTrace) {
+    StartClean(64);
+    Work(2);
+    TraceRecorder::Stop();
+    auto threads = TraceRecorder::Drain();
+    std::string s;
+    TraceRecorder::WritePerfettoTrace(threads, s);
+
+    // Process, thread and counter tracks, then 8 events.
+    auto packets = Parse(s);
+    ASSERT_EQ(packets.size(), 3 + 8);
+    std::map<uint64_t, std::string> tracks;
+    int events = 0;
+    for (auto& packet : packets) {
+        EXPECT_EQ(packet.number, 1);
+        auto fields = Parse(packet.bytes);
+        if (auto descriptor = Get(fields, 60)) {
+            auto d = Parse(descriptor->bytes);
+            ASSERT_NE(Get(d, 1), nullptr);
+            std::string kind = Get(d, 3)   ? "process"
+                               : Get(d, 4) ? "thread"
+                               : Get(d, 8) ? Get(d, 2)->bytes
+                                           : "";
+            tracks[Get(d, 1)->value] = kind;
+            if (kind == "thread") {
+                auto thread = Parse(Get(d, 4)->bytes);
+                EXPECT_EQ(Get(thread, 2)->value, gettid());
+            }
+            continue;
+        }
+        auto track_event = Get(fields, 11);
+        ASSERT_NE(track_event, nullptr);
+        EXPECT_EQ(Get(fields, 8)->value, threads[0].events[events].time_ns);
+        EXPECT_EQ(Get(fields, 58)->value, 3);
+        EXPECT_NE(Get(fields, 10), nullptr);
+        auto e = Parse(track_event->bytes);
+        auto track = tracks.find(Get(e, 11)->value);
+        ASSERT_NE(track, tracks.end());
+        uint64_t type = Get(e, 9)->value;
+        EXPECT_EQ(track->second, type == 4 ? "count" : "thread");
+        if (type == 1) {
+            EXPECT_NE(Get(e, 23), nullptr);
+        }
+        ++events;
+    }
+    EXPECT_EQ(events, 8);
+}
+
+}  // namespace trace_recorder_test
@@ -0,0 +1,237 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "core/upload_queue.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "core/backend.h"
+#include "gtest/gtest.h"
+#include "proto/protobuf_util.h"
+
+namespace upload_queue_test {
+
+using namespace tuningfork;
+
+// A persister that keeps values in memory.
+class MemoryCache {
+   public:
+    std::map<uint64_t, std::string> values;
+    TuningFork_Cache c_cache{this, Set, Get, Remove};
+
+   private:
+    static TuningFork_ErrorCode Set(uint64_t key,
+                                    const TuningFork_CProtobufSerialization* v,
+                                    void* self) {
+        static_cast<MemoryCache*>(self)->values[key] = ToString(*v);
+        return TUNINGFORK_ERROR_OK;
+    }
+    static TuningFork_ErrorCode Get(uint64_t key,
+                                    TuningFork_CProtobufSerialization* v,
+                                    void* self) {
+        auto& values = static_cast<MemoryCache*>(self)->values;
+        auto it = values.find(key);
+        if (it == values.end()) return TUNINGFORK_ERROR_NO_SUCH_KEY;
+        ToCProtobufSerialization(it->second, *v);
+        return TUNINGFORK_ERROR_OK;
+    }
+    static TuningFork_ErrorCode Remove(uint64_t key, void* self) {
+        static_cast<MemoryCache*>(self)->values.erase(key);
+        return TUNINGFORK_ERROR_OK;
+    }
+};
+
+// The sessions that Front returns.
+std::vector<std::string> Front(UploadQueue& queue, size_t max_n = 8) {
+    std::vector<UploadQueue::Entry> entries;
+    queue.Front(max_n, entries);
+    std::vector<std::string> sessions;
+    for (auto& e : entries) sessions.push_back(e.evt_ser);
+    return sessions;
+}
+
+TuningFork_UploadQueueStats Stats(const UploadQueue& queue) {
+    TuningFork_UploadQueueStats stats;
+    queue.GetStats(stats);
+    return stats;
+}
+
+TEST(UploadQueueTest, FirstInFirstOut) {
+    MemoryCache cache;
+    UploadQueue queue(&cache.c_cache, 1000);
+    queue.Load();
+    EXPECT_EQ(queue.Push("one"), TUNINGFORK_ERROR_OK);
+    EXPECT_EQ(queue.Push("two"), TUNINGFORK_ERROR_OK);
+    EXPECT_EQ(queue.Push("three"), TUNINGFORK_ERROR_OK);
+    EXPECT_EQ(Front(queue, 2), (std::vector<std::string>{"one", "two"}));
+    queue.Pop(0);
+    EXPECT_EQ(Front(queue), (std::vector<std::string>{"two", "three"}));
+    auto stats = Stats(queue);
+    EXPECT_EQ(stats.queued_sessions, 2);
+    EXPECT_EQ(stats.queued_bytes, 8);
+    EXPECT_EQ(stats.dropped_sessions, 0);
+    queue.Pop(2);
+    EXPECT_TRUE(Front(queue).empty());
+    // Only the index is left.
+    EXPECT_EQ(cache.values.size(), 1);
+}
+
+TEST(UploadQueueTest, SurvivesRestart) {
+    MemoryCache cache;
+    {
+        UploadQueue queue(&cache.c_cache, 1000);
+        queue.Load();
+        queue.Push("one");
+        queue.Push("two");
+        queue.Pop(0);
+    }
+    UploadQueue queue(&cache.c_cache, 1000);
+    queue.Load();
+    queue.Push("three");
+    EXPECT_EQ(Front(queue), (std::vector<std::string>{"two", "three"}));
+}
+
+TEST(UploadQueueTest, EvictsOldestOverBudget) {
+    MemoryCache cache;
+    UploadQueue queue(&cache.c_cache, 10);
+    queue.Load();
+    queue.Push("aaaa");
+    queue.Push("bbbb");
+    queue.Push("cccc");
+    EXPECT_EQ(Front(queue), (std::vector<std::string>{"bbbb", "cccc"}));
+    EXPECT_EQ(Stats(queue).dropped_sessions, 1);
+    // Too big to ever fit.
+    EXPECT_EQ(queue.Push("dddddddddddd"), TUNINGFORK_ERROR_BAD_PARAMETER);
+    auto stats = Stats(queue);
+    EXPECT_EQ(stats.queued_sessions, 2);
+    EXPECT_EQ(stats.queued_bytes, 8);
+    EXPECT_EQ(stats.dropped_sessions, 2);
+}
+
+TEST(UploadQueueTest, EvictionDuringUpload) {
+    MemoryCache cache;
+    UploadQueue queue(&cache.c_cache, 10);
+    queue.Load();
+    queue.Push("aaaa");
+    queue.Push("bbbb");
+    std::vector<UploadQueue::Entry> batch;
+    queue.Front(8, batch);
+    ASSERT_EQ(batch.size(), 2);
+    // While the batch is being uploaded, new sessions evict it.
+    queue.Push("cccc");
+    queue.Push("dddd");
+    EXPECT_EQ(Stats(queue).dropped_sessions, 2);
+    // Popping the uploaded sessions leaves the new ones.
+    queue.Pop(batch[0].seq);
+    queue.Pop(batch[1].seq);
+    EXPECT_EQ(Front(queue), (std::vector<std::string>{"cccc", "dddd"}));
+    // Only evicting some of the batch leaves the rest to be popped.
+    queue.Front(8, batch);
+    ASSERT_EQ(batch.size(), 2);
+    queue.Push("eeee");
+    queue.Pop(batch[0].seq);
+    EXPECT_EQ(Front(queue), (std::vector<std::string>{"dddd", "eeee"}));
+    queue.Pop(batch[1].seq);
+    EXPECT_EQ(Front(queue), (std::vector<std::string>{"eeee"}));
+    auto stats = Stats(queue);
+    EXPECT_EQ(stats.queued_sessions, 1);
+    EXPECT_EQ(stats.dropped_sessions, 3);
+}
+
+TEST(UploadQueueTest, HoldsPausedSessions) {
+    MemoryCache cache;
+    {
+        UploadQueue queue(&cache.c_cache, 1000);
+        queue.Load();
+        queue.Push("one");
+        queue.Push("paused", true);
+        queue.Push("two");
+        std::vector<UploadQueue::Entry> batch;
+        queue.Front(8, batch);
+        ASSERT_EQ(batch.size(), 2);
+        EXPECT_EQ(batch[1].evt_ser, "two");
+        // Held sessions aren't popped with the uploaded ones.
+        queue.Pop(batch[1].seq);
+        EXPECT_TRUE(Front(queue).empty());
+        EXPECT_EQ(Stats(queue).queued_sessions, 1);
+        queue.ReplaceHeld("paused again");
+        EXPECT_EQ(Stats(queue).queued_sessions, 1);
+    }
+    // The next run takes them.
+    UploadQueue queue(&cache.c_cache, 1000);
+    queue.Load();
+    std::vector<std::string> held;
+    queue.TakeHeld(held);
+    EXPECT_EQ(held, (std::vector<std::string>{"paused again"}));
+    queue.TakeHeld(held);
+    EXPECT_TRUE(held.empty());
+    queue.Push("paused", true);
+    queue.RemoveHeld();
+    auto stats = Stats(queue);
+    EXPECT_EQ(stats.queued_sessions, 0);
+    EXPECT_EQ(stats.dropped_sessions, 0);
+    EXPECT_EQ(cache.values.size(), 1);
+}
+
+TEST(UploadQueueTest, MovesLegacySessionsIntoQueue) {
+    MemoryCache cache;
+    cache.values[HISTOGRAMS_UPLOADING] = "pending";
+    cache.values[HISTOGRAMS_PAUSED] = "paused";
+    {
+        UploadQueue queue(&cache.c_cache, 1000);
+        queue.Load();
+        EXPECT_EQ(cache.values.count(HISTOGRAMS_UPLOADING), 0);
+        EXPECT_EQ(cache.values.count(HISTOGRAMS_PAUSED), 0);
+    }
+    // Only once.
+    UploadQueue queue(&cache.c_cache, 1000);
+    queue.Load();
+    EXPECT_EQ(Front(queue), (std::vector<std::string>{"pending"}));
+    std::vector<std::string> held;
+    queue.TakeHeld(held);
+    EXPECT_EQ(held, (std::vector<std::string>{"paused"}));
+    EXPECT_EQ(Stats(queue).queued_sessions, 1);
+}
+
+TEST(UploadQueueTest, DropsCorruptSessions) {
+    MemoryCache cache;
+    UploadQueue queue(&cache.c_cache, 1000);
+    queue.Load();
+    queue.Push("one");
+    queue.Push("two");
+    cache.values[UPLOAD_QUEUE_FIRST_ENTRY].back() ^= 1;
+    EXPECT_EQ(Front(queue), (std::vector<std::string>{"two"}));
+    EXPECT_EQ(Stats(queue).dropped_sessions, 1);
+}
+
+TEST(UploadQueueTest, IgnoresCorruptIndex) {
+    MemoryCache cache;
+    {
+        UploadQueue queue(&cache.c_cache, 1000);
+        queue.Load();
+        queue.Push("one");
+    }
+    cache.values[UPLOAD_QUEUE_INDEX][5] ^= 1;
+    UploadQueue queue(&cache.c_cache, 1000);
+    queue.Load();
+    EXPECT_EQ(Stats(queue).queued_sessions, 0);
+    queue.Push("two");
+    EXPECT_EQ(Front(queue), (std::vector<std::string>{"two"}));
+}
+
+}  // namespace upload_queue_test